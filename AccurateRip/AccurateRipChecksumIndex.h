@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+// ========================================
+// A track checksum from the AccurateRip database
+// The database holds a single checksum per track and pressing, which may be
+// either a v1 or a v2 checksum
+// ========================================
+typedef struct {
+	uint32_t checksum;
+	uint32_t trackNumber;
+	uint32_t pressingIndex;		// The index of the AccurateRipDiscRecord the checksum came from
+	uint32_t confidenceLevel;
+} AccurateRipChecksumEntry;
+
+// ========================================
+// A flat, open-addressing hash table mapping (track number, checksum) to the
+// AccurateRip entries for a disc
+// Building the table walks the Core Data relationships once, so offset matching
+// costs a single probe per offset instead of a fetch per pressing
+// ========================================
+@interface AccurateRipChecksumIndex : NSObject
+{
+@private
+	AccurateRipChecksumEntry *_entries;
+	NSUInteger _capacity;		// Always a power of two
+	NSUInteger _count;
+	NSUInteger _pressingCount;
+}
+
+// ========================================
+// Creation
++ (id) checksumIndexWithAccurateRipDiscs:(NSSet *)accurateRipDiscs;
+// Indexes the offset checksums (the checksum of the sector six seconds into each track) instead
++ (id) offsetChecksumIndexWithAccurateRipDiscs:(NSSet *)accurateRipDiscs;
+
+- (id) initWithAccurateRipDiscs:(NSSet *)accurateRipDiscs;
+- (id) initWithAccurateRipDiscs:(NSSet *)accurateRipDiscs useOffsetChecksums:(BOOL)useOffsetChecksums;
+
+// Indexes a dBAR response directly, for discs that aren't in the store
+// Pressings with a different track count are skipped
++ (id) checksumIndexWithDatabaseResponse:(NSData *)responseData trackCount:(NSUInteger)trackCount;
+- (id) initWithDatabaseResponse:(NSData *)responseData trackCount:(NSUInteger)trackCount useOffsetChecksums:(BOOL)useOffsetChecksums;
+
+// ========================================
+// Properties
+@property (readonly) NSUInteger count;
+@property (readonly) NSUInteger pressingCount;
+
+// ========================================
+// Lookup
+// Returns YES if checksum is present for the track, and if match is not NULL stores
+// the entry with the highest confidence level there
+- (BOOL) findChecksum:(uint32_t)checksum forTrackNumber:(NSUInteger)trackNumber match:(AccurateRipChecksumEntry *)match;
+
+// ========================================
+// Batched offset verification across tracks
+// trackChecksums contains, for consecutive tracks beginning with firstTrackNumber, an NSData
+// of the v1 checksums for every offset in [-maximumOffsetInFrames, +maximumOffsetInFrames]
+// Returns an NSData of uint32_t holding, for each offset, the number of tracks matching an entry
+- (NSData *) matchingTrackCountsForChecksums:(NSArray *)trackChecksums firstTrackNumber:(NSUInteger)firstTrackNumber;
+
+@end
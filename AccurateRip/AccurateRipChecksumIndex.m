@@ -0,0 +1,233 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "AccurateRipChecksumIndex.h"
+#import "AccurateRipDiscRecord.h"
+#import "AccurateRipTrackRecord.h"
+
+// ========================================
+// Track numbers start at 1, so a zero track number marks an empty slot
+// ========================================
+static inline NSUInteger
+slotForChecksum(uint32_t checksum, NSUInteger trackNumber, NSUInteger capacity)
+{
+	uint32_t hash = (checksum ^ ((uint32_t)trackNumber * 0x9E3779B9u)) * 0x85EBCA6Bu;
+	hash ^= hash >> 16;
+	return hash & (capacity - 1);
+}
+
+// ========================================
+// The size of the dBAR pressing record at offset, from the record's own track count,
+// or 0 if the record is truncated
+// ========================================
+static inline NSUInteger
+pressingSizeAtOffset(const uint8_t *bytes, NSUInteger length, NSUInteger offset)
+{
+	if(offset + (1 + 4 + 4 + 4) > length)
+		return 0;
+	
+	NSUInteger pressingSize = (1 + 4 + 4 + 4) + (bytes[offset] * (1 + 4 + 4));
+	if(offset + pressingSize > length)
+		return 0;
+	
+	return pressingSize;
+}
+
+// ========================================
+// Private methods
+// ========================================
+@interface AccurateRipChecksumIndex (Private)
+- (BOOL) allocateEntriesForCount:(NSUInteger)count;
+- (void) addChecksum:(uint32_t)checksum forTrackNumber:(NSUInteger)trackNumber pressingIndex:(NSUInteger)pressingIndex confidenceLevel:(NSUInteger)confidenceLevel;
+@end
+
+@implementation AccurateRipChecksumIndex
+
+@synthesize count = _count;
+@synthesize pressingCount = _pressingCount;
+
++ (id) checksumIndexWithAccurateRipDiscs:(NSSet *)accurateRipDiscs
+{
+	return [[AccurateRipChecksumIndex alloc] initWithAccurateRipDiscs:accurateRipDiscs];
+}
+
++ (id) offsetChecksumIndexWithAccurateRipDiscs:(NSSet *)accurateRipDiscs
+{
+	return [[AccurateRipChecksumIndex alloc] initWithAccurateRipDiscs:accurateRipDiscs useOffsetChecksums:YES];
+}
+
++ (id) checksumIndexWithDatabaseResponse:(NSData *)responseData trackCount:(NSUInteger)trackCount
+{
+	return [[AccurateRipChecksumIndex alloc] initWithDatabaseResponse:responseData trackCount:trackCount useOffsetChecksums:NO];
+}
+
+- (id) initWithAccurateRipDiscs:(NSSet *)accurateRipDiscs
+{
+	return [self initWithAccurateRipDiscs:accurateRipDiscs useOffsetChecksums:NO];
+}
+
+- (id) initWithAccurateRipDiscs:(NSSet *)accurateRipDiscs useOffsetChecksums:(BOOL)useOffsetChecksums
+{
+	if((self = [super init])) {
+		// Sort the pressings so the indexes are stable
+		NSSortDescriptor *URLSortDescriptor = [[NSSortDescriptor alloc] initWithKey:@"URL.absoluteString" ascending:YES];
+		NSArray *pressings = [accurateRipDiscs.allObjects sortedArrayUsingDescriptors:[NSArray arrayWithObject:URLSortDescriptor]];
+		
+		NSUInteger trackCount = 0;
+		for(AccurateRipDiscRecord *accurateRipDisc in pressings)
+			trackCount += accurateRipDisc.tracks.count;
+		
+		if(![self allocateEntriesForCount:trackCount])
+			return nil;
+		
+		_pressingCount = pressings.count;
+		
+		NSUInteger pressingIndex = 0;
+		for(AccurateRipDiscRecord *accurateRipDisc in pressings) {
+			for(AccurateRipTrackRecord *accurateRipTrack in accurateRipDisc.tracks) {
+				NSUInteger trackNumber = accurateRipTrack.number.unsignedIntegerValue;
+				NSNumber *checksumNumber = (useOffsetChecksums ? accurateRipTrack.offsetChecksum : accurateRipTrack.checksum);
+				if(!trackNumber || !checksumNumber)
+					continue;
+				
+				[self addChecksum:checksumNumber.unsignedIntValue forTrackNumber:trackNumber pressingIndex:pressingIndex confidenceLevel:accurateRipTrack.confidenceLevel.unsignedIntegerValue];
+			}
+			
+			++pressingIndex;
+		}
+	}
+	return self;
+}
+
+- (id) initWithDatabaseResponse:(NSData *)responseData trackCount:(NSUInteger)trackCount useOffsetChecksums:(BOOL)useOffsetChecksums
+{
+	NSParameterAssert(nil != responseData);
+	NSParameterAssert(0 < trackCount);
+	
+	if((self = [super init])) {
+		// See AccurateRipQueryOperation for the layout of a dBAR response
+		// A response may contain pressings with other track counts, so each record is sized by its own
+		const uint8_t *bytes = [responseData bytes];
+		NSUInteger length = [responseData length];
+		
+		NSUInteger checksumCount = 0;
+		NSUInteger pressingSize;
+		for(NSUInteger offset = 0; (pressingSize = pressingSizeAtOffset(bytes, length, offset)); offset += pressingSize) {
+			if(bytes[offset] == trackCount)
+				checksumCount += trackCount;
+		}
+		
+		if(![self allocateEntriesForCount:checksumCount])
+			return nil;
+		
+		for(NSUInteger offset = 0; (pressingSize = pressingSizeAtOffset(bytes, length, offset)); offset += pressingSize) {
+			const uint8_t *pressing = bytes + offset;
+			
+			if(pressing[0] != trackCount)
+				continue;
+			
+			for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+				const uint8_t *track = pressing + (1 + 4 + 4 + 4) + (trackIndex * (1 + 4 + 4));
+				
+				uint32_t checksum = OSReadLittleInt32(track, (useOffsetChecksums ? 1 + 4 : 1));
+				if(!track[0] && !checksum)
+					continue;
+				
+				[self addChecksum:checksum forTrackNumber:(trackIndex + 1) pressingIndex:_pressingCount confidenceLevel:track[0]];
+			}
+			
+			++_pressingCount;
+		}
+	}
+	return self;
+}
+
+- (void) finalize
+{
+	free(_entries), _entries = NULL;
+	
+	[super finalize];
+}
+
+- (BOOL) findChecksum:(uint32_t)checksum forTrackNumber:(NSUInteger)trackNumber match:(AccurateRipChecksumEntry *)match
+{
+	const AccurateRipChecksumEntry *bestMatch = NULL;
+	
+	// The same checksum may be present for more than one pressing, so probe until an empty slot
+	NSUInteger slot = slotForChecksum(checksum, trackNumber, _capacity);
+	while(_entries[slot].trackNumber) {
+		const AccurateRipChecksumEntry *entry = &_entries[slot];
+		
+		if(entry->checksum == checksum && entry->trackNumber == trackNumber && (!bestMatch || entry->confidenceLevel > bestMatch->confidenceLevel))
+			bestMatch = entry;
+		
+		slot = (slot + 1) & (_capacity - 1);
+	}
+	
+	if(bestMatch && match)
+		*match = *bestMatch;
+	
+	return (NULL != bestMatch);
+}
+
+- (NSData *) matchingTrackCountsForChecksums:(NSArray *)trackChecksums firstTrackNumber:(NSUInteger)firstTrackNumber
+{
+	NSParameterAssert(nil != trackChecksums);
+	NSParameterAssert(0 < firstTrackNumber);
+	
+	if(!trackChecksums.count)
+		return nil;
+	
+	NSUInteger checksumsCount = [[trackChecksums objectAtIndex:0] length] / sizeof(uint32_t);
+	NSMutableData *matchCountsData = [NSMutableData dataWithLength:(checksumsCount * sizeof(uint32_t))];
+	uint32_t *matchCounts = [matchCountsData mutableBytes];
+	
+	NSUInteger trackNumber = firstTrackNumber;
+	for(NSData *checksumsData in trackChecksums) {
+		NSParameterAssert([checksumsData length] / sizeof(uint32_t) == checksumsCount);
+		
+		const uint32_t *checksums = [checksumsData bytes];
+		for(NSUInteger i = 0; i < checksumsCount; ++i) {
+			if([self findChecksum:checksums[i] forTrackNumber:trackNumber match:NULL])
+				++matchCounts[i];
+		}
+		
+		++trackNumber;
+	}
+	
+	return matchCountsData;
+}
+
+@end
+
+@implementation AccurateRipChecksumIndex (Private)
+
+- (BOOL) allocateEntriesForCount:(NSUInteger)count
+{
+	// Keep the load factor at or below 50%
+	_capacity = 16;
+	while(_capacity < 2 * count)
+		_capacity *= 2;
+	
+	_entries = calloc(_capacity, sizeof(AccurateRipChecksumEntry));
+	
+	return (NULL != _entries);
+}
+
+- (void) addChecksum:(uint32_t)checksum forTrackNumber:(NSUInteger)trackNumber pressingIndex:(NSUInteger)pressingIndex confidenceLevel:(NSUInteger)confidenceLevel
+{
+	NSUInteger slot = slotForChecksum(checksum, trackNumber, _capacity);
+	while(_entries[slot].trackNumber)
+		slot = (slot + 1) & (_capacity - 1);
+	
+	_entries[slot].checksum = checksum;
+	_entries[slot].trackNumber = (uint32_t)trackNumber;
+	_entries[slot].pressingIndex = (uint32_t)pressingIndex;
+	_entries[slot].confidenceLevel = (uint32_t)confidenceLevel;
+	
+	++_count;
+}
+
+@end
@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+// ========================================
+// How the cache and the network are consulted
+// ========================================
+enum _eAccurateRipCachePolicy {
+	eAccurateRipCachePolicyUseCache		= 0,	// Use unexpired cache entries, otherwise query the network (falling back to expired entries)
+	eAccurateRipCachePolicyRefresh		= 1,	// Always query the network, falling back to the cache if it is unavailable
+	eAccurateRipCachePolicyOffline		= 2		// Never query the network
+};
+typedef enum _eAccurateRipCachePolicy eAccurateRipCachePolicy;
+
+// ========================================
+// An on-disk cache of AccurateRip database (dBAR) responses
+// Responses are stored content-addressed by their SHA1 digest, and an append-only
+// index of fixed-size records maps (track count, disc ID 1, disc ID 2, FreeDB ID)
+// to the digest and the time the response was fetched
+// Later records supersede earlier ones for the same key; when the index is loaded
+// superseded records are dropped and the remaining records are kept sorted in memory
+// Discs that aren't present in AccurateRip are cached as well, with a separate
+// (usually shorter) expiration interval
+// Before the network is queried, the response is looked up in localDatabaseURL (if set),
+// a directory of dBAR .bin files laid out either flat or as on the AccurateRip server
+// ========================================
+@interface AccurateRipDatabaseCache : NSObject
+{
+@private
+	NSURL *_cacheURL;
+	NSMutableData *_index;
+	NSURL *_databaseURL;
+	NSURL *_localDatabaseURL;
+	NSTimeInterval _expirationInterval;
+	NSTimeInterval _notFoundExpirationInterval;
+}
+
+// ========================================
+// The shared cache, configured from the user defaults
++ (AccurateRipDatabaseCache *) sharedCache;
+
+- (id) initWithCacheURL:(NSURL *)cacheURL;
+
+// ========================================
+// Properties
+@property (readonly, copy) NSURL * cacheURL;
+
+// The base URL of the dBAR files, either AccurateRip or a local HTTP stand-in
+@property (copy) NSURL * databaseURL;
+// A directory of dBAR files that is consulted before the network
+@property (copy) NSURL * localDatabaseURL;
+
+@property (assign) NSTimeInterval expirationInterval;
+@property (assign) NSTimeInterval notFoundExpirationInterval;
+
+// ========================================
+// Returns the dBAR data for the disc, or nil
+// If the disc isn't present in AccurateRip nil is returned and error is not set
+// sourceURL receives the URL of the content-addressed cache file holding the data
+- (NSData *) dataForTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID cachePolicy:(eAccurateRipCachePolicy)cachePolicy sourceURL:(NSURL **)sourceURL error:(NSError **)error;
+
+// ========================================
+// Add dBAR data to the cache (for example, from bulk imports)
+// If data is nil the disc is recorded as not present in AccurateRip
+- (BOOL) storeData:(NSData *)data forTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID error:(NSError **)error;
+
+// The path of the dBAR file for the disc, relative to the database's base URL
+- (NSString *) relativePathForTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID;
+
+@end
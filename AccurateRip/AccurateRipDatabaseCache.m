@@ -0,0 +1,546 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+// Access to AccurateRip is regulated, see http://www.accuraterip.com/3rdparty-access.htm for details
+
+#import "AccurateRipDatabaseCache.h"
+#import "DigestUtilities.h"
+#import "Logger.h"
+
+#include <SystemConfiguration/SCNetwork.h>
+
+// ========================================
+// The index file begins with an 8 byte signature, followed by records of this
+// layout with all fields little endian
+// ========================================
+#define INDEX_SIGNATURE						"dBARIDX1"
+#define INDEX_SIGNATURE_LENGTH				8
+
+#define INDEX_RECORD_FLAG_NOT_FOUND			(1u << 0)
+
+typedef struct {
+	uint32_t trackCount;
+	uint32_t discID1;
+	uint32_t discID2;
+	uint32_t freeDBDiscID;
+	uint32_t flags;
+	uint32_t reserved;
+	int64_t timestamp;						// Seconds since the reference date, when the response was fetched
+	uint8_t digest [SHA1_DIGEST_LENGTH];	// The SHA1 of the response data
+	uint8_t padding [4];
+} AccurateRipCacheIndexRecord;
+
+// Index records are ordered by (track count, disc ID 1, disc ID 2, FreeDB ID)
+static int
+compareIndexRecordKeys(const void *a, const void *b)
+{
+	const AccurateRipCacheIndexRecord *lhs = (const AccurateRipCacheIndexRecord *)a;
+	const AccurateRipCacheIndexRecord *rhs = (const AccurateRipCacheIndexRecord *)b;
+
+	if(lhs->trackCount != rhs->trackCount)
+		return (lhs->trackCount < rhs->trackCount ? -1 : 1);
+	if(lhs->discID1 != rhs->discID1)
+		return (lhs->discID1 < rhs->discID1 ? -1 : 1);
+	if(lhs->discID2 != rhs->discID2)
+		return (lhs->discID2 < rhs->discID2 ? -1 : 1);
+	if(lhs->freeDBDiscID != rhs->freeDBDiscID)
+		return (lhs->freeDBDiscID < rhs->freeDBDiscID ? -1 : 1);
+
+	return 0;
+}
+
+static void
+swapIndexRecord(AccurateRipCacheIndexRecord *record, BOOL toHost)
+{
+	if(toHost) {
+		record->trackCount = OSSwapLittleToHostInt32(record->trackCount);
+		record->discID1 = OSSwapLittleToHostInt32(record->discID1);
+		record->discID2 = OSSwapLittleToHostInt32(record->discID2);
+		record->freeDBDiscID = OSSwapLittleToHostInt32(record->freeDBDiscID);
+		record->flags = OSSwapLittleToHostInt32(record->flags);
+		record->timestamp = (int64_t)OSSwapLittleToHostInt64(record->timestamp);
+	}
+	else {
+		record->trackCount = OSSwapHostToLittleInt32(record->trackCount);
+		record->discID1 = OSSwapHostToLittleInt32(record->discID1);
+		record->discID2 = OSSwapHostToLittleInt32(record->discID2);
+		record->freeDBDiscID = OSSwapHostToLittleInt32(record->freeDBDiscID);
+		record->flags = OSSwapHostToLittleInt32(record->flags);
+		record->timestamp = (int64_t)OSSwapHostToLittleInt64(record->timestamp);
+	}
+}
+
+// Timeouts when the cache can fall back to an expired response, and when it can't
+#define EXPIRED_ENTRY_REQUEST_TIMEOUT		10.0
+#define REQUEST_TIMEOUT						120.0
+
+// ========================================
+// Private methods
+// ========================================
+@interface AccurateRipDatabaseCache ()
+@property (copy) NSURL * cacheURL;
+@end
+
+@interface AccurateRipDatabaseCache (Private)
+- (NSString *) indexPath;
+- (NSString *) pathForDigest:(const uint8_t *)digest;
+- (void) loadIndex;
+- (BOOL) writeIndex:(NSError **)error;
+- (NSUInteger) indexOfRecordWithKey:(const AccurateRipCacheIndexRecord *)key found:(BOOL *)found;
+- (BOOL) findRecord:(AccurateRipCacheIndexRecord *)record forTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID;
+- (NSData *) dataForRecord:(const AccurateRipCacheIndexRecord *)record sourceURL:(NSURL **)sourceURL;
+- (BOOL) appendRecord:(const AccurateRipCacheIndexRecord *)record error:(NSError **)error;
+- (NSData *) localDataForRelativePath:(NSString *)relativePath;
+@end
+
+// ========================================
+// Static variables
+// ========================================
+static AccurateRipDatabaseCache *sSharedCache		= nil;
+
+@implementation AccurateRipDatabaseCache
+
+@synthesize cacheURL = _cacheURL;
+@synthesize databaseURL = _databaseURL;
+@synthesize localDatabaseURL = _localDatabaseURL;
+@synthesize expirationInterval = _expirationInterval;
+@synthesize notFoundExpirationInterval = _notFoundExpirationInterval;
+
++ (AccurateRipDatabaseCache *) sharedCache
+{
+	@synchronized(self) {
+		if(!sSharedCache) {
+			NSArray *cachesPaths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+			NSString *cachesPath = (0 < cachesPaths.count) ? [cachesPaths objectAtIndex:0] : NSTemporaryDirectory();
+			NSString *applicationName = [[NSBundle mainBundle] objectForInfoDictionaryKey:@"CFBundleName"];
+			NSString *cachePath = [[cachesPath stringByAppendingPathComponent:applicationName] stringByAppendingPathComponent:@"AccurateRip"];
+
+			sSharedCache = [[self alloc] initWithCacheURL:[NSURL fileURLWithPath:cachePath]];
+
+			NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+
+			NSString *databaseURLString = [userDefaults stringForKey:@"accurateRipDatabaseURL"];
+			if(databaseURLString)
+				sSharedCache.databaseURL = [NSURL URLWithString:databaseURLString];
+
+			NSString *localDatabasePath = [userDefaults stringForKey:@"accurateRipLocalDatabasePath"];
+			if(localDatabasePath)
+				sSharedCache.localDatabaseURL = [NSURL fileURLWithPath:[localDatabasePath stringByExpandingTildeInPath]];
+
+			if([userDefaults objectForKey:@"accurateRipCacheExpirationInterval"])
+				sSharedCache.expirationInterval = [userDefaults doubleForKey:@"accurateRipCacheExpirationInterval"];
+			if([userDefaults objectForKey:@"accurateRipCacheNotFoundExpirationInterval"])
+				sSharedCache.notFoundExpirationInterval = [userDefaults doubleForKey:@"accurateRipCacheNotFoundExpirationInterval"];
+		}
+	}
+
+	return sSharedCache;
+}
+
+- (id) initWithCacheURL:(NSURL *)cacheURL
+{
+	NSParameterAssert(nil != cacheURL);
+
+	if((self = [super init])) {
+		self.cacheURL = cacheURL;
+		self.databaseURL = [NSURL URLWithString:@"http://www.accuraterip.com/accuraterip"];
+		self.expirationInterval = 7 * 24 * 60 * 60;
+		self.notFoundExpirationInterval = 24 * 60 * 60;
+	}
+	return self;
+}
+
+- (NSString *) relativePathForTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID
+{
+	return [NSString stringWithFormat:@"%.1x/%.1x/%.1x/dBAR-%.3d-%.8x-%.8x-%.8x.bin",
+			discID1 & 0x0F,
+			(discID1 >> 4) & 0x0F,
+			(discID1 >> 8) & 0x0F,
+			trackCount,
+			discID1,
+			discID2,
+			freeDBDiscID];
+}
+
+- (NSData *) dataForTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID cachePolicy:(eAccurateRipCachePolicy)cachePolicy sourceURL:(NSURL **)sourceURL error:(NSError **)error
+{
+	AccurateRipCacheIndexRecord record;
+	BOOL haveRecord = [self findRecord:&record forTrackCount:trackCount discID1:discID1 discID2:discID2 freeDBDiscID:freeDBDiscID];
+
+	NSData *cachedData = nil;
+	NSURL *cachedDataURL = nil;
+	if(haveRecord && !(INDEX_RECORD_FLAG_NOT_FOUND & record.flags)) {
+		cachedData = [self dataForRecord:&record sourceURL:&cachedDataURL];
+
+		// A missing or damaged response is a cache miss
+		if(!cachedData)
+			haveRecord = NO;
+	}
+
+	// Use unexpired entries without touching the network
+	if(haveRecord && eAccurateRipCachePolicyRefresh != cachePolicy) {
+		NSTimeInterval age = [NSDate timeIntervalSinceReferenceDate] - (NSTimeInterval)record.timestamp;
+		NSTimeInterval expirationInterval = (INDEX_RECORD_FLAG_NOT_FOUND & record.flags) ? self.notFoundExpirationInterval : self.expirationInterval;
+
+		if(age < expirationInterval || eAccurateRipCachePolicyOffline == cachePolicy) {
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Using cached AccurateRip response (%.0f seconds old)", age];
+
+			if(sourceURL)
+				*sourceURL = cachedDataURL;
+			return cachedData;
+		}
+	}
+
+	NSString *relativePath = [self relativePathForTrackCount:trackCount discID1:discID1 discID2:discID2 freeDBDiscID:freeDBDiscID];
+
+	// Local copies of the database are preferred to the network
+	NSData *responseData = [self localDataForRelativePath:relativePath];
+	if(responseData)
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Using local AccurateRip response for %@", relativePath];
+	else if(eAccurateRipCachePolicyOffline == cachePolicy) {
+		if(error) {
+			NSMutableDictionary *errorDictionary = [NSMutableDictionary dictionary];
+
+			[errorDictionary setObject:NSLocalizedString(@"The disc was not found in the AccurateRip cache.", @"") forKey:NSLocalizedDescriptionKey];
+			[errorDictionary setObject:NSLocalizedString(@"AccurateRip is in offline mode, so only cached responses are available.", @"") forKey:NSLocalizedRecoverySuggestionErrorKey];
+
+			*error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:errorDictionary];
+		}
+
+		return nil;
+	}
+	else {
+		NSString *databaseURLString = [self.databaseURL absoluteString];
+		if(![databaseURLString hasSuffix:@"/"])
+			databaseURLString = [databaseURLString stringByAppendingString:@"/"];
+		NSURL *accurateRipURL = [NSURL URLWithString:[databaseURLString stringByAppendingString:relativePath]];
+		NSError *networkError = nil;
+
+		// Before doing anything, verify we can access the server
+		SCNetworkConnectionFlags flags;
+		NSString *host = [self.databaseURL host];
+		if(host && SCNetworkCheckReachabilityByName([host UTF8String], &flags) && !(kSCNetworkFlagsReachable & flags && !(kSCNetworkFlagsConnectionRequired & flags))) {
+			NSMutableDictionary *errorDictionary = [NSMutableDictionary dictionary];
+
+			[errorDictionary setObject:NSLocalizedString(@"A connection to AccurateRip could not be established.", @"") forKey:NSLocalizedDescriptionKey];
+			[errorDictionary setObject:NSLocalizedString(@"Please check your internet connection and try again.", @"") forKey:NSLocalizedRecoverySuggestionErrorKey];
+			[errorDictionary setObject:[self.databaseURL absoluteString] forKey:NSErrorFailingURLStringKey];
+
+			networkError = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:errorDictionary];
+		}
+		else {
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Querying %@", accurateRipURL];
+
+			// Don't wait long if there is an expired response to fall back on
+			NSURLRequest *request = [NSURLRequest requestWithURL:accurateRipURL
+													 cachePolicy:NSURLRequestReloadIgnoringLocalCacheData
+												 timeoutInterval:(haveRecord ? EXPIRED_ENTRY_REQUEST_TIMEOUT : REQUEST_TIMEOUT)];
+
+			NSHTTPURLResponse *accurateRipResponse = nil;
+			responseData = [NSURLConnection sendSynchronousRequest:request returningResponse:&accurateRipResponse error:&networkError];
+
+			// If the disc wasn't found in AccurateRip it isn't an error condition
+			if(responseData && [accurateRipResponse isKindOfClass:[NSHTTPURLResponse class]] && 404 == [accurateRipResponse statusCode]) {
+				[self storeData:nil forTrackCount:trackCount discID1:discID1 discID2:discID2 freeDBDiscID:freeDBDiscID error:NULL];
+				return nil;
+			}
+			else if(responseData && [accurateRipResponse isKindOfClass:[NSHTTPURLResponse class]] && 200 != [accurateRipResponse statusCode]) {
+				responseData = nil;
+				networkError = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil];
+			}
+		}
+
+		if(!responseData) {
+			// Expired responses are better than none
+			if(haveRecord) {
+				[[Logger sharedLogger] logMessage:NSLocalizedString(@"AccurateRip is unavailable, using the cached response", @"")];
+
+				if(sourceURL)
+					*sourceURL = cachedDataURL;
+				return cachedData;
+			}
+
+			if(error)
+				*error = networkError;
+			return nil;
+		}
+	}
+
+	NSError *storeError = nil;
+	if(![self storeData:responseData forTrackCount:trackCount discID1:discID1 discID2:discID2 freeDBDiscID:freeDBDiscID error:&storeError])
+		[[Logger sharedLogger] logMessage:@"Unable to cache AccurateRip response: %@", storeError];
+
+	if(sourceURL) {
+		uint8_t digest [SHA1_DIGEST_LENGTH];
+		SHA1Context sha1;
+		sha1Init(&sha1);
+		sha1Update(&sha1, [responseData bytes], [responseData length]);
+		sha1Final(&sha1, digest);
+
+		*sourceURL = [NSURL fileURLWithPath:[self pathForDigest:digest]];
+	}
+
+	return responseData;
+}
+
+- (BOOL) storeData:(NSData *)data forTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID error:(NSError **)error
+{
+	AccurateRipCacheIndexRecord record;
+	memset(&record, 0, sizeof(record));
+
+	record.trackCount = (uint32_t)trackCount;
+	record.discID1 = discID1;
+	record.discID2 = discID2;
+	record.freeDBDiscID = freeDBDiscID;
+	record.timestamp = (int64_t)[NSDate timeIntervalSinceReferenceDate];
+
+	if(data) {
+		SHA1Context sha1;
+		sha1Init(&sha1);
+		sha1Update(&sha1, [data bytes], [data length]);
+		sha1Final(&sha1, record.digest);
+
+		// Identical responses share storage
+		NSString *path = [self pathForDigest:record.digest];
+		if(![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+			if(![[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:error])
+				return NO;
+			if(![data writeToFile:path options:NSAtomicWrite error:error])
+				return NO;
+		}
+	}
+	else
+		record.flags = INDEX_RECORD_FLAG_NOT_FOUND;
+
+	return [self appendRecord:&record error:error];
+}
+
+@end
+
+@implementation AccurateRipDatabaseCache (Private)
+
+- (NSString *) indexPath
+{
+	return [self.cacheURL.path stringByAppendingPathComponent:@"index"];
+}
+
+- (NSString *) pathForDigest:(const uint8_t *)digest
+{
+	NSString *digestString = hexStringForDigest(digest, SHA1_DIGEST_LENGTH);
+	NSString *directory = [[self.cacheURL.path stringByAppendingPathComponent:@"objects"] stringByAppendingPathComponent:[digestString substringToIndex:2]];
+
+	return [directory stringByAppendingPathComponent:[digestString stringByAppendingPathExtension:@"bin"]];
+}
+
+- (void) loadIndex
+{
+	_index = [NSMutableData data];
+
+	NSData *indexData = [NSData dataWithContentsOfFile:[self indexPath] options:NSMappedRead error:NULL];
+	if(!indexData)
+		return;
+
+	if([indexData length] < INDEX_SIGNATURE_LENGTH || memcmp([indexData bytes], INDEX_SIGNATURE, INDEX_SIGNATURE_LENGTH)) {
+		[[Logger sharedLogger] logMessage:@"Discarding AccurateRip cache index with an unknown format"];
+		[self writeIndex:NULL];
+		return;
+	}
+
+	NSUInteger recordCount = ([indexData length] - INDEX_SIGNATURE_LENGTH) / sizeof(AccurateRipCacheIndexRecord);
+	[_index appendBytes:((const uint8_t *)[indexData bytes] + INDEX_SIGNATURE_LENGTH) length:(recordCount * sizeof(AccurateRipCacheIndexRecord))];
+
+	AccurateRipCacheIndexRecord *records = [_index mutableBytes];
+	for(NSUInteger i = 0; i < recordCount; ++i)
+		swapIndexRecord(records + i, YES);
+
+	// A stable sort keeps records for the same key in the order they were appended,
+	// so the last record of each run is the one that supersedes the others
+	if(recordCount)
+		mergesort(records, recordCount, sizeof(AccurateRipCacheIndexRecord), compareIndexRecordKeys);
+
+	NSUInteger uniqueRecordCount = 0;
+	for(NSUInteger i = 0; i < recordCount; ++i) {
+		if(uniqueRecordCount && !compareIndexRecordKeys(records + uniqueRecordCount - 1, records + i))
+			records[uniqueRecordCount - 1] = records[i];
+		else
+			records[uniqueRecordCount++] = records[i];
+	}
+
+	[_index setLength:(uniqueRecordCount * sizeof(AccurateRipCacheIndexRecord))];
+
+	// Rewrite the index without superseded or partial records
+	if(uniqueRecordCount != recordCount || ([indexData length] - INDEX_SIGNATURE_LENGTH) % sizeof(AccurateRipCacheIndexRecord)) {
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Compacting AccurateRip cache index (%lu records, %lu unique)", (unsigned long)recordCount, (unsigned long)uniqueRecordCount];
+
+		NSError *error = nil;
+		if(![self writeIndex:&error])
+			[[Logger sharedLogger] logMessage:@"Unable to compact AccurateRip cache index: %@", error];
+	}
+}
+
+- (BOOL) writeIndex:(NSError **)error
+{
+	NSUInteger recordCount = [_index length] / sizeof(AccurateRipCacheIndexRecord);
+	const AccurateRipCacheIndexRecord *records = [_index bytes];
+
+	NSMutableData *indexData = [NSMutableData dataWithBytes:INDEX_SIGNATURE length:INDEX_SIGNATURE_LENGTH];
+	for(NSUInteger i = 0; i < recordCount; ++i) {
+		AccurateRipCacheIndexRecord swappedRecord = records[i];
+		swapIndexRecord(&swappedRecord, NO);
+		[indexData appendBytes:&swappedRecord length:sizeof(swappedRecord)];
+	}
+
+	if(![[NSFileManager defaultManager] createDirectoryAtPath:self.cacheURL.path withIntermediateDirectories:YES attributes:nil error:error])
+		return NO;
+
+	return [indexData writeToFile:[self indexPath] options:NSAtomicWrite error:error];
+}
+
+// Returns the position of the record for key in the sorted index, or the position at which it would be inserted
+- (NSUInteger) indexOfRecordWithKey:(const AccurateRipCacheIndexRecord *)key found:(BOOL *)found
+{
+	NSParameterAssert(NULL != key);
+	NSParameterAssert(NULL != found);
+
+	const AccurateRipCacheIndexRecord *records = [_index bytes];
+	NSUInteger low = 0;
+	NSUInteger high = [_index length] / sizeof(AccurateRipCacheIndexRecord);
+
+	while(low < high) {
+		NSUInteger middle = low + ((high - low) / 2);
+		int result = compareIndexRecordKeys(records + middle, key);
+
+		if(0 == result) {
+			*found = YES;
+			return middle;
+		}
+		else if(0 > result)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	*found = NO;
+	return low;
+}
+
+- (BOOL) findRecord:(AccurateRipCacheIndexRecord *)record forTrackCount:(NSUInteger)trackCount discID1:(uint32_t)discID1 discID2:(uint32_t)discID2 freeDBDiscID:(uint32_t)freeDBDiscID
+{
+	NSParameterAssert(NULL != record);
+
+	AccurateRipCacheIndexRecord key;
+	memset(&key, 0, sizeof(key));
+
+	key.trackCount = (uint32_t)trackCount;
+	key.discID1 = discID1;
+	key.discID2 = discID2;
+	key.freeDBDiscID = freeDBDiscID;
+
+	@synchronized(self) {
+		if(!_index)
+			[self loadIndex];
+
+		BOOL found = NO;
+		NSUInteger i = [self indexOfRecordWithKey:&key found:&found];
+		if(found) {
+			*record = ((const AccurateRipCacheIndexRecord *)[_index bytes])[i];
+			return YES;
+		}
+	}
+
+	return NO;
+}
+
+- (NSData *) dataForRecord:(const AccurateRipCacheIndexRecord *)record sourceURL:(NSURL **)sourceURL
+{
+	NSParameterAssert(NULL != record);
+
+	NSString *path = [self pathForDigest:record->digest];
+	NSData *data = [NSData dataWithContentsOfFile:path];
+	if(!data)
+		return nil;
+
+	// Verify the contents match the address
+	uint8_t digest [SHA1_DIGEST_LENGTH];
+	SHA1Context sha1;
+	sha1Init(&sha1);
+	sha1Update(&sha1, [data bytes], [data length]);
+	sha1Final(&sha1, digest);
+
+	if(memcmp(digest, record->digest, SHA1_DIGEST_LENGTH)) {
+		[[Logger sharedLogger] logMessage:@"Cached AccurateRip response %@ is damaged", path];
+		return nil;
+	}
+
+	if(sourceURL)
+		*sourceURL = [NSURL fileURLWithPath:path];
+
+	return data;
+}
+
+- (BOOL) appendRecord:(const AccurateRipCacheIndexRecord *)record error:(NSError **)error
+{
+	NSParameterAssert(NULL != record);
+
+	AccurateRipCacheIndexRecord swappedRecord = *record;
+	swapIndexRecord(&swappedRecord, NO);
+
+	@synchronized(self) {
+		if(!_index)
+			[self loadIndex];
+
+		NSString *indexPath = [self indexPath];
+		NSFileManager *fileManager = [NSFileManager defaultManager];
+
+		if(![fileManager fileExistsAtPath:indexPath]) {
+			if(![fileManager createDirectoryAtPath:self.cacheURL.path withIntermediateDirectories:YES attributes:nil error:error])
+				return NO;
+			if(![[NSData dataWithBytes:INDEX_SIGNATURE length:INDEX_SIGNATURE_LENGTH] writeToFile:indexPath options:NSAtomicWrite error:error])
+				return NO;
+		}
+
+		NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:indexPath];
+		if(!fileHandle) {
+			if(error)
+				*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:[NSDictionary dictionaryWithObject:indexPath forKey:NSFilePathErrorKey]];
+			return NO;
+		}
+
+		// Drop any partial record left by an interrupted write
+		unsigned long long length = [fileHandle seekToEndOfFile];
+		unsigned long long partialRecordLength = (length - INDEX_SIGNATURE_LENGTH) % sizeof(AccurateRipCacheIndexRecord);
+		if(partialRecordLength)
+			[fileHandle truncateFileAtOffset:(length - partialRecordLength)];
+
+		[fileHandle writeData:[NSData dataWithBytes:&swappedRecord length:sizeof(swappedRecord)]];
+		[fileHandle closeFile];
+
+		// Keep the in-memory index sorted, replacing any record this one supersedes
+		BOOL found = NO;
+		NSUInteger i = [self indexOfRecordWithKey:record found:&found];
+		NSRange range = NSMakeRange(i * sizeof(AccurateRipCacheIndexRecord), (found ? sizeof(AccurateRipCacheIndexRecord) : 0));
+		[_index replaceBytesInRange:range withBytes:record length:sizeof(AccurateRipCacheIndexRecord)];
+	}
+
+	return YES;
+}
+
+- (NSData *) localDataForRelativePath:(NSString *)relativePath
+{
+	NSParameterAssert(nil != relativePath);
+
+	if(!self.localDatabaseURL)
+		return nil;
+
+	// Files may be laid out as on the server or in a single directory
+	NSString *localDatabasePath = self.localDatabaseURL.path;
+	NSData *data = [NSData dataWithContentsOfFile:[localDatabasePath stringByAppendingPathComponent:relativePath]];
+	if(!data)
+		data = [NSData dataWithContentsOfFile:[localDatabasePath stringByAppendingPathComponent:[relativePath lastPathComponent]]];
+
+	return data;
+}
+
+@end
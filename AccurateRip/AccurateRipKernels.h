@@ -0,0 +1,49 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#include <Foundation/Foundation.h>
+
+// ========================================
+// The per-sector sums from which AccurateRip checksums are built
+// Samples are the 32-bit little endian stereo frames of a CDDA sector, and the
+// position of the first frame is supplied by the caller
+// All sums are modulo 2^32
+// ========================================
+typedef struct {
+	uint32_t sumOfSamples;					// sum(sample[i])
+	uint32_t sumOfSamplesAndPositions;		// sum(low 32 bits of sample[i] * (firstPosition + i)), the v1 checksum
+	uint32_t sumOfProductHighWords;			// sum(high 32 bits of sample[i] * (firstPosition + i)), added to the v1 checksum for v2
+} AccurateRipBlockSums;
+
+typedef void (*AccurateRipBlockSumsFunction)(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums);
+
+// ========================================
+// The available implementations
+// ========================================
+enum _eAccurateRipKernel {
+	eAccurateRipKernelScalar		= 0,
+	eAccurateRipKernelSSE41			= 1,
+	eAccurateRipKernelAVX2			= 2,
+	eAccurateRipKernelNEON			= 3
+};
+typedef enum _eAccurateRipKernel eAccurateRipKernel;
+
+// ========================================
+// Calculate the sums for a sector (2352 bytes) of CDDA audio using the fastest
+// implementation supported by the processor
+// block need not be aligned
+// ========================================
+void accurateRipBlockSums(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums);
+
+// ========================================
+// Returns the specified implementation, or NULL if it isn't supported by the
+// compiler or processor (used for testing)
+// ========================================
+AccurateRipBlockSumsFunction accurateRipBlockSumsKernel(eAccurateRipKernel kernel);
+
+// A description of the selected implementation, suitable for logging
+NSString * accurateRipKernelDescription(void);
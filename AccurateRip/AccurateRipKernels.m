@@ -0,0 +1,269 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#include "AccurateRipKernels.h"
+#include "CDDAUtilities.h"
+#include "CPUFeatures.h"
+
+#include <libkern/OSByteOrder.h>
+#include <pthread.h>
+#include <string.h>
+
+// ========================================
+// The x86 kernels rely on per-function target attributes, which require a
+// compiler that understands them; older compilers get the scalar code only
+// ========================================
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#  define ENABLE_X86_ACCURATERIP_KERNELS 1
+#  include <immintrin.h>
+#endif
+
+#if defined(__arm64__) || defined(__aarch64__)
+#  define ENABLE_NEON_ACCURATERIP_KERNEL 1
+#  include <arm_neon.h>
+#endif
+
+static pthread_once_t					sAccurateRipKernelOnce			= PTHREAD_ONCE_INIT;
+static AccurateRipBlockSumsFunction		sAccurateRipBlockSums			= NULL;
+static const char						*sAccurateRipKernelName			= NULL;
+
+// ========================================
+// Scalar reference implementation, also used for the frames left over by the vector kernels
+// ========================================
+static void
+accumulateFramesScalar(const uint8_t *frames, NSUInteger frameCount, uint32_t firstPosition, AccurateRipBlockSums *sums)
+{
+	uint32_t position = firstPosition;
+
+	for(NSUInteger i = 0; i < frameCount; ++i) {
+		uint32_t sample;
+		memcpy(&sample, frames + (4 * i), sizeof(sample));
+		sample = OSSwapLittleToHostInt32(sample);
+
+		uint64_t product = (uint64_t)sample * position++;
+
+		sums->sumOfSamples += sample;
+		sums->sumOfSamplesAndPositions += (uint32_t)product;
+		sums->sumOfProductHighWords += (uint32_t)(product >> 32);
+	}
+}
+
+static void
+accurateRipBlockSumsScalar(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums)
+{
+	memset(sums, 0, sizeof(AccurateRipBlockSums));
+	accumulateFramesScalar(block, AUDIO_FRAMES_PER_CDDA_SECTOR, firstPosition, sums);
+}
+
+#if ENABLE_X86_ACCURATERIP_KERNELS
+
+// ========================================
+// SSE4.1, four frames at a time
+// The low words of the products come from pmulld, the high words from pmuludq
+// on the even and odd lanes
+// ========================================
+__attribute__((target("sse4.1")))
+static uint32_t
+horizontalSumSSE41(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+	return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse4.1")))
+static void
+accurateRipBlockSumsSSE41(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums)
+{
+	const uint8_t *frames = block;
+
+	__m128i positions = _mm_add_epi32(_mm_set1_epi32((int)firstPosition), _mm_setr_epi32(0, 1, 2, 3));
+	const __m128i increment = _mm_set1_epi32(4);
+
+	__m128i sumOfSamples = _mm_setzero_si128();
+	__m128i sumOfLowWords = _mm_setzero_si128();
+	__m128i sumOfHighWords = _mm_setzero_si128();
+
+	// AUDIO_FRAMES_PER_CDDA_SECTOR is a multiple of 4
+	for(NSUInteger i = 0; i < AUDIO_FRAMES_PER_CDDA_SECTOR; i += 4) {
+		__m128i samples = _mm_loadu_si128((const __m128i *)(frames + (4 * i)));
+
+		__m128i evenProducts = _mm_mul_epu32(samples, positions);
+		__m128i oddProducts = _mm_mul_epu32(_mm_srli_epi64(samples, 32), _mm_srli_epi64(positions, 32));
+		__m128i highWords = _mm_blend_epi16(_mm_srli_epi64(evenProducts, 32), oddProducts, 0xCC);
+
+		sumOfSamples = _mm_add_epi32(sumOfSamples, samples);
+		sumOfLowWords = _mm_add_epi32(sumOfLowWords, _mm_mullo_epi32(samples, positions));
+		sumOfHighWords = _mm_add_epi32(sumOfHighWords, highWords);
+
+		positions = _mm_add_epi32(positions, increment);
+	}
+
+	sums->sumOfSamples = horizontalSumSSE41(sumOfSamples);
+	sums->sumOfSamplesAndPositions = horizontalSumSSE41(sumOfLowWords);
+	sums->sumOfProductHighWords = horizontalSumSSE41(sumOfHighWords);
+}
+
+// ========================================
+// AVX2, eight frames at a time
+// ========================================
+__attribute__((target("avx2")))
+static uint32_t
+horizontalSumAVX2(__m256i v)
+{
+	__m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4E));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0xB1));
+	return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+__attribute__((target("avx2")))
+static void
+accurateRipBlockSumsAVX2(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums)
+{
+	const uint8_t *frames = block;
+
+	__m256i positions = _mm256_add_epi32(_mm256_set1_epi32((int)firstPosition), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m256i increment = _mm256_set1_epi32(8);
+
+	__m256i sumOfSamples = _mm256_setzero_si256();
+	__m256i sumOfLowWords = _mm256_setzero_si256();
+	__m256i sumOfHighWords = _mm256_setzero_si256();
+
+	NSUInteger i = 0;
+	for(; i + 8 <= AUDIO_FRAMES_PER_CDDA_SECTOR; i += 8) {
+		__m256i samples = _mm256_loadu_si256((const __m256i *)(frames + (4 * i)));
+
+		__m256i evenProducts = _mm256_mul_epu32(samples, positions);
+		__m256i oddProducts = _mm256_mul_epu32(_mm256_srli_epi64(samples, 32), _mm256_srli_epi64(positions, 32));
+		__m256i highWords = _mm256_blend_epi32(_mm256_srli_epi64(evenProducts, 32), oddProducts, 0xAA);
+
+		sumOfSamples = _mm256_add_epi32(sumOfSamples, samples);
+		sumOfLowWords = _mm256_add_epi32(sumOfLowWords, _mm256_mullo_epi32(samples, positions));
+		sumOfHighWords = _mm256_add_epi32(sumOfHighWords, highWords);
+
+		positions = _mm256_add_epi32(positions, increment);
+	}
+
+	sums->sumOfSamples = horizontalSumAVX2(sumOfSamples);
+	sums->sumOfSamplesAndPositions = horizontalSumAVX2(sumOfLowWords);
+	sums->sumOfProductHighWords = horizontalSumAVX2(sumOfHighWords);
+
+	// 588 frames leave 4 over
+	accumulateFramesScalar(frames + (4 * i), AUDIO_FRAMES_PER_CDDA_SECTOR - i, firstPosition + (uint32_t)i, sums);
+}
+
+#endif /* ENABLE_X86_ACCURATERIP_KERNELS */
+
+#if ENABLE_NEON_ACCURATERIP_KERNEL
+
+// ========================================
+// NEON, four frames at a time
+// ========================================
+static void
+accurateRipBlockSumsNEON(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums)
+{
+	const uint8_t *frames = block;
+
+	static const uint32_t laneOffsets [4] = { 0, 1, 2, 3 };
+	uint32x4_t positions = vaddq_u32(vdupq_n_u32(firstPosition), vld1q_u32(laneOffsets));
+	const uint32x4_t increment = vdupq_n_u32(4);
+
+	uint32x4_t sumOfSamples = vdupq_n_u32(0);
+	uint32x4_t sumOfLowWords = vdupq_n_u32(0);
+	uint32x4_t sumOfHighWords = vdupq_n_u32(0);
+
+	// AUDIO_FRAMES_PER_CDDA_SECTOR is a multiple of 4
+	for(NSUInteger i = 0; i < AUDIO_FRAMES_PER_CDDA_SECTOR; i += 4) {
+		uint32x4_t samples = vreinterpretq_u32_u8(vld1q_u8(frames + (4 * i)));
+
+		uint64x2_t lowProducts = vmull_u32(vget_low_u32(samples), vget_low_u32(positions));
+		uint64x2_t highProducts = vmull_u32(vget_high_u32(samples), vget_high_u32(positions));
+		uint32x4_t highWords = vcombine_u32(vshrn_n_u64(lowProducts, 32), vshrn_n_u64(highProducts, 32));
+
+		sumOfSamples = vaddq_u32(sumOfSamples, samples);
+		sumOfLowWords = vmlaq_u32(sumOfLowWords, samples, positions);
+		sumOfHighWords = vaddq_u32(sumOfHighWords, highWords);
+
+		positions = vaddq_u32(positions, increment);
+	}
+
+	sums->sumOfSamples = vaddvq_u32(sumOfSamples);
+	sums->sumOfSamplesAndPositions = vaddvq_u32(sumOfLowWords);
+	sums->sumOfProductHighWords = vaddvq_u32(sumOfHighWords);
+}
+
+#endif /* ENABLE_NEON_ACCURATERIP_KERNEL */
+
+// ========================================
+// Runtime selection of the implementation
+// ========================================
+static void
+selectAccurateRipKernel(void)
+{
+	sAccurateRipBlockSums = accurateRipBlockSumsScalar;
+	sAccurateRipKernelName = "scalar";
+
+#if ENABLE_X86_ACCURATERIP_KERNELS
+	if(cpuHasFeatures(eCPUFeatureAVX2)) {
+		sAccurateRipBlockSums = accurateRipBlockSumsAVX2;
+		sAccurateRipKernelName = "AVX2";
+	}
+	else if(cpuHasFeatures(eCPUFeatureSSE41)) {
+		sAccurateRipBlockSums = accurateRipBlockSumsSSE41;
+		sAccurateRipKernelName = "SSE4.1";
+	}
+#endif
+
+#if ENABLE_NEON_ACCURATERIP_KERNEL
+	if(cpuHasFeatures(eCPUFeatureNEON)) {
+		sAccurateRipBlockSums = accurateRipBlockSumsNEON;
+		sAccurateRipKernelName = "NEON";
+	}
+#endif
+}
+
+void
+accurateRipBlockSums(const void *block, uint32_t firstPosition, AccurateRipBlockSums *sums)
+{
+	NSCParameterAssert(NULL != block);
+	NSCParameterAssert(NULL != sums);
+
+	pthread_once(&sAccurateRipKernelOnce, selectAccurateRipKernel);
+
+	sAccurateRipBlockSums(block, firstPosition, sums);
+}
+
+AccurateRipBlockSumsFunction
+accurateRipBlockSumsKernel(eAccurateRipKernel kernel)
+{
+	switch(kernel) {
+		case eAccurateRipKernelScalar:
+			return accurateRipBlockSumsScalar;
+
+#if ENABLE_X86_ACCURATERIP_KERNELS
+		case eAccurateRipKernelSSE41:
+			return (cpuHasFeatures(eCPUFeatureSSE41) ? accurateRipBlockSumsSSE41 : NULL);
+		case eAccurateRipKernelAVX2:
+			return (cpuHasFeatures(eCPUFeatureAVX2) ? accurateRipBlockSumsAVX2 : NULL);
+#endif
+
+#if ENABLE_NEON_ACCURATERIP_KERNEL
+		case eAccurateRipKernelNEON:
+			return (cpuHasFeatures(eCPUFeatureNEON) ? accurateRipBlockSumsNEON : NULL);
+#endif
+
+		default:
+			return NULL;
+	}
+}
+
+NSString *
+accurateRipKernelDescription(void)
+{
+	pthread_once(&sAccurateRipKernelOnce, selectAccurateRipKernel);
+
+	return [NSString stringWithUTF8String:sAccurateRipKernelName];
+}
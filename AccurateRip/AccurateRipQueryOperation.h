@@ -1,25 +1,35 @@
 /*
- *  Copyright (C) 2008 Stephen F. Booth <me@sbooth.org>
+ *  Copyright (C) 2008 - 2009 Stephen F. Booth <me@sbooth.org>
  *  All Rights Reserved
  */
 
 #import <Cocoa/Cocoa.h>
+#import "AccurateRipDatabaseCache.h"
 
 // ========================================
 // An NSOperation subclass that queries the AccurateRip database for a 
 // specific compact disc, and if found, creates the appropriate Core Data
 // representation of the returned data
+// Responses come from the shared AccurateRipDatabaseCache, so repeated queries
+// for the same disc don't wait on the network
+// Each response (or its absence) is also recorded in the disc's identity; if
+// useDiscIdentity is set unexpired cached responses are used even when the cache
+// policy is to refresh, and the identity's response is used if the lookup fails
 // ========================================
 @interface AccurateRipQueryOperation : NSOperation
 {
 @private
 	NSManagedObjectID *_compactDiscID;
+	eAccurateRipCachePolicy _cachePolicy;
+	BOOL _useDiscIdentity;
 	NSError *_error;
 }
 
 // ========================================
 // Properties affecting the query
 @property (copy) NSManagedObjectID * compactDiscID;
+@property (assign) eAccurateRipCachePolicy cachePolicy;
+@property (assign) BOOL useDiscIdentity;
 
 // ========================================
 // Properties set after the query is complete (or cancelled)
@@ -11,11 +11,10 @@
 #import "TrackDescriptor.h"
 #import "AccurateRipDiscRecord.h"
 #import "AccurateRipTrackRecord.h"
+#import "DiscIdentityCache.h"
 #import "Logger.h"
 #import "ApplicationDelegate.h"
 
-#include <SystemConfiguration/SCNetwork.h>
-
 @interface AccurateRipQueryOperation ()
 @property (copy) NSError *error;
 @end
@@ -25,27 +24,21 @@
 // ========================================
 // Properties
 @synthesize compactDiscID = _compactDiscID;
+@synthesize cachePolicy = _cachePolicy;
+@synthesize useDiscIdentity = _useDiscIdentity;
 @synthesize error = _error;
 
+- (id) init
+{
+	if((self = [super init]))
+		self.cachePolicy = (eAccurateRipCachePolicy)[[NSUserDefaults standardUserDefaults] integerForKey:@"accurateRipCachePolicy"];
+	return self;
+}
+
 - (void) main
 {
 	NSAssert(nil != self.compactDiscID, @"self.compactDiscID may not be nil");
 
-	// Before doing anything, verify we can access the AccurateRip web site
-	SCNetworkConnectionFlags flags;
-	if(SCNetworkCheckReachabilityByName("www.accuraterip.com", &flags)) {
-		if(!(kSCNetworkFlagsReachable & flags && !(kSCNetworkFlagsConnectionRequired & flags))) {
-			NSMutableDictionary *errorDictionary = [NSMutableDictionary dictionary];
-			
-			[errorDictionary setObject:NSLocalizedString(@"A connection to AccurateRip could not be established.", @"") forKey:NSLocalizedDescriptionKey];
-			[errorDictionary setObject:NSLocalizedString(@"Please check your internet connection and try again.", @"") forKey:NSLocalizedRecoverySuggestionErrorKey];
-			[errorDictionary setObject:[NSURL URLWithString:@"www.accuraterip.com"] forKey:NSErrorFailingURLStringKey];
-			
-			self.error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:errorDictionary];
-			return;
-		}
-	}
-	
 	// Create our own context for accessing the store
 	NSManagedObjectContext *managedObjectContext = [[NSManagedObjectContext alloc] init];
 	[managedObjectContext setPersistentStoreCoordinator:[(ApplicationDelegate *)[[NSApplication sharedApplication] delegate] persistentStoreCoordinator]];
@@ -65,36 +58,61 @@
 	// Use the first session
 	NSSet *sessionTracks = compactDisc.firstSession.tracks;
 	
-	// Build the URL
-	NSURL *accurateRipURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://www.accuraterip.com/accuraterip/%.1x/%.1x/%.1x/dBAR-%.3d-%.8x-%.8x-%.8x.bin",
-												  accurateRipID1 & 0x0F,
-												  (accurateRipID1 >> 4) & 0x0F,
-												  (accurateRipID1 >> 8) & 0x0F,
-												  sessionTracks.count,
-												  accurateRipID1,
-												  accurateRipID2,
-												  compactDisc.freeDBDiscID]];
-	
-	[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Querying %@", accurateRipURL];
+	NSURL *accurateRipURL = nil;
+	NSError *error = nil;
+	NSData *accurateRipResponseData = nil;
+
+	// The response recorded in the disc's identity expires like any other, so rather than being used as-is
+	// it is looked up in the cache, which only queries the network once the response has expired
+	eAccurateRipCachePolicy cachePolicy = self.cachePolicy;
+	if(self.useDiscIdentity && eAccurateRipCachePolicyRefresh == cachePolicy)
+		cachePolicy = eAccurateRipCachePolicyUseCache;
+
+	// Fetch the dBAR file, from the cache if possible
+	accurateRipResponseData = [[AccurateRipDatabaseCache sharedCache] dataForTrackCount:sessionTracks.count
+																				discID1:(uint32_t)accurateRipID1
+																				discID2:(uint32_t)accurateRipID2
+																		   freeDBDiscID:(uint32_t)compactDisc.freeDBDiscID
+																			cachePolicy:cachePolicy
+																			  sourceURL:&accurateRipURL
+																				  error:&error];
+
+	NSDictionary *identity = (self.useDiscIdentity ? [[DiscIdentityCache sharedCache] identityForDiscTOC:compactDisc.discTOC] : nil);
+	if(!accurateRipResponseData && error && [identity objectForKey:kDiscIdentityAccurateRipResponseKey]) {
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Using the AccurateRip response from the disc's identity: %@", error];
+
+		// An empty response means the disc wasn't found
+		accurateRipResponseData = [identity objectForKey:kDiscIdentityAccurateRipResponseKey];
+		if(![accurateRipResponseData length])
+			accurateRipResponseData = nil;
+		accurateRipURL = [identity objectForKey:kDiscIdentityAccurateRipResponseURLKey];
+		error = nil;
+	}
+	// Remember the response with the disc
+	else if(accurateRipResponseData || !error) {
+		NSMutableDictionary *values = [NSMutableDictionary dictionary];
+
+		[values setObject:(accurateRipResponseData ? accurateRipResponseData : [NSData data]) forKey:kDiscIdentityAccurateRipResponseKey];
+		[values setObject:(accurateRipURL ? (id)accurateRipURL : (id)[NSNull null]) forKey:kDiscIdentityAccurateRipResponseURLKey];
 
-	// Create a request for the URL with a 2 minute timeout
-	NSURLRequest *request = [NSURLRequest requestWithURL:accurateRipURL
-											 cachePolicy:NSURLRequestUseProtocolCachePolicy
-										 timeoutInterval:120.0];
+		NSError *identityError = nil;
+		if(![[DiscIdentityCache sharedCache] updateIdentityForDiscTOC:compactDisc.discTOC withValues:values error:&identityError])
+			[[Logger sharedLogger] logMessage:@"Unable to cache the disc's identity: %@", identityError];
+	}
 	
-	NSHTTPURLResponse *accurateRipResponse = nil;
-	NSError *error = nil;
-	NSData *accurateRipResponseData = [NSURLConnection sendSynchronousRequest:request 
-															returningResponse:&accurateRipResponse 
-																		error:&error];
+	// If the disc wasn't found in AccurateRip it isn't an error condition
 	if(!accurateRipResponseData) {
-		self.error = error;
+		if(error)
+			self.error = error;
+		else
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Disc not found in AccurateRip"];
 		return;
 	}
 	
-	// If the disc wasn't found in AccurateRip it isn't an error condition
-	if(404 == [accurateRipResponse statusCode]) {
-		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Disc not found in AccurateRip"];
+	// The cached responses are content-addressed, so if the existing records were created from this
+	// response there is nothing to do
+	if(accurateRipURL && compactDisc.accurateRipDiscs.count && [[compactDisc.accurateRipDiscs valueForKey:@"URL"] isEqualToSet:[NSSet setWithObject:accurateRipURL]]) {
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"AccurateRip data is unchanged"];
 		return;
 	}
 	
@@ -124,14 +142,16 @@
 	//   4 bytes (LE) for the track's CRC				[arTrackCRC]
 	//   4 bytes (LE) for offset CRC					[arOffsetChecksum]
 	
-	NSUInteger accurateRipDiscDataSize = (1 + 4 + 4 + 4) + (orderedTracks.count * (1 + 4 + 4));
-	NSUInteger accurateRipPressingCount = [accurateRipResponseData length] / accurateRipDiscDataSize;
-	
-	NSUInteger pressingDataOffset = 0;
-	for(NSUInteger pressingIndex = 0; pressingIndex < accurateRipPressingCount; ++pressingIndex) {
+	// Pressings with other track counts may be present, so each record is sized by its own [arTrackCount]
+	NSUInteger accurateRipDiscDataSize = 0;
+	for(NSUInteger pressingDataOffset = 0; pressingDataOffset + (1 + 4 + 4 + 4) <= [accurateRipResponseData length]; pressingDataOffset += accurateRipDiscDataSize) {
 		uint8_t arTrackCount = 0;
 		[accurateRipResponseData getBytes:&arTrackCount range:NSMakeRange(pressingDataOffset, 1)];
 		
+		accurateRipDiscDataSize = (1 + 4 + 4 + 4) + (arTrackCount * (1 + 4 + 4));
+		if(pressingDataOffset + accurateRipDiscDataSize > [accurateRipResponseData length])
+			break;
+		
 		uint32_t arDiscID1 = 0;
 		[accurateRipResponseData getBytes:&arDiscID1 range:NSMakeRange(pressingDataOffset + 1, 4)];
 		arDiscID1 = OSSwapLittleToHostInt32(arDiscID1);
@@ -209,8 +229,6 @@
 			if(arOffsetChecksum)
 				accurateRipTrack.offsetChecksum = [NSNumber numberWithUnsignedInt:arOffsetChecksum];
 		}
-		
-		pressingDataOffset += accurateRipDiscDataSize;
 	}
 	
 	// Save the changes
@@ -7,17 +7,82 @@
 
 #include <Foundation/Foundation.h>
 
+@class SectorStore;
+
+// ========================================
+// Each function calculates the original (v1) AccurateRip checksum and returns it
+// If checksumV2 is not NULL, the v2 checksum (which folds the high 32 bits of each
+// sample * position product back into the sum) is calculated in the same pass and
+// stored there
+// ========================================
+
 // Calculate the AccurateRip checksum for the file at path
-uint32_t calculateAccurateRipChecksumForFile(NSURL *fileURL, BOOL isFirstTrack, BOOL isLastTrack);
+uint32_t calculateAccurateRipChecksumForFile(NSURL *fileURL, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2);
+
+// Calculate the AccurateRip checksum for the audio in sectorStore
+uint32_t calculateAccurateRipChecksumForSectorStore(SectorStore *sectorStore, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2);
 
 // Calculate the AccurateRip checksum for the specified range of CDDA sectors file at path
-uint32_t calculateAccurateRipChecksumForFileRegion(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack);
+uint32_t calculateAccurateRipChecksumForFileRegion(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2);
 
 // Calculate the AccurateRip checksum for the specified range of CDDA sectors file at path using the specified offset
-uint32_t calculateAccurateRipChecksumForFileRegionUsingOffset(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, NSInteger readOffsetInFrames);
+uint32_t calculateAccurateRipChecksumForFileRegionUsingOffset(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, NSInteger readOffsetInFrames, uint32_t *checksumV2);
+
+// Calculate the AccurateRip checksum for the specified range of CDDA sectors in sectorStore
+uint32_t calculateAccurateRipChecksumForSectorStoreRegion(SectorStore *sectorStore, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2);
+
+// Calculate the AccurateRip checksum for the specified range of CDDA sectors in sectorStore using the specified offset
+// Audio the offset moves outside the store is treated as silence
+uint32_t calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(SectorStore *sectorStore, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, NSInteger readOffsetInFrames, uint32_t *checksumV2);
+
+// ========================================
+// The AccurateRip offset checksum is the v1 checksum of the single sector at the six second point of
+// a track, as if it were the first sector of a track that isn't the first or last on the disc
+// The returned NSData contains the offset checksums for every offset in [-maximumOffsetInFrames, +maximumOffsetInFrames]
+// Audio outside the file is treated as silence
+// ========================================
+
+// Calculate the AccurateRip offset checksums for the sector in the file at path
+NSData * calculateAccurateRipOffsetChecksumsForFile(NSURL *fileURL, NSUInteger sector, NSUInteger maximumOffsetInFrames);
+
+// Calculate the AccurateRip offset checksums for the sector in sectorStore
+NSData * calculateAccurateRipOffsetChecksumsForSectorStore(SectorStore *sectorStore, NSUInteger sector, NSUInteger maximumOffsetInFrames);
 
 // Generate the AccurateRip checksum for a sector (2352 bytes) of CDDA audio
-uint32_t calculateAccurateRipChecksumForBlock(const void *block, NSUInteger blockNumber, NSUInteger totalBlocks, BOOL isFirstTrack, BOOL isLastTrack);
+uint32_t calculateAccurateRipChecksumForBlock(const void *block, NSUInteger blockNumber, NSUInteger totalBlocks, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2);
+
+// ========================================
+// The returned NSData contains the v1 checksums for every offset in [-maximumOffsetInFrames, +maximumOffsetInFrames]
+// The v2 checksum isn't linear in the offset, so it is only calculated for offset 0 (stored in primaryChecksumV2)
+// ========================================
 
 // Calculate the AccurateRip checksums for the file at path
-NSData * calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors, BOOL isFirstTrack, BOOL isLastTrack, NSUInteger maximumOffsetInBlocks, BOOL assumeMissingSectorsAreSilence);
+NSData * calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors, BOOL isFirstTrack, BOOL isLastTrack, NSUInteger maximumOffsetInBlocks, BOOL assumeMissingSectorsAreSilence, uint32_t *primaryChecksumV2);
+
+// Calculate the AccurateRip checksums for the track contained in sectorStore
+NSData * calculateAccurateRipChecksumsForTrackInSectorStore(SectorStore *sectorStore, NSRange trackSectors, BOOL isFirstTrack, BOOL isLastTrack, NSUInteger maximumOffsetInBlocks, BOOL assumeMissingSectorsAreSilence, uint32_t *primaryChecksumV2);
+
+// ========================================
+// Whole-disc calculation for a disc image (or sweep file) in a single sequential pass
+// trackSectors holds the sector range of each audio track on the disc, in order and relative to the
+// start of the image; the first and last elements receive the first and last track skip rules
+// Sectors outside the image are treated as silence
+// Returns an array containing, for each track, the v1 checksums for every offset in
+// [-maximumOffsetInFrames, +maximumOffsetInFrames]
+// The v2 checksums are calculated only for the offsets (in frames) in offsetsForChecksumsV2, and
+// checksumsV2 receives an array containing, for each track, an NSData of uint32_t in the same order
+// ========================================
+
+// Calculate the AccurateRip checksums for every track in the disc image at path
+NSArray * calculateAccurateRipChecksumsForDiscInFile(NSURL *fileURL, const NSRange *trackSectors, NSUInteger trackCount, NSUInteger maximumOffsetInBlocks, const NSInteger *offsetsForChecksumsV2, NSUInteger offsetCountForChecksumsV2, NSArray **checksumsV2);
+
+// Calculate the AccurateRip checksums for every track in the disc image contained in sectorStore
+NSArray * calculateAccurateRipChecksumsForDiscInSectorStore(SectorStore *sectorStore, const NSRange *trackSectors, NSUInteger trackCount, NSUInteger maximumOffsetInBlocks, const NSInteger *offsetsForChecksumsV2, NSUInteger offsetCountForChecksumsV2, NSArray **checksumsV2);
+
+// ========================================
+// Calculate the AccurateRip and FreeDB disc IDs for a disc whose audio tracks begin at the sectors
+// in trackOffsets and whose lead out begins at leadOut, for discs known only from their audio
+// (for example files ripped without a log)
+// Sectors are relative to the start of the program area (the first track usually begins at 0)
+// ========================================
+void calculateAccurateRipDiscIDs(const NSUInteger *trackOffsets, NSUInteger trackCount, NSUInteger leadOut, uint32_t *discID1, uint32_t *discID2, uint32_t *freeDBDiscID);
@@ -4,68 +4,63 @@
  */
 
 #import "AccurateRipUtilities.h"
+#import "AccurateRipKernels.h"
 #import "CDDAUtilities.h"
+#import "SectorStore.h"
 
-#include <AudioToolbox/AudioFile.h>
 #include <IOKit/storage/IOCDTypes.h>
 
+// The number of sectors read from the image at once during a whole-disc calculation
+#define SECTORS_PER_DISC_READ 64u
+
 // ========================================
 // Calculate the AccurateRip checksum for the file at path
 // ========================================
 uint32_t 
-calculateAccurateRipChecksumForFile(NSURL *fileURL, BOOL isFirstTrack, BOOL isLastTrack)
+calculateAccurateRipChecksumForFile(NSURL *fileURL, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2)
 {
 	NSCParameterAssert(nil != fileURL);
 	
-	uint32_t checksum = 0;
-
-	// Open the file for reading
-	AudioFileID file = NULL;
-	OSStatus status = AudioFileOpenURL((CFURLRef)fileURL, fsRdPerm, kAudioFileWAVEType, &file);
-	if(noErr != status)
+	SectorStore *sectorStore = [SectorStore sectorStoreWithContentsOfURL:fileURL error:NULL];
+	if(!sectorStore)
 		return 0;
 	
-	// Verify the file contains CDDA audio
-	AudioStreamBasicDescription fileFormat;
-	UInt32 dataSize = sizeof(fileFormat);
-	status = AudioFileGetProperty(file, kAudioFilePropertyDataFormat, &dataSize, &fileFormat);
-	if(noErr != status)
-		goto cleanup;
+	uint32_t checksum = calculateAccurateRipChecksumForSectorStore(sectorStore, isFirstTrack, isLastTrack, checksumV2);
 	
-	if(!streamDescriptionIsCDDA(&fileFormat))
-		goto cleanup;
+	[sectorStore close];
 	
-	// Determine the total number of audio packets (frames) in the file
-	UInt64 totalPackets;
-	dataSize = sizeof(totalPackets);
-	status = AudioFileGetProperty(file, kAudioFilePropertyAudioDataPacketCount, &dataSize, &totalPackets);
-	if(noErr != status)
-		goto cleanup;
+	return checksum;
+}
+
+// ========================================
+// Calculate the AccurateRip checksum for the audio in sectorStore
+// ========================================
+uint32_t 
+calculateAccurateRipChecksumForSectorStore(SectorStore *sectorStore, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2)
+{
+	NSCParameterAssert(nil != sectorStore);
 	
-	// Convert the number of frames to the number of blocks (CDDA sectors)
-	NSUInteger totalBlocks = (NSUInteger)(totalPackets / AUDIO_FRAMES_PER_CDDA_SECTOR);
-	NSUInteger blockNumber = 0;
+	uint32_t checksum = 0;
+	uint32_t v2 = 0;
+
+	// The number of blocks (CDDA sectors) in the store
+	NSUInteger totalBlocks = sectorStore.sectorCount;
 
 	// Set up extraction buffers
 	int8_t buffer [kCDSectorSizeCDDA];
 	
-	// Iteratively process each CDDA sector in the file
-	for(;;) {
-		
-		UInt32 byteCount = kCDSectorSizeCDDA;
-		UInt32 packetCount = AUDIO_FRAMES_PER_CDDA_SECTOR;
-		SInt64 startingPacket = blockNumber * AUDIO_FRAMES_PER_CDDA_SECTOR;
-		
-		status = AudioFileReadPackets(file, false, &byteCount, NULL, startingPacket, &packetCount, buffer);
-		
-		if(noErr != status || kCDSectorSizeCDDA != byteCount || AUDIO_FRAMES_PER_CDDA_SECTOR != packetCount)
+	// Iteratively process each CDDA sector in the store
+	for(NSUInteger blockNumber = 0; blockNumber < totalBlocks; ++blockNumber) {
+		if(1 != [sectorStore readAudioForSectors:NSMakeRange(blockNumber, 1) buffer:buffer error:NULL])
 			break;
 		
-		checksum += calculateAccurateRipChecksumForBlock(buffer, blockNumber++, totalBlocks, isFirstTrack, isLastTrack);
+		uint32_t blockChecksumV2 = 0;
+		checksum += calculateAccurateRipChecksumForBlock(buffer, blockNumber, totalBlocks, isFirstTrack, isLastTrack, &blockChecksumV2);
+		v2 += blockChecksumV2;
 	}
 	
-cleanup:
-	/*status = */AudioFileClose(file);
+	if(checksumV2)
+		*checksumV2 = v2;
 	
 	return checksum;
 }
@@ -74,145 +69,196 @@ cleanup:
 // Calculate the AccurateRip checksum for the specified range of CDDA sectors file at path
 // ========================================
 uint32_t 
-calculateAccurateRipChecksumForFileRegion(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack)
+calculateAccurateRipChecksumForFileRegion(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2)
 {
-	return calculateAccurateRipChecksumForFileRegionUsingOffset(fileURL, sectorsToProcess, isFirstTrack, isLastTrack, 0);
+	return calculateAccurateRipChecksumForFileRegionUsingOffset(fileURL, sectorsToProcess, isFirstTrack, isLastTrack, 0, checksumV2);
 }
 
 uint32_t 
-calculateAccurateRipChecksumForFileRegionUsingOffset(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, NSInteger readOffsetInFrames)
+calculateAccurateRipChecksumForFileRegionUsingOffset(NSURL *fileURL, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, NSInteger readOffsetInFrames, uint32_t *checksumV2)
 {
 	NSCParameterAssert(nil != fileURL);
 	
-	uint32_t checksum = 0;
-	
-	// Open the file for reading
-	AudioFileID file = NULL;
-	OSStatus status = AudioFileOpenURL((CFURLRef)fileURL, fsRdPerm, kAudioFileWAVEType, &file);
-	if(noErr != status)
+	SectorStore *sectorStore = [SectorStore sectorStoreWithContentsOfURL:fileURL error:NULL];
+	if(!sectorStore)
 		return 0;
 	
-	// Verify the file contains CDDA audio
-	AudioStreamBasicDescription fileFormat;
-	UInt32 dataSize = sizeof(fileFormat);
-	status = AudioFileGetProperty(file, kAudioFilePropertyDataFormat, &dataSize, &fileFormat);
-	if(noErr != status)
-		goto cleanup;
-	
-	if(!streamDescriptionIsCDDA(&fileFormat))
-		goto cleanup;
+	uint32_t checksum = calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(sectorStore, sectorsToProcess, isFirstTrack, isLastTrack, readOffsetInFrames, checksumV2);
 	
-	// Determine the total number of audio packets (frames) in the file
-	UInt64 totalPacketsInFile;
-	dataSize = sizeof(totalPacketsInFile);
-	status = AudioFileGetProperty(file, kAudioFilePropertyAudioDataPacketCount, &dataSize, &totalPacketsInFile);
-	if(noErr != status)
-		goto cleanup;
+	[sectorStore close];
 	
-	NSInteger totalSectorsInFile = (NSInteger)(totalPacketsInFile / AUDIO_FRAMES_PER_CDDA_SECTOR);
-	
-	// With no read offset, the range of sectors that will be read won't change
-	NSInteger firstSectorToRead = sectorsToProcess.location;
-	NSInteger lastSectorToRead = sectorsToProcess.location + sectorsToProcess.length - 1;
+	return checksum;
+}
 
-	// Negative read offsets can easily be transformed into positive read offsets
-	// For example, suppose the desired range is sectors 10 through 20 and the read offset is -600 frames.
-	// This is equivalent to requesting sectors 8 - 18 with a read offset of 576 frames
-	while(0 > readOffsetInFrames) {
-		readOffsetInFrames += AUDIO_FRAMES_PER_CDDA_SECTOR;
-		--firstSectorToRead;
-		--lastSectorToRead;
-	}
-	
-	// Adjust the sectors which will be read for read offsets equal to or larger than one sector
-	while(AUDIO_FRAMES_PER_CDDA_SECTOR <= readOffsetInFrames) {
-		readOffsetInFrames -= AUDIO_FRAMES_PER_CDDA_SECTOR;
-		++firstSectorToRead;
-		++lastSectorToRead;
-	}
+// ========================================
+// Calculate the AccurateRip checksum for the specified range of CDDA sectors in sectorStore
+// ========================================
+uint32_t 
+calculateAccurateRipChecksumForSectorStoreRegion(SectorStore *sectorStore, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2)
+{
+	return calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(sectorStore, sectorsToProcess, isFirstTrack, isLastTrack, 0, checksumV2);
+}
 
-	// Clamp the read range to the range of audio contained in the file
-	NSUInteger sectorsOfSilenceToPrepend = 0;
-	if(0 > firstSectorToRead) {
-		sectorsOfSilenceToPrepend = 0 - firstSectorToRead;
-		firstSectorToRead = 0;
-	}
+uint32_t 
+calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(SectorStore *sectorStore, NSRange sectorsToProcess, BOOL isFirstTrack, BOOL isLastTrack, NSInteger readOffsetInFrames, uint32_t *checksumV2)
+{
+	NSCParameterAssert(nil != sectorStore);
 	
-	NSUInteger sectorsOfSilenceToAppend = 0;
-	if(lastSectorToRead > totalSectorsInFile) {
-		sectorsOfSilenceToAppend = lastSectorToRead - totalSectorsInFile;
-		lastSectorToRead = totalSectorsInFile;
-	}
+	uint32_t checksum = 0;
+	uint32_t v2 = 0;
 	
-	// The number of complete blocks to be read; the sector range is inclusive
-	NSUInteger totalBlocks = lastSectorToRead - firstSectorToRead + 1;
-	NSUInteger blockNumber = 0;
+	// The read offset shifts the audio making up each block, but not the block numbers
+	NSUInteger totalBlocks = sectorsToProcess.length;
+	NSInteger totalFramesInStore = (NSInteger)(sectorStore.sectorCount * AUDIO_FRAMES_PER_CDDA_SECTOR);
+	NSInteger firstFrame = (NSInteger)(sectorsToProcess.location * AUDIO_FRAMES_PER_CDDA_SECTOR) + readOffsetInFrames;
 	
 	int8_t buffer [kCDSectorSizeCDDA];
-
-	// Prepend silence, if required
-	// Since the AccurateRip checksum for silence is zero, all that must be accounted for is the block counter
-	if(sectorsOfSilenceToPrepend)
-		blockNumber += sectorsOfSilenceToPrepend;
-
-	// Adjust the starting packet for the read offset
-	SInt64 startingPacket = (firstSectorToRead * AUDIO_FRAMES_PER_CDDA_SECTOR) + readOffsetInFrames;
 	
-	// Iteratively process each CDDA sector in the file
-	NSUInteger sectorCount = totalBlocks - (sectorsOfSilenceToPrepend + sectorsOfSilenceToAppend);
-	while(sectorCount--) {
+	// Iteratively process each block
+	for(NSUInteger blockNumber = 0; blockNumber < totalBlocks; ++blockNumber) {
+		NSInteger blockFirstFrame = firstFrame + (NSInteger)(blockNumber * AUDIO_FRAMES_PER_CDDA_SECTOR);
+		NSInteger blockEndFrame = blockFirstFrame + AUDIO_FRAMES_PER_CDDA_SECTOR;
 		
-		UInt32 byteCount = kCDSectorSizeCDDA;
-		UInt32 packetCount = AUDIO_FRAMES_PER_CDDA_SECTOR;
+		// Audio outside the store is treated as silence, and the AccurateRip checksum for silence is zero
+		NSInteger firstFrameToRead = MAX(blockFirstFrame, 0);
+		NSInteger endFrameToRead = MIN(blockEndFrame, totalFramesInStore);
+		if(firstFrameToRead >= endFrameToRead)
+			continue;
 		
-		status = AudioFileReadPackets(file, false, &byteCount, NULL, startingPacket, &packetCount, buffer);
+		// Blocks straddling either end of the store are partially silent
+		if(firstFrameToRead != blockFirstFrame || endFrameToRead != blockEndFrame)
+			memset(buffer, 0, kCDSectorSizeCDDA);
 		
-		if(noErr != status || kCDSectorSizeCDDA != byteCount || AUDIO_FRAMES_PER_CDDA_SECTOR != packetCount)
+		NSRange framesToRead = NSMakeRange((NSUInteger)firstFrameToRead, (NSUInteger)(endFrameToRead - firstFrameToRead));
+		int8_t *frameBuffer = buffer + ((firstFrameToRead - blockFirstFrame) * (kCDSectorSizeCDDA / AUDIO_FRAMES_PER_CDDA_SECTOR));
+		if(framesToRead.length != [sectorStore readAudioForFrames:framesToRead buffer:frameBuffer error:NULL])
 			break;
 		
-		checksum += calculateAccurateRipChecksumForBlock(buffer, blockNumber++, totalBlocks, isFirstTrack, isLastTrack);
-		
-		startingPacket += packetCount;
+		uint32_t blockChecksumV2 = 0;
+		checksum += calculateAccurateRipChecksumForBlock(buffer, blockNumber, totalBlocks, isFirstTrack, isLastTrack, &blockChecksumV2);
+		v2 += blockChecksumV2;
 	}
 	
-	// Append silence, if required
-	// Since the AccurateRip checksum for silence is zero, nothing need be done here
-//	if(sectorsOfSilenceToAppend)
-//		;
-
-cleanup:
-	/*status = */AudioFileClose(file);
+	if(checksumV2)
+		*checksumV2 = v2;
 	
 	return checksum;
 }
 
+// ========================================
+// Calculate the AccurateRip offset checksums for the sector in the file at path
+// ========================================
+NSData * 
+calculateAccurateRipOffsetChecksumsForFile(NSURL *fileURL, NSUInteger sector, NSUInteger maximumOffsetInFrames)
+{
+	NSCParameterAssert(nil != fileURL);
+	
+	SectorStore *sectorStore = [SectorStore sectorStoreWithContentsOfURL:fileURL error:NULL];
+	if(!sectorStore)
+		return nil;
+	
+	NSData *checksums = calculateAccurateRipOffsetChecksumsForSectorStore(sectorStore, sector, maximumOffsetInFrames);
+	
+	[sectorStore close];
+	
+	return checksums;
+}
+
+// ========================================
+// Calculate the AccurateRip offset checksums for the sector in sectorStore
+// For a window of frames f[X] ... f[X + 587] the checksum is C(X) = sum(f[X + i] * (i + 1)), so moving
+// the window one frame drops the first frame and lowers the weight of the others by one:
+// C(X + 1) = C(X) - S(X) + 588 * f[X + 588], where S(X) is the sum of the frames in the window
+// This makes every offset O(1) once the audio covering all the offsets has been read
+// ========================================
+NSData * 
+calculateAccurateRipOffsetChecksumsForSectorStore(SectorStore *sectorStore, NSUInteger sector, NSUInteger maximumOffsetInFrames)
+{
+	NSCParameterAssert(nil != sectorStore);
+	
+	NSUInteger checksumCount = (2 * maximumOffsetInFrames) + 1;
+	NSUInteger frameCount = checksumCount + AUDIO_FRAMES_PER_CDDA_SECTOR - 1;
+	
+	// The first frame in the file for the most negative offset
+	NSInteger firstFrame = (NSInteger)(sector * AUDIO_FRAMES_PER_CDDA_SECTOR) - (NSInteger)maximumOffsetInFrames;
+	
+	NSMutableData *framesData = [NSMutableData dataWithLength:(frameCount * sizeof(uint32_t))];
+	NSMutableData *checksumsData = [NSMutableData dataWithLength:(checksumCount * sizeof(uint32_t))];
+	if(!framesData || !checksumsData)
+		return nil;
+	
+	uint32_t *frames = [framesData mutableBytes];
+	uint32_t *checksums = [checksumsData mutableBytes];
+	
+	// Frames before the start of the file are left as silence
+	NSUInteger framesToSkip = (0 > firstFrame ? (NSUInteger)-firstFrame : 0);
+	if(framesToSkip < frameCount) {
+		NSRange framesToRead = NSMakeRange((NSUInteger)(firstFrame + (NSInteger)framesToSkip), frameCount - framesToSkip);
+		[sectorStore readAudioForFrames:framesToRead buffer:(frames + framesToSkip) error:NULL];
+	}
+	
+	for(NSUInteger i = 0; i < frameCount; ++i)
+		frames[i] = OSSwapLittleToHostInt32(frames[i]);
+	
+	// Calculate the checksum and sum for the first window directly
+	uint32_t checksum = 0;
+	uint32_t sum = 0;
+	for(NSUInteger i = 0; i < AUDIO_FRAMES_PER_CDDA_SECTOR; ++i) {
+		checksum += frames[i] * (uint32_t)(i + 1);
+		sum += frames[i];
+	}
+	
+	checksums[0] = checksum;
+	
+	// And slide the window for the remaining offsets
+	for(NSUInteger offsetIndex = 1; offsetIndex < checksumCount; ++offsetIndex) {
+		uint32_t incomingFrame = frames[offsetIndex + AUDIO_FRAMES_PER_CDDA_SECTOR - 1];
+		
+		checksum = checksum - sum + (AUDIO_FRAMES_PER_CDDA_SECTOR * incomingFrame);
+		sum = sum - frames[offsetIndex - 1] + incomingFrame;
+		
+		checksums[offsetIndex] = checksum;
+	}
+	
+	return checksumsData;
+}
+
 // ========================================
 // Generate the AccurateRip CRC for a sector of CDDA audio
 // ========================================
 uint32_t
-calculateAccurateRipChecksumForBlock(const void *block, NSUInteger blockNumber, NSUInteger totalBlocks, BOOL isFirstTrack, BOOL isLastTrack)
+calculateAccurateRipChecksumForBlock(const void *block, NSUInteger blockNumber, NSUInteger totalBlocks, BOOL isFirstTrack, BOOL isLastTrack, uint32_t *checksumV2)
 {
 	NSCParameterAssert(NULL != block);
 
+	uint32_t checksum = 0;
+	uint32_t v2 = 0;
+
 	if(isFirstTrack && 4 > blockNumber)
-		return 0;
+		;
 	else if(isLastTrack && 6 > (totalBlocks - blockNumber))
-		return 0;
+		;
+	// Only the last sample in the fifth block of the first track is included
 	else if(isFirstTrack && 4 == blockNumber) {
 		const uint32_t *buffer = (const uint32_t *)block;
 		uint32_t sample = OSSwapHostToLittleInt32(buffer[AUDIO_FRAMES_PER_CDDA_SECTOR - 1]);
-		return AUDIO_FRAMES_PER_CDDA_SECTOR * (4 + 1) * sample;
+		uint64_t product = (uint64_t)sample * (AUDIO_FRAMES_PER_CDDA_SECTOR * (4 + 1));
+
+		checksum = (uint32_t)product;
+		v2 = (uint32_t)product + (uint32_t)(product >> 32);
 	}
 	else {
-		const uint32_t *buffer = (const uint32_t *)block;
-		uint32_t checksum = 0;
-		uint32_t blockOffset = (uint32_t)(AUDIO_FRAMES_PER_CDDA_SECTOR * blockNumber);
-		
-		for(NSUInteger i = 0; i < AUDIO_FRAMES_PER_CDDA_SECTOR; ++i)
-			checksum += OSSwapHostToLittleInt32(*buffer++) * ++blockOffset;
+		AccurateRipBlockSums sums;
+		accurateRipBlockSums(block, (uint32_t)(AUDIO_FRAMES_PER_CDDA_SECTOR * blockNumber) + 1, &sums);
 
-		return checksum;
+		checksum = sums.sumOfSamplesAndPositions;
+		v2 = sums.sumOfSamplesAndPositions + sums.sumOfProductHighWords;
 	}
+
+	if(checksumV2)
+		*checksumV2 = v2;
+
+	return checksum;
 }
 
 /*
@@ -248,41 +294,40 @@ calculateAccurateRipChecksumForBlock(const void *block, NSUInteger blockNumber,
 // Calculate the AccurateRip checksums for the file at path
 // ========================================
 NSData * 
-calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors, BOOL isFirstTrack, BOOL isLastTrack, NSUInteger maximumOffsetInBlocks, BOOL assumeMissingSectorsAreSilence)
+calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors, BOOL isFirstTrack, BOOL isLastTrack, NSUInteger maximumOffsetInBlocks, BOOL assumeMissingSectorsAreSilence, uint32_t *primaryChecksumV2)
 {
 	NSCParameterAssert(nil != fileURL);
 	
+	SectorStore *sectorStore = [SectorStore sectorStoreWithContentsOfURL:fileURL error:NULL];
+	if(!sectorStore)
+		return nil;
+	
+	NSData *checksums = calculateAccurateRipChecksumsForTrackInSectorStore(sectorStore, trackSectors, isFirstTrack, isLastTrack, maximumOffsetInBlocks, assumeMissingSectorsAreSilence, primaryChecksumV2);
+	
+	[sectorStore close];
+	
+	return checksums;
+}
+
+// ========================================
+// Calculate the AccurateRip checksums for the track contained in sectorStore
+// ========================================
+NSData * 
+calculateAccurateRipChecksumsForTrackInSectorStore(SectorStore *sectorStore, NSRange trackSectors, BOOL isFirstTrack, BOOL isLastTrack, NSUInteger maximumOffsetInBlocks, BOOL assumeMissingSectorsAreSilence, uint32_t *primaryChecksumV2)
+{
+	NSCParameterAssert(nil != sectorStore);
+	
 	// The number of audio frames in the track
 	NSUInteger totalFramesInTrack = trackSectors.length * AUDIO_FRAMES_PER_CDDA_SECTOR;
 	
 	// Checksums will be tracked in this array
 	uint32_t *checksums = NULL;
 	
-	// Open the file for reading
-	AudioFileID file = NULL;
-	OSStatus status = AudioFileOpenURL((CFURLRef)fileURL, fsRdPerm, kAudioFileWAVEType, &file);
-	if(noErr != status)
-		return nil;
+	// The v2 checksum for offset 0
+	uint32_t v2 = 0;
 	
-	// Verify the file contains CDDA audio
-	AudioStreamBasicDescription fileFormat;
-	UInt32 dataSize = sizeof(fileFormat);
-	status = AudioFileGetProperty(file, kAudioFilePropertyDataFormat, &dataSize, &fileFormat);
-	if(noErr != status)
-		goto cleanup;
-	
-	if(!streamDescriptionIsCDDA(&fileFormat))
-		goto cleanup;
-	
-	// Determine the total number of audio packets (frames) in the file
-	UInt64 totalPackets;
-	dataSize = sizeof(totalPackets);
-	status = AudioFileGetProperty(file, kAudioFilePropertyAudioDataPacketCount, &dataSize, &totalPackets);
-	if(noErr != status)
-		goto cleanup;
-	
-	// Convert the number of frames to the number of blocks (CDDA sectors)
-	NSUInteger totalBlocks = (NSUInteger)(totalPackets / AUDIO_FRAMES_PER_CDDA_SECTOR);
+	// The number of blocks (CDDA sectors) in the store
+	NSUInteger totalBlocks = sectorStore.sectorCount;
 	
 	// Determine if any sectors are missing at the beginning or end
 	NSUInteger missingSectorsAtStart = 0;
@@ -298,11 +343,11 @@ calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors
 	
 	// If there aren't enough sectors (blocks) in the file, it can't be processed
 	if(totalBlocks < trackSectors.length)
-		goto cleanup;
+		return nil;
 
 	// Missing non-track sectors may be allowed
 	if(!assumeMissingSectorsAreSilence && (missingSectorsAtStart || missingSectorsAtEnd))
-		goto cleanup;
+		return nil;
 
 	NSUInteger maximumOffsetInFrames = maximumOffsetInBlocks * AUDIO_FRAMES_PER_CDDA_SECTOR;
 	
@@ -311,33 +356,44 @@ calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors
 	NSUInteger lastFileBlockForTrack = firstFileBlockForTrack + trackSectors.length - 1;
 	
 	// Only blocks in the middle of the track can be processed using the fast offset calculation algorithm
+	// For the first and last tracks, no sample in a fast block may fall in the skipped five sectors at any offset
 	NSUInteger firstFileBlockForFastProcessing;
 	if(isFirstTrack)
-		firstFileBlockForFastProcessing = firstFileBlockForTrack + (5 > maximumOffsetInBlocks ? 5 : maximumOffsetInBlocks);
+		firstFileBlockForFastProcessing = firstFileBlockForTrack + 5 + maximumOffsetInBlocks;
 	else
 		firstFileBlockForFastProcessing = firstFileBlockForTrack + maximumOffsetInBlocks;
 	
 	NSUInteger lastFileBlockForFastProcessing;
 	if(isLastTrack)
-		lastFileBlockForFastProcessing = lastFileBlockForTrack - (5 > maximumOffsetInBlocks ? 5 : maximumOffsetInBlocks);
+		lastFileBlockForFastProcessing = lastFileBlockForTrack - (5 + maximumOffsetInBlocks);
 	else
 		lastFileBlockForFastProcessing = lastFileBlockForTrack - maximumOffsetInBlocks;
 	
+	// The inclusive range of track frames included in the checksums, excluding the skipped areas of the first and last tracks
+	NSInteger firstValidFrame = (isFirstTrack ? (5 * AUDIO_FRAMES_PER_CDDA_SECTOR) - 1 : 0);
+	NSInteger lastValidFrame = (isLastTrack ? (NSInteger)totalFramesInTrack - (5 * AUDIO_FRAMES_PER_CDDA_SECTOR) - 1 : (NSInteger)totalFramesInTrack - 1);
+	
 	// Set up the checksum buffer
 	checksums = calloc((2 * maximumOffsetInFrames) + 1, sizeof(uint32_t));
+	if(!checksums)
+		return nil;
+	
+	// Difference arrays for the boundary sectors, indexed by offset with one extra element for the end of the last range
+	uint32_t *weightedSampleDeltas = calloc((2 * maximumOffsetInFrames) + 2, sizeof(uint32_t));
+	uint32_t *sampleDeltas = calloc((2 * maximumOffsetInFrames) + 2, sizeof(uint32_t));
+	if(!weightedSampleDeltas || !sampleDeltas) {
+		free(weightedSampleDeltas);
+		free(sampleDeltas);
+		free(checksums);
+		return nil;
+	}
 	
 	// The extraction buffer
 	int8_t buffer [kCDSectorSizeCDDA];
 	
 	// Iteratively process each CDDA sector of interest in the file
 	for(NSUInteger fileBlockNumber = firstFileBlockForTrack - maximumOffsetInBlocks + missingSectorsAtStart; fileBlockNumber <= lastFileBlockForTrack + maximumOffsetInBlocks - missingSectorsAtEnd; ++fileBlockNumber) {
-		UInt32 byteCount = kCDSectorSizeCDDA;
-		UInt32 packetCount = AUDIO_FRAMES_PER_CDDA_SECTOR;
-		SInt64 startingPacket = fileBlockNumber * AUDIO_FRAMES_PER_CDDA_SECTOR;
-		
-		status = AudioFileReadPackets(file, false, &byteCount, NULL, startingPacket, &packetCount, buffer);
-		
-		if(noErr != status || kCDSectorSizeCDDA != byteCount || AUDIO_FRAMES_PER_CDDA_SECTOR != packetCount)
+		if(1 != [sectorStore readAudioForSectors:NSMakeRange(fileBlockNumber, 1) buffer:buffer error:NULL])
 			break;
 		
 		NSInteger trackBlockNumber = fileBlockNumber - firstFileBlockForTrack;
@@ -346,55 +402,314 @@ calculateAccurateRipChecksumsForTrackInFile(NSURL *fileURL, NSRange trackSectors
 		
 		// Sectors in the middle of the track can be processed quickly
 		if(fileBlockNumber >= firstFileBlockForFastProcessing && fileBlockNumber <= lastFileBlockForFastProcessing) {
-			uint32_t sumOfSamples = 0;
-			uint32_t sumOfSamplesAndPositions = 0;
-			
-			// Calculate two sums for the audio
-			for(NSUInteger frameIndex = 0; frameIndex < AUDIO_FRAMES_PER_CDDA_SECTOR; ++frameIndex) {
-				uint32_t sample = OSSwapHostToLittleInt32(*sampleBuffer++);
-				
-				sumOfSamples += sample;
-				sumOfSamplesAndPositions += (uint32_t)(sample * (frameIndex + 1));
-			}
+			// Calculate the sums for the audio, using the frames' positions for offset 0
+			AccurateRipBlockSums sums;
+			accurateRipBlockSums(buffer, (uint32_t)(trackFrameNumber + 1), &sums);
 			
 			for(NSInteger offsetIndex = -maximumOffsetInFrames; offsetIndex <= (NSInteger)maximumOffsetInFrames; ++offsetIndex)
-				checksums[offsetIndex + maximumOffsetInFrames] += sumOfSamplesAndPositions + (uint32_t)(((trackFrameNumber - offsetIndex) * sumOfSamples));
+				checksums[offsetIndex + maximumOffsetInFrames] += sums.sumOfSamplesAndPositions - (uint32_t)(offsetIndex * sums.sumOfSamples);
+			
+			v2 += sums.sumOfSamplesAndPositions + sums.sumOfProductHighWords;
 		}
 		// Sectors at the beginning or end of the track or disc must be handled specially
-		// This could be optimized but for now it uses the normal method of Accurate Rip checksum calculation
+		// A frame in these sectors contributes sample * (frame - offset + 1) to every offset placing it in the valid
+		// (non-skipped) part of the track, and those offsets form a contiguous range.  The contribution is linear in
+		// the offset, so it is recorded as range updates in the difference arrays and resolved once at the end
 		else {
 			for(NSUInteger frameIndex = 0; frameIndex < AUDIO_FRAMES_PER_CDDA_SECTOR; ++frameIndex) {
 				uint32_t sample = OSSwapHostToLittleInt32(*sampleBuffer++);
 				
-				for(NSInteger offsetIndex = -maximumOffsetInFrames; offsetIndex <= (NSInteger)maximumOffsetInFrames; ++offsetIndex) {
-					// Current frame is the track's frame number in the context of the current offset
-					NSInteger currentFrame = trackFrameNumber + (NSInteger)frameIndex - offsetIndex;
+				if(!sample)
+					continue;
+				
+				NSInteger frame = trackFrameNumber + (NSInteger)frameIndex;
+				
+				// The offsets for which this frame falls in the valid part of the track
+				NSInteger firstOffset = MAX(-(NSInteger)maximumOffsetInFrames, frame - lastValidFrame);
+				NSInteger lastOffset = MIN((NSInteger)maximumOffsetInFrames, frame - firstValidFrame);
+				
+				if(firstOffset > lastOffset)
+					continue;
+				
+				uint32_t weightedSample = sample * (uint32_t)(frame + 1);
+				
+				weightedSampleDeltas[firstOffset + maximumOffsetInFrames] += weightedSample;
+				weightedSampleDeltas[lastOffset + maximumOffsetInFrames + 1] -= weightedSample;
+				sampleDeltas[firstOffset + maximumOffsetInFrames] += sample;
+				sampleDeltas[lastOffset + maximumOffsetInFrames + 1] -= sample;
+				
+				if(0 >= firstOffset && 0 <= lastOffset) {
+					uint64_t product = (uint64_t)sample * (uint32_t)(frame + 1);
+					v2 += (uint32_t)product + (uint32_t)(product >> 32);
+				}
+			}
+		}
+	}
+	
+	// Resolve the boundary sectors' contributions: for each offset the running sums hold sum(sample * (frame + 1))
+	// and sum(sample) over the frames valid at that offset
+	uint32_t weightedSampleSum = 0;
+	uint32_t sampleSum = 0;
+	for(NSInteger offsetIndex = -maximumOffsetInFrames; offsetIndex <= (NSInteger)maximumOffsetInFrames; ++offsetIndex) {
+		weightedSampleSum += weightedSampleDeltas[offsetIndex + maximumOffsetInFrames];
+		sampleSum += sampleDeltas[offsetIndex + maximumOffsetInFrames];
+		
+		checksums[offsetIndex + maximumOffsetInFrames] += weightedSampleSum - (uint32_t)(offsetIndex * sampleSum);
+	}
+	
+	free(weightedSampleDeltas);
+	free(sampleDeltas);
+	
+	if(primaryChecksumV2)
+		*primaryChecksumV2 = v2;
+	
+	return [NSData dataWithBytesNoCopy:checksums length:(((2 * maximumOffsetInFrames) + 1) * sizeof(uint32_t))];
+}
+
+// ========================================
+// Calculate the AccurateRip checksums for every track in the disc image at path
+// ========================================
+NSArray * 
+calculateAccurateRipChecksumsForDiscInFile(NSURL *fileURL, const NSRange *trackSectors, NSUInteger trackCount, NSUInteger maximumOffsetInBlocks, const NSInteger *offsetsForChecksumsV2, NSUInteger offsetCountForChecksumsV2, NSArray **checksumsV2)
+{
+	NSCParameterAssert(nil != fileURL);
+	
+	SectorStore *sectorStore = [SectorStore sectorStoreWithContentsOfURL:fileURL error:NULL];
+	if(!sectorStore)
+		return nil;
+	
+	NSArray *checksums = calculateAccurateRipChecksumsForDiscInSectorStore(sectorStore, trackSectors, trackCount, maximumOffsetInBlocks, offsetsForChecksumsV2, offsetCountForChecksumsV2, checksumsV2);
+	
+	[sectorStore close];
+	
+	return checksums;
+}
+
+// ========================================
+// The state for one track during a whole-disc calculation
+// Frame numbers are relative to the start of the image
+// ========================================
+typedef struct {
+	NSInteger firstFrame;				// The image frame at which the track starts
+	NSInteger firstValidFrame;			// The inclusive range of track frames included in the checksums
+	NSInteger lastValidFrame;
+	uint32_t *weightedSampleDeltas;		// Difference arrays indexed by offset, as in calculateAccurateRipChecksumsForTrackInSectorStore
+	uint32_t *sampleDeltas;
+	uint32_t *checksumsV2;				// The v2 checksums for the requested offsets
+} AccurateRipDiscTrackState;
+
+// Accumulate the v1 contributions of frames in a sector for every offset, and the v2 contributions for the requested offsets
+static void
+accumulateAccurateRipDiscTrackFrames(AccurateRipDiscTrackState *track, const uint32_t *sampleBuffer, NSInteger firstTrackFrame, NSUInteger firstFrameIndex, NSUInteger frameCount, NSInteger maximumOffsetInFrames, const NSInteger *offsetsForChecksumsV2, NSUInteger offsetCountForChecksumsV2)
+{
+	for(NSUInteger frameIndex = firstFrameIndex; frameIndex < firstFrameIndex + frameCount; ++frameIndex) {
+		uint32_t sample = OSSwapHostToLittleInt32(sampleBuffer[frameIndex]);
+		
+		if(!sample)
+			continue;
+		
+		NSInteger frame = firstTrackFrame + (NSInteger)frameIndex;
+		
+		NSInteger firstOffset = MAX(-maximumOffsetInFrames, frame - track->lastValidFrame);
+		NSInteger lastOffset = MIN(maximumOffsetInFrames, frame - track->firstValidFrame);
+		
+		if(firstOffset > lastOffset)
+			continue;
+		
+		uint32_t weightedSample = sample * (uint32_t)(frame + 1);
+		
+		track->weightedSampleDeltas[firstOffset + maximumOffsetInFrames] += weightedSample;
+		track->weightedSampleDeltas[lastOffset + maximumOffsetInFrames + 1] -= weightedSample;
+		track->sampleDeltas[firstOffset + maximumOffsetInFrames] += sample;
+		track->sampleDeltas[lastOffset + maximumOffsetInFrames + 1] -= sample;
+		
+		for(NSUInteger i = 0; i < offsetCountForChecksumsV2; ++i) {
+			NSInteger offset = offsetsForChecksumsV2[i];
+			if(offset >= firstOffset && offset <= lastOffset) {
+				uint64_t product = (uint64_t)sample * (uint32_t)(frame - offset + 1);
+				track->checksumsV2[i] += (uint32_t)product + (uint32_t)(product >> 32);
+			}
+		}
+	}
+}
+
+// ========================================
+// Calculate the AccurateRip checksums for every track in the disc image contained in sectorStore
+// ========================================
+NSArray * 
+calculateAccurateRipChecksumsForDiscInSectorStore(SectorStore *sectorStore, const NSRange *trackSectors, NSUInteger trackCount, NSUInteger maximumOffsetInBlocks, const NSInteger *offsetsForChecksumsV2, NSUInteger offsetCountForChecksumsV2, NSArray **checksumsV2)
+{
+	NSCParameterAssert(nil != sectorStore);
+	NSCParameterAssert(NULL != trackSectors);
+	NSCParameterAssert(0 < trackCount);
+	NSCParameterAssert(0 == offsetCountForChecksumsV2 || NULL != offsetsForChecksumsV2);
+	
+	NSInteger maximumOffsetInFrames = (NSInteger)(maximumOffsetInBlocks * AUDIO_FRAMES_PER_CDDA_SECTOR);
+	NSUInteger checksumCount = (2 * maximumOffsetInFrames) + 1;
+	
+	for(NSUInteger i = 0; i < offsetCountForChecksumsV2; ++i)
+		NSCParameterAssert(offsetsForChecksumsV2[i] >= -maximumOffsetInFrames && offsetsForChecksumsV2[i] <= maximumOffsetInFrames);
+	
+	NSArray *result = nil;
+	AccurateRipDiscTrackState *tracks = calloc(trackCount, sizeof(AccurateRipDiscTrackState));
+	uint8_t *buffer = NULL;
+	
+	if(!tracks)
+		return nil;
+	
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+		NSCParameterAssert(0 == trackIndex || trackSectors[trackIndex].location >= trackSectors[trackIndex - 1].location + trackSectors[trackIndex - 1].length);
+		
+		AccurateRipDiscTrackState *track = &tracks[trackIndex];
+		NSInteger totalFramesInTrack = (NSInteger)(trackSectors[trackIndex].length * AUDIO_FRAMES_PER_CDDA_SECTOR);
+		
+		track->firstFrame = (NSInteger)(trackSectors[trackIndex].location * AUDIO_FRAMES_PER_CDDA_SECTOR);
+		track->firstValidFrame = (0 == trackIndex ? (5 * AUDIO_FRAMES_PER_CDDA_SECTOR) - 1 : 0);
+		track->lastValidFrame = (trackCount - 1 == trackIndex ? totalFramesInTrack - (5 * AUDIO_FRAMES_PER_CDDA_SECTOR) - 1 : totalFramesInTrack - 1);
+		
+		track->weightedSampleDeltas = calloc(checksumCount + 1, sizeof(uint32_t));
+		track->sampleDeltas = calloc(checksumCount + 1, sizeof(uint32_t));
+		track->checksumsV2 = calloc(MAX(offsetCountForChecksumsV2, 1U), sizeof(uint32_t));
+		
+		if(!track->weightedSampleDeltas || !track->sampleDeltas || !track->checksumsV2)
+			goto cleanup;
+	}
+	
+	// The range of image sectors that contribute to any track at any offset
+	// Sectors outside the image are treated as silence and need not be read
+	NSInteger firstSectorToRead = MAX(0, (NSInteger)trackSectors[0].location - (NSInteger)maximumOffsetInBlocks);
+	NSInteger lastSectorToRead = MIN((NSInteger)sectorStore.sectorCount - 1, (NSInteger)(trackSectors[trackCount - 1].location + trackSectors[trackCount - 1].length + maximumOffsetInBlocks) - 1);
+	
+	buffer = malloc(kCDSectorSizeCDDA * SECTORS_PER_DISC_READ);
+	if(!buffer)
+		goto cleanup;
+	
+	// Process the image in a single sequential pass
+	NSUInteger firstActiveTrackIndex = 0;
+	NSInteger sector = firstSectorToRead;
+	while(sector <= lastSectorToRead) {
+		NSUInteger sectorCount = MIN(SECTORS_PER_DISC_READ, (NSUInteger)(lastSectorToRead - sector + 1));
+		NSUInteger sectorsRead = [sectorStore readAudioForSectors:NSMakeRange(sector, sectorCount) buffer:buffer error:NULL];
+		if(!sectorsRead)
+			goto cleanup;
+		
+		for(NSUInteger sectorIndex = 0; sectorIndex < sectorsRead; ++sectorIndex, ++sector) {
+			const uint32_t *sampleBuffer = (const uint32_t *)(buffer + (kCDSectorSizeCDDA * sectorIndex));
+			NSInteger firstImageFrame = sector * AUDIO_FRAMES_PER_CDDA_SECTOR;
+			NSInteger lastImageFrame = firstImageFrame + AUDIO_FRAMES_PER_CDDA_SECTOR - 1;
+			
+			// Tracks that end (including the offset window) before this sector are finished
+			while(firstActiveTrackIndex < trackCount && tracks[firstActiveTrackIndex].firstFrame + tracks[firstActiveTrackIndex].lastValidFrame + maximumOffsetInFrames < firstImageFrame)
+				++firstActiveTrackIndex;
+			
+			// Adjacent tracks share the sectors around their boundary
+			for(NSUInteger trackIndex = firstActiveTrackIndex; trackIndex < trackCount; ++trackIndex) {
+				AccurateRipDiscTrackState *track = &tracks[trackIndex];
+				
+				if(track->firstFrame + track->firstValidFrame - maximumOffsetInFrames > lastImageFrame)
+					break;
+				if(track->firstValidFrame > track->lastValidFrame)
+					continue;
+				
+				// The track frame number of the first frame in this sector at offset 0
+				NSInteger firstTrackFrame = firstImageFrame - track->firstFrame;
+				
+				// Sectors that lie in the valid part of the track at every offset can be processed quickly
+				if(firstTrackFrame - maximumOffsetInFrames >= track->firstValidFrame && firstTrackFrame + (AUDIO_FRAMES_PER_CDDA_SECTOR - 1) + maximumOffsetInFrames <= track->lastValidFrame) {
+					AccurateRipBlockSums sums;
+					accurateRipBlockSums(sampleBuffer, (uint32_t)(firstTrackFrame + 1), &sums);
+					
+					track->weightedSampleDeltas[0] += sums.sumOfSamplesAndPositions;
+					track->sampleDeltas[0] += sums.sumOfSamples;
 					
-					// The current frame is in the skipped area of the first track on the disc
-					if(isFirstTrack && ((5 * AUDIO_FRAMES_PER_CDDA_SECTOR) - 1) > currentFrame)
-						;
-					// The current frame is in the skipped area of the last track on the disc
-					else if(isLastTrack && (5 * AUDIO_FRAMES_PER_CDDA_SECTOR) >= (totalFramesInTrack - currentFrame))
-						;
-					// The current frame is in the previous track
-					else if(0 > currentFrame)
-						;
-					// The current frame is in the next track
-					else if(currentFrame >= (NSInteger)totalFramesInTrack)
-						;
-					// Process the sample
-					else
-						checksums[offsetIndex + maximumOffsetInFrames] += sample * (uint32_t)(currentFrame + 1);
+					// The v2 checksum isn't linear in the offset, so each requested offset needs its own sums
+					for(NSUInteger i = 0; i < offsetCountForChecksumsV2; ++i) {
+						AccurateRipBlockSums offsetSums = sums;
+						if(0 != offsetsForChecksumsV2[i])
+							accurateRipBlockSums(sampleBuffer, (uint32_t)(firstTrackFrame - offsetsForChecksumsV2[i] + 1), &offsetSums);
+						track->checksumsV2[i] += offsetSums.sumOfSamplesAndPositions + offsetSums.sumOfProductHighWords;
+					}
 				}
+				// Sectors at the beginning or end of the track or disc must be handled frame by frame
+				else
+					accumulateAccurateRipDiscTrackFrames(track, sampleBuffer, firstTrackFrame, 0, AUDIO_FRAMES_PER_CDDA_SECTOR, maximumOffsetInFrames, offsetsForChecksumsV2, offsetCountForChecksumsV2);
 			}
 		}
 	}
 	
+	// Resolve the difference arrays into the checksums for each offset
+	NSMutableArray *trackChecksums = [NSMutableArray arrayWithCapacity:trackCount];
+	NSMutableArray *trackChecksumsV2 = [NSMutableArray arrayWithCapacity:trackCount];
+	
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+		AccurateRipDiscTrackState *track = &tracks[trackIndex];
+		NSMutableData *checksumsData = [NSMutableData dataWithLength:(checksumCount * sizeof(uint32_t))];
+		uint32_t *checksums = [checksumsData mutableBytes];
+		
+		uint32_t weightedSampleSum = 0;
+		uint32_t sampleSum = 0;
+		for(NSInteger offsetIndex = -maximumOffsetInFrames; offsetIndex <= maximumOffsetInFrames; ++offsetIndex) {
+			weightedSampleSum += track->weightedSampleDeltas[offsetIndex + maximumOffsetInFrames];
+			sampleSum += track->sampleDeltas[offsetIndex + maximumOffsetInFrames];
+			
+			checksums[offsetIndex + maximumOffsetInFrames] = weightedSampleSum - (uint32_t)(offsetIndex * sampleSum);
+		}
+		
+		[trackChecksums addObject:checksumsData];
+		[trackChecksumsV2 addObject:[NSData dataWithBytes:track->checksumsV2 length:(offsetCountForChecksumsV2 * sizeof(uint32_t))]];
+	}
+	
+	result = trackChecksums;
+	if(checksumsV2)
+		*checksumsV2 = trackChecksumsV2;
+	
 cleanup:
-	/*status = */AudioFileClose(file);
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+		free(tracks[trackIndex].weightedSampleDeltas);
+		free(tracks[trackIndex].sampleDeltas);
+		free(tracks[trackIndex].checksumsV2);
+	}
 	
-	if(checksums)
-		return [NSData dataWithBytesNoCopy:checksums length:(((2 * maximumOffsetInFrames) + 1) * sizeof(uint32_t))];
-	else
-		return nil;
+	free(tracks);
+	free(buffer);
+	
+	return result;
+}
+
+// ========================================
+// Calculate the AccurateRip and FreeDB disc IDs for a disc
+// ========================================
+void
+calculateAccurateRipDiscIDs(const NSUInteger *trackOffsets, NSUInteger trackCount, NSUInteger leadOut, uint32_t *discID1, uint32_t *discID2, uint32_t *freeDBDiscID)
+{
+	NSCParameterAssert(NULL != trackOffsets);
+	NSCParameterAssert(0 < trackCount);
+	
+	uint32_t accurateRipID1 = 0;
+	uint32_t accurateRipID2 = 0;
+	NSUInteger sumOfTrackStartDigits = 0;
+	
+	// The lead out is treated as track n + 1, as in -[CompactDisc accurateRipID1] and -[CompactDisc accurateRipID2]
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+		NSUInteger offset = trackOffsets[trackIndex];
+		
+		accurateRipID1 += (uint32_t)offset;
+		accurateRipID2 += (uint32_t)((0 == offset ? 1 : offset) * (trackIndex + 1));
+		
+		// FreeDB uses the sum of the digits of each track's starting time in seconds, including the two second pregap
+		for(NSUInteger seconds = (offset + 150) / CDDA_SECTORS_PER_SECOND; 0 < seconds; seconds /= 10)
+			sumOfTrackStartDigits += seconds % 10;
+	}
+	
+	accurateRipID1 += (uint32_t)leadOut;
+	accurateRipID2 += (uint32_t)(leadOut * (trackCount + 1));
+	
+	NSUInteger discLengthInSeconds = ((leadOut + 150) / CDDA_SECTORS_PER_SECOND) - ((trackOffsets[0] + 150) / CDDA_SECTORS_PER_SECOND);
+	
+	if(discID1)
+		*discID1 = accurateRipID1;
+	if(discID2)
+		*discID2 = accurateRipID2;
+	if(freeDBDiscID)
+		*freeDBDiscID = (uint32_t)(((sumOfTrackStartDigits % 0xFF) << 24) | (discLengthInSeconds << 8) | trackCount);
 }
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+// ========================================
+// How a drive was matched to an entry in the database
+// ========================================
+enum _eDriveOffsetMatchType {
+	eDriveOffsetMatchTypeNone				= 0,
+	eDriveOffsetMatchTypeExact				= 1,	// Vendor and product
+	eDriveOffsetMatchTypeProduct			= 2,	// Product only (the vendor is often missing or spelled differently)
+	eDriveOffsetMatchTypeProductPrefix		= 3		// The database entry is a truncated form of the product
+};
+typedef enum _eDriveOffsetMatchType eDriveOffsetMatchType;
+
+// ========================================
+// A compact, sorted table of drive read offsets built from the AccurateRip
+// drive offsets database (DriveOffsets.bin), or from the copy of it shipped
+// in the application bundle until the database has been downloaded
+// Vendor and product names are normalized (upper case, with runs of whitespace
+// collapsed) and limited to the length of a database entry
+// The table is persisted in the caches folder with a format version and the
+// time it was built, and only needs to be refreshed when it is stale
+// ========================================
+@interface DriveOffsetDatabase : NSObject
+{
+@private
+	NSData *_entries;			// DriveOffsetEntry, sorted by name
+	NSData *_productIndex;		// uint16_t indexes into _entries, sorted by product
+	NSDate *_lastUpdated;
+}
+
+// ========================================
+// The shared database
++ (DriveOffsetDatabase *) sharedDatabase;
+
+// ========================================
+// Properties
+@property (readonly) NSUInteger count;
+@property (readonly, copy) NSDate * lastUpdated;
+@property (readonly) BOOL isStale;
+
+// ========================================
+// Lookup
+// Returns the read offset in audio frames, or nil if the drive isn't in the database
+- (NSNumber *) readOffsetForVendorName:(NSString *)vendorName productName:(NSString *)productName matchType:(eDriveOffsetMatchType *)matchType;
+
+// ========================================
+// Replace the table with the contents of DriveOffsets.bin and persist it
+- (BOOL) updateWithAccurateRipDriveOffsetsData:(NSData *)data error:(NSError **)error;
+
+@end
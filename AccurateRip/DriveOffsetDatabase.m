@@ -0,0 +1,418 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+// Access to AccurateRip is regulated, see http://www.accuraterip.com/3rdparty-access.htm for details
+
+#import "DriveOffsetDatabase.h"
+#import "Logger.h"
+
+// ========================================
+// Entries in DriveOffsets.bin consist of 0x45 bytes:
+//  - 2 bytes for the drive's read offset (int16_t, little endian)
+//  - 0x21 bytes for the drive's name and manufacturer, separated by " - "
+//  - 0x22 bytes of miscellaneous data (?? unknown format and purpose)
+// ========================================
+#define DRIVE_RECORD_SIZE				0x45
+#define DRIVE_NAME_SIZE					0x21
+
+// The format of the persisted table, incremented whenever it changes
+#define DRIVE_OFFSET_DATABASE_VERSION	1
+
+// ========================================
+// A table entry, stored little endian
+// ========================================
+typedef struct {
+	char name [DRIVE_NAME_SIZE];		// The normalized "VENDOR - PRODUCT", NUL terminated
+	uint8_t productStart;				// The index of the product in name
+	int16_t readOffset;
+} DriveOffsetEntry;
+
+// ========================================
+// Private methods
+// ========================================
+@interface DriveOffsetDatabase ()
+@property (copy) NSDate * lastUpdated;
+@end
+
+@interface DriveOffsetDatabase (Private)
++ (NSString *) persistentStorePath;
+- (BOOL) loadPersistentStore;
+- (BOOL) loadBundledDatabase;
+- (BOOL) buildTableWithDriveOffsets:(NSDictionary *)driveOffsets lastUpdated:(NSDate *)lastUpdated;
+- (BOOL) savePersistentStore:(NSError **)error;
+@end
+
+// ========================================
+// Upper case with runs of whitespace collapsed to a single space
+// ========================================
+static NSString *
+normalizedDriveNameComponent(NSString *component)
+{
+	NSMutableArray *words = [NSMutableArray array];
+	for(NSString *word in [[component uppercaseString] componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]]) {
+		if(word.length)
+			[words addObject:word];
+	}
+
+	return [words componentsJoinedByString:@" "];
+}
+
+// ========================================
+// Build the normalized, length-limited name for a drive
+// ========================================
+static void
+makeDriveOffsetEntryName(NSString *vendorName, NSString *productName, DriveOffsetEntry *entry)
+{
+	NSString *vendor = normalizedDriveNameComponent(vendorName ? vendorName : @"");
+	NSString *product = normalizedDriveNameComponent(productName ? productName : @"");
+	NSString *name = [NSString stringWithFormat:@"%@ - %@", vendor, product];
+
+	memset(entry->name, 0, DRIVE_NAME_SIZE);
+	NSData *nameData = [name dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:YES];
+	memcpy(entry->name, [nameData bytes], MIN([nameData length], (NSUInteger)(DRIVE_NAME_SIZE - 1)));
+
+	entry->productStart = (uint8_t)MIN(vendor.length + 3, strlen(entry->name));
+}
+
+// ========================================
+// Split an AccurateRip drive name into the vendor and product
+// Entries without a vendor are stored as "- PRODUCT"
+// ========================================
+static void
+splitAccurateRipDriveName(NSString *name, NSString **vendorName, NSString **productName)
+{
+	if([name hasPrefix:@"- "]) {
+		*vendorName = @"";
+		*productName = [name substringFromIndex:2];
+		return;
+	}
+
+	NSRange separatorRange = [name rangeOfString:@" - "];
+	if(NSNotFound == separatorRange.location) {
+		*vendorName = @"";
+		*productName = name;
+	}
+	else {
+		*vendorName = [name substringToIndex:separatorRange.location];
+		*productName = [name substringFromIndex:NSMaxRange(separatorRange)];
+	}
+}
+
+static int
+compareDriveOffsetEntryNames(const void *a, const void *b)
+{
+	return strcmp(((const DriveOffsetEntry *)a)->name, ((const DriveOffsetEntry *)b)->name);
+}
+
+static int
+compareDriveOffsetEntryProducts(void *thunk, const void *a, const void *b)
+{
+	const DriveOffsetEntry *entries = thunk;
+	const DriveOffsetEntry *entryA = &entries[*(const uint16_t *)a];
+	const DriveOffsetEntry *entryB = &entries[*(const uint16_t *)b];
+
+	return strcmp(entryA->name + entryA->productStart, entryB->name + entryB->productStart);
+}
+
+// ========================================
+// Static variables
+// ========================================
+static DriveOffsetDatabase *sSharedDatabase		= nil;
+
+@implementation DriveOffsetDatabase
+
+@synthesize lastUpdated = _lastUpdated;
+
++ (DriveOffsetDatabase *) sharedDatabase
+{
+	@synchronized(self) {
+		if(!sSharedDatabase) {
+			sSharedDatabase = [[self alloc] init];
+
+			// Until the database has been downloaded, use the copy in the bundle
+			if(![sSharedDatabase loadPersistentStore] && ![sSharedDatabase loadBundledDatabase])
+				[[Logger sharedLogger] logMessage:@"Unable to load the drive offset database"];
+		}
+	}
+
+	return sSharedDatabase;
+}
+
+- (NSUInteger) count
+{
+	return [_entries length] / sizeof(DriveOffsetEntry);
+}
+
+- (BOOL) isStale
+{
+	if(!self.lastUpdated)
+		return YES;
+
+	NSTimeInterval expirationInterval = [[NSUserDefaults standardUserDefaults] doubleForKey:@"driveOffsetDatabaseExpirationInterval"];
+	return (-[self.lastUpdated timeIntervalSinceNow] > expirationInterval);
+}
+
+- (NSNumber *) readOffsetForVendorName:(NSString *)vendorName productName:(NSString *)productName matchType:(eDriveOffsetMatchType *)matchType
+{
+	if(matchType)
+		*matchType = eDriveOffsetMatchTypeNone;
+
+	NSData *entriesData = nil;
+	NSData *productIndexData = nil;
+	@synchronized(self) {
+		entriesData = _entries;
+		productIndexData = _productIndex;
+	}
+
+	const DriveOffsetEntry *entries = [entriesData bytes];
+	const uint16_t *productIndex = [productIndexData bytes];
+	NSUInteger entryCount = [entriesData length] / sizeof(DriveOffsetEntry);
+
+	if(!entryCount)
+		return nil;
+
+	DriveOffsetEntry key;
+	makeDriveOffsetEntryName(vendorName, productName, &key);
+
+	// Vendor and product
+	const DriveOffsetEntry *match = bsearch(&key, entries, entryCount, sizeof(DriveOffsetEntry), compareDriveOffsetEntryNames);
+	if(match) {
+		if(matchType)
+			*matchType = eDriveOffsetMatchTypeExact;
+		return [NSNumber numberWithShort:(int16_t)OSSwapLittleToHostInt16(match->readOffset)];
+	}
+
+	// The product alone, which may be shared by several entries
+	const char *product = key.name + key.productStart;
+	if(!*product)
+		return nil;
+
+	NSMutableArray *candidates = [NSMutableArray array];
+
+	NSUInteger low = 0, high = entryCount;
+	while(low < high) {
+		NSUInteger middle = low + ((high - low) / 2);
+		const DriveOffsetEntry *entry = &entries[productIndex[middle]];
+		if(0 > strcmp(entry->name + entry->productStart, product))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for(NSUInteger i = low; i < entryCount; ++i) {
+		const DriveOffsetEntry *entry = &entries[productIndex[i]];
+		if(strcmp(entry->name + entry->productStart, product))
+			break;
+		[candidates addObject:[NSNumber numberWithShort:(int16_t)OSSwapLittleToHostInt16(entry->readOffset)]];
+	}
+
+	eDriveOffsetMatchType candidateMatchType = eDriveOffsetMatchTypeProduct;
+
+	// Names that filled the database field were truncated, so their products may be a prefix of the drive's
+	if(!candidates.count) {
+		size_t productLength = strlen(product);
+		for(NSUInteger i = 0; i < entryCount; ++i) {
+			const DriveOffsetEntry *entry = &entries[i];
+			size_t entryProductLength = strlen(entry->name + entry->productStart);
+
+			if(DRIVE_NAME_SIZE - 1 != strlen(entry->name) || !entryProductLength || entryProductLength > productLength)
+				continue;
+
+			if(!strncmp(entry->name + entry->productStart, product, entryProductLength))
+				[candidates addObject:[NSNumber numberWithShort:(int16_t)OSSwapLittleToHostInt16(entry->readOffset)]];
+		}
+
+		candidateMatchType = eDriveOffsetMatchTypeProductPrefix;
+	}
+
+	if(!candidates.count)
+		return nil;
+
+	// Use the offset the most entries agree on
+	NSCountedSet *offsets = [NSCountedSet setWithArray:candidates];
+	NSNumber *readOffset = nil;
+	NSUInteger readOffsetCount = 0;
+	for(NSNumber *offset in candidates) {
+		if([offsets countForObject:offset] > readOffsetCount) {
+			readOffset = offset;
+			readOffsetCount = [offsets countForObject:offset];
+		}
+	}
+
+	if(matchType)
+		*matchType = candidateMatchType;
+
+	return readOffset;
+}
+
+- (BOOL) updateWithAccurateRipDriveOffsetsData:(NSData *)data error:(NSError **)error
+{
+	NSParameterAssert(nil != data);
+
+	NSUInteger numberOfDriveRecords = [data length] / DRIVE_RECORD_SIZE;
+	const uint8_t *bytes = [data bytes];
+
+	NSMutableDictionary *driveOffsets = [NSMutableDictionary dictionaryWithCapacity:numberOfDriveRecords];
+
+	for(NSUInteger driveRecordIndex = 0; driveRecordIndex < numberOfDriveRecords; ++driveRecordIndex) {
+		const uint8_t *record = bytes + (driveRecordIndex * DRIVE_RECORD_SIZE);
+
+		int16_t readOffset;
+		memcpy(&readOffset, record, sizeof(readOffset));
+		readOffset = (int16_t)OSSwapLittleToHostInt16(readOffset);
+
+		char name [DRIVE_NAME_SIZE + 1];
+		memcpy(name, record + 2, DRIVE_NAME_SIZE);
+		name[DRIVE_NAME_SIZE] = '\0';
+
+		NSString *nameString = [[NSString alloc] initWithBytes:name length:strlen(name) encoding:NSASCIIStringEncoding];
+
+		// The first entry for a drive wins
+		if(nameString.length && ![driveOffsets objectForKey:nameString])
+			[driveOffsets setObject:[NSNumber numberWithShort:readOffset] forKey:nameString];
+	}
+
+	[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Retrieved %ld drive records", numberOfDriveRecords];
+
+	if(!driveOffsets.count || ![self buildTableWithDriveOffsets:driveOffsets lastUpdated:[NSDate date]]) {
+		if(error)
+			*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:nil];
+		return NO;
+	}
+
+	return [self savePersistentStore:error];
+}
+
+@end
+
+@implementation DriveOffsetDatabase (Private)
+
++ (NSString *) persistentStorePath
+{
+	NSArray *cachesPaths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	NSString *cachesPath = (0 < cachesPaths.count) ? [cachesPaths objectAtIndex:0] : NSTemporaryDirectory();
+	NSString *applicationName = [[NSBundle mainBundle] objectForInfoDictionaryKey:@"CFBundleName"];
+
+	return [[cachesPath stringByAppendingPathComponent:applicationName] stringByAppendingPathComponent:@"DriveOffsets.plist"];
+}
+
+- (BOOL) loadPersistentStore
+{
+	NSData *data = [NSData dataWithContentsOfFile:[[self class] persistentStorePath]];
+	if(!data)
+		return NO;
+
+	NSDictionary *store = [NSPropertyListSerialization propertyListFromData:data mutabilityOption:NSPropertyListImmutable format:NULL errorDescription:NULL];
+	if(![store isKindOfClass:[NSDictionary class]] || DRIVE_OFFSET_DATABASE_VERSION != [[store objectForKey:@"version"] integerValue])
+		return NO;
+
+	NSData *entries = [store objectForKey:@"entries"];
+	NSData *productIndex = [store objectForKey:@"productIndex"];
+	NSUInteger entryCount = [entries length] / sizeof(DriveOffsetEntry);
+
+	if(!entryCount || [entries length] != entryCount * sizeof(DriveOffsetEntry) || [productIndex length] != entryCount * sizeof(uint16_t))
+		return NO;
+
+	@synchronized(self) {
+		_entries = entries;
+		_productIndex = productIndex;
+	}
+
+	self.lastUpdated = [store objectForKey:@"lastUpdated"];
+
+	return YES;
+}
+
+- (BOOL) loadBundledDatabase
+{
+	NSString *driveOffsetsPath = [[NSBundle mainBundle] pathForResource:@"DriveOffsets" ofType:@"plist" inDirectory:nil];
+	NSDictionary *driveOffsets = [NSDictionary dictionaryWithContentsOfFile:driveOffsetsPath];
+	if(!driveOffsets)
+		return NO;
+
+	// The bundled copy is always considered stale
+	return [self buildTableWithDriveOffsets:driveOffsets lastUpdated:nil];
+}
+
+- (BOOL) buildTableWithDriveOffsets:(NSDictionary *)driveOffsets lastUpdated:(NSDate *)lastUpdated
+{
+	NSParameterAssert(nil != driveOffsets);
+
+	if(UINT16_MAX < driveOffsets.count)
+		return NO;
+
+	NSMutableData *entriesData = [NSMutableData dataWithLength:(driveOffsets.count * sizeof(DriveOffsetEntry))];
+	DriveOffsetEntry *entries = [entriesData mutableBytes];
+	NSUInteger entryCount = 0;
+
+	for(NSString *name in driveOffsets) {
+		NSString *vendorName = nil, *productName = nil;
+		splitAccurateRipDriveName(name, &vendorName, &productName);
+
+		DriveOffsetEntry *entry = &entries[entryCount];
+		makeDriveOffsetEntryName(vendorName, productName, entry);
+		entry->readOffset = (int16_t)OSSwapHostToLittleInt16([[driveOffsets objectForKey:name] shortValue]);
+
+		++entryCount;
+	}
+
+	qsort(entries, entryCount, sizeof(DriveOffsetEntry), compareDriveOffsetEntryNames);
+
+	// Names that differed only in case or spacing are now adjacent; keep the first
+	NSUInteger uniqueEntryCount = 0;
+	for(NSUInteger i = 0; i < entryCount; ++i) {
+		if(uniqueEntryCount && !strcmp(entries[uniqueEntryCount - 1].name, entries[i].name))
+			continue;
+		entries[uniqueEntryCount++] = entries[i];
+	}
+
+	[entriesData setLength:(uniqueEntryCount * sizeof(DriveOffsetEntry))];
+	entries = [entriesData mutableBytes];
+
+	NSMutableData *productIndexData = [NSMutableData dataWithLength:(uniqueEntryCount * sizeof(uint16_t))];
+	uint16_t *productIndex = [productIndexData mutableBytes];
+	for(NSUInteger i = 0; i < uniqueEntryCount; ++i)
+		productIndex[i] = (uint16_t)i;
+
+	qsort_r(productIndex, uniqueEntryCount, sizeof(uint16_t), entries, compareDriveOffsetEntryProducts);
+
+	@synchronized(self) {
+		_entries = entriesData;
+		_productIndex = productIndexData;
+	}
+
+	self.lastUpdated = lastUpdated;
+
+	return YES;
+}
+
+- (BOOL) savePersistentStore:(NSError **)error
+{
+	NSDictionary *store = nil;
+	@synchronized(self) {
+		store = [NSDictionary dictionaryWithObjectsAndKeys:
+				 [NSNumber numberWithInteger:DRIVE_OFFSET_DATABASE_VERSION], @"version",
+				 _entries, @"entries",
+				 _productIndex, @"productIndex",
+				 self.lastUpdated, @"lastUpdated",
+				 nil];
+	}
+
+	NSString *errorDescription = nil;
+	NSData *data = [NSPropertyListSerialization dataFromPropertyList:store format:NSPropertyListBinaryFormat_v1_0 errorDescription:&errorDescription];
+	if(!data) {
+		if(error)
+			*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:[NSDictionary dictionaryWithObject:errorDescription forKey:NSLocalizedFailureReasonErrorKey]];
+		return NO;
+	}
+
+	NSString *path = [[self class] persistentStorePath];
+	if(![[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:error])
+		return NO;
+
+	return [data writeToFile:path options:NSAtomicWrite error:error];
+}
+
+@end
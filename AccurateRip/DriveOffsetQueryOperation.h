@@ -7,8 +7,8 @@
 #include <DiskArbitration/DiskArbitration.h>
 
 // ========================================
-// An NSOperation subclass that downloads the AccurateRip drive offsets 
-// database and searches it for a specific drive
+// An NSOperation subclass that searches the AccurateRip drive offsets
+// database for a specific drive, downloading it only if the local copy is stale
 // ========================================
 @interface DriveOffsetQueryOperation : NSOperation
 {
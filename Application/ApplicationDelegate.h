@@ -35,4 +35,7 @@
 // Save changes to the main NSManagedObjectContext
 - (IBAction) saveAction:(id)sender;
 
+// Verify a folder of previously ripped albums against AccurateRip
+- (IBAction) verifyLibrary:(id)sender;
+
 @end
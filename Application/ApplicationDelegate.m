@@ -12,6 +12,12 @@
 #import "MetadataSourceManager.h"
 #import "ReadOffsetCalculatorSheetController.h"
 #import "Logger.h"
+#import "DigestUtilities.h"
+#import "AccurateRipKernels.h"
+#import "AccurateRipDatabaseCache.h"
+#import "DiscIdentityCache.h"
+#import "LibraryVerificationOperation.h"
+#import "PersistentStoreMigration.h"
 
 #import "AquaticPrime.h"
 
@@ -57,6 +63,8 @@
 - (BOOL) validateLicenseURL:(NSURL *)licenseURL error:(NSError **)error;
 - (void) displayNagDialog;
 - (void) handleGetURLAppleEvent:(NSAppleEventDescriptor *)event withReplyEvent:(NSAppleEventDescriptor *)replyEvent;
+- (void) verifyLibraryAtURL:(NSURL *)libraryURL;
+- (void) libraryVerificationDidFinish:(LibraryVerificationOperation *)operation;
 @end
 
 
@@ -98,6 +106,13 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 	[defaultsDictionary setObject:[NSNumber numberWithInteger:1] forKey:@"requiredTrackMatches"];
 	[defaultsDictionary setObject:[NSNumber numberWithBool:NO] forKey:@"useCustomOutputFileNaming"];
 	[defaultsDictionary setObject:[NSNumber numberWithBool:YES] forKey:@"allowExtractionFailure"];
+	[defaultsDictionary setObject:[NSNumber numberWithBool:NO] forKey:@"useTestAndCopy"];
+	[defaultsDictionary setObject:[NSNumber numberWithBool:NO] forKey:@"verifyQSubchannelPositions"];
+	[defaultsDictionary setObject:[NSNumber numberWithInteger:3] forKey:@"recoveryRetryCount"];
+	[defaultsDictionary setObject:[NSNumber numberWithDouble:0.25] forKey:@"recoveryBackoffInterval"];
+	[defaultsDictionary setObject:[NSNumber numberWithInteger:4] forKey:@"recoverySpeedMultiplier"];
+	[defaultsDictionary setObject:[NSNumber numberWithBool:YES] forKey:@"adaptiveDriveSpeed"];
+	[defaultsDictionary setObject:[NSNumber numberWithInteger:256] forKey:@"sectorStoreMemoryBudget"];
 
 	[defaultsDictionary setObject:[NSNumber numberWithBool:YES] forKey:@"calculateReplayGain"];
 
@@ -108,6 +123,10 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 	[defaultsDictionary setObject:[NSNumber numberWithInteger:eLogMessageLevelNormal] forKey:@"logMessageLevel"];
 	
 	[defaultsDictionary setObject:[NSNumber numberWithBool:YES] forKey:@"automaticallyQueryAccurateRip"];
+	[defaultsDictionary setObject:[NSNumber numberWithInteger:eAccurateRipCachePolicyUseCache] forKey:@"accurateRipCachePolicy"];
+	[defaultsDictionary setObject:[NSNumber numberWithDouble:(7 * 24 * 60 * 60)] forKey:@"accurateRipCacheExpirationInterval"];
+	[defaultsDictionary setObject:[NSNumber numberWithDouble:(24 * 60 * 60)] forKey:@"accurateRipCacheNotFoundExpirationInterval"];
+	[defaultsDictionary setObject:[NSNumber numberWithDouble:(30 * 24 * 60 * 60)] forKey:@"driveOffsetDatabaseExpirationInterval"];
 	[defaultsDictionary setObject:[NSNumber numberWithBool:YES] forKey:@"automaticallyQueryMusicDatabase"];
 
 	[defaultsDictionary setObject:[NSNumber numberWithBool:YES] forKey:@"automaticallySaveCueSheetAfterEncoding"];
@@ -183,6 +202,8 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 	NSString *versionNumber = [[NSBundle mainBundle] objectForInfoDictionaryKey:@"CFBundleVersion"];	
 
 	[[Logger sharedLogger] logMessage:@"%@ %@ (%@) log opened", appName, shortVersionNumber, versionNumber];
+	[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Digest implementations: %@", digestImplementationDescription()];
+	[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"AccurateRip kernel: %@", accurateRipKernelDescription()];
 	
 	// Register our URL handlers
 	[[NSAppleEventManager sharedAppleEventManager] setEventHandler:self 
@@ -405,8 +426,11 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 
 - (NSManagedObjectModel *) managedObjectModel
 {
-	if(!_managedObjectModel)
-		self.managedObjectModel = [NSManagedObjectModel mergedModelFromBundles:nil];
+	// The current version of the versioned model
+	if(!_managedObjectModel) {
+		NSString *modelPath = [[NSBundle mainBundle] pathForResource:@"Rip" ofType:@"momd"];
+		self.managedObjectModel = [[NSManagedObjectModel alloc] initWithContentsOfURL:[NSURL fileURLWithPath:modelPath]];
+	}
 
 	return _managedObjectModel;
 }
@@ -427,6 +451,17 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 
 	NSURL *url = [NSURL fileURLWithPath:[applicationSupportFolderPath stringByAppendingPathComponent:@"Ripped CDs.sqlite"]];
 
+	// Stores created with an earlier version of the model are migrated before being opened
+	NSMutableArray *previousModels = [NSMutableArray array];
+	for(NSString *modelPath in [[NSBundle mainBundle] pathsForResourcesOfType:@"mom" inDirectory:@"Rip.momd"]) {
+		NSManagedObjectModel *model = [[NSManagedObjectModel alloc] initWithContentsOfURL:[NSURL fileURLWithPath:modelPath]];
+		if(model)
+			[previousModels addObject:model];
+	}
+
+	if(!migratePersistentStore(url, NSSQLiteStoreType, self.managedObjectModel, previousModels, &error))
+		[[NSApplication sharedApplication] presentError:error];
+
 	self.persistentStoreCoordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:self.managedObjectModel];
 
 	// Add the main store
@@ -471,6 +506,25 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 		[[NSApplication sharedApplication] presentError:error];
 }
 
+- (IBAction) verifyLibrary:(id)sender
+{
+
+#pragma unused(sender)
+
+	NSOpenPanel *openPanel = [NSOpenPanel openPanel];
+	
+	[openPanel setCanChooseFiles:NO];
+	[openPanel setCanChooseDirectories:YES];
+	[openPanel setAllowsMultipleSelection:NO];
+	[openPanel setPrompt:NSLocalizedString(@"Verify", @"")];
+	
+	if(NSOKButton != [openPanel runModalForTypes:nil])
+		return;
+	
+	// Verification of a large library takes a long time, so do it in the background
+	[NSThread detachNewThreadSelector:@selector(verifyLibraryAtURL:) toTarget:self withObject:[[openPanel URLs] lastObject]];
+}
+
 @end
 
 @implementation ApplicationDelegate (Private)
@@ -494,10 +548,14 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 		
 		[compactDiscWindow showWindow:self];
 		
-		if([[NSUserDefaults standardUserDefaults] boolForKey:@"automaticallyQueryAccurateRip"])
+		// Discs that have been seen before don't need to be looked up again; the AccurateRip response
+		// is requeried when the identity is restored, and refreshed by the cache once it has expired
+		NSDictionary *identity = [compactDiscWindow restoreDiscIdentity];
+		
+		if([[NSUserDefaults standardUserDefaults] boolForKey:@"automaticallyQueryAccurateRip"] && ![identity objectForKey:kDiscIdentityAccurateRipResponseKey])
 			[compactDiscWindow queryAccurateRip:self];
 		
-		if([[NSUserDefaults standardUserDefaults] boolForKey:@"automaticallyQueryMusicDatabase"])
+		if([[NSUserDefaults standardUserDefaults] boolForKey:@"automaticallyQueryMusicDatabase"] && ![identity objectForKey:kDiscIdentityMetadataKey])
 			[compactDiscWindow queryDefaultMusicDatabase:self];
 		
 		// Automatically select all the tracks
@@ -661,4 +719,39 @@ diskDisappearedCallback(DADiskRef disk, void *context)
 	NSLog(@"%@", url);
 }
 
+- (void) verifyLibraryAtURL:(NSURL *)libraryURL
+{
+	NSParameterAssert(nil != libraryURL);
+
+	NSString *reportsPath = [self.applicationSupportFolderURL.path stringByAppendingPathComponent:@"Verification Reports"];
+	NSError *error = nil;
+	if(![[NSFileManager defaultManager] createDirectoryAtPath:reportsPath withIntermediateDirectories:YES attributes:nil error:&error]) {
+		[[NSApplication sharedApplication] performSelectorOnMainThread:@selector(presentError:) withObject:error waitUntilDone:NO];
+		return;
+	}
+
+	NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
+	[dateFormatter setDateFormat:@"yyyy-MM-dd HH.mm.ss"];
+	NSString *reportName = [NSString stringWithFormat:@"%@ %@.txt", [[libraryURL path] lastPathComponent], [dateFormatter stringFromDate:[NSDate date]]];
+
+	LibraryVerificationOperation *operation = [[LibraryVerificationOperation alloc] init];
+
+	operation.libraryURL = libraryURL;
+	operation.reportURL = [NSURL fileURLWithPath:[reportsPath stringByAppendingPathComponent:reportName]];
+
+	[operation start];
+
+	[self performSelectorOnMainThread:@selector(libraryVerificationDidFinish:) withObject:operation waitUntilDone:NO];
+}
+
+- (void) libraryVerificationDidFinish:(LibraryVerificationOperation *)operation
+{
+	NSParameterAssert(nil != operation);
+
+	if(operation.error)
+		[[NSApplication sharedApplication] presentError:operation.error];
+	else
+		[[NSWorkspace sharedWorkspace] openFile:[operation.reportURL path]];
+}
+
 @end
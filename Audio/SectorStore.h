@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#import <AudioToolbox/AudioFile.h>
+
+// ========================================
+// A class representing a temporary store of CD-DA audio
+// that presents read/write access to that audio as CD-DA sectors
+// Audio is held in memory as long as the memory budget shared by all stores
+// permits, and is transparently moved to a temporary WAVE file once the
+// budget is exhausted
+// Stores must be closed when they are no longer needed, to return their
+// memory to the budget and remove any temporary file
+// An object of this class should not be created directly using alloc/init,
+// but using the provided class methods
+// ========================================
+@interface SectorStore : NSObject
+{
+@private
+	NSMutableData *_data;		// The audio, while the store is memory-backed
+	NSURL *_URL;				// The backing file, once the store is file-backed
+	AudioFileID _file;
+	BOOL _ownsFile;				// Whether the backing file is deleted when the store is closed
+	BOOL _readOnly;
+	NSUInteger _byteCount;		// The number of bytes of audio in the store
+	NSString *_cachedMD5;
+	NSString *_cachedSHA1;
+	NSData *_cachedSectorFingerprints;
+}
+
+// ========================================
+// Creation
+// ========================================
++ (id) sectorStore;
++ (id) sectorStoreWithContentsOfURL:(NSURL *)URL error:(NSError **)error;
+
+// ========================================
+// The memory budget (in bytes) shared by all stores
+// ========================================
++ (NSUInteger) memoryBudget;
++ (NSUInteger) memoryInUse;
+
+// ========================================
+// Properties
+// ========================================
+@property (readonly) BOOL isMemoryBacked;
+@property (readonly, copy) NSURL * URL;
+@property (readonly) NSString * MD5;
+@property (readonly) NSString * SHA1;
+
+// An xxHash64 fingerprint (uint64_t) for each sector, used for fast comparisons
+@property (readonly) NSData * sectorFingerprints;
+
+@property (readonly) NSUInteger sectorCount;
+
+- (BOOL) close;
+
+// ========================================
+// Reading
+// ========================================
+- (NSData *) audioDataForSector:(NSUInteger)sector error:(NSError **)error;
+- (NSData *) audioDataForSectors:(NSRange)sectors error:(NSError **)error;
+
+- (NSUInteger) readAudioForSectors:(NSRange)sectors buffer:(void *)buffer error:(NSError **)error;
+- (NSUInteger) readAudioForFrames:(NSRange)frames buffer:(void *)buffer error:(NSError **)error;
+
+// ========================================
+// Writing
+// ========================================
+- (BOOL) appendAudio:(const void *)buffer byteCount:(NSUInteger)byteCount error:(NSError **)error;
+
+- (BOOL) setAudioData:(NSData *)data forSector:(NSUInteger)sector error:(NSError **)error;
+- (BOOL) setAudioData:(NSData *)data forSectors:(NSRange)sectors error:(NSError **)error;
+
+- (NSUInteger) setAudio:(const void *)buffer forSectors:(NSRange)sectors error:(NSError **)error;
+
+- (BOOL) copySectors:(NSRange)sectors fromSectorStore:(SectorStore *)sectorStore toSector:(NSUInteger)sector error:(NSError **)error;
+
+// ========================================
+// Comparison
+// Returns the indexes of the sectors that differ, or nil if the stores contain
+// a different number of sectors
+// Stores that aren't both memory-backed use sector fingerprints to skip
+// sectors that can't match, and confirm the rest by comparing the audio
+// ========================================
+- (NSIndexSet *) nonMatchingSectorsInSectorStore:(SectorStore *)sectorStore;
+
+// ========================================
+// Create a WAVE file at URL containing the specified sectors
+// ========================================
+- (BOOL) writeSectors:(NSRange)sectors toURL:(NSURL *)URL error:(NSError **)error;
+
+@end
@@ -0,0 +1,726 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "SectorStore.h"
+
+#include <IOKit/storage/IOCDTypes.h>
+
+#import "CDDAUtilities.h"
+#import "FileUtilities.h"
+#import "DigestUtilities.h"
+#import "Logger.h"
+
+// ========================================
+// Keep file reads to approximately 2 MB in size (2352 bytes are necessary for each sector)
+// ========================================
+#define BUFFER_SIZE_IN_SECTORS 875u
+
+// ========================================
+// The number of bytes of audio currently held in memory by all stores
+// ========================================
+static NSUInteger sMemoryInUse = 0;
+
+@interface SectorStore ()
+@property (copy) NSURL * URL;
+@property (copy) NSString * cachedMD5;
+@property (copy) NSString * cachedSHA1;
+@property (copy) NSData * cachedSectorFingerprints;
+@end
+
+@interface SectorStore (Private)
++ (BOOL) reserveMemory:(NSUInteger)byteCount;
++ (void) releaseMemory:(NSUInteger)byteCount;
+
+- (BOOL) openFileForReadingAtURL:(NSURL *)URL error:(NSError **)error;
+- (BOOL) moveAudioToFile:(NSError **)error;
+- (BOOL) writeAudio:(const void *)buffer byteCount:(NSUInteger)byteCount atByteOffset:(NSUInteger)byteOffset error:(NSError **)error;
+- (void) calculateMD5AndSHA1Digests;
+- (void) calculateSectorFingerprints;
+@end
+
+@implementation SectorStore
+
+// ========================================
+// Creation
+// ========================================
++ (id) sectorStore
+{
+	SectorStore *sectorStore = [[SectorStore alloc] init];
+
+	// Stores start out in memory whenever possible
+	if(sectorStore)
+		sectorStore->_data = [NSMutableData data];
+
+	return sectorStore;
+}
+
++ (id) sectorStoreWithContentsOfURL:(NSURL *)URL error:(NSError **)error
+{
+	NSParameterAssert(nil != URL);
+	NSParameterAssert([URL isFileURL]);
+
+	SectorStore *sectorStore = [[SectorStore alloc] init];
+
+	return ([sectorStore openFileForReadingAtURL:URL error:error] ? sectorStore : nil);
+}
+
+// ========================================
+// Memory budget
+// ========================================
++ (NSUInteger) memoryBudget
+{
+	NSInteger budgetInMegabytes = [[NSUserDefaults standardUserDefaults] integerForKey:@"sectorStoreMemoryBudget"];
+	if(0 >= budgetInMegabytes)
+		return 0;
+
+	return (NSUInteger)budgetInMegabytes * 1024 * 1024;
+}
+
++ (NSUInteger) memoryInUse
+{
+	@synchronized(self) {
+		return sMemoryInUse;
+	}
+}
+
+// ========================================
+// Properties
+// ========================================
+@synthesize URL = _URL;
+@synthesize cachedMD5 = _cachedMD5;
+@synthesize cachedSHA1 = _cachedSHA1;
+@synthesize cachedSectorFingerprints = _cachedSectorFingerprints;
+
+- (BOOL) close
+{
+	BOOL result = YES;
+
+	if(_data) {
+		[SectorStore releaseMemory:[_data length]];
+		_data = nil;
+	}
+
+	if(_file) {
+		OSStatus status = AudioFileClose(_file);
+		_file = NULL;
+		if(noErr != status) {
+			[[Logger sharedLogger] logMessage:@"Unable to close the sector store's audio file (%i)", (int)status];
+			result = NO;
+		}
+	}
+
+	// Remove the temporary file, if one was created
+	if(_ownsFile && self.URL) {
+		if(![[NSFileManager defaultManager] removeItemAtPath:[self.URL path] error:NULL])
+			result = NO;
+		_ownsFile = NO;
+	}
+
+	_byteCount = 0;
+
+	return result;
+}
+
+- (BOOL) isMemoryBacked
+{
+	return (nil != _data);
+}
+
+- (NSUInteger) sectorCount
+{
+	return (_byteCount / kCDSectorSizeCDDA);
+}
+
+// ========================================
+// Digests
+// ========================================
+- (NSString *) MD5
+{
+	if(!self.cachedMD5)
+		[self calculateMD5AndSHA1Digests];
+	return self.cachedMD5;
+}
+
+- (NSString *) SHA1
+{
+	if(!self.cachedSHA1)
+		[self calculateMD5AndSHA1Digests];
+	return self.cachedSHA1;
+}
+
+- (NSData *) sectorFingerprints
+{
+	if(!self.cachedSectorFingerprints)
+		[self calculateSectorFingerprints];
+	return self.cachedSectorFingerprints;
+}
+
+// ========================================
+// Reading
+// ========================================
+- (NSData *) audioDataForSector:(NSUInteger)sector error:(NSError **)error
+{
+	return [self audioDataForSectors:NSMakeRange(sector, 1) error:error];
+}
+
+- (NSData *) audioDataForSectors:(NSRange)sectors error:(NSError **)error
+{
+	int8_t *buffer = calloc(sectors.length, kCDSectorSizeCDDA);
+	if(!buffer) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		return nil;
+	}
+
+	NSError *localError = nil;
+	NSUInteger sectorsRead = [self readAudioForSectors:sectors buffer:buffer error:&localError];
+
+	if(0 == sectorsRead && localError) {
+		free(buffer);
+		if(error)
+			*error = localError;
+		return nil;
+	}
+
+	// The returned NSData takes ownership of buffer
+	return [NSData dataWithBytesNoCopy:buffer length:(kCDSectorSizeCDDA * sectorsRead) freeWhenDone:YES];
+}
+
+- (NSUInteger) readAudioForSectors:(NSRange)sectors buffer:(void *)buffer error:(NSError **)error
+{
+	NSRange frames = NSMakeRange(AUDIO_FRAMES_PER_CDDA_SECTOR * sectors.location, AUDIO_FRAMES_PER_CDDA_SECTOR * sectors.length);
+	NSUInteger framesRead = [self readAudioForFrames:frames buffer:buffer error:error];
+
+	return (framesRead / AUDIO_FRAMES_PER_CDDA_SECTOR);
+}
+
+- (NSUInteger) readAudioForFrames:(NSRange)frames buffer:(void *)buffer error:(NSError **)error
+{
+	NSParameterAssert(NULL != buffer);
+
+	const NSUInteger bytesPerFrame = CDDA_CHANNELS_PER_FRAME * (CDDA_BITS_PER_CHANNEL / 8);
+
+	NSUInteger byteOffset = bytesPerFrame * frames.location;
+	NSUInteger byteCount = bytesPerFrame * frames.length;
+
+	// Reads past the end of the audio return nothing
+	if(byteOffset >= _byteCount)
+		return 0;
+
+	if(byteOffset + byteCount > _byteCount)
+		byteCount = _byteCount - byteOffset;
+
+	// Memory-backed stores are simple
+	if(_data) {
+		memcpy(buffer, (const int8_t *)[_data bytes] + byteOffset, byteCount);
+		return (byteCount / bytesPerFrame);
+	}
+
+	UInt32 fileByteCount = (UInt32)byteCount;
+	UInt32 packetCount = (UInt32)(byteCount / bytesPerFrame);
+
+	OSStatus status = AudioFileReadPackets(_file, false, &fileByteCount, NULL, (SInt64)frames.location, &packetCount, buffer);
+	if(noErr != status) {
+		if(error)
+			*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+		return 0;
+	}
+
+	return packetCount;
+}
+
+// ========================================
+// Writing
+// ========================================
+- (BOOL) appendAudio:(const void *)buffer byteCount:(NSUInteger)byteCount error:(NSError **)error
+{
+	return [self writeAudio:buffer byteCount:byteCount atByteOffset:_byteCount error:error];
+}
+
+- (BOOL) setAudioData:(NSData *)data forSector:(NSUInteger)sector error:(NSError **)error
+{
+	return [self setAudioData:data forSectors:NSMakeRange(sector, 1) error:error];
+}
+
+- (BOOL) setAudioData:(NSData *)data forSectors:(NSRange)sectors error:(NSError **)error
+{
+	NSParameterAssert(nil != data);
+	NSParameterAssert([data length] >= (kCDSectorSizeCDDA * sectors.length));
+
+	NSError *localError = nil;
+	NSUInteger sectorsWritten = [self setAudio:[data bytes] forSectors:sectors error:&localError];
+
+	if(0 == sectorsWritten && localError) {
+		if(error)
+			*error = localError;
+		return NO;
+	}
+
+	if(sectors.length != sectorsWritten)
+		return NO;
+
+	return YES;
+}
+
+- (NSUInteger) setAudio:(const void *)buffer forSectors:(NSRange)sectors error:(NSError **)error
+{
+	NSParameterAssert(NULL != buffer);
+
+	if(![self writeAudio:buffer byteCount:(kCDSectorSizeCDDA * sectors.length) atByteOffset:(kCDSectorSizeCDDA * sectors.location) error:error])
+		return 0;
+
+	return sectors.length;
+}
+
+- (BOOL) copySectors:(NSRange)sectors fromSectorStore:(SectorStore *)sectorStore toSector:(NSUInteger)sector error:(NSError **)error
+{
+	NSParameterAssert(nil != sectorStore);
+
+	// Ensure the input contains an adequate number of sectors
+	if(sectorStore.sectorCount < NSMaxRange(sectors)) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+		return NO;
+	}
+
+	// Sectors held in memory can be copied directly
+	if(sectorStore.isMemoryBacked) {
+		const int8_t *bytes = (const int8_t *)[sectorStore->_data bytes] + (kCDSectorSizeCDDA * sectors.location);
+		return [self writeAudio:bytes byteCount:(kCDSectorSizeCDDA * sectors.length) atByteOffset:(kCDSectorSizeCDDA * sector) error:error];
+	}
+
+	// Allocate the transfer buffer
+	__strong int8_t *buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
+	if(NULL == buffer) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		return NO;
+	}
+
+	NSUInteger sectorsRemaining = sectors.length;
+	while(0 < sectorsRemaining) {
+		NSUInteger sectorCount = MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining);
+		NSUInteger sectorOffset = sectors.length - sectorsRemaining;
+
+		NSUInteger sectorsRead = [sectorStore readAudioForSectors:NSMakeRange(sectors.location + sectorOffset, sectorCount) buffer:buffer error:error];
+		if(sectorsRead != sectorCount)
+			return NO;
+
+		if(![self writeAudio:buffer byteCount:(kCDSectorSizeCDDA * sectorsRead) atByteOffset:(kCDSectorSizeCDDA * (sector + sectorOffset)) error:error])
+			return NO;
+
+		sectorsRemaining -= sectorsRead;
+	}
+
+	return YES;
+}
+
+// ========================================
+// Comparison
+// ========================================
+- (NSIndexSet *) nonMatchingSectorsInSectorStore:(SectorStore *)sectorStore
+{
+	NSParameterAssert(nil != sectorStore);
+
+	NSUInteger sectorCount = self.sectorCount;
+	if(sectorCount != sectorStore.sectorCount)
+		return nil;
+
+	NSMutableIndexSet *mismatchedSectors = [NSMutableIndexSet indexSet];
+
+	// When both stores are memory-backed no copying is necessary
+	if(self.isMemoryBacked && sectorStore.isMemoryBacked) {
+		const int8_t *leftBytes = [_data bytes];
+		const int8_t *rightBytes = [sectorStore->_data bytes];
+
+		for(NSUInteger sectorIndex = 0; sectorIndex < sectorCount; ++sectorIndex) {
+			if(memcmp(leftBytes + (kCDSectorSizeCDDA * sectorIndex), rightBytes + (kCDSectorSizeCDDA * sectorIndex), kCDSectorSizeCDDA))
+				[mismatchedSectors addIndex:sectorIndex];
+		}
+
+		return [mismatchedSectors copy];
+	}
+
+	// Otherwise the fingerprints, which each store calculates only once, identify the sectors that
+	// may match; a matching fingerprint is confirmed by comparing the audio itself
+	NSData *leftFingerprints = self.sectorFingerprints;
+	NSData *rightFingerprints = sectorStore.sectorFingerprints;
+	if(!leftFingerprints || !rightFingerprints)
+		return nil;
+
+	const uint64_t *leftFingerprint = [leftFingerprints bytes];
+	const uint64_t *rightFingerprint = [rightFingerprints bytes];
+
+	__strong int8_t *leftBuffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
+	__strong int8_t *rightBuffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
+	if(NULL == leftBuffer || NULL == rightBuffer)
+		return nil;
+
+	NSUInteger sectorIndex = 0;
+	while(sectorIndex < sectorCount) {
+		NSRange sectors = NSMakeRange(sectorIndex, MIN(BUFFER_SIZE_IN_SECTORS, sectorCount - sectorIndex));
+
+		// Sectors with differing fingerprints can't match, so only read the audio if there are candidates
+		BOOL candidatesFound = NO;
+		for(NSUInteger i = sectors.location; i < NSMaxRange(sectors); ++i) {
+			if(leftFingerprint[i] == rightFingerprint[i]) {
+				candidatesFound = YES;
+				break;
+			}
+		}
+
+		if(!candidatesFound) {
+			[mismatchedSectors addIndexesInRange:sectors];
+			sectorIndex = NSMaxRange(sectors);
+			continue;
+		}
+
+		const int8_t *leftBytes = leftBuffer;
+		if(self.isMemoryBacked)
+			leftBytes = (const int8_t *)[_data bytes] + (kCDSectorSizeCDDA * sectors.location);
+		else if(sectors.length != [self readAudioForSectors:sectors buffer:leftBuffer error:NULL])
+			return nil;
+
+		const int8_t *rightBytes = rightBuffer;
+		if(sectorStore.isMemoryBacked)
+			rightBytes = (const int8_t *)[sectorStore->_data bytes] + (kCDSectorSizeCDDA * sectors.location);
+		else if(sectors.length != [sectorStore readAudioForSectors:sectors buffer:rightBuffer error:NULL])
+			return nil;
+
+		for(NSUInteger i = 0; i < sectors.length; ++i) {
+			NSUInteger sector = sectors.location + i;
+			if(leftFingerprint[sector] != rightFingerprint[sector] || memcmp(leftBytes + (kCDSectorSizeCDDA * i), rightBytes + (kCDSectorSizeCDDA * i), kCDSectorSizeCDDA))
+				[mismatchedSectors addIndex:sector];
+		}
+
+		sectorIndex = NSMaxRange(sectors);
+	}
+
+	return [mismatchedSectors copy];
+}
+
+// ========================================
+// Export
+// ========================================
+- (BOOL) writeSectors:(NSRange)sectors toURL:(NSURL *)URL error:(NSError **)error
+{
+	NSParameterAssert(nil != URL);
+
+	if(self.sectorCount < NSMaxRange(sectors)) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+		return NO;
+	}
+
+	// Set up the ASBD for CDDA audio
+	AudioStreamBasicDescription cddaASBD = getStreamDescriptionForCDDA();
+
+	// Create and open the output file, overwriting if it exists
+	AudioFileID file = NULL;
+	OSStatus status = AudioFileCreateWithURL((CFURLRef)URL, kAudioFileWAVEType, &cddaASBD, kAudioFileFlags_EraseFile, &file);
+	if(noErr != status) {
+		if(error)
+			*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+		return NO;
+	}
+
+	BOOL result = NO;
+	__strong int8_t *buffer = NULL;
+
+	// Sectors held in memory can be written directly
+	if(self.isMemoryBacked) {
+		const int8_t *bytes = (const int8_t *)[_data bytes] + (kCDSectorSizeCDDA * sectors.location);
+
+		UInt32 packetCount = (UInt32)(AUDIO_FRAMES_PER_CDDA_SECTOR * sectors.length);
+		status = AudioFileWritePackets(file, false, (UInt32)(kCDSectorSizeCDDA * sectors.length), NULL, 0, &packetCount, bytes);
+		if(noErr != status) {
+			if(error)
+				*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+			goto cleanup;
+		}
+
+		result = YES;
+		goto cleanup;
+	}
+
+	buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
+	if(NULL == buffer) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		goto cleanup;
+	}
+
+	SInt64 outputPacket = 0;
+	NSUInteger sectorsRemaining = sectors.length;
+	while(0 < sectorsRemaining) {
+		NSRange sectorsToRead = NSMakeRange(sectors.location + sectors.length - sectorsRemaining, MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining));
+
+		NSUInteger sectorsRead = [self readAudioForSectors:sectorsToRead buffer:buffer error:error];
+		if(sectorsRead != sectorsToRead.length)
+			goto cleanup;
+
+		UInt32 packetCount = (UInt32)(AUDIO_FRAMES_PER_CDDA_SECTOR * sectorsRead);
+		status = AudioFileWritePackets(file, false, (UInt32)(kCDSectorSizeCDDA * sectorsRead), NULL, outputPacket, &packetCount, buffer);
+		if(noErr != status) {
+			if(error)
+				*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+			goto cleanup;
+		}
+
+		outputPacket += packetCount;
+		sectorsRemaining -= sectorsRead;
+	}
+
+	result = YES;
+
+cleanup:
+	status = AudioFileClose(file);
+	if(noErr != status) {
+		if(error)
+			*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+		result = NO;
+	}
+
+	return result;
+}
+
+@end
+
+@implementation SectorStore (Private)
+
++ (BOOL) reserveMemory:(NSUInteger)byteCount
+{
+	NSUInteger memoryBudget = [self memoryBudget];
+
+	@synchronized(self) {
+		if(sMemoryInUse + byteCount > memoryBudget)
+			return NO;
+
+		sMemoryInUse += byteCount;
+	}
+
+	return YES;
+}
+
++ (void) releaseMemory:(NSUInteger)byteCount
+{
+	@synchronized(self) {
+		sMemoryInUse -= MIN(byteCount, sMemoryInUse);
+	}
+}
+
+- (BOOL) openFileForReadingAtURL:(NSURL *)URL error:(NSError **)error
+{
+	NSParameterAssert(nil != URL);
+
+	// Open the input file for reading
+	OSStatus status = AudioFileOpenURL((CFURLRef)URL, fsRdPerm, kAudioFileWAVEType, &_file);
+	if(noErr != status) {
+		if(error)
+			*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+		return NO;
+	}
+
+	// Determine the file's type
+	AudioStreamBasicDescription streamDescription;
+	UInt32 dataSize = (UInt32)sizeof(streamDescription);
+	status = AudioFileGetProperty(_file, kAudioFilePropertyDataFormat, &dataSize, &streamDescription);
+	if(noErr != status)
+		goto error;
+
+	// Make sure the file is the expected type (CDDA)
+	if(!streamDescriptionIsCDDA(&streamDescription)) {
+		status = paramErr;
+		goto error;
+	}
+
+	// Determine the size of the audio
+	UInt64 totalPackets = 0;
+	dataSize = sizeof(totalPackets);
+	status = AudioFileGetProperty(_file, kAudioFilePropertyAudioDataPacketCount, &dataSize, &totalPackets);
+	if(noErr != status)
+		goto error;
+
+	self.URL = URL;
+	_byteCount = (NSUInteger)(totalPackets * streamDescription.mBytesPerPacket);
+	_readOnly = YES;
+
+	return YES;
+
+error:
+	/*status = */AudioFileClose(_file);
+	_file = NULL;
+	if(error)
+		*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+	return NO;
+}
+
+- (BOOL) moveAudioToFile:(NSError **)error
+{
+	NSAssert(nil != _data, @"Audio must be in memory to be moved to a file");
+
+	// The "Temporary Directory" default may point to a RAM disk, which is preferable to the boot volume
+	NSURL *URL = temporaryURLWithExtension(@"wav");
+
+	// Set up the ASBD for CDDA audio
+	AudioStreamBasicDescription cddaASBD = getStreamDescriptionForCDDA();
+
+	OSStatus status = AudioFileCreateWithURL((CFURLRef)URL, kAudioFileWAVEType, &cddaASBD, kAudioFileFlags_EraseFile, &_file);
+	if(noErr != status) {
+		if(error)
+			*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+		return NO;
+	}
+
+	self.URL = URL;
+	_ownsFile = YES;
+
+	// Write the audio held in memory to the file
+	if([_data length]) {
+		UInt32 packetCount = (UInt32)([_data length] / cddaASBD.mBytesPerPacket);
+		status = AudioFileWritePackets(_file, false, (UInt32)[_data length], NULL, 0, &packetCount, [_data bytes]);
+		if(noErr != status) {
+			if(error)
+				*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+
+			// Leave the audio in memory and discard the partially written file
+			/*status = */AudioFileClose(_file);
+			_file = NULL;
+			[[NSFileManager defaultManager] removeItemAtPath:[URL path] error:NULL];
+			self.URL = nil;
+			_ownsFile = NO;
+
+			return NO;
+		}
+	}
+
+	[SectorStore releaseMemory:[_data length]];
+	_data = nil;
+
+	return YES;
+}
+
+- (BOOL) writeAudio:(const void *)buffer byteCount:(NSUInteger)byteCount atByteOffset:(NSUInteger)byteOffset error:(NSError **)error
+{
+	NSParameterAssert(NULL != buffer);
+
+	const NSUInteger bytesPerFrame = CDDA_CHANNELS_PER_FRAME * (CDDA_BITS_PER_CHANNEL / 8);
+	NSAssert(0 == byteOffset % bytesPerFrame && 0 == byteCount % bytesPerFrame, @"Writes must consist of whole audio frames");
+
+	if(_readOnly) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EPERM userInfo:nil];
+		return NO;
+	}
+
+	NSUInteger endingByteOffset = byteOffset + byteCount;
+
+	// Grow the in-memory audio if the budget allows, otherwise move the audio to disk
+	if(_data && endingByteOffset > [_data length]) {
+		if([SectorStore reserveMemory:(endingByteOffset - [_data length])])
+			[_data setLength:endingByteOffset];
+		else if(![self moveAudioToFile:error])
+			return NO;
+	}
+
+	if(_data)
+		memcpy((int8_t *)[_data mutableBytes] + byteOffset, buffer, byteCount);
+	else {
+		UInt32 packetCount = (UInt32)(byteCount / bytesPerFrame);
+		OSStatus status = AudioFileWritePackets(_file, false, (UInt32)byteCount, NULL, (SInt64)(byteOffset / bytesPerFrame), &packetCount, buffer);
+		if(noErr != status) {
+			if(error)
+				*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+			return NO;
+		}
+	}
+
+	_byteCount = MAX(_byteCount, endingByteOffset);
+
+	// Invalidate our cached digests
+	self.cachedMD5 = nil;
+	self.cachedSHA1 = nil;
+	self.cachedSectorFingerprints = nil;
+
+	return YES;
+}
+
+- (void) calculateMD5AndSHA1Digests
+{
+	// Initialize the MD5 and SHA1 checksums
+	AudioDigestContext digest;
+	audioDigestInit(&digest);
+
+	NSUInteger sectorCount = self.sectorCount;
+
+	if(_data) {
+		audioDigestUpdate(&digest, [_data bytes], (kCDSectorSizeCDDA * sectorCount));
+	}
+	else {
+		__strong int8_t *buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
+		if(NULL == buffer)
+			return;
+
+		// Iteratively process each chunk of sectors in the file
+		NSUInteger sectorsRemaining = sectorCount;
+		while(0 < sectorsRemaining) {
+			NSRange sectorsToRead = NSMakeRange(sectorCount - sectorsRemaining, MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining));
+
+			NSUInteger sectorsRead = [self readAudioForSectors:sectorsToRead buffer:buffer error:NULL];
+			if(sectorsRead != sectorsToRead.length)
+				return;
+
+			// Update the MD5 and SHA1 digests
+			audioDigestUpdate(&digest, buffer, (kCDSectorSizeCDDA * sectorsRead));
+
+			sectorsRemaining -= sectorsRead;
+		}
+	}
+
+	// Complete the MD5 and SHA1 calculations and store the result
+	NSString *MD5 = nil, *SHA1 = nil;
+	audioDigestFinal(&digest, &MD5, &SHA1);
+
+	self.cachedMD5 = MD5;
+	self.cachedSHA1 = SHA1;
+}
+
+- (void) calculateSectorFingerprints
+{
+	NSUInteger sectorCount = self.sectorCount;
+
+	NSMutableData *fingerprints = [NSMutableData dataWithLength:(sizeof(uint64_t) * sectorCount)];
+	uint64_t *fingerprint = [fingerprints mutableBytes];
+
+	if(_data) {
+		const int8_t *bytes = [_data bytes];
+		for(NSUInteger sectorIndex = 0; sectorIndex < sectorCount; ++sectorIndex)
+			fingerprint[sectorIndex] = xxHash64(bytes + (kCDSectorSizeCDDA * sectorIndex), kCDSectorSizeCDDA, 0);
+	}
+	else {
+		__strong int8_t *buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
+		if(NULL == buffer)
+			return;
+
+		// Iteratively process each chunk of sectors in the file
+		NSUInteger sectorsRemaining = sectorCount;
+		while(0 < sectorsRemaining) {
+			NSRange sectorsToRead = NSMakeRange(sectorCount - sectorsRemaining, MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining));
+
+			NSUInteger sectorsRead = [self readAudioForSectors:sectorsToRead buffer:buffer error:NULL];
+			if(sectorsRead != sectorsToRead.length)
+				return;
+
+			for(NSUInteger i = 0; i < sectorsRead; ++i)
+				fingerprint[sectorsToRead.location + i] = xxHash64(buffer + (kCDSectorSizeCDDA * i), kCDSectorSizeCDDA, 0);
+
+			sectorsRemaining -= sectorsRead;
+		}
+	}
+
+	self.cachedSectorFingerprints = fingerprints;
+}
+
+@end
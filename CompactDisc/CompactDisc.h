@@ -15,6 +15,10 @@
 // ========================================
 @interface CompactDisc : NSManagedObject
 {
+@private
+	NSNumber *_freeDBDiscID;		// The disc's identifiers, calculated or restored once
+	NSNumber *_accurateRipID1;
+	NSNumber *_accurateRipID2;
 }
 
 // ========================================
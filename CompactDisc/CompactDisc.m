@@ -8,13 +8,18 @@
 #import "SectorRange.h"
 #import "SessionDescriptor.h"
 #import "TrackDescriptor.h"
+#import "AlbumMetadata.h"
+#import "TrackMetadata.h"
+#import "DiscIdentityCache.h"
+#import "Logger.h"
 
 #include "base64.h"
 
 #include <stdio.h>
 
 #include <IOKit/storage/IOCDMedia.h>
-#include <CommonCrypto/CommonDigest.h>
+
+#import "DigestUtilities.h"
 
 // ========================================
 // Calculates the sum of the digits in the given number
@@ -110,27 +115,27 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 	}
 
 	// First calculate the SHA-1 digest of the uppercase hex ASCII TOC information
-	CC_SHA1_CTX sha1;	
-	CC_SHA1_Init(&sha1);
+	SHA1Context sha1;
+	sha1Init(&sha1);
 	
 	char numberAsHexASCII [8 + 1];
 	snprintf(numberAsHexASCII, 2 + 1, "%02X", firstTrackNumber);
-	CC_SHA1_Update(&sha1, &numberAsHexASCII, 2);
+	sha1Update(&sha1, numberAsHexASCII, 2);
 
 	snprintf(numberAsHexASCII, 2 + 1, "%02X", lastTrackNumber);
-	CC_SHA1_Update(&sha1, &numberAsHexASCII, 2);
+	sha1Update(&sha1, numberAsHexASCII, 2);
 
 	for(int i = 0; i < 100; ++i) {
 		snprintf(numberAsHexASCII, 8 + 1, "%08X", offsets[i]);
-		CC_SHA1_Update(&sha1, &numberAsHexASCII, 8);
+		sha1Update(&sha1, numberAsHexASCII, 8);
 	}
 	
-	unsigned char sha1Digest [CC_SHA1_DIGEST_LENGTH];
-	CC_SHA1_Final(sha1Digest, &sha1);
+	uint8_t sha1Digest [SHA1_DIGEST_LENGTH];
+	sha1Final(&sha1, sha1Digest);
 
 	// Then encode the SHA-1 digest using a MusicBrainz-specific base 64 encoding
 	unsigned long len = 0;
-	unsigned char *rawMusicBrainzDiscID = rfc822_binary(sha1Digest, CC_SHA1_DIGEST_LENGTH, &len);
+	unsigned char *rawMusicBrainzDiscID = rfc822_binary(sha1Digest, SHA1_DIGEST_LENGTH, &len);
 
 	// len is always 30, but the actual ID length is 28, so don't use initWithBytes:length:encoding:freeWhenDone
 	musicBrainzDiscID = [[NSString alloc] initWithCString:(const char *)rawMusicBrainzDiscID encoding:NSASCIIStringEncoding];
@@ -144,6 +149,10 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 // Private methods
 @interface CompactDisc (Private)
 - (void) parseTOC:(CDTOC *)toc;
+- (void) restoreIdentity:(NSDictionary *)identity;
+- (void) restoreIdentifiers:(NSDictionary *)identity;
+- (NSUInteger) calculateAccurateRipID1;
+- (NSUInteger) calculateAccurateRipID2;
 @end
 
 @implementation CompactDisc
@@ -201,8 +210,13 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 	
 	CDTOC *toc = (CDTOC *)[tocData bytes];
 
+	// Discs that have been seen before have their identities cached
+	NSDictionary *identity = [[DiscIdentityCache sharedCache] identityForDiscTOC:tocData];
+
 	// If this disc has been seen before, fetch it
-	NSString *discID = calculateMusicBrainzDiscIDForCDTOC(toc);
+	NSString *discID = [identity objectForKey:kDiscIdentityMusicBrainzDiscIDKey];
+	if(!discID)
+		discID = calculateMusicBrainzDiscIDForCDTOC(toc);
 
 	// Build and execute a fetch request matching on the disc's MusicBrainz ID
 	NSEntityDescription *entityDescription = [NSEntityDescription entityForName:@"CompactDisc" 
@@ -231,10 +245,30 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 		compactDisc.discTOC = tocData;
 		compactDisc.musicBrainzDiscID = discID;
 		[compactDisc parseTOC:toc];
+
+		if(identity)
+			[compactDisc restoreIdentity:identity];
+		else {
+			NSMutableDictionary *values = [NSMutableDictionary dictionary];
+
+			[values setObject:discID forKey:kDiscIdentityMusicBrainzDiscIDKey];
+			[values setObject:[NSNumber numberWithUnsignedInteger:calculateFreeDBDiscIDForCDTOC(toc)] forKey:kDiscIdentityFreeDBDiscIDKey];
+			[values setObject:[NSNumber numberWithUnsignedInteger:[compactDisc calculateAccurateRipID1]] forKey:kDiscIdentityAccurateRipID1Key];
+			[values setObject:[NSNumber numberWithUnsignedInteger:[compactDisc calculateAccurateRipID2]] forKey:kDiscIdentityAccurateRipID2Key];
+
+			if(![[DiscIdentityCache sharedCache] updateIdentityForDiscTOC:tocData withValues:values error:&error])
+				[[Logger sharedLogger] logMessage:@"Unable to cache the disc's identity: %@", error];
+
+			identity = values;
+		}
 	}
 	else
 		compactDisc = matchingDiscs.lastObject;
 	
+	// The identity cache is only consulted here; the identifiers are kept for the life of the object
+	if(identity)
+		[compactDisc restoreIdentifiers:identity];
+	
 	return compactDisc;
 }
 
@@ -274,6 +308,15 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 												  inManagedObjectContext:self.managedObjectContext];	
 }
 
+- (void) didTurnIntoFault
+{
+	_freeDBDiscID = nil;
+	_accurateRipID1 = nil;
+	_accurateRipID2 = nil;
+
+	[super didTurnIntoFault];
+}
+
 // ========================================
 // Other properties
 - (NSArray *) orderedSessions
@@ -298,51 +341,28 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 // Computed properties
 - (NSUInteger) freeDBDiscID
 {
-	CDTOC *toc = (CDTOC *)[self.discTOC bytes];
-	return calculateFreeDBDiscIDForCDTOC(toc);
+	if(!_freeDBDiscID) {
+		CDTOC *toc = (CDTOC *)[self.discTOC bytes];
+		_freeDBDiscID = [NSNumber numberWithUnsignedInteger:calculateFreeDBDiscIDForCDTOC(toc)];
+	}
+
+	return _freeDBDiscID.unsignedIntegerValue;
 }
 
 - (NSUInteger) accurateRipID1
 {
-	// ID 1 is the sum of all the disc's offsets
-	// The lead out is treated as track n + 1, where n is the number of audio tracks
-	NSUInteger accurateRipID1 = 0;
-	
-	// Use the first session
-	SessionDescriptor *firstSession = self.firstSession;
-	if(!firstSession)
-		return 0;
+	if(!_accurateRipID1)
+		_accurateRipID1 = [NSNumber numberWithUnsignedInteger:[self calculateAccurateRipID1]];
 
-	for(TrackDescriptor *track in firstSession.tracks)
-		accurateRipID1 += track.firstSector.unsignedIntegerValue;
-	
-	// Adjust for lead out
-	accurateRipID1 += firstSession.leadOut.unsignedIntegerValue;
-	
-	return accurateRipID1;
+	return _accurateRipID1.unsignedIntegerValue;
 }
 
 - (NSUInteger) accurateRipID2
 {
-	// ID 2 is the sum of all the disc's offsets times their track number
-	// The lead out is treated as track n + 1, where n is the number of audio tracks
-	NSUInteger accurateRipID2 = 0;
+	if(!_accurateRipID2)
+		_accurateRipID2 = [NSNumber numberWithUnsignedInteger:[self calculateAccurateRipID2]];
 
-	// Use the first session
-	SessionDescriptor *firstSession = self.firstSession;
-	if(!firstSession)
-		return 0;
-
-	NSSet *tracks = firstSession.tracks;
-	for(TrackDescriptor *track in tracks) {
-		NSUInteger offset = track.firstSector.unsignedIntegerValue;
-		accurateRipID2 += (0 == offset ? 1 : offset) * track.number.unsignedIntValue;
-	}
-	
-	// Adjust for lead out
-	accurateRipID2 += firstSession.leadOut.unsignedIntegerValue * (1 + tracks.count);
-
-	return accurateRipID2;
+	return _accurateRipID2.unsignedIntegerValue;
 }
 
 // Disc track information
@@ -498,4 +518,78 @@ static NSString * calculateMusicBrainzDiscIDForCDTOC(CDTOC *toc)
 	}
 }
 
+- (void) restoreIdentity:(NSDictionary *)identity
+{
+	NSParameterAssert(nil != identity);
+
+	NSString *MCN = [identity objectForKey:kDiscIdentityMCNKey];
+	if(MCN)
+		self.metadata.MCN = MCN;
+
+	NSDictionary *ISRCs = [identity objectForKey:kDiscIdentityISRCsKey];
+	NSDictionary *pregaps = [identity objectForKey:kDiscIdentityPregapsKey];
+
+	for(TrackDescriptor *track in self.firstSession.tracks) {
+		NSString *ISRC = [ISRCs objectForKey:track.number];
+		if(ISRC)
+			track.metadata.ISRC = ISRC;
+
+		NSNumber *pregap = [pregaps objectForKey:track.number];
+		if(pregap)
+			track.pregap = pregap;
+	}
+}
+
+- (void) restoreIdentifiers:(NSDictionary *)identity
+{
+	NSParameterAssert(nil != identity);
+
+	_freeDBDiscID = [identity objectForKey:kDiscIdentityFreeDBDiscIDKey];
+	_accurateRipID1 = [identity objectForKey:kDiscIdentityAccurateRipID1Key];
+	_accurateRipID2 = [identity objectForKey:kDiscIdentityAccurateRipID2Key];
+}
+
+- (NSUInteger) calculateAccurateRipID1
+{
+	// ID 1 is the sum of all the disc's offsets
+	// The lead out is treated as track n + 1, where n is the number of audio tracks
+	NSUInteger accurateRipID1 = 0;
+	
+	// Use the first session
+	SessionDescriptor *firstSession = self.firstSession;
+	if(!firstSession)
+		return 0;
+
+	for(TrackDescriptor *track in firstSession.tracks)
+		accurateRipID1 += track.firstSector.unsignedIntegerValue;
+	
+	// Adjust for lead out
+	accurateRipID1 += firstSession.leadOut.unsignedIntegerValue;
+	
+	return accurateRipID1;
+}
+
+- (NSUInteger) calculateAccurateRipID2
+{
+	// ID 2 is the sum of all the disc's offsets times their track number
+	// The lead out is treated as track n + 1, where n is the number of audio tracks
+	NSUInteger accurateRipID2 = 0;
+
+	// Use the first session
+	SessionDescriptor *firstSession = self.firstSession;
+	if(!firstSession)
+		return 0;
+
+	NSSet *tracks = firstSession.tracks;
+	for(TrackDescriptor *track in tracks) {
+		NSUInteger offset = track.firstSector.unsignedIntegerValue;
+		accurateRipID2 += (0 == offset ? 1 : offset) * track.number.unsignedIntValue;
+	}
+	
+	// Adjust for lead out
+	accurateRipID2 += firstSession.leadOut.unsignedIntegerValue * (1 + tracks.count);
+
+	return accurateRipID2;
+}
+
 @end
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+// ========================================
+// Keys for the values in an identity
+// ========================================
+extern NSString * const		kDiscIdentityMusicBrainzDiscIDKey;			// NSString *
+extern NSString * const		kDiscIdentityFreeDBDiscIDKey;				// NSNumber * (unsigned int)
+extern NSString * const		kDiscIdentityAccurateRipID1Key;				// NSNumber * (unsigned int)
+extern NSString * const		kDiscIdentityAccurateRipID2Key;				// NSNumber * (unsigned int)
+extern NSString * const		kDiscIdentityAccurateRipResponseKey;		// NSData * (empty if the disc isn't in AccurateRip)
+extern NSString * const		kDiscIdentityAccurateRipResponseURLKey;		// NSURL *
+extern NSString * const		kDiscIdentityMetadataKey;					// NSDictionary *, the chosen music database entry
+extern NSString * const		kDiscIdentityMCNKey;						// NSString *
+extern NSString * const		kDiscIdentityISRCsKey;						// NSDictionary * (track number -> NSString *)
+extern NSString * const		kDiscIdentityPregapsKey;					// NSDictionary * (track number -> NSNumber *)
+extern NSString * const		kDiscIdentitySubchannelSurveyedKey;			// NSNumber * (BOOL)
+
+// ========================================
+// A persistent cache of what has been learned about each disc, keyed by the SHA1
+// of its raw TOC, so a disc that has been seen before doesn't need to be identified,
+// looked up or surveyed again
+// Each identity is archived to its own file; identities are kept in memory once read
+// ========================================
+@interface DiscIdentityCache : NSObject
+{
+@private
+	NSURL *_cacheURL;
+	NSMutableDictionary *_identities;
+}
+
+// ========================================
+// The shared cache, stored in the application support folder
++ (DiscIdentityCache *) sharedCache;
+
+- (id) initWithCacheURL:(NSURL *)cacheURL;
+
+// ========================================
+// Properties
+@property (readonly, copy) NSURL * cacheURL;
+
+// ========================================
+// Returns the identity of the disc with the given TOC, or nil if it hasn't been seen
+- (NSDictionary *) identityForDiscTOC:(NSData *)discTOC;
+
+// ========================================
+// Merge values into the disc's identity and write it to disk
+// NSNull values remove the corresponding keys
+- (BOOL) updateIdentityForDiscTOC:(NSData *)discTOC withValues:(NSDictionary *)values error:(NSError **)error;
+
+@end
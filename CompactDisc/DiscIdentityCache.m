@@ -0,0 +1,176 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "DiscIdentityCache.h"
+#import "DigestUtilities.h"
+#import "ApplicationDelegate.h"
+#import "Logger.h"
+
+// ========================================
+// Identity keys
+// ========================================
+NSString * const	kDiscIdentityMusicBrainzDiscIDKey				= @"musicBrainzDiscID";
+NSString * const	kDiscIdentityFreeDBDiscIDKey					= @"freeDBDiscID";
+NSString * const	kDiscIdentityAccurateRipID1Key					= @"accurateRipID1";
+NSString * const	kDiscIdentityAccurateRipID2Key					= @"accurateRipID2";
+NSString * const	kDiscIdentityAccurateRipResponseKey				= @"accurateRipResponse";
+NSString * const	kDiscIdentityAccurateRipResponseURLKey			= @"accurateRipResponseURL";
+NSString * const	kDiscIdentityMetadataKey						= @"metadata";
+NSString * const	kDiscIdentityMCNKey								= @"MCN";
+NSString * const	kDiscIdentityISRCsKey							= @"ISRCs";
+NSString * const	kDiscIdentityPregapsKey							= @"pregaps";
+NSString * const	kDiscIdentitySubchannelSurveyedKey				= @"subchannelSurveyed";
+
+// ========================================
+// Private methods
+// ========================================
+@interface DiscIdentityCache ()
+@property (copy) NSURL * cacheURL;
+@end
+
+@interface DiscIdentityCache (Private)
+- (NSString *) keyForDiscTOC:(NSData *)discTOC;
+- (NSString *) pathForKey:(NSString *)key;
+@end
+
+// ========================================
+// Static variables
+// ========================================
+static DiscIdentityCache *sSharedCache				= nil;
+
+@implementation DiscIdentityCache
+
+@synthesize cacheURL = _cacheURL;
+
++ (DiscIdentityCache *) sharedCache
+{
+	@synchronized(self) {
+		if(!sSharedCache) {
+			NSURL *applicationSupportFolderURL = [(ApplicationDelegate *)[[NSApplication sharedApplication] delegate] applicationSupportFolderURL];
+			NSString *cachePath = [applicationSupportFolderURL.path stringByAppendingPathComponent:@"Disc Identities"];
+
+			sSharedCache = [[self alloc] initWithCacheURL:[NSURL fileURLWithPath:cachePath]];
+		}
+	}
+
+	return sSharedCache;
+}
+
+- (id) initWithCacheURL:(NSURL *)cacheURL
+{
+	NSParameterAssert(nil != cacheURL);
+
+	if((self = [super init])) {
+		self.cacheURL = cacheURL;
+		_identities = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (NSDictionary *) identityForDiscTOC:(NSData *)discTOC
+{
+	NSParameterAssert(nil != discTOC);
+
+	NSString *key = [self keyForDiscTOC:discTOC];
+
+	@synchronized(self) {
+		NSDictionary *identity = [_identities objectForKey:key];
+		if(identity)
+			return identity;
+
+		NSString *path = [self pathForKey:key];
+		if(![[NSFileManager defaultManager] fileExistsAtPath:path])
+			return nil;
+
+		@try {
+			identity = [NSKeyedUnarchiver unarchiveObjectWithFile:path];
+		}
+		@catch(NSException *exception) {
+			identity = nil;
+		}
+
+		if(![identity isKindOfClass:[NSDictionary class]]) {
+			[[Logger sharedLogger] logMessage:@"Ignoring damaged disc identity %@", path];
+			return nil;
+		}
+
+		[_identities setObject:identity forKey:key];
+
+		return identity;
+	}
+}
+
+- (BOOL) updateIdentityForDiscTOC:(NSData *)discTOC withValues:(NSDictionary *)values error:(NSError **)error
+{
+	NSParameterAssert(nil != discTOC);
+	NSParameterAssert(nil != values);
+
+	NSString *key = [self keyForDiscTOC:discTOC];
+
+	@synchronized(self) {
+		NSMutableDictionary *identity = [NSMutableDictionary dictionaryWithDictionary:[self identityForDiscTOC:discTOC]];
+
+		for(NSString *valueKey in values) {
+			id value = [values objectForKey:valueKey];
+			if([value isKindOfClass:[NSNull class]])
+				[identity removeObjectForKey:valueKey];
+			else
+				[identity setObject:value forKey:valueKey];
+		}
+
+		// Skip writes that don't change anything
+		if([identity isEqualToDictionary:[_identities objectForKey:key]])
+			return YES;
+
+		NSString *path = [self pathForKey:key];
+		if(![[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:error])
+			return NO;
+
+		// Values that can't be archived are a programming error, but shouldn't take the cache down
+		NSData *archive = nil;
+		@try {
+			archive = [NSKeyedArchiver archivedDataWithRootObject:identity];
+		}
+		@catch(NSException *exception) {
+			if(error)
+				*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:[NSDictionary dictionaryWithObject:[exception reason] forKey:NSLocalizedFailureReasonErrorKey]];
+			return NO;
+		}
+
+		if(![archive writeToFile:path options:NSAtomicWrite error:error])
+			return NO;
+
+		[_identities setObject:[identity copy] forKey:key];
+	}
+
+	return YES;
+}
+
+@end
+
+@implementation DiscIdentityCache (Private)
+
+- (NSString *) keyForDiscTOC:(NSData *)discTOC
+{
+	NSParameterAssert(nil != discTOC);
+
+	uint8_t digest [SHA1_DIGEST_LENGTH];
+	SHA1Context sha1;
+	sha1Init(&sha1);
+	sha1Update(&sha1, [discTOC bytes], [discTOC length]);
+	sha1Final(&sha1, digest);
+
+	return hexStringForDigest(digest, SHA1_DIGEST_LENGTH);
+}
+
+- (NSString *) pathForKey:(NSString *)key
+{
+	NSParameterAssert(nil != key);
+
+	NSString *directory = [self.cacheURL.path stringByAppendingPathComponent:[key substringToIndex:2]];
+	return [directory stringByAppendingPathComponent:[key stringByAppendingPathExtension:@"discid"]];
+}
+
+@end
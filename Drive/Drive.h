@@ -6,6 +6,8 @@
 #import <Cocoa/Cocoa.h>
 #include <DiskArbitration/DiskArbitration.h>
 
+#import "DriveIOScheduler.h"
+
 @class SectorRange;
 
 // ========================================
@@ -19,6 +21,7 @@ enum {
 // ========================================
 // This class encapsulates operations useful on an IOKit
 // device that can read IOCDMedia.
+// Every command is executed by the drive's DriveIOScheduler, at ioPriority
 // ========================================
 @interface Drive : NSObject
 {
@@ -26,6 +29,7 @@ enum {
 	__strong DADiskRef _disk;
 	int _fd;
 	NSUInteger _cacheSize;
+	eDriveIOPriority _ioPriority;
 	NSError *_error;
 }
 
@@ -34,6 +38,7 @@ enum {
 @property (assign) NSUInteger cacheSize;
 @property (readonly) NSUInteger cacheSizeInSectors;
 @property (readonly) BOOL deviceIsOpen;
+@property (assign) eDriveIOPriority ioPriority;
 
 // ========================================
 // Set up to use the drive corresponding to disk
@@ -65,6 +70,13 @@ enum {
 - (NSUInteger) readAudioAndQSubchannel:(void *)buffer sectorRange:(SectorRange *)range;
 - (NSUInteger) readAudioAndQSubchannel:(void *)buffer startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount;
 
+// ========================================
+// Read only the Q sub-channel (buffer should be kCDSectorSizeQSubchannel * sectorCount bytes)
+// Much less data crosses the bus than when reading audio, which makes this suitable for
+// probing the positions of track and index boundaries
+- (NSUInteger) readQSubchannel:(void *)buffer sector:(NSUInteger)sector;
+- (NSUInteger) readQSubchannel:(void *)buffer startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount;
+
 // ========================================
 // Read a chunk of CD-DA data, with error flags (buffer should be (kCDSectorSizeCDDA + kCDSectorSizeErrorFlags) * sectorCount bytes)
 - (NSUInteger) readAudioAndErrorFlags:(void *)buffer sector:(NSUInteger)sector;
@@ -18,7 +18,16 @@
 @end
 
 @interface Drive (Private)
+- (NSInvocation *) invocationForSelector:(SEL)selector;
+- (void) performInvocation:(NSInvocation *)invocation sectorRange:(SectorRange *)range;
+
 - (NSUInteger) readCD:(void *)buffer sectorAreas:(uint8_t)sectorAreas startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount;
+
+- (uint16_t) performGetSpeed;
+- (BOOL) performSetSpeed:(uint16_t)speed;
+- (NSUInteger) performReadCD:(void *)buffer sectorAreas:(uint8_t)sectorAreas startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount;
+- (NSString *) performReadMCN;
+- (NSString *) performReadISRC:(NSUInteger)track;
 @end
 
 @implementation Drive
@@ -27,6 +36,7 @@
 @synthesize error = _error;
 @synthesize fd = _fd;
 @synthesize cacheSize = _cacheSize;
+@synthesize ioPriority = _ioPriority;
 
 - (id) initWithDADiskRef:(DADiskRef)disk
 {
@@ -99,24 +109,23 @@
 
 - (uint16_t) speed
 {
-	uint16_t speed = 0;
-	if(-1 == ioctl(self.fd, DKIOCCDGETSPEED, &speed)) {
-		[[Logger sharedLogger] logMessage:@"Unable to get the drive's speed"];
-		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
-	}
+	NSInvocation *invocation = [self invocationForSelector:@selector(performGetSpeed)];
+	[self performInvocation:invocation sectorRange:nil];
 
+	uint16_t speed = 0;
+	[invocation getReturnValue:&speed];
 	return speed;
 }
 
 - (BOOL) setSpeed:(uint16_t)speed
 {
-	if(-1 == ioctl(self.fd, DKIOCCDSETSPEED, &speed)) {
-		[[Logger sharedLogger] logMessage:@"Unable to set the drive's speed"];
-		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
-		return NO;
-	}
+	NSInvocation *invocation = [self invocationForSelector:@selector(performSetSpeed:)];
+	[invocation setArgument:&speed atIndex:2];
+	[self performInvocation:invocation sectorRange:nil];
 
-	return YES;
+	BOOL result = NO;
+	[invocation getReturnValue:&result];
+	return result;
 }
 
 - (BOOL) clearCacheAvoidingRange:(SectorRange *)range legalSectors:(SectorRange *)legalSectors
@@ -244,6 +253,16 @@
 	return [self readCD:buffer sectorAreas:(kCDSectorAreaUser | kCDSectorAreaSubChannelQ) startSector:startSector sectorCount:sectorCount];
 }
 
+- (NSUInteger) readQSubchannel:(void *)buffer sector:(NSUInteger)sector
+{
+	return [self readQSubchannel:buffer startSector:sector sectorCount:1];
+}
+
+- (NSUInteger) readQSubchannel:(void *)buffer startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount
+{
+	return [self readCD:buffer sectorAreas:kCDSectorAreaSubChannelQ startSector:startSector sectorCount:sectorCount];
+}
+
 - (NSUInteger) readAudioAndErrorFlags:(void *)buffer sector:(NSUInteger)sector
 {
 	return [self readAudioAndErrorFlags:buffer startSector:sector sectorCount:1];
@@ -276,42 +295,87 @@
 
 - (NSString *) readMCN
 {
-	dk_cd_read_mcn_t cd_read_mcn;
-	bzero(&cd_read_mcn, sizeof(cd_read_mcn));
-
-	if(-1 == ioctl(self.fd, DKIOCCDREADMCN, &cd_read_mcn)) {
-		[[Logger sharedLogger] logMessage:@"Unable to read the disc's media catalog number (MCN)"];
-		
-		// This is not an error condition
-		return nil;
-	}
+	NSInvocation *invocation = [self invocationForSelector:@selector(performReadMCN)];
+	[self performInvocation:invocation sectorRange:nil];
 
-	return [NSString stringWithCString:cd_read_mcn.mcn encoding:NSASCIIStringEncoding];
+	NSString *mcn = nil;
+	[invocation getReturnValue:&mcn];
+	return mcn;
 }
 
 - (NSString *) readISRC:(NSUInteger)track
 {
-	dk_cd_read_isrc_t cd_read_isrc;
-	bzero(&cd_read_isrc, sizeof(cd_read_isrc));
+	NSInvocation *invocation = [self invocationForSelector:@selector(performReadISRC:)];
+	[invocation setArgument:&track atIndex:2];
+	[self performInvocation:invocation sectorRange:nil];
 
-	cd_read_isrc.track = track;
+	NSString *isrc = nil;
+	[invocation getReturnValue:&isrc];
+	return isrc;
+}
 
-	if(-1 == ioctl(self.fd, DKIOCCDREADISRC, &cd_read_isrc)) {
-		[[Logger sharedLogger] logMessage:@"Unable to read the international standard recording code (ISRC) for track %i", track];
+@end
 
-		// This is not an error condition
-		return nil;
+@implementation Drive (Private)
+
+- (NSInvocation *) invocationForSelector:(SEL)selector
+{
+	NSInvocation *invocation = [NSInvocation invocationWithMethodSignature:[self methodSignatureForSelector:selector]];
+
+	[invocation setTarget:self];
+	[invocation setSelector:selector];
+
+	return invocation;
+}
+
+// Execute a command on the drive's scheduler and wait for it
+- (void) performInvocation:(NSInvocation *)invocation sectorRange:(SectorRange *)range
+{
+	NSParameterAssert(nil != invocation);
+
+	DriveIORequest *request = [DriveIORequest requestWithInvocation:invocation sectorRange:range priority:self.ioPriority];
+	[[DriveIOScheduler schedulerForDADiskRef:self.disk] performRequest:request];
+}
+
+- (NSUInteger) readCD:(void *)buffer sectorAreas:(uint8_t)sectorAreas startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount
+{
+	NSInvocation *invocation = [self invocationForSelector:@selector(performReadCD:sectorAreas:startSector:sectorCount:)];
+	[invocation setArgument:&buffer atIndex:2];
+	[invocation setArgument:&sectorAreas atIndex:3];
+	[invocation setArgument:&startSector atIndex:4];
+	[invocation setArgument:&sectorCount atIndex:5];
+
+	[self performInvocation:invocation sectorRange:[SectorRange sectorRangeWithFirstSector:startSector sectorCount:sectorCount]];
+
+	NSUInteger sectorsRead = 0;
+	[invocation getReturnValue:&sectorsRead];
+	return sectorsRead;
+}
+
+- (uint16_t) performGetSpeed
+{
+	uint16_t speed = 0;
+	if(-1 == ioctl(self.fd, DKIOCCDGETSPEED, &speed)) {
+		[[Logger sharedLogger] logMessage:@"Unable to get the drive's speed"];
+		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
 	}
 
-	return [NSString stringWithCString:cd_read_isrc.isrc encoding:NSASCIIStringEncoding];
+	return speed;
 }
 
-@end
+- (BOOL) performSetSpeed:(uint16_t)speed
+{
+	if(-1 == ioctl(self.fd, DKIOCCDSETSPEED, &speed)) {
+		[[Logger sharedLogger] logMessage:@"Unable to set the drive's speed"];
+		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+		return NO;
+	}
 
-@implementation Drive (Private)
+	return YES;
+}
 
 // Implementation method
-- (NSUInteger) readCD:(void *)buffer sectorAreas:(uint8_t)sectorAreas startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount
+- (NSUInteger) performReadCD:(void *)buffer sectorAreas:(uint8_t)sectorAreas startSector:(NSUInteger)startSector sectorCount:(NSUInteger)sectorCount
 {
 	NSParameterAssert(NULL != buffer);
 	NSParameterAssert(0 != sectorAreas);
@@ -347,4 +411,36 @@
 	return cd_read.bufferLength / blockSize;
 }
 
+- (NSString *) performReadMCN
+{
+	dk_cd_read_mcn_t cd_read_mcn;
+	bzero(&cd_read_mcn, sizeof(cd_read_mcn));
+
+	if(-1 == ioctl(self.fd, DKIOCCDREADMCN, &cd_read_mcn)) {
+		[[Logger sharedLogger] logMessage:@"Unable to read the disc's media catalog number (MCN)"];
+		
+		// This is not an error condition
+		return nil;
+	}
+
+	return [NSString stringWithCString:cd_read_mcn.mcn encoding:NSASCIIStringEncoding];
+}
+
+- (NSString *) performReadISRC:(NSUInteger)track
+{
+	dk_cd_read_isrc_t cd_read_isrc;
+	bzero(&cd_read_isrc, sizeof(cd_read_isrc));
+
+	cd_read_isrc.track = track;
+
+	if(-1 == ioctl(self.fd, DKIOCCDREADISRC, &cd_read_isrc)) {
+		[[Logger sharedLogger] logMessage:@"Unable to read the international standard recording code (ISRC) for track %i", track];
+
+		// This is not an error condition
+		return nil;
+	}
+
+	return [NSString stringWithCString:cd_read_isrc.isrc encoding:NSASCIIStringEncoding];
+}
+
 @end
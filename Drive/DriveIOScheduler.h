@@ -0,0 +1,84 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#include <DiskArbitration/DiskArbitration.h>
+
+@class SectorRange;
+
+// ========================================
+// Request priorities
+// Higher priority requests are always served first; within a priority requests
+// are served in elevator order
+// ========================================
+enum _eDriveIOPriority {
+	eDriveIOPriorityBackground			= -1,	// Work nobody is waiting on, such as surveys
+	eDriveIOPriorityNormal				= 0,
+	eDriveIOPriorityCritical			= 1		// Reads the extraction of the current track is waiting on
+};
+typedef enum _eDriveIOPriority eDriveIOPriority;
+
+// ========================================
+// A drive command waiting to be executed by a DriveIOScheduler
+// ========================================
+@interface DriveIORequest : NSObject
+{
+@private
+	NSInvocation *_invocation;		// The command
+	SectorRange *_sectorRange;		// The sectors the command reads, if any
+	eDriveIOPriority _priority;
+	NSUInteger _timesPassedOver;	// The number of other requests served while this one waited
+	BOOL _isFinished;
+}
+
++ (id) requestWithInvocation:(NSInvocation *)invocation sectorRange:(SectorRange *)sectorRange priority:(eDriveIOPriority)priority;
+
+// ========================================
+// Properties
+@property (readonly, assign) NSInvocation * invocation;
+@property (readonly, copy) SectorRange * sectorRange;
+@property (readonly, assign) eDriveIOPriority priority;
+@property (readonly, assign) BOOL isFinished;
+
+// ========================================
+// Get the value returned by the command, once it has finished
+- (void) getReturnValue:(void *)buffer;
+
+@end
+
+// ========================================
+// Serializes the commands sent to a drive, so operations running at the same time
+// don't make the drive seek back and forth between them
+// There is one scheduler for each drive, executing requests one at a time on its own
+// thread; waiting requests are ordered by priority, then by sector in the direction
+// the head is moving (C-LOOK). Requests that don't read sectors are served as if they
+// were at the head's position
+// A request passed over too many times is treated as critical, so nothing starves
+// The thread exits once the scheduler has been idle for a while, and is started again
+// by the next request
+// ========================================
+@interface DriveIOScheduler : NSObject
+{
+@private
+	NSString *_BSDName;
+	NSCondition *_condition;
+	NSMutableArray *_pendingRequests;
+	NSUInteger _headPosition;		// The sector following the last one read
+	NSThread *_thread;
+}
+
+// ========================================
+// The scheduler for the drive holding disk
++ (DriveIOScheduler *) schedulerForDADiskRef:(DADiskRef)disk;
+
+// ========================================
+// Properties
+@property (readonly, copy) NSString * BSDName;
+
+// ========================================
+// Queue a request and wait for it to finish
+- (void) performRequest:(DriveIORequest *)request;
+
+@end
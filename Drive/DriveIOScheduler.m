@@ -0,0 +1,247 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "DriveIOScheduler.h"
+#import "SectorRange.h"
+#import "Logger.h"
+
+// Requests passed over this many times are served as if they were critical
+#define MAXIMUM_TIMES_PASSED_OVER 32
+
+// The scheduler's thread exits after waiting this many seconds without a request
+#define IDLE_THREAD_TIMEOUT 30.0
+
+// ========================================
+// Private methods
+// ========================================
+@interface DriveIORequest ()
+@property (assign) NSInvocation * invocation;
+@property (copy) SectorRange * sectorRange;
+@property (assign) eDriveIOPriority priority;
+@property (assign) NSUInteger timesPassedOver;
+@property (assign) BOOL isFinished;
+@end
+
+@interface DriveIOScheduler ()
+@property (copy) NSString * BSDName;
+@end
+
+@interface DriveIOScheduler (Private)
+- (id) initWithBSDName:(NSString *)BSDName;
+- (void) scheduleRequest:(DriveIORequest *)request;
+- (DriveIORequest *) dequeueNextRequest;
+- (void) processRequests:(id)unused;
+@end
+
+// ========================================
+// Static variables
+// ========================================
+static NSMutableDictionary *sSchedulers				= nil;
+
+// ========================================
+// The distance the head travels to reach request, moving toward higher sectors and
+// returning to the lowest waiting request once there are none ahead of it
+// ========================================
+static NSUInteger
+elevatorDistance(DriveIORequest *request,
+				 NSUInteger headPosition)
+{
+	NSCParameterAssert(nil != request);
+
+	if(!request.sectorRange)
+		return 0;
+
+	NSUInteger position = request.sectorRange.firstSector;
+	if(position >= headPosition)
+		return position - headPosition;
+
+	// Behind the head, so served on the next sweep
+	return (NSUIntegerMax / 2) + position;
+}
+
+@implementation DriveIORequest
+
+@synthesize invocation = _invocation;
+@synthesize sectorRange = _sectorRange;
+@synthesize priority = _priority;
+@synthesize timesPassedOver = _timesPassedOver;
+@synthesize isFinished = _isFinished;
+
++ (id) requestWithInvocation:(NSInvocation *)invocation sectorRange:(SectorRange *)sectorRange priority:(eDriveIOPriority)priority
+{
+	NSParameterAssert(nil != invocation);
+
+	DriveIORequest *request = [[DriveIORequest alloc] init];
+
+	request.invocation = invocation;
+	request.sectorRange = sectorRange;
+	request.priority = priority;
+
+	return request;
+}
+
+- (void) getReturnValue:(void *)buffer
+{
+	NSParameterAssert(NULL != buffer);
+	NSAssert(self.isFinished, @"The request hasn't finished");
+
+	[self.invocation getReturnValue:buffer];
+}
+
+@end
+
+@implementation DriveIOScheduler
+
+@synthesize BSDName = _BSDName;
+
++ (DriveIOScheduler *) schedulerForDADiskRef:(DADiskRef)disk
+{
+	NSParameterAssert(NULL != disk);
+
+	// Partitions and the whole disc share a drive
+	DADiskRef wholeDisk = DADiskCopyWholeDisk(disk);
+	NSString *BSDName = [NSString stringWithCString:DADiskGetBSDName(wholeDisk) encoding:NSASCIIStringEncoding];
+	CFRelease(wholeDisk);
+
+	@synchronized(self) {
+		if(!sSchedulers)
+			sSchedulers = [[NSMutableDictionary alloc] init];
+
+		DriveIOScheduler *scheduler = [sSchedulers objectForKey:BSDName];
+		if(!scheduler) {
+			scheduler = [[self alloc] initWithBSDName:BSDName];
+			[sSchedulers setObject:scheduler forKey:BSDName];
+		}
+
+		return scheduler;
+	}
+}
+
+- (void) performRequest:(DriveIORequest *)request
+{
+	NSParameterAssert(nil != request);
+
+	// Commands issued while serving a request can't wait for the scheduler, since it is waiting for them
+	if([NSThread currentThread] == _thread) {
+		[request.invocation invoke];
+		request.isFinished = YES;
+		return;
+	}
+
+	[self scheduleRequest:request];
+
+	[_condition lock];
+	while(!request.isFinished)
+		[_condition wait];
+	[_condition unlock];
+}
+
+@end
+
+@implementation DriveIOScheduler (Private)
+
+- (id) initWithBSDName:(NSString *)BSDName
+{
+	NSParameterAssert(nil != BSDName);
+
+	if((self = [super init])) {
+		self.BSDName = BSDName;
+		_condition = [[NSCondition alloc] init];
+		_pendingRequests = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (void) scheduleRequest:(DriveIORequest *)request
+{
+	NSParameterAssert(nil != request);
+
+	[_condition lock];
+
+	// Start the thread serving requests if it isn't running
+	if(!_thread) {
+		_thread = [[NSThread alloc] initWithTarget:self selector:@selector(processRequests:) object:nil];
+		[_thread setName:[NSString stringWithFormat:@"Drive I/O (%@)", self.BSDName]];
+		[_thread start];
+	}
+
+	[_pendingRequests addObject:request];
+	[_condition broadcast];
+
+	[_condition unlock];
+}
+
+// Must be called with _condition locked
+- (DriveIORequest *) dequeueNextRequest
+{
+	DriveIORequest *nextRequest = nil;
+	eDriveIOPriority nextPriority = eDriveIOPriorityBackground;
+	NSUInteger nextDistance = NSUIntegerMax;
+
+	// Requests that arrived earlier win ties
+	for(DriveIORequest *request in _pendingRequests) {
+		eDriveIOPriority priority = request.priority;
+		if(MAXIMUM_TIMES_PASSED_OVER <= request.timesPassedOver)
+			priority = eDriveIOPriorityCritical;
+
+		NSUInteger distance = elevatorDistance(request, _headPosition);
+
+		if(!nextRequest || priority > nextPriority || (priority == nextPriority && distance < nextDistance)) {
+			nextRequest = request;
+			nextPriority = priority;
+			nextDistance = distance;
+		}
+	}
+
+	if(!nextRequest)
+		return nil;
+
+	[_pendingRequests removeObject:nextRequest];
+
+	for(DriveIORequest *request in _pendingRequests)
+		request.timesPassedOver = request.timesPassedOver + 1;
+
+	if(nextRequest.sectorRange)
+		_headPosition = nextRequest.sectorRange.lastSector + 1;
+
+	return nextRequest;
+}
+
+- (void) processRequests:(id)unused
+{
+
+#pragma unused(unused)
+
+	for(;;) {
+		[_condition lock];
+
+		// Once nothing has been requested for a while the thread exits; the next request starts another
+		while(![_pendingRequests count]) {
+			if(![_condition waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:IDLE_THREAD_TIMEOUT]] && ![_pendingRequests count]) {
+				_thread = nil;
+				[_condition unlock];
+				return;
+			}
+		}
+
+		DriveIORequest *request = [self dequeueNextRequest];
+
+		[_condition unlock];
+
+		@try {
+			[request.invocation invoke];
+		}
+		@catch(NSException *exception) {
+			[[Logger sharedLogger] logMessage:@"Exception while executing a drive command: %@", exception];
+		}
+
+		[_condition lock];
+		request.isFinished = YES;
+		[_condition broadcast];
+		[_condition unlock];
+	}
+}
+
+@end
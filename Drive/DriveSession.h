@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#include <DiskArbitration/DiskArbitration.h>
+
+@class Drive;
+
+// ========================================
+// A long-lived connection to a drive, which keeps the device open and holds scratch
+// buffers so operations run one after another don't each pay to open the device and
+// allocate their buffers
+// Operations sharing a session lock it only while they use the drive (for each block
+// they read, for example), so the drive's scheduler can interleave their requests
+// ========================================
+@interface DriveSession : NSObject <NSLocking>
+{
+@private
+	Drive *_drive;
+	NSRecursiveLock *_lock;
+	NSMutableDictionary *_buffers;	// NSString * keys, NSMutableData * values
+	NSMutableArray *_buffersInUse;	// NSMutableData * checked out by operations
+}
+
+// ========================================
+// Set up a session for the drive corresponding to disk
+- (id) initWithDADiskRef:(DADiskRef)disk;
+
+// ========================================
+// Properties
+@property (readonly) Drive * drive;
+@property (readonly) BOOL isOpen;
+
+// ========================================
+// Session management
+- (BOOL) open:(NSError **)error;
+- (BOOL) close:(NSError **)error;
+
+// ========================================
+// Returns a buffer of at least length bytes identified by key, reserved for the caller until it is
+// checked back in; if the session's buffer for key is already checked out a new one is allocated
+// The contents are whatever the previous user of the buffer left in it
+- (void *) checkOutBufferWithLength:(NSUInteger)length forKey:(NSString *)key;
+- (void) checkInBuffer:(void *)buffer forKey:(NSString *)key;
+
+@end
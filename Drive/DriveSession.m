@@ -0,0 +1,123 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "DriveSession.h"
+#import "Drive.h"
+
+@interface DriveSession ()
+@property (assign) Drive * drive;
+@end
+
+@implementation DriveSession
+
+@synthesize drive = _drive;
+
+- (id) initWithDADiskRef:(DADiskRef)disk
+{
+	NSParameterAssert(NULL != disk);
+
+	if((self = [super init])) {
+		self.drive = [[Drive alloc] initWithDADiskRef:disk];
+		_lock = [[NSRecursiveLock alloc] init];
+		_buffers = [[NSMutableDictionary alloc] init];
+		_buffersInUse = [[NSMutableArray alloc] init];
+	}
+
+	return self;
+}
+
+- (BOOL) isOpen
+{
+	return self.drive.deviceIsOpen;
+}
+
+- (BOOL) open:(NSError **)error
+{
+	[self lock];
+
+	BOOL result = [self.drive openDevice];
+	if(!result && error)
+		*error = self.drive.error;
+
+	[self unlock];
+
+	return result;
+}
+
+- (BOOL) close:(NSError **)error
+{
+	// Wait for the operation using the drive, if any, to finish with it
+	// Operations still holding the session notice the device is closed the next time they lock it
+	[self lock];
+
+	BOOL result = [self.drive closeDevice];
+	if(!result && error)
+		*error = self.drive.error;
+
+	[self unlock];
+
+	// Release the buffers along with the device
+	@synchronized(_buffers) {
+		[_buffers removeAllObjects];
+	}
+
+	return result;
+}
+
+- (void *) checkOutBufferWithLength:(NSUInteger)length forKey:(NSString *)key
+{
+	NSParameterAssert(nil != key);
+
+	// Buffers aren't protected by the session lock, which is only held while the drive is in use
+	@synchronized(_buffers) {
+		NSMutableData *buffer = [_buffers objectForKey:key];
+		if(!buffer)
+			buffer = [NSMutableData dataWithLength:length];
+		else {
+			[_buffers removeObjectForKey:key];
+			if(buffer.length < length)
+				[buffer setLength:length];
+		}
+
+		[_buffersInUse addObject:buffer];
+
+		return buffer.mutableBytes;
+	}
+}
+
+- (void) checkInBuffer:(void *)buffer forKey:(NSString *)key
+{
+	NSParameterAssert(NULL != buffer);
+	NSParameterAssert(nil != key);
+
+	@synchronized(_buffers) {
+		NSMutableData *returnedBuffer = nil;
+		for(NSMutableData *bufferInUse in _buffersInUse) {
+			if(bufferInUse.mutableBytes == buffer) {
+				returnedBuffer = bufferInUse;
+				break;
+			}
+		}
+
+		if(!returnedBuffer)
+			return;
+
+		// Only the most recently returned buffer for key is kept
+		[_buffersInUse removeObjectIdenticalTo:returnedBuffer];
+		[_buffers setObject:returnedBuffer forKey:key];
+	}
+}
+
+- (void) lock
+{
+	[_lock lock];
+}
+
+- (void) unlock
+{
+	[_lock unlock];
+}
+
+@end
@@ -0,0 +1,57 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+// ========================================
+// Chooses the speed at which each block of an extraction is read, based on the errors
+// the drive returns
+// Clean passes run at the drive's maximum speed; when the density of sectors with C2
+// errors, or of sectors that disagreed between passes, rises in a region the speed drops
+// a step at a time, and once the drive has read cleanly past the region it returns to
+// full speed
+// The error rate seen at each speed is remembered for each drive (the error curve), so a
+// step down skips speeds that have proven no better than the next slower one
+// Only the reduced speeds are compared with each other, since they are all used in the same
+// kind of region (one with errors) while the maximum speed mostly reads clean audio; the
+// curve can make the speed drop further, but never keeps it from dropping
+// ========================================
+@interface DriveSpeedController : NSObject
+{
+@private
+	NSString *_deviceIdentifier;
+	NSMutableDictionary *_errorCurve;	// NSString * speed step (multiple of 1x, 0 for maximum) -> NSArray * (sectors read, sectors in error)
+	NSUInteger _stepIndex;				// The current speed step
+	NSUInteger _cleanBlocks;			// The number of consecutive clean blocks read below full speed
+}
+
+// ========================================
+// The controller for the drive with the given identifier, whose error curve is loaded from the user defaults
++ (DriveSpeedController *) speedControllerForDeviceIdentifier:(NSString *)deviceIdentifier;
+
+// ========================================
+// Properties
+@property (readonly, copy) NSString * deviceIdentifier;
+@property (readonly) uint16_t currentSpeed;		// In kB/s, kCDSpeedMax for the drive's maximum
+
+// ========================================
+// Return to full speed, at the start of a new pass
+- (void) reset;
+
+// ========================================
+// The speed to read the next block at, given how many of its sectors disagreed in earlier passes
+- (uint16_t) speedForBlockWithSectorCount:(NSUInteger)sectorCount suspectSectorCount:(NSUInteger)suspectSectorCount;
+
+// ========================================
+// Record the errors in a block read at currentSpeed
+// Blocks (partly) read at another speed, such as while recovering unreadable sectors, still
+// affect the speed but aren't added to the error curve
+- (void) recordBlockWithSectorCount:(NSUInteger)sectorCount errorSectorCount:(NSUInteger)errorSectorCount readAtCurrentSpeed:(BOOL)readAtCurrentSpeed;
+
+// ========================================
+// Store the error curve in the user defaults
+- (void) saveErrorCurve;
+
+@end
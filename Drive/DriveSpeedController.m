@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "DriveSpeedController.h"
+#import "Logger.h"
+
+#include <IOKit/storage/IOCDTypes.h>
+
+// The speed steps, as multiples of 1x (0 is the drive's maximum)
+static const NSUInteger sSpeedSteps [] = { 0, 24, 16, 12, 8, 4 };
+#define SPEED_STEP_COUNT (sizeof(sSpeedSteps) / sizeof(sSpeedSteps[0]))
+
+// The fraction of a block's sectors that may be in error before the speed is lowered
+#define STEP_DOWN_DENSITY 0.005
+
+// The number of consecutive clean blocks marking the end of a region with errors
+#define CLEAN_BLOCKS_TO_RETURN_TO_FULL_SPEED 2
+
+// A speed's error rate isn't trusted until this many sectors (one minute of audio) have been read at it
+#define MINIMUM_SECTORS_FOR_ERROR_RATE (60 * 75)
+
+// A reduced step is skipped if the next slower step's error rate is at most this fraction of its own
+#define REQUIRED_IMPROVEMENT 0.5
+
+// ========================================
+// Private methods
+// ========================================
+@interface DriveSpeedController ()
+@property (copy) NSString * deviceIdentifier;
+@end
+
+@interface DriveSpeedController (Private)
+- (id) initWithDeviceIdentifier:(NSString *)deviceIdentifier;
+- (BOOL) getErrorRate:(double *)errorRate forStepIndex:(NSUInteger)stepIndex;
+- (NSUInteger) stepIndexBelowStepIndex:(NSUInteger)stepIndex;
+- (void) stepDown;
+@end
+
+// ========================================
+// Static variables
+// ========================================
+static NSMutableDictionary *sSpeedControllers		= nil;
+
+@implementation DriveSpeedController
+
+@synthesize deviceIdentifier = _deviceIdentifier;
+
++ (DriveSpeedController *) speedControllerForDeviceIdentifier:(NSString *)deviceIdentifier
+{
+	NSParameterAssert(nil != deviceIdentifier);
+
+	@synchronized(self) {
+		if(!sSpeedControllers)
+			sSpeedControllers = [[NSMutableDictionary alloc] init];
+
+		DriveSpeedController *speedController = [sSpeedControllers objectForKey:deviceIdentifier];
+		if(!speedController) {
+			speedController = [[self alloc] initWithDeviceIdentifier:deviceIdentifier];
+			[sSpeedControllers setObject:speedController forKey:deviceIdentifier];
+		}
+
+		return speedController;
+	}
+}
+
+- (uint16_t) currentSpeed
+{
+	@synchronized(self) {
+		NSUInteger step = sSpeedSteps[_stepIndex];
+		return (0 == step ? kCDSpeedMax : (uint16_t)MIN(kCDSpeedMax, step * kCDSpeedMin));
+	}
+}
+
+- (void) reset
+{
+	@synchronized(self) {
+		_stepIndex = 0;
+		_cleanBlocks = 0;
+	}
+}
+
+- (uint16_t) speedForBlockWithSectorCount:(NSUInteger)sectorCount suspectSectorCount:(NSUInteger)suspectSectorCount
+{
+	@synchronized(self) {
+		// A block that disagreed in earlier passes is read more slowly than the block before it
+		if(sectorCount && STEP_DOWN_DENSITY < ((double)suspectSectorCount / (double)sectorCount)) {
+			if(!_cleanBlocks)
+				[self stepDown];
+			_cleanBlocks = 0;
+		}
+
+		return self.currentSpeed;
+	}
+}
+
+- (void) recordBlockWithSectorCount:(NSUInteger)sectorCount errorSectorCount:(NSUInteger)errorSectorCount readAtCurrentSpeed:(BOOL)readAtCurrentSpeed
+{
+	if(!sectorCount)
+		return;
+
+	@synchronized(self) {
+		// Add the block to the error curve, unless the errors belong to another speed
+		if(readAtCurrentSpeed) {
+			NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)sSpeedSteps[_stepIndex]];
+			NSArray *counts = [_errorCurve objectForKey:key];
+			unsigned long long sectorsRead = [[counts objectAtIndex:0] unsignedLongLongValue] + sectorCount;
+			unsigned long long sectorsInError = [[counts objectAtIndex:1] unsignedLongLongValue] + errorSectorCount;
+			[_errorCurve setObject:[NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:sectorsRead], [NSNumber numberWithUnsignedLongLong:sectorsInError], nil] forKey:key];
+		}
+
+		if(STEP_DOWN_DENSITY < ((double)errorSectorCount / (double)sectorCount)) {
+			[self stepDown];
+			_cleanBlocks = 0;
+		}
+		else if(!errorSectorCount && _stepIndex && CLEAN_BLOCKS_TO_RETURN_TO_FULL_SPEED <= ++_cleanBlocks) {
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Returning to full speed"];
+
+			_stepIndex = 0;
+			_cleanBlocks = 0;
+		}
+	}
+}
+
+- (void) saveErrorCurve
+{
+	@synchronized(self) {
+		NSMutableDictionary *errorCurves = [NSMutableDictionary dictionaryWithDictionary:[[NSUserDefaults standardUserDefaults] dictionaryForKey:@"driveSpeedErrorCurves"]];
+		[errorCurves setObject:[_errorCurve copy] forKey:self.deviceIdentifier];
+		[[NSUserDefaults standardUserDefaults] setObject:errorCurves forKey:@"driveSpeedErrorCurves"];
+	}
+}
+
+@end
+
+@implementation DriveSpeedController (Private)
+
+- (id) initWithDeviceIdentifier:(NSString *)deviceIdentifier
+{
+	NSParameterAssert(nil != deviceIdentifier);
+
+	if((self = [super init])) {
+		self.deviceIdentifier = deviceIdentifier;
+
+		NSDictionary *errorCurve = [[[NSUserDefaults standardUserDefaults] dictionaryForKey:@"driveSpeedErrorCurves"] objectForKey:deviceIdentifier];
+		if([errorCurve isKindOfClass:[NSDictionary class]])
+			_errorCurve = [errorCurve mutableCopy];
+		else
+			_errorCurve = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (BOOL) getErrorRate:(double *)errorRate forStepIndex:(NSUInteger)stepIndex
+{
+	NSParameterAssert(NULL != errorRate);
+	NSParameterAssert(SPEED_STEP_COUNT > stepIndex);
+
+	NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)sSpeedSteps[stepIndex]];
+	NSArray *counts = [_errorCurve objectForKey:key];
+	if(2 != counts.count)
+		return NO;
+
+	unsigned long long sectorsRead = [[counts objectAtIndex:0] unsignedLongLongValue];
+	if(MINIMUM_SECTORS_FOR_ERROR_RATE > sectorsRead)
+		return NO;
+
+	*errorRate = (double)[[counts objectAtIndex:1] unsignedLongLongValue] / (double)sectorsRead;
+	return YES;
+}
+
+// The next slower step to use: the step below stepIndex, unless the curve shows a slower step to be
+// sufficiently better, in which case that one
+// Neighboring reduced steps are compared, since both are only used in regions with errors; the maximum
+// speed reads mostly clean audio, so comparing against it would make every reduced step look worse
+- (NSUInteger) stepIndexBelowStepIndex:(NSUInteger)stepIndex
+{
+	NSUInteger candidate = stepIndex + 1;
+	if(SPEED_STEP_COUNT <= candidate)
+		return stepIndex;
+
+	while(candidate + 1 < SPEED_STEP_COUNT) {
+		double errorRate, slowerErrorRate;
+		if(![self getErrorRate:&errorRate forStepIndex:candidate] || ![self getErrorRate:&slowerErrorRate forStepIndex:(candidate + 1)])
+			break;
+
+		if(slowerErrorRate > (errorRate * REQUIRED_IMPROVEMENT))
+			break;
+
+		++candidate;
+	}
+
+	return candidate;
+}
+
+- (void) stepDown
+{
+	NSUInteger stepIndex = [self stepIndexBelowStepIndex:_stepIndex];
+	if(stepIndex == _stepIndex)
+		return;
+
+	[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Lowering the drive's speed to %lux", (unsigned long)sSpeedSteps[stepIndex]];
+
+	_stepIndex = stepIndex;
+}
+
+@end
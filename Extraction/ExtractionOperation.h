@@ -6,12 +6,26 @@
 #import <Cocoa/Cocoa.h>
 #include <DiskArbitration/DiskArbitration.h>
 
-@class SectorRange;
+#import "DriveIOScheduler.h"
+
+@class SectorRange, SectorStore, DriveSession, DriveSpeedController;
 
 // ========================================
 // An NSOperation subclass that extracts audio from a specified range of sectors
 // on a compact disc, adjusting for a read offset and optionally limiting extraction
 // to a specific range of sectors (typically a session).
+// If verifyPositions is set, the Q sub-channel is read with the audio and any block
+// whose Q positions don't match the sectors requested is re-read immediately
+// If correctJitter is set, each read overlaps the previous one and is aligned to it
+// by matching audio, correcting sample slips for drives without accurate stream
+// Reads that fail or come up short are bisected down to single sectors, which are retried
+// recoveryRetryCount times; sectors that still can't be read are zero-filled and reported
+// in unreadableSectors instead of failing the extraction
+// If sectorIndexes is set, only those sectors (which must lie within sectors) are extracted,
+// each contiguous run handled as a separate extraction would, and the audio is packed into
+// the sector store in ascending order; use indexForSector: to locate a sector in the store
+// If session is set its drive, which must be open, and buffers are used, and the session is
+// locked while each block is read
 // ========================================
 @interface ExtractionOperation : NSOperation
 {
@@ -19,8 +33,12 @@
 	__strong DADiskRef _disk;		// The DADiskRef holding the CD from which to extract
 	SectorRange *_sectors;			// The sectors to be extracted (not adjusted for read offset) 
 	SectorRange *_allowedSectors;	// The range of sectors to which extraction will be limited
-	NSURL *_URL;					// The URL of the output file
+	SectorRange *_trackSectors;		// The sectors (contained in sectors) for which CRCs are calculated
+	SectorStore *_sectorStore;		// The store receiving the extracted audio
 	NSNumber *_readOffset;			// The read offset (in audio frames) to use for extraction
+	NSIndexSet *_sectorIndexes;		// The sectors (in sectors) to be extracted, if not all of them
+	DriveSession *_session;			// The session whose drive and buffers are used, if any
+	eDriveIOPriority _ioPriority;	// The priority of the operation's reads relative to other users of the drive
 	
 	NSDate *_startTime;				// The time the operation started
 	float _fractionComplete;		// A float [0, 1] indicating the extraction progress
@@ -31,10 +49,27 @@
 	NSError *_error;				// Holds the first error (if any) occurring during extraction
 	NSString *_MD5;					// The MD5 sum of the extracted audio
 	NSString *_SHA1;				// The SHA1 sum of the extracted audio
+	NSNumber *_CRC32;				// The EAC-style CRC32 of the audio in trackSectors
+	NSNumber *_CRC32WithoutNullSamples; // The EAC-style CRC32 of the audio in trackSectors, skipping null samples
 
 	BOOL _useC2;							// Whether to request C2 error information
 	NSMutableIndexSet *_blockErrorFlags;	// C2 block error flags (indexes correspond to disc sectors)
 	NSMutableDictionary *_errorFlags;		// NSNumber * keys correspond to disc sectors, NSData * values
+
+	BOOL _verifyPositions;					// Whether to verify each sector's position using the Q sub-channel
+	NSUInteger _positionRetryCount;			// The number of blocks re-read because they were misplaced
+	NSMutableIndexSet *_misplacedSectors;	// Sectors whose positions couldn't be confirmed (indexes correspond to disc sectors)
+
+	BOOL _correctJitter;					// Whether to align overlapping reads to correct jitter
+	NSMutableDictionary *_sampleSlips;		// NSNumber * keys correspond to disc sectors, NSNumber * values are slips in frames
+
+	NSUInteger _recoveryRetryCount;			// The number of times a sector that can't be read is retried
+	NSTimeInterval _recoveryBackoffInterval; // The delay before the first retry of a sector, doubled for each retry after it
+	uint16_t _recoverySpeed;				// The drive speed (kB/s) used while recovering, or 0 to leave the speed unchanged
+	NSMutableIndexSet *_unreadableSectors;	// Sectors that couldn't be read (indexes correspond to disc sectors)
+
+	DriveSpeedController *_speedController;	// Chooses the drive speed for each block, if set (the original speed is restored afterwards)
+	NSIndexSet *_suspectSectors;			// Sectors that disagreed in earlier passes (indexes correspond to disc sectors)
 }
 
 // ========================================
@@ -42,9 +77,20 @@
 @property (assign) DADiskRef disk;
 @property (copy) SectorRange * sectors;
 @property (copy) SectorRange * allowedSectors;
-@property (copy) NSURL * URL;
+@property (copy) SectorRange * trackSectors;
+@property (assign) SectorStore * sectorStore;
 @property (copy) NSNumber * readOffset;
+@property (copy) NSIndexSet * sectorIndexes;
+@property (assign) DriveSession * session;
+@property (assign) eDriveIOPriority ioPriority;
 @property (assign) BOOL useC2;
+@property (assign) BOOL verifyPositions;
+@property (assign) BOOL correctJitter;
+@property (assign) NSUInteger recoveryRetryCount;
+@property (assign) NSTimeInterval recoveryBackoffInterval;
+@property (assign) uint16_t recoverySpeed;
+@property (assign) DriveSpeedController * speedController;
+@property (copy) NSIndexSet * suspectSectors;
 
 // ========================================
 // Properties set during extraction
@@ -59,11 +105,22 @@
 @property (readonly, copy) NSError * error;
 @property (readonly, copy) NSIndexSet * blockErrorFlags;
 @property (readonly, copy) NSDictionary * errorFlags;
+@property (readonly, assign) NSUInteger positionRetryCount;
+@property (readonly, copy) NSIndexSet * misplacedSectors;
+@property (readonly, copy) NSDictionary * sampleSlips;
+@property (readonly, copy) NSIndexSet * unreadableSectors;
 @property (readonly, copy) NSString * MD5;
 @property (readonly, copy) NSString * SHA1;
+@property (readonly, copy) NSNumber * CRC32;
+@property (readonly, copy) NSNumber * CRC32WithoutNullSamples;
 
 // ========================================
 // Initialization
 - (id) initWithDADiskRef:(DADiskRef)disk;
 
+// ========================================
+// Whether a sector was extracted, and its index in the sector store (NSNotFound if it wasn't)
+- (BOOL) containsSector:(NSUInteger)sector;
+- (NSUInteger) indexForSector:(NSUInteger)sector;
+
 @end
@@ -7,15 +7,77 @@
 #import "SectorRange.h"
 #import "SessionDescriptor.h"
 #import "Drive.h"
+#import "DriveSession.h"
+#import "DriveSpeedController.h"
+#import "SectorStore.h"
+#import "DigestUtilities.h"
 #import "CDDAUtilities.h"
+#import "QSubchannelUtilities.h"
+#import "Logger.h"
 
 #include <IOKit/storage/IOCDTypes.h>
-#include <AudioToolbox/AudioFile.h>
-#include <CommonCrypto/CommonDigest.h>
 
 // Keep reads to approximately 2 MB in size (2352 + 294 + 16 bytes are necessary for each sector)
 #define BUFFER_SIZE_IN_SECTORS 775u
 
+// The number of times a block is re-read when its Q sub-channel shows it was misplaced
+#define MAXIMUM_POSITION_RETRIES 3
+
+// Some drives return the Q sub-channel of a neighboring sector with the audio
+#define MAXIMUM_Q_SKEW 1
+
+// When correcting jitter, each read repeats the last sectors of the previous one, and
+// the last frames of the previous read are located in this overlap to align the two
+#define OVERLAP_SECTORS 2u
+#define ALIGNMENT_FRAMES 128u
+#define MAXIMUM_JITTER_FRAMES AUDIO_FRAMES_PER_CDDA_SECTOR
+
+// The overlap, plus one sector following the read so a late read can still fill it
+#define JITTER_CUSHION_SECTORS (OVERLAP_SECTORS + 1u)
+
+// When this many sectors in a row can't be read the disc is assumed to be unreadable, and recovery stops
+#define MAXIMUM_CONSECUTIVE_UNREADABLE_SECTORS 75u
+
+// ========================================
+// The keys of the buffers borrowed from the session
+// ========================================
+static NSString * const kBufferKey					= kBufferKey;
+static NSString * const kAudioBufferKey				= kAudioBufferKey;
+static NSString * const kC2BufferKey				= kC2BufferKey;
+static NSString * const kQFramesKey					= kQFramesKey;
+static NSString * const kOverlapBufferKey			= kOverlapBufferKey;
+static NSString * const kOverlapC2BufferKey			= kOverlapC2BufferKey;
+
+// ========================================
+// Borrow a buffer from the session if there is one, otherwise allocate it
+// ========================================
+static void *
+allocateBuffer(DriveSession *session,
+			   NSString *key,
+			   NSUInteger length)
+{
+	NSCParameterAssert(nil != key);
+
+	if(session)
+		return [session checkOutBufferWithLength:length forKey:key];
+	else
+		return NSAllocateCollectable(length, 0);
+}
+
+// ========================================
+// Give a buffer borrowed from the session back to it
+// ========================================
+static void
+releaseBuffer(DriveSession *session,
+			  NSString *key,
+			  void *buffer)
+{
+	NSCParameterAssert(nil != key);
+
+	if(session && buffer)
+		[session checkInBuffer:buffer forKey:key];
+}
+
 // ========================================
 // Delete the specified number of bits from the beginning of buffer
 // ========================================
@@ -80,6 +142,169 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 	memset(alias, 0, bytesToZero);
 }
 
+// ========================================
+// Copy the C2 error bits for frameCount frames beginning at firstFrame
+// Each frame has 4 error bits (one per byte), most significant bit first, so a frame is a nibble
+// ========================================
+static void
+copyErrorFlagsForFrames(uint8_t *destination,
+						const uint8_t *source,
+						NSUInteger firstFrame,
+						NSUInteger frameCount)
+{
+	NSCParameterAssert(NULL != destination);
+	NSCParameterAssert(NULL != source);
+	NSCParameterAssert(0 == (frameCount % 2));
+
+	const uint8_t *alias = source + (firstFrame / 2);
+
+	if(0 == (firstFrame % 2))
+		memcpy(destination, alias, frameCount / 2);
+	else {
+		for(NSUInteger i = 0; i < frameCount / 2; ++i)
+			destination[i] = (uint8_t)((alias[i] << 4) | (alias[i + 1] >> 4));
+	}
+}
+
+// ========================================
+// Update the EAC CRCs with the portion of a block of audio that lies within trackByteRange
+// byteOffset is the offset of the block from the beginning of the extracted audio
+// ========================================
+static void
+updateEACCRCForTrackByteRange(EACCRCContext *context,
+							  const int8_t *bytes,
+							  NSUInteger length,
+							  NSUInteger byteOffset,
+							  NSRange trackByteRange)
+{
+	NSCParameterAssert(NULL != context);
+	NSCParameterAssert(NULL != bytes);
+
+	NSRange intersection = NSIntersectionRange(NSMakeRange(byteOffset, length), trackByteRange);
+	if(intersection.length)
+		eacCRCUpdate(context, bytes + (intersection.location - byteOffset), intersection.length);
+}
+
+// ========================================
+// Determine the difference between the positions in the Q sub-channel and the
+// sectors requested, which is constant for a drive
+// Returns NO unless most of the frames with a valid CRC agree on a difference
+// of at most MAXIMUM_Q_SKEW sectors
+// ========================================
+static BOOL
+determineQSkew(const QSubchannelFrame *frames,
+			   NSUInteger startSector,
+			   NSUInteger sectorCount,
+			   NSInteger *qSkew)
+{
+	NSCParameterAssert(NULL != frames);
+	NSCParameterAssert(NULL != qSkew);
+
+	NSUInteger skewCounts [(2 * MAXIMUM_Q_SKEW) + 1];
+	memset(skewCounts, 0, sizeof(skewCounts));
+
+	NSUInteger framesChecked = 0;
+	for(NSUInteger i = 0; i < sectorCount; ++i) {
+		NSInteger sector;
+		if(!(eQSubchannelFrameCRCIsValid & frames[i].flags) || !getSectorForQSubchannelFrame(&frames[i], &sector))
+			continue;
+
+		++framesChecked;
+
+		NSInteger skew = sector - (NSInteger)(startSector + i);
+		if(-MAXIMUM_Q_SKEW <= skew && MAXIMUM_Q_SKEW >= skew)
+			++skewCounts[skew + MAXIMUM_Q_SKEW];
+	}
+
+	for(NSInteger skew = -MAXIMUM_Q_SKEW; skew <= MAXIMUM_Q_SKEW; ++skew) {
+		if(skewCounts[skew + MAXIMUM_Q_SKEW] > (framesChecked / 2)) {
+			*qSkew = skew;
+			return YES;
+		}
+	}
+
+	return NO;
+}
+
+// ========================================
+// Add the sectors whose Q sub-channel has a valid CRC but describes a position other
+// than the sector requested to misplacedSectors
+// ========================================
+static void
+findMisplacedSectors(const QSubchannelFrame *frames,
+					 NSUInteger startSector,
+					 NSUInteger sectorCount,
+					 NSInteger qSkew,
+					 NSMutableIndexSet *misplacedSectors)
+{
+	NSCParameterAssert(NULL != frames);
+	NSCParameterAssert(nil != misplacedSectors);
+
+	for(NSUInteger i = 0; i < sectorCount; ++i) {
+		NSInteger sector;
+		if(!(eQSubchannelFrameCRCIsValid & frames[i].flags) || !getSectorForQSubchannelFrame(&frames[i], &sector))
+			continue;
+
+		if(sector != (NSInteger)(startSector + i) + qSkew)
+			[misplacedSectors addIndex:(startSector + i)];
+	}
+}
+
+// ========================================
+// Locate needle (ALIGNMENT_FRAMES frames) within MAXIMUM_JITTER_FRAMES of expectedPosition in frames
+// Candidates are found with a rolling sum of the frames and confirmed with memcmp
+// The window is only 2 * MAXIMUM_JITTER_FRAMES positions and the sum rejects nearly all of them,
+// so the search is a small fraction of the time spent reading and isn't vectorized
+// The match nearest the expected position wins, so silence (which matches everywhere) never appears to slip
+// Returns NO if needle wasn't found
+// ========================================
+static BOOL
+findSampleSlip(const uint32_t *frames,
+			   NSUInteger frameCount,
+			   const uint32_t *needle,
+			   NSUInteger expectedPosition,
+			   NSInteger *slip)
+{
+	NSCParameterAssert(NULL != frames);
+	NSCParameterAssert(NULL != needle);
+	NSCParameterAssert(NULL != slip);
+
+	if(ALIGNMENT_FRAMES > frameCount)
+		return NO;
+
+	NSUInteger firstPosition = (expectedPosition > MAXIMUM_JITTER_FRAMES ? expectedPosition - MAXIMUM_JITTER_FRAMES : 0);
+	NSUInteger lastPosition = MIN(expectedPosition + MAXIMUM_JITTER_FRAMES, frameCount - ALIGNMENT_FRAMES);
+	if(firstPosition > lastPosition)
+		return NO;
+
+	uint32_t needleSum = 0, sum = 0;
+	for(NSUInteger i = 0; i < ALIGNMENT_FRAMES; ++i) {
+		needleSum += needle[i];
+		sum += frames[firstPosition + i];
+	}
+
+	NSUInteger bestDistance = NSUIntegerMax;
+	for(NSUInteger position = firstPosition; ; ++position) {
+		NSUInteger distance = (position > expectedPosition ? position - expectedPosition : expectedPosition - position);
+
+		// Matches beyond this point are further away than the best one
+		if(position > expectedPosition && distance >= bestDistance)
+			break;
+
+		if(sum == needleSum && distance < bestDistance && !memcmp(frames + position, needle, ALIGNMENT_FRAMES * sizeof(uint32_t))) {
+			bestDistance = distance;
+			*slip = (NSInteger)position - (NSInteger)expectedPosition;
+		}
+
+		if(position == lastPosition)
+			break;
+
+		sum += frames[position + ALIGNMENT_FRAMES] - frames[position];
+	}
+
+	return (NSUIntegerMax != bestDistance);
+}
+
 @interface ExtractionOperation ()
 @property (copy) SectorRange * sectorsRead;
 @property (assign) NSUInteger sectorsOfSilencePrepended;
@@ -87,14 +312,23 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 @property (copy) NSError * error;
 @property (copy) NSIndexSet * blockErrorFlags;
 @property (copy) NSDictionary * errorFlags;
+@property (assign) NSUInteger positionRetryCount;
+@property (copy) NSIndexSet * misplacedSectors;
+@property (copy) NSDictionary * sampleSlips;
+@property (copy) NSIndexSet * unreadableSectors;
 @property (copy) NSString * MD5;
 @property (copy) NSString * SHA1;
+@property (copy) NSNumber * CRC32;
+@property (copy) NSNumber * CRC32WithoutNullSamples;
 @property (assign) float fractionComplete;
 @property (assign) NSDate * startTime;
 @end
 
 @interface ExtractionOperation (Private)
 - (void) setErrorFlags:(const uint8_t *)errorFlags forSectorRange:(SectorRange *)range;
+- (NSUInteger) readSectorRange:(SectorRange *)range intoBuffer:(void *)buffer fromDrive:(Drive *)drive;
+- (BOOL) recoverSectorRange:(SectorRange *)range intoBuffer:(int8_t *)buffer blockSize:(NSUInteger)blockSize fromDrive:(Drive *)drive unreadableSectors:(NSMutableIndexSet *)unreadableSectors consecutiveFailures:(NSUInteger *)consecutiveFailures;
+- (BOOL) recoverSector:(NSUInteger)sector intoBuffer:(int8_t *)buffer blockSize:(NSUInteger)blockSize fromDrive:(Drive *)drive unreadableSectors:(NSMutableIndexSet *)unreadableSectors consecutiveFailures:(NSUInteger *)consecutiveFailures;
 @end
 
 @implementation ExtractionOperation
@@ -102,6 +336,7 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 @synthesize disk = _disk;
 @synthesize sectors = _sectors;
 @synthesize allowedSectors = _allowedSectors;
+@synthesize trackSectors = _trackSectors;
 @synthesize sectorsRead = _sectorsRead;
 @synthesize sectorsOfSilencePrepended = _sectorsOfSilencePrepended;
 @synthesize sectorsOfSilenceAppended = _sectorsOfSilenceAppended;
@@ -109,10 +344,26 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 @synthesize useC2 = _useC2;
 @synthesize blockErrorFlags = _blockErrorFlags;
 @synthesize errorFlags = _errorFlags;
-@synthesize URL = _URL;
+@synthesize verifyPositions = _verifyPositions;
+@synthesize positionRetryCount = _positionRetryCount;
+@synthesize misplacedSectors = _misplacedSectors;
+@synthesize correctJitter = _correctJitter;
+@synthesize sampleSlips = _sampleSlips;
+@synthesize recoveryRetryCount = _recoveryRetryCount;
+@synthesize recoveryBackoffInterval = _recoveryBackoffInterval;
+@synthesize recoverySpeed = _recoverySpeed;
+@synthesize unreadableSectors = _unreadableSectors;
+@synthesize speedController = _speedController;
+@synthesize suspectSectors = _suspectSectors;
+@synthesize sectorStore = _sectorStore;
+@synthesize session = _session;
+@synthesize sectorIndexes = _sectorIndexes;
+@synthesize ioPriority = _ioPriority;
 @synthesize readOffset = _readOffset;
 @synthesize MD5 = _MD5;
 @synthesize SHA1 = _SHA1;
+@synthesize CRC32 = _CRC32;
+@synthesize CRC32WithoutNullSamples = _CRC32WithoutNullSamples;
 @synthesize fractionComplete = _fractionComplete;
 @synthesize startTime = _startTime;
 
@@ -125,11 +376,33 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 	return self;
 }
 		
+- (BOOL) containsSector:(NSUInteger)sector
+{
+	if(self.sectorIndexes)
+		return [self.sectorIndexes containsIndex:sector];
+	else
+		return [self.sectors containsSector:sector];
+}
+
+- (NSUInteger) indexForSector:(NSUInteger)sector
+{
+	if(!self.sectorIndexes)
+		return [self.sectors indexForSector:sector];
+
+	// The sectors are packed into the store in ascending order
+	if(![self.sectorIndexes containsIndex:sector])
+		return NSNotFound;
+
+	NSUInteger firstSector = [self.sectorIndexes firstIndex];
+	return [self.sectorIndexes countOfIndexesInRange:NSMakeRange(firstSector, sector - firstSector)];
+}
+
 - (void) main
 {
 	NSAssert(NULL != self.disk, @"self.disk may not be NULL");
 	NSAssert(nil != self.sectors, @"self.sectors may not be nil");
-	NSAssert(nil != self.URL, @"self.URL may not be nil");
+	NSAssert(nil != self.sectorStore, @"self.sectorStore may not be nil");
+	NSAssert(nil == self.sectorIndexes || ([self.sectors containsSector:[self.sectorIndexes firstIndex]] && [self.sectors containsSector:[self.sectorIndexes lastIndex]]), @"self.sectorIndexes must lie within self.sectors");
 
 	// Record the start time
 	self.startTime = [NSDate date];
@@ -137,276 +410,535 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 	// ========================================
 	// GENERAL SETUP
 
-	// Open the CD media for reading
-	Drive *drive = [[Drive alloc] initWithDADiskRef:self.disk];
-	if(![drive openDevice]) {
-		self.error = drive.error;
-		return;
-	}
+	// Open the CD media for reading, or use the session's drive, which is already open
+	// The session is only locked while a block is being read, so others sharing it can use the drive in between
+	Drive *drive = nil;
+	if(self.session) {
+		drive = self.session.drive;
 
-	// Set up the ASBD for CDDA audio
-	const AudioStreamBasicDescription cddaASBD = getStreamDescriptionForCDDA();
-	
-	// Create and open the output file, overwriting if it exists
-	AudioFileID file = NULL;
-	OSStatus status = AudioFileCreateWithURL((CFURLRef)self.URL, kAudioFileWAVEType, &cddaASBD, kAudioFileFlags_EraseFile, &file);
-	if(noErr != status) {
-		self.error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
-		goto cleanup;
+		[self.session lock];
+		BOOL deviceIsOpen = drive.deviceIsOpen;
+		[self.session unlock];
+
+		if(!deviceIsOpen) {
+			self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENXIO userInfo:nil];
+			return;
+		}
+	}
+	else {
+		drive = [[Drive alloc] initWithDADiskRef:self.disk];
+		if(![drive openDevice]) {
+			self.error = drive.error;
+			return;
+		}
 	}
 
-	// Allocate the extraction buffers
-	__strong int8_t *buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * (kCDSectorSizeCDDA + kCDSectorSizeErrorFlags/* + kCDSectorSizeQSubchannel*/), 0);
-	__strong int8_t *audioBuffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA, 0);
-	__strong uint8_t *c2Buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeErrorFlags, 0);
-//	__strong int8_t *qBuffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeQSubchannel, 0);
+	// Whether the session is locked for the block being read
+	BOOL sessionLocked = NO;
+
+	// The drive's speed before the speed controller first changed it (0 if it hasn't), restored during cleanup
+	uint16_t originalSpeed = 0;
+
+	// Audio is appended to the store as it is read
+	NSError *error = nil;
+
+	// Allocate the extraction buffers, or borrow them from the session
+	__strong int8_t *buffer = allocateBuffer(self.session, kBufferKey, (BUFFER_SIZE_IN_SECTORS + JITTER_CUSHION_SECTORS) * (kCDSectorSizeCDDA + kCDSectorSizeErrorFlags + kCDSectorSizeQSubchannel));
+	__strong int8_t *audioBuffer = allocateBuffer(self.session, kAudioBufferKey, BUFFER_SIZE_IN_SECTORS * kCDSectorSizeCDDA);
+	__strong uint8_t *c2Buffer = allocateBuffer(self.session, kC2BufferKey, BUFFER_SIZE_IN_SECTORS * kCDSectorSizeErrorFlags);
+	__strong QSubchannelFrame *qFrames = allocateBuffer(self.session, kQFramesKey, (BUFFER_SIZE_IN_SECTORS + JITTER_CUSHION_SECTORS) * sizeof(QSubchannelFrame));
+	__strong int8_t *overlapBuffer = allocateBuffer(self.session, kOverlapBufferKey, (BUFFER_SIZE_IN_SECTORS + JITTER_CUSHION_SECTORS) * kCDSectorSizeCDDA);
+	__strong uint8_t *overlapC2Buffer = allocateBuffer(self.session, kOverlapC2BufferKey, (BUFFER_SIZE_IN_SECTORS + JITTER_CUSHION_SECTORS) * kCDSectorSizeErrorFlags);
 	int8_t *alias = NULL;
 	
-	if(NULL == buffer || NULL == audioBuffer || NULL == c2Buffer/* || NULL == qBuffer*/) {
+	if(NULL == buffer || NULL == audioBuffer || NULL == c2Buffer || NULL == qFrames || NULL == overlapBuffer || NULL == overlapC2Buffer) {
 		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
 		goto cleanup;
 	}
 	
 	// Initialize the MD5 and SHA1 checksums
-	CC_MD5_CTX md5;
-	CC_MD5_Init(&md5);
-	
-	CC_SHA1_CTX sha1;
-	CC_SHA1_Init(&sha1);
+	AudioDigestContext digest;
+	audioDigestInit(&digest);
 
-	// ========================================
-	// SETUP FOR READ OFFSET HANDLING
-	
-	// With no read offset, the range of sectors that will be extracted won't change
-	NSInteger firstSectorToRead = self.sectors.firstSector;
-	NSInteger lastSectorToRead = self.sectors.lastSector;
-
-	// Handle the read offset, if specified
-	NSInteger readOffsetInFrames = 0;
-	if(self.readOffset)
-		readOffsetInFrames = self.readOffset.integerValue;
-
-	// Calculate the "read translation", to map between actual sector numbers on disc
-	// and logical sector numbers
-	NSInteger sectorDelta = 0;
-
-	// Negative read offsets can easily be transformed into positive read offsets
-	// For example, suppose the desired range is sectors 10 through 20 and the read offset is -600 frames.
-	// This is equivalent to requesting sectors 8 - 18 with a read offset of 576 frames
-	while(0 > readOffsetInFrames) {
-		readOffsetInFrames += AUDIO_FRAMES_PER_CDDA_SECTOR;
-		--firstSectorToRead;
-		--lastSectorToRead;
-		--sectorDelta;
-	}
+	// The EAC CRCs cover only the track's audio, not any surrounding sectors extracted with it
+	// They are meaningless for a batch of scattered sectors
+	EACCRCContext eacCRC;
+	eacCRCInit(&eacCRC);
 
-	// Adjust the sectors which will be read for read offsets equal to or larger than one sector
-	while(AUDIO_FRAMES_PER_CDDA_SECTOR <= readOffsetInFrames) {
-		readOffsetInFrames -= AUDIO_FRAMES_PER_CDDA_SECTOR;
-		++firstSectorToRead;
-		++lastSectorToRead;
-		++sectorDelta;
-	}
-	
-	// At this point readOffsetInFrames is either 0 or a positive value less than AUDIO_FRAMES_PER_CDDA_SECTOR
-	// One additional sector must be read so this data can be appended to the last full sector
-	if(readOffsetInFrames)
-		++lastSectorToRead;
-	
-	// Determine the number of bytes which should be skipped before the desired audio data is reached
-	NSUInteger readOffsetInBytes = 2 * sizeof(int16_t) * readOffsetInFrames;
-	
-	// Determine the first sector that can be legally read (so as not to over-read the lead in)
-	NSInteger firstPermissibleSector = 0;
-	if(self.allowedSectors)
-		firstPermissibleSector = self.allowedSectors.firstSector;
-	
-	// Determine the last sector that can be legally read (so as not to over-read the lead out)
-	NSInteger lastPermissibleSector = NSIntegerMax;
-	if(self.allowedSectors)
-		lastPermissibleSector = self.allowedSectors.lastSector;
-	
-	// Clamp the read range to the specified sector limitations
-	NSUInteger sectorsOfSilenceToPrepend = 0;
-	if(firstSectorToRead < firstPermissibleSector) {
-		sectorsOfSilenceToPrepend = firstPermissibleSector - firstSectorToRead;
-		firstSectorToRead = firstPermissibleSector;
-	}
-	
-	NSUInteger sectorsOfSilenceToAppend = 0;
-	if(lastSectorToRead > lastPermissibleSector) {
-		sectorsOfSilenceToAppend = lastSectorToRead - lastPermissibleSector;
-		lastSectorToRead = lastPermissibleSector;
-	}
+	NSRange trackByteRange = NSMakeRange(0, 0);
+	if(!self.sectorIndexes && self.trackSectors && [self.sectors containsSectorRange:self.trackSectors])
+		trackByteRange = NSMakeRange((self.trackSectors.firstSector - self.sectors.firstSector) * kCDSectorSizeCDDA, self.trackSectors.byteSize);
+
+	// The offset of the next audio byte from the beginning of the extracted audio
+	NSUInteger byteOffset = 0;
+
+	// The sectors to extract, which are read one contiguous run at a time
+	NSIndexSet *sectorIndexes = self.sectorIndexes;
+	if(!sectorIndexes)
+		sectorIndexes = [NSIndexSet indexSetWithIndexesInRange:[self.sectors rangeValue]];
 
-	// Store the sectors that will actually be read
-	self.sectorsRead = [[SectorRange alloc] initWithFirstSector:firstSectorToRead lastSector:lastSectorToRead];
-	
 	// Setup C2 block error tracking
 	if(self.useC2) {
 		_blockErrorFlags = [NSMutableIndexSet indexSet];
 		_errorFlags = [NSMutableDictionary dictionary];
 	}
+
+	// The size of each sector returned by the drive, and the location of the Q sub-channel within it
+	NSUInteger blockSize = kCDSectorSizeCDDA;
+	if(self.useC2)
+		blockSize += kCDSectorSizeErrorFlags;
+	NSUInteger qSubchannelOffset = blockSize;
+	if(self.verifyPositions) {
+		blockSize += kCDSectorSizeQSubchannel;
+		_misplacedSectors = [NSMutableIndexSet indexSet];
+	}
+
+	// The drive's Q skew is determined from the first block with enough valid Q
+	NSInteger qSkew = 0;
+	BOOL qSkewIsKnown = NO;
+
+	// The last frames of the previous read, for aligning the next one
+	uint32_t alignmentFrames [ALIGNMENT_FRAMES];
+	BOOL haveAlignmentFrames = NO;
+	if(self.correctJitter)
+		_sampleSlips = [NSMutableDictionary dictionary];
+	if(self.correctJitter && !_misplacedSectors)
+		_misplacedSectors = [NSMutableIndexSet indexSet];
+
+	// Sectors that can't be read are zero-filled and tracked
+	_unreadableSectors = [NSMutableIndexSet indexSet];
+
+	// The speed most recently set by the speed controller (0 until the first block)
+	uint16_t currentSpeed = 0;
 	
 	// Housekeeping setup
 	self.fractionComplete = 0;
-	SInt64 packetNumber = 0;
-	
+
 	// ========================================
-	// EXTRACTION PHASE 1: PREPEND SILENCE AS NECESSARY
+	// EXTRACTION OF EACH RUN OF SECTORS
+
+	// Each run is extracted as if by a separate operation, and its audio appended to the store
+	NSUInteger sectorsCompleted = 0;
+	NSUInteger runFirstSector = [sectorIndexes firstIndex];
+	while(NSNotFound != runFirstSector) {
+		NSUInteger runLastSector = runFirstSector;
+		while([sectorIndexes containsIndex:(runLastSector + 1)])
+			++runLastSector;
+
+		SectorRange *sectors = [SectorRange sectorRangeWithFirstSector:runFirstSector lastSector:runLastSector];
+
+		// ========================================
+		// SETUP FOR READ OFFSET HANDLING
 	
-	// Prepend silence, adjusted for the read offset, if required
-	if(sectorsOfSilenceToPrepend) {
-		memset(buffer, 0, sectorsOfSilenceToPrepend * kCDSectorSizeCDDA);
+		// With no read offset, the range of sectors that will be extracted won't change
+		NSInteger firstSectorToRead = sectors.firstSector;
+		NSInteger lastSectorToRead = sectors.lastSector;
 
-		NSData *audioData = [NSData dataWithBytesNoCopy:(buffer + readOffsetInBytes)
-												 length:((kCDSectorSizeCDDA * sectorsOfSilenceToPrepend) - readOffsetInBytes)
-										   freeWhenDone:NO];
+		// Handle the read offset, if specified
+		NSInteger readOffsetInFrames = 0;
+		if(self.readOffset)
+			readOffsetInFrames = self.readOffset.integerValue;
 
-		// Write the silence to the output file
-		UInt32 packetCount = (UInt32)(audioData.length / cddaASBD.mBytesPerPacket);
-		status = AudioFileWritePackets(file, false, (UInt32)audioData.length, NULL, packetNumber, &packetCount, audioData.bytes);
-		if(noErr != status) {
-			self.error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
-			goto cleanup;
+		// Calculate the "read translation", to map between actual sector numbers on disc
+		// and logical sector numbers
+		NSInteger sectorDelta = 0;
+
+		// Negative read offsets can easily be transformed into positive read offsets
+		// For example, suppose the desired range is sectors 10 through 20 and the read offset is -600 frames.
+		// This is equivalent to requesting sectors 8 - 18 with a read offset of 576 frames
+		while(0 > readOffsetInFrames) {
+			readOffsetInFrames += AUDIO_FRAMES_PER_CDDA_SECTOR;
+			--firstSectorToRead;
+			--lastSectorToRead;
+			--sectorDelta;
 		}
 
-		self.sectorsOfSilencePrepended = sectorsOfSilenceToPrepend;
-		
-		// Update the MD5 and SHA1 digests
-		CC_MD5_Update(&md5, audioData.bytes, (CC_LONG)audioData.length);
-		CC_SHA1_Update(&sha1, audioData.bytes, (CC_LONG)audioData.length);
-		
-		// Housekeeping
-		packetNumber += packetCount;
-	}
+		// Adjust the sectors which will be read for read offsets equal to or larger than one sector
+		while(AUDIO_FRAMES_PER_CDDA_SECTOR <= readOffsetInFrames) {
+			readOffsetInFrames -= AUDIO_FRAMES_PER_CDDA_SECTOR;
+			++firstSectorToRead;
+			++lastSectorToRead;
+			++sectorDelta;
+		}
 	
-	// ========================================
-	// EXTRACTION PHASE 2: ITERATIVE READS FROM CD MEDIA
-
-	// Iteratively extract the desired sector range
-	NSUInteger sectorsRemaining = self.sectorsRead.length;
-	while(0 < sectorsRemaining) {
-		// Set up the parameters for this read
-		NSUInteger startSector = self.sectorsRead.firstSector + self.sectorsRead.length - sectorsRemaining;
-		NSUInteger sectorCount = MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining);
-		SectorRange *readRange = [SectorRange sectorRangeWithFirstSector:startSector sectorCount:sectorCount];
-
-		// Read from the CD media
-		NSUInteger sectorsRead = 0;
-		if(self.useC2)
-			sectorsRead = [drive readAudioAndErrorFlags:buffer sectorRange:readRange];
-		else
-			sectorsRead = [drive readAudio:buffer sectorRange:readRange];
-
-		// Verify the requested sectors were read
-		if(0 == sectorsRead) {
-			self.error = drive.error;
-			goto cleanup;
+		// At this point readOffsetInFrames is either 0 or a positive value less than AUDIO_FRAMES_PER_CDDA_SECTOR
+		// One additional sector must be read so this data can be appended to the last full sector
+		if(readOffsetInFrames)
+			++lastSectorToRead;
+	
+		// Determine the number of bytes which should be skipped before the desired audio data is reached
+		NSUInteger readOffsetInBytes = 2 * sizeof(int16_t) * readOffsetInFrames;
+	
+		// Determine the first sector that can be legally read (so as not to over-read the lead in)
+		NSInteger firstPermissibleSector = 0;
+		if(self.allowedSectors)
+			firstPermissibleSector = self.allowedSectors.firstSector;
+	
+		// Determine the last sector that can be legally read (so as not to over-read the lead out)
+		NSInteger lastPermissibleSector = NSIntegerMax;
+		if(self.allowedSectors)
+			lastPermissibleSector = self.allowedSectors.lastSector;
+	
+		// Clamp the read range to the specified sector limitations
+		NSUInteger sectorsOfSilenceToPrepend = 0;
+		if(firstSectorToRead < firstPermissibleSector) {
+			sectorsOfSilenceToPrepend = firstPermissibleSector - firstSectorToRead;
+			firstSectorToRead = firstPermissibleSector;
 		}
-		else if(sectorsRead != sectorCount) {
-#if DEBUG
-			NSLog(@"ExtractionOperation: Requested %ld sectors, got %ld", sectorCount, sectorsRead);
-#endif
-			self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
-			goto cleanup;
+	
+		NSUInteger sectorsOfSilenceToAppend = 0;
+		if(lastSectorToRead > lastPermissibleSector) {
+			sectorsOfSilenceToAppend = lastSectorToRead - lastPermissibleSector;
+			lastSectorToRead = lastPermissibleSector;
 		}
 
-		// Split the audio and C2 data to their respective buffers
-		if(self.useC2) {
-			for(NSUInteger i = 0; i < sectorsRead; ++i) {
-				alias = buffer + (i * (kCDSectorSizeCDDA + kCDSectorSizeErrorFlags));
-				
-				memcpy(audioBuffer + (i * kCDSectorSizeCDDA), alias, kCDSectorSizeCDDA);
-				memcpy(c2Buffer + (i * kCDSectorSizeErrorFlags), alias + kCDSectorSizeCDDA, kCDSectorSizeErrorFlags);				
-				//memcpy(qBuffer + (i * kCDSectorSizeQSubchannel), alias + kCDSectorSizeCDDA + kCDSectorSizeErrorFlags, kCDSectorSizeQSubchannel);
+		// Store the sectors that will actually be read
+		SectorRange *runSectorsRead = [SectorRange sectorRangeWithFirstSector:firstSectorToRead lastSector:lastSectorToRead];
+		self.sectorsRead = (self.sectorsRead ? [SectorRange sectorRangeWithFirstSector:self.sectorsRead.firstSector lastSector:lastSectorToRead] : runSectorsRead);
+
+		// Each run is aligned independently
+		haveAlignmentFrames = NO;
+		
+		// ========================================
+		// EXTRACTION PHASE 1: PREPEND SILENCE AS NECESSARY
+	
+		// Prepend silence, adjusted for the read offset, if required
+		if(sectorsOfSilenceToPrepend) {
+			memset(buffer, 0, sectorsOfSilenceToPrepend * kCDSectorSizeCDDA);
+
+			NSData *audioData = [NSData dataWithBytesNoCopy:(buffer + readOffsetInBytes)
+													 length:((kCDSectorSizeCDDA * sectorsOfSilenceToPrepend) - readOffsetInBytes)
+											   freeWhenDone:NO];
+
+			// Write the silence to the store
+			if(![self.sectorStore appendAudio:audioData.bytes byteCount:audioData.length error:&error]) {
+				self.error = error;
+				goto cleanup;
 			}
-		}
-		else
-			memcpy(audioBuffer, buffer, kCDSectorSizeCDDA * sectorsRead);
 
-		NSData *audioData = nil;
+			self.sectorsOfSilencePrepended = self.sectorsOfSilencePrepended + sectorsOfSilenceToPrepend;
 		
-		// Audio data is offset by the number of bytes corresponding to the read offset in sample frames
-		// If sectors of silence were prepended or will be appended, the read offset is taken into account there
-		if(!sectorsOfSilenceToPrepend && readRange.firstSector == self.sectorsRead.firstSector) {
-			audioData = [NSData dataWithBytesNoCopy:(audioBuffer + readOffsetInBytes)
-											 length:((kCDSectorSizeCDDA * sectorsRead) - readOffsetInBytes)
-									   freeWhenDone:NO];
-
-			// Discard any C2 error bits corresponding to discarded samples in the read offset
-			if(self.useC2)
-				zeroLeadingBitsOfBufferInPlace(c2Buffer, readOffsetInFrames);
-		}
-		// If this is the last read, account for the read offset by discarding everything in the last sector
-		// except for that required by the read offset
-		else if(!sectorsOfSilenceToAppend && readRange.lastSector == self.sectorsRead.lastSector) {
-			audioData = [NSData dataWithBytesNoCopy:audioBuffer
-											 length:((kCDSectorSizeCDDA * sectorsRead) - (kCDSectorSizeCDDA - readOffsetInBytes))
-									   freeWhenDone:NO];
-
-			// Discard any C2 error bits corresponding to discarded samples after the read offset
-			if(self.useC2)
-				zeroTrailingBitsOfBufferInPlace(c2Buffer, (kCDSectorSizeErrorFlags * sectorsRead), (AUDIO_FRAMES_PER_CDDA_SECTOR - readOffsetInFrames));
-		}
-		else
-			audioData = [NSData dataWithBytesNoCopy:audioBuffer 
-											 length:(kCDSectorSizeCDDA * sectorsRead) 
-									   freeWhenDone:NO];
-
-		// Store the error flags
-		if(self.useC2) {
-			// Translate the sector numbers from disc (physical) numbers to logical (physical adjusted for whole sectors of read offset)
-			NSInteger logicalFirstSector = startSector - sectorDelta;
-			[self setErrorFlags:c2Buffer forSectorRange:[SectorRange sectorRangeWithFirstSector:logicalFirstSector sectorCount:sectorCount]];
+			// Update the MD5 and SHA1 digests and the CRCs
+			audioDigestUpdate(&digest, audioData.bytes, audioData.length);
+			updateEACCRCForTrackByteRange(&eacCRC, audioData.bytes, audioData.length, byteOffset, trackByteRange);
+			byteOffset += audioData.length;
 		}
+	
+		// ========================================
+		// EXTRACTION PHASE 2: ITERATIVE READS FROM CD MEDIA
 
-		// Write the data to the output file
-		UInt32 packetCount = (UInt32)(audioData.length / cddaASBD.mBytesPerPacket);
-		status = AudioFileWritePackets(file, false, (UInt32)audioData.length, NULL, packetNumber, &packetCount, audioData.bytes);
-		if(noErr != status) {
-			self.error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
-			goto cleanup;
-		}
+		// Iteratively extract the desired sector range
+		NSUInteger sectorsRemaining = runSectorsRead.length;
+		while(0 < sectorsRemaining) {
+			// Set up the parameters for this read
+			NSUInteger startSector = runSectorsRead.firstSector + runSectorsRead.length - sectorsRemaining;
+			NSUInteger sectorCount = MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining);
+			SectorRange *readRange = [SectorRange sectorRangeWithFirstSector:startSector sectorCount:sectorCount];
+
+			// When correcting jitter, the sectors read overlap the previous read and extend past this one (if permitted)
+			NSUInteger overlapSectors = 0;
+			NSUInteger cushionSectors = 0;
+			if(self.correctJitter && haveAlignmentFrames) {
+				overlapSectors = OVERLAP_SECTORS;
+				if((NSInteger)(startSector + sectorCount) <= lastPermissibleSector)
+					cushionSectors = 1;
+			}
+
+			SectorRange *physicalRange = [SectorRange sectorRangeWithFirstSector:(startSector - overlapSectors) sectorCount:(overlapSectors + sectorCount + cushionSectors)];
+
+			// Hold the session's drive until the block (and any recovery) has been read
+			if(self.session) {
+				[self.session lock];
+				sessionLocked = YES;
+
+				if(!drive.deviceIsOpen) {
+					self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENXIO userInfo:nil];
+					goto cleanup;
+				}
+			}
+
+			// The drive's scheduler serves the reads in order of priority
+			// The drive may be shared, so its priority is set for each block
+			drive.ioPriority = self.ioPriority;
+
+			// Blocks with errors (now or in earlier passes) are read more slowly
+			NSRange logicalReadRange = NSMakeRange(startSector - sectorDelta, sectorCount);
+			if(self.speedController) {
+				uint16_t speed = [self.speedController speedForBlockWithSectorCount:sectorCount suspectSectorCount:[self.suspectSectors countOfIndexesInRange:logicalReadRange]];
+				if(speed != currentSpeed) {
+					if(!originalSpeed)
+						originalSpeed = [drive speed];
+					[drive setSpeed:speed];
+					currentSpeed = speed;
+				}
+			}
+
+			// Read from the CD media
+			// If the Q sub-channel shows the drive was mispositioned, the block is read again before moving on
+			NSUInteger sectorsRead = 0;
+			NSMutableIndexSet *misplacedSectors = [NSMutableIndexSet indexSet];
+			for(NSUInteger attempt = 0; ; ++attempt) {
+				sectorsRead = [self readSectorRange:physicalRange intoBuffer:buffer fromDrive:drive];
+
+				if(!self.verifyPositions || sectorsRead != physicalRange.length)
+					break;
+
+				decodeQSubchannelFrames(buffer + qSubchannelOffset, blockSize, sectorsRead, qFrames);
+
+				if(!qSkewIsKnown) {
+					qSkewIsKnown = determineQSkew(qFrames, physicalRange.firstSector, sectorsRead, &qSkew);
+					if(qSkewIsKnown && qSkew)
+						[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"The drive's Q sub-channel is offset by %ld sectors", (long)qSkew];
+				}
+
+				[misplacedSectors removeAllIndexes];
+				if(qSkewIsKnown)
+					findMisplacedSectors(qFrames, physicalRange.firstSector, sectorsRead, qSkew, misplacedSectors);
+
+				if(!misplacedSectors.count || MAXIMUM_POSITION_RETRIES == attempt)
+					break;
+
+				[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Sectors %@ were misplaced, re-reading sectors %ld - %ld", misplacedSectors, physicalRange.firstSector, physicalRange.lastSector];
+
+				self.positionRetryCount = self.positionRetryCount + 1;
+
+				if(self.isCancelled)
+					goto cleanup;
+			}
+
+			// If the requested sectors weren't all read, the remainder is read again in pieces
+			// Only the damaged parts of the block end up being re-read sector by sector
+			NSMutableIndexSet *unreadableSectors = [NSMutableIndexSet indexSet];
+			BOOL readAtRecoverySpeed = NO;
+			if(sectorsRead != physicalRange.length) {
+				[[Logger sharedLogger] logMessage:@"Read of sectors %ld - %ld returned %ld sectors, recovering", (long)physicalRange.firstSector, (long)physicalRange.lastSector, (long)sectorsRead];
+
+				// Slow the drive down while recovering, if requested
+				uint16_t driveSpeed = 0;
+				if(self.recoverySpeed) {
+					driveSpeed = [drive speed];
+					if(driveSpeed > self.recoverySpeed) {
+						[drive setSpeed:self.recoverySpeed];
+						readAtRecoverySpeed = YES;
+					}
+					else
+						driveSpeed = 0;
+				}
+
+				NSUInteger consecutiveFailures = 0;
+				SectorRange *remainingRange = [SectorRange sectorRangeWithFirstSector:(physicalRange.firstSector + sectorsRead) lastSector:physicalRange.lastSector];
+				BOOL recovered = [self recoverSectorRange:remainingRange 
+											   intoBuffer:(buffer + (sectorsRead * blockSize)) 
+												blockSize:blockSize 
+												fromDrive:drive 
+										unreadableSectors:unreadableSectors 
+									  consecutiveFailures:&consecutiveFailures];
+
+				if(driveSpeed)
+					[drive setSpeed:driveSpeed];
+
+				if(self.isCancelled)
+					goto cleanup;
+
+				if(!recovered) {
+					self.error = (drive.error ? drive.error : [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil]);
+					goto cleanup;
+				}
+
+				sectorsRead = physicalRange.length;
+			}
+
+			// The rest of the block's processing doesn't need the drive
+			if(sessionLocked) {
+				[self.session unlock];
+				sessionLocked = NO;
+			}
+
+			// Only this read's sectors are of interest; the overlap belongs to the previous block
+			[misplacedSectors removeIndexesInRange:NSMakeRange(physicalRange.firstSector, overlapSectors)];
+			[misplacedSectors removeIndexesInRange:NSMakeRange(startSector + sectorCount, cushionSectors)];
+			[unreadableSectors removeIndexesInRange:NSMakeRange(physicalRange.firstSector, overlapSectors)];
+			[unreadableSectors removeIndexesInRange:NSMakeRange(startSector + sectorCount, cushionSectors)];
+			sectorsRead = sectorCount;
+
+			// Split the audio and C2 data to their respective buffers, aligning the audio with the previous read
+			if(self.correctJitter) {
+				for(NSUInteger i = 0; i < physicalRange.length; ++i)
+					memcpy(overlapBuffer + (i * kCDSectorSizeCDDA), buffer + (i * blockSize), kCDSectorSizeCDDA);
+
+				if(self.useC2) {
+					for(NSUInteger i = 0; i < physicalRange.length; ++i)
+						memcpy(overlapC2Buffer + (i * kCDSectorSizeErrorFlags), buffer + (i * blockSize) + kCDSectorSizeCDDA, kCDSectorSizeErrorFlags);
+				}
+
+				NSUInteger firstFrame = overlapSectors * AUDIO_FRAMES_PER_CDDA_SECTOR;
+
+				if(overlapSectors) {
+					NSInteger slip = 0;
+					BOOL aligned = findSampleSlip((const uint32_t *)overlapBuffer, physicalRange.length * AUDIO_FRAMES_PER_CDDA_SECTOR, alignmentFrames, firstFrame - ALIGNMENT_FRAMES, &slip);
+
+					// A read that started early ends early, so it can only be corrected if the sector following it was read
+					if(aligned && 0 < slip && !cushionSectors)
+						aligned = NO;
+
+					if(aligned) {
+						firstFrame += slip;
+
+						if(slip) {
+							[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Corrected a slip of %ld frames at sector %ld", (long)slip, (long)startSector];
+							[_sampleSlips setObject:[NSNumber numberWithInteger:slip] forKey:[NSNumber numberWithInteger:(startSector - sectorDelta)]];
+						}
+					}
+					else {
+						[[Logger sharedLogger] logMessage:@"Unable to align the read at sector %ld with the previous read", (long)startSector];
+						[misplacedSectors addIndexesInRange:NSMakeRange(startSector, sectorCount)];
+					}
+				}
+
+				memcpy(audioBuffer, overlapBuffer + (firstFrame * 2 * sizeof(int16_t)), kCDSectorSizeCDDA * sectorsRead);
+
+				// The error bits move with the audio they describe
+				if(self.useC2)
+					copyErrorFlagsForFrames(c2Buffer, overlapC2Buffer, firstFrame, sectorsRead * AUDIO_FRAMES_PER_CDDA_SECTOR);
+
+				// The next read is aligned to the frames ending this one
+				memcpy(alignmentFrames, audioBuffer + (kCDSectorSizeCDDA * sectorsRead) - sizeof(alignmentFrames), sizeof(alignmentFrames));
+				haveAlignmentFrames = YES;
+			}
+			else if(self.useC2 || self.verifyPositions) {
+				for(NSUInteger i = 0; i < sectorsRead; ++i) {
+					alias = buffer + (i * blockSize);
+				
+					memcpy(audioBuffer + (i * kCDSectorSizeCDDA), alias, kCDSectorSizeCDDA);
+					if(self.useC2)
+						memcpy(c2Buffer + (i * kCDSectorSizeErrorFlags), alias + kCDSectorSizeCDDA, kCDSectorSizeErrorFlags);
+				}
+			}
+			else
+				memcpy(audioBuffer, buffer, kCDSectorSizeCDDA * sectorsRead);
+
+			NSData *audioData = nil;
 		
-		// Update the MD5 and SHA1 digests
-		CC_MD5_Update(&md5, audioData.bytes, (CC_LONG)audioData.length);
-		CC_SHA1_Update(&sha1, audioData.bytes, (CC_LONG)audioData.length);
+			// Audio data is offset by the number of bytes corresponding to the read offset in sample frames
+			// If sectors of silence were prepended or will be appended, the read offset is taken into account there
+			if(!sectorsOfSilenceToPrepend && readRange.firstSector == runSectorsRead.firstSector) {
+				audioData = [NSData dataWithBytesNoCopy:(audioBuffer + readOffsetInBytes)
+												 length:((kCDSectorSizeCDDA * sectorsRead) - readOffsetInBytes)
+										   freeWhenDone:NO];
+
+				// Discard any C2 error bits corresponding to discarded samples in the read offset
+				if(self.useC2)
+					zeroLeadingBitsOfBufferInPlace(c2Buffer, readOffsetInFrames);
+			}
+			// If this is the last read, account for the read offset by discarding everything in the last sector
+			// except for that required by the read offset
+			else if(!sectorsOfSilenceToAppend && readRange.lastSector == runSectorsRead.lastSector) {
+				audioData = [NSData dataWithBytesNoCopy:audioBuffer
+												 length:((kCDSectorSizeCDDA * sectorsRead) - (kCDSectorSizeCDDA - readOffsetInBytes))
+										   freeWhenDone:NO];
+
+				// Discard any C2 error bits corresponding to discarded samples after the read offset
+				if(self.useC2)
+					zeroTrailingBitsOfBufferInPlace(c2Buffer, (kCDSectorSizeErrorFlags * sectorsRead), (AUDIO_FRAMES_PER_CDDA_SECTOR - readOffsetInFrames));
+			}
+			else
+				audioData = [NSData dataWithBytesNoCopy:audioBuffer 
+												 length:(kCDSectorSizeCDDA * sectorsRead) 
+										   freeWhenDone:NO];
+
+			// Store the error flags
+			if(self.useC2) {
+				// Translate the sector numbers from disc (physical) numbers to logical (physical adjusted for whole sectors of read offset)
+				NSInteger logicalFirstSector = startSector - sectorDelta;
+				[self setErrorFlags:c2Buffer forSectorRange:[SectorRange sectorRangeWithFirstSector:logicalFirstSector sectorCount:sectorCount]];
+			}
+
+			// Sectors that couldn't be read in place are suspect, just like those with C2 errors
+			if(misplacedSectors.count) {
+				[[Logger sharedLogger] logMessage:@"The positions of sectors %@ could not be confirmed", misplacedSectors];
+
+				[misplacedSectors shiftIndexesStartingAtIndex:[misplacedSectors firstIndex] by:-sectorDelta];
+				[_misplacedSectors addIndexes:misplacedSectors];
+				if(self.useC2)
+					[_blockErrorFlags addIndexes:misplacedSectors];
+			}
+
+			// Sectors that couldn't be read at all were zero-filled, so every bit in them is in error
+			if(unreadableSectors.count) {
+				[unreadableSectors shiftIndexesStartingAtIndex:[unreadableSectors firstIndex] by:-sectorDelta];
+				[_unreadableSectors addIndexes:unreadableSectors];
+
+				if(self.useC2) {
+					uint8_t allErrorFlags [kCDSectorSizeErrorFlags];
+					memset(allErrorFlags, 0xFF, kCDSectorSizeErrorFlags);
+					NSData *allErrorFlagsData = [NSData dataWithBytes:allErrorFlags length:kCDSectorSizeErrorFlags];
+
+					NSUInteger sectorNumber = [unreadableSectors firstIndex];
+					while(NSNotFound != sectorNumber) {
+						[_blockErrorFlags addIndex:sectorNumber];
+						[_errorFlags setObject:allErrorFlagsData forKey:[NSNumber numberWithUnsignedInteger:sectorNumber]];
+						sectorNumber = [unreadableSectors indexGreaterThanIndex:sectorNumber];
+					}
+				}
+			}
+
+			// Let the speed controller know how the block fared
+			if(self.speedController) {
+				NSUInteger errorSectorCount = 0;
+				if(self.useC2)
+					errorSectorCount = [_blockErrorFlags countOfIndexesInRange:logicalReadRange];
+				else
+					errorSectorCount = [_misplacedSectors countOfIndexesInRange:logicalReadRange] + [_unreadableSectors countOfIndexesInRange:logicalReadRange];
+				[self.speedController recordBlockWithSectorCount:sectorCount errorSectorCount:errorSectorCount readAtCurrentSpeed:!readAtRecoverySpeed];
+			}
+
+			// Write the data to the store
+			if(![self.sectorStore appendAudio:audioData.bytes byteCount:audioData.length error:&error]) {
+				self.error = error;
+				goto cleanup;
+			}
 		
-		// Housekeeping
-		sectorsRemaining -= sectorsRead;
-		packetNumber += packetCount;
-		self.fractionComplete = (1.f - ((float)sectorsRemaining / (float)self.sectorsRead.length));
+			// Update the MD5 and SHA1 digests and the CRCs
+			audioDigestUpdate(&digest, audioData.bytes, audioData.length);
+			updateEACCRCForTrackByteRange(&eacCRC, audioData.bytes, audioData.length, byteOffset, trackByteRange);
+			byteOffset += audioData.length;
 		
-		// Stop if requested
-		if(self.isCancelled)
-			goto cleanup;
-	}
+			// Housekeeping
+			sectorsRemaining -= sectorsRead;
+			self.fractionComplete = ((float)sectorsCompleted + ((float)sectors.length * (1.f - ((float)sectorsRemaining / (float)runSectorsRead.length)))) / (float)sectorIndexes.count;
+		
+			// Stop if requested
+			if(self.isCancelled)
+				goto cleanup;
+		}
 
-	// ========================================
-	// EXTRACTION PHASE 3: APPEND SILENCE AS NECESSARY
+		// ========================================
+		// EXTRACTION PHASE 3: APPEND SILENCE AS NECESSARY
 
-	// Append silence, with extra added for the read offset, if required
-	if(sectorsOfSilenceToAppend) {
-		memset(buffer, 0, (sectorsOfSilenceToAppend * kCDSectorSizeCDDA) + readOffsetInBytes);
+		// Append silence, with extra added for the read offset, if required
+		if(sectorsOfSilenceToAppend) {
+			memset(buffer, 0, (sectorsOfSilenceToAppend * kCDSectorSizeCDDA) + readOffsetInBytes);
 		
-		NSData *audioData = [NSData dataWithBytesNoCopy:buffer
-												 length:((kCDSectorSizeCDDA * sectorsOfSilenceToAppend) + readOffsetInBytes)
-										   freeWhenDone:NO];
+			NSData *audioData = [NSData dataWithBytesNoCopy:buffer
+													 length:((kCDSectorSizeCDDA * sectorsOfSilenceToAppend) + readOffsetInBytes)
+											   freeWhenDone:NO];
 		
-		// Write the silence to the output file
-		UInt32 packetCount = (UInt32)(audioData.length / cddaASBD.mBytesPerPacket);
-		status = AudioFileWritePackets(file, false, (UInt32)audioData.length, NULL, packetNumber, &packetCount, audioData.bytes);
-		if(noErr != status) {
-			self.error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
-			goto cleanup;
-		}
+			// Write the silence to the store
+			if(![self.sectorStore appendAudio:audioData.bytes byteCount:audioData.length error:&error]) {
+				self.error = error;
+				goto cleanup;
+			}
+
+			self.sectorsOfSilenceAppended = self.sectorsOfSilenceAppended + sectorsOfSilenceToAppend;
 
-		self.sectorsOfSilenceAppended = sectorsOfSilenceToAppend;
+			// Update the MD5 and SHA1 digests and the CRCs
+			audioDigestUpdate(&digest, audioData.bytes, audioData.length);
+			updateEACCRCForTrackByteRange(&eacCRC, audioData.bytes, audioData.length, byteOffset, trackByteRange);
+			byteOffset += audioData.length;
+		}
 
-		// Update the MD5 and SHA1 digests
-		CC_MD5_Update(&md5, audioData.bytes, (CC_LONG)audioData.length);
-		CC_SHA1_Update(&sha1, audioData.bytes, (CC_LONG)audioData.length);
+		sectorsCompleted += sectors.length;
+		runFirstSector = [sectorIndexes indexGreaterThanIndex:runLastSector];
 	}
 
 	// ========================================
@@ -415,37 +947,42 @@ zeroTrailingBitsOfBufferInPlace(void *buffer,
 	self.fractionComplete = 1;
 
 	// Complete the full MD5 and SHA1 calculations
-	unsigned char md5Digest [CC_MD5_DIGEST_LENGTH];
-	CC_MD5_Final(md5Digest, &md5);
+	NSString *MD5 = nil, *SHA1 = nil;
+	audioDigestFinal(&digest, &MD5, &SHA1);
 
-	unsigned char sha1Digest [CC_SHA1_DIGEST_LENGTH];
-	CC_SHA1_Final(sha1Digest, &sha1);
-	
-	NSMutableString *tempString = [NSMutableString string];
-	
-	for(NSUInteger i = 0; i < CC_MD5_DIGEST_LENGTH; ++i)
-		[tempString appendFormat:@"%02x", md5Digest[i]];
-	self.MD5 = tempString;
+	self.MD5 = MD5;
+	self.SHA1 = SHA1;
 
-	tempString = [NSMutableString string];
-	for(NSUInteger i = 0; i < CC_SHA1_DIGEST_LENGTH; ++i)
-		[tempString appendFormat:@"%02x", sha1Digest[i]];
-	self.SHA1 = tempString;
+	if(trackByteRange.length) {
+		self.CRC32 = [NSNumber numberWithUnsignedInt:eacCRC.CRC32];
+		self.CRC32WithoutNullSamples = [NSNumber numberWithUnsignedInt:eacCRC.CRC32WithoutNullSamples];
+	}
 
 	// ========================================
 	// CLEAN UP
 
 cleanup:
-	// Close the device
-	if(![drive closeDevice])
-		self.error = drive.error;
-	
-	// Close the output file
-	if(file) {
-		status = AudioFileClose(file);
-		if(noErr != status)
-			self.error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+	// Leave the drive at the speed it was found at, whether the extraction finished, failed or was cancelled
+	if(originalSpeed) {
+		[self.session lock];
+		[drive setSpeed:originalSpeed];
+		[self.session unlock];
+	}
+
+	if(sessionLocked)
+		[self.session unlock];
+
+	// Return the buffers to the session, or close the device if it doesn't belong to one
+	if(self.session) {
+		releaseBuffer(self.session, kBufferKey, buffer);
+		releaseBuffer(self.session, kAudioBufferKey, audioBuffer);
+		releaseBuffer(self.session, kC2BufferKey, c2Buffer);
+		releaseBuffer(self.session, kQFramesKey, qFrames);
+		releaseBuffer(self.session, kOverlapBufferKey, overlapBuffer);
+		releaseBuffer(self.session, kOverlapC2BufferKey, overlapC2Buffer);
 	}
+	else if(![drive closeDevice])
+		self.error = drive.error;
 }
 
 @end
@@ -479,4 +1016,102 @@ cleanup:
 	}
 }
 
+// Read range using the read command matching the data requested
+- (NSUInteger) readSectorRange:(SectorRange *)range intoBuffer:(void *)buffer fromDrive:(Drive *)drive
+{
+	NSParameterAssert(nil != range);
+	NSParameterAssert(NULL != buffer);
+	NSParameterAssert(nil != drive);
+
+	if(self.useC2 && self.verifyPositions)
+		return [drive readAudioAndErrorFlagsWithQSubchannel:buffer sectorRange:range];
+	else if(self.useC2)
+		return [drive readAudioAndErrorFlags:buffer sectorRange:range];
+	else if(self.verifyPositions)
+		return [drive readAudioAndQSubchannel:buffer sectorRange:range];
+	else
+		return [drive readAudio:buffer sectorRange:range];
+}
+
+// Read range, bisecting it until the pieces that can't be read are single sectors
+// A short read returns the leading sectors intact, so only what follows them is read again
+// Returns NO if the operation was cancelled or too many consecutive sectors couldn't be read
+- (BOOL) recoverSectorRange:(SectorRange *)range intoBuffer:(int8_t *)buffer blockSize:(NSUInteger)blockSize fromDrive:(Drive *)drive unreadableSectors:(NSMutableIndexSet *)unreadableSectors consecutiveFailures:(NSUInteger *)consecutiveFailures
+{
+	NSParameterAssert(nil != range);
+	NSParameterAssert(NULL != buffer);
+	NSParameterAssert(nil != unreadableSectors);
+	NSParameterAssert(NULL != consecutiveFailures);
+
+	if(self.isCancelled)
+		return NO;
+
+	NSUInteger sectorsRead = [self readSectorRange:range intoBuffer:buffer fromDrive:drive];
+
+	if(sectorsRead) {
+		*consecutiveFailures = 0;
+
+		if(sectorsRead == range.length)
+			return YES;
+
+		SectorRange *remainingRange = [SectorRange sectorRangeWithFirstSector:(range.firstSector + sectorsRead) lastSector:range.lastSector];
+		return [self recoverSectorRange:remainingRange intoBuffer:(buffer + (sectorsRead * blockSize)) blockSize:blockSize fromDrive:drive unreadableSectors:unreadableSectors consecutiveFailures:consecutiveFailures];
+	}
+
+	if(1 == range.length)
+		return [self recoverSector:range.firstSector intoBuffer:buffer blockSize:blockSize fromDrive:drive unreadableSectors:unreadableSectors consecutiveFailures:consecutiveFailures];
+
+	NSUInteger sectorsInFirstHalf = range.length / 2;
+	SectorRange *firstHalf = [SectorRange sectorRangeWithFirstSector:range.firstSector sectorCount:sectorsInFirstHalf];
+	SectorRange *secondHalf = [SectorRange sectorRangeWithFirstSector:(range.firstSector + sectorsInFirstHalf) lastSector:range.lastSector];
+
+	if(![self recoverSectorRange:firstHalf intoBuffer:buffer blockSize:blockSize fromDrive:drive unreadableSectors:unreadableSectors consecutiveFailures:consecutiveFailures])
+		return NO;
+
+	return [self recoverSectorRange:secondHalf intoBuffer:(buffer + (sectorsInFirstHalf * blockSize)) blockSize:blockSize fromDrive:drive unreadableSectors:unreadableSectors consecutiveFailures:consecutiveFailures];
+}
+
+// Retry a single sector that couldn't be read, backing off between attempts
+// If it still can't be read it is zero-filled and added to unreadableSectors
+- (BOOL) recoverSector:(NSUInteger)sector intoBuffer:(int8_t *)buffer blockSize:(NSUInteger)blockSize fromDrive:(Drive *)drive unreadableSectors:(NSMutableIndexSet *)unreadableSectors consecutiveFailures:(NSUInteger *)consecutiveFailures
+{
+	NSParameterAssert(NULL != buffer);
+	NSParameterAssert(nil != unreadableSectors);
+	NSParameterAssert(NULL != consecutiveFailures);
+
+	SectorRange *range = [SectorRange sectorRangeWithSector:sector];
+	NSTimeInterval backoffInterval = self.recoveryBackoffInterval;
+
+	for(NSUInteger attempt = 0; attempt < self.recoveryRetryCount; ++attempt) {
+		// The session's drive is free for others while waiting (the block's buffers belong to this operation)
+		if(0 < backoffInterval) {
+			[self.session unlock];
+			[NSThread sleepForTimeInterval:backoffInterval];
+			[self.session lock];
+
+			backoffInterval *= 2;
+		}
+
+		if(self.isCancelled)
+			return NO;
+
+		// The session may have been closed while waiting
+		if(!drive.deviceIsOpen)
+			return NO;
+
+		if([self readSectorRange:range intoBuffer:buffer fromDrive:drive]) {
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Sector %ld read after %ld retries", (long)sector, (long)(attempt + 1)];
+			*consecutiveFailures = 0;
+			return YES;
+		}
+	}
+
+	[[Logger sharedLogger] logMessage:@"Unable to read sector %ld", (long)sector];
+
+	memset(buffer, 0, blockSize);
+	[unreadableSectors addIndex:sector];
+
+	return (MAXIMUM_CONSECUTIVE_UNREADABLE_SECTORS > ++(*consecutiveFailures));
+}
+
 @end
@@ -17,11 +17,14 @@
 // ========================================
 // Core Data properties
 @property (assign) NSNumber * accurateRipChecksum;
+@property (assign) NSNumber * accurateRipChecksumV2;
 @property (assign) NSNumber * accurateRipAlternatePressingChecksum;
 @property (assign) NSNumber * accurateRipAlternatePressingOffset;
 @property (assign) NSNumber * accurateRipConfidenceLevel;
 @property (assign) NSIndexSet * blockErrorFlags;
 @property (assign) NSNumber * copyVerified;
+@property (assign) NSNumber * CRC32;
+@property (assign) NSNumber * CRC32WithoutNullSamples;
 @property (assign) NSDate * date;
 @property (assign) NSURL * inputURL;
 @property (assign) NSString * MD5;
@@ -10,11 +10,14 @@
 // ========================================
 // Core Data properties
 @dynamic accurateRipChecksum;
+@dynamic accurateRipChecksumV2;
 @dynamic accurateRipAlternatePressingChecksum;
 @dynamic accurateRipAlternatePressingOffset;
 @dynamic accurateRipConfidenceLevel;
 @dynamic blockErrorFlags;
 @dynamic copyVerified;
+@dynamic CRC32;
+@dynamic CRC32WithoutNullSamples;
 @dynamic date;
 @dynamic inputURL;
 @dynamic MD5;
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#import "AccurateRipDatabaseCache.h"
+
+// ========================================
+// KVC key names for the album report dictionaries
+// ========================================
+extern NSString * const		kAlbumURLsKey; // NSArray * of NSURL *, the files verified
+extern NSString * const		kAlbumCueSheetURLKey; // NSURL *, if the album was described by a cue sheet
+extern NSString * const		kAlbumAccurateRipDiscIDKey; // NSString *, the dBAR file name for the album
+extern NSString * const		kAlbumFoundInAccurateRipKey; // NSNumber * (BOOL)
+extern NSString * const		kAlbumPressingCountKey; // NSNumber *
+extern NSString * const		kAlbumReadOffsetKey; // NSNumber *, in sample frames, the offset matching the most tracks
+extern NSString * const		kAlbumAccurateTrackCountKey; // NSNumber *
+extern NSString * const		kAlbumTracksKey; // NSArray * of NSDictionary *, see keys below
+
+extern NSString * const		kTrackNumberKey; // NSNumber *
+extern NSString * const		kTrackSectorCountKey; // NSNumber *
+extern NSString * const		kTrackCRC32Key; // NSNumber *, the EAC-style CRC32
+extern NSString * const		kTrackCRC32WithoutNullSamplesKey; // NSNumber *
+extern NSString * const		kTrackAccurateRipChecksumKey; // NSNumber *
+extern NSString * const		kTrackAccurateRipChecksumV2Key; // NSNumber *
+extern NSString * const		kTrackAccurateRipConfidenceLevelKey; // NSNumber *, absent if the track isn't accurate
+extern NSString * const		kTrackAccurateRipOffsetKey; // NSNumber *, in sample frames, present if the track is accurate
+extern NSString * const		kTrackAccurateRipMatchedV2Key; // NSNumber * (BOOL), present if the track is accurate
+
+// ========================================
+// An NSOperation subclass that verifies a previously ripped album against AccurateRip
+// The album is either one file per track (trackURLs, in track order) or described by a
+// cue sheet referencing one or more files (cueSheetURL)
+// Files are decoded with ExtAudioFile and must contain 44.1 kHz stereo audio
+// Audio is assumed to have been ripped offset-corrected with the first track beginning
+// at sector 0, and checksums are calculated for every offset in the window so rips
+// of other pressings (or uncorrected rips) are also recognized
+// dBAR responses come from the shared AccurateRipDatabaseCache
+// ========================================
+@interface AlbumVerificationOperation : NSOperation
+{
+@private
+	NSArray *_trackURLs;
+	NSURL *_cueSheetURL;
+	NSUInteger _maximumOffsetInSectors;
+	eAccurateRipCachePolicy _cachePolicy;
+
+	NSError *_error;
+	NSDictionary *_report;
+}
+
+// ========================================
+// Properties affecting verification
+@property (copy) NSArray * trackURLs;
+@property (copy) NSURL * cueSheetURL;
+@property (assign) NSUInteger maximumOffsetInSectors;
+@property (assign) eAccurateRipCachePolicy cachePolicy;
+
+// ========================================
+// Properties set after verification is complete (or cancelled)
+@property (readonly, copy) NSError * error;
+@property (readonly, copy) NSDictionary * report; // See keys above
+
+@end
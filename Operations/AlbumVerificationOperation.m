@@ -0,0 +1,477 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "AlbumVerificationOperation.h"
+
+#import "AccurateRipChecksumIndex.h"
+#import "AccurateRipUtilities.h"
+#import "SectorStore.h"
+
+#import "CDDAUtilities.h"
+#import "DigestUtilities.h"
+#import "Logger.h"
+
+#include <AudioToolbox/ExtendedAudioFile.h>
+#include <IOKit/storage/IOCDTypes.h>
+
+// The number of sectors decoded at once
+#define SECTORS_PER_READ 64u
+
+// ========================================
+// KVC key names for the album report dictionaries
+// ========================================
+NSString * const	kAlbumURLsKey							= @"URLs";
+NSString * const	kAlbumCueSheetURLKey					= @"cueSheetURL";
+NSString * const	kAlbumAccurateRipDiscIDKey				= @"accurateRipDiscID";
+NSString * const	kAlbumFoundInAccurateRipKey				= @"foundInAccurateRip";
+NSString * const	kAlbumPressingCountKey					= @"pressingCount";
+NSString * const	kAlbumReadOffsetKey						= @"readOffset";
+NSString * const	kAlbumAccurateTrackCountKey				= @"accurateTrackCount";
+NSString * const	kAlbumTracksKey							= @"tracks";
+
+NSString * const	kTrackNumberKey							= @"number";
+NSString * const	kTrackSectorCountKey					= @"sectorCount";
+NSString * const	kTrackCRC32Key							= @"CRC32";
+NSString * const	kTrackCRC32WithoutNullSamplesKey		= @"CRC32WithoutNullSamples";
+NSString * const	kTrackAccurateRipChecksumKey			= @"accurateRipChecksum";
+NSString * const	kTrackAccurateRipChecksumV2Key			= @"accurateRipChecksumV2";
+NSString * const	kTrackAccurateRipConfidenceLevelKey		= @"accurateRipConfidenceLevel";
+NSString * const	kTrackAccurateRipOffsetKey				= @"accurateRipOffset";
+NSString * const	kTrackAccurateRipMatchedV2Key			= @"accurateRipMatchedV2";
+
+// Keys for the files making up an album
+static NSString * const kFileURLKey						= @"URL";
+static NSString * const kFileTrackStartsKey				= @"trackStarts"; // NSArray * of NSNumber *, in sectors relative to the start of the file
+
+// ========================================
+// Parse the audio tracks from a cue sheet
+// Returns an array of the files referenced, in order, with the INDEX 01 of each audio track
+// ========================================
+static NSArray *
+filesForCueSheet(NSURL *cueSheetURL, NSError **error)
+{
+	NSCParameterAssert(nil != cueSheetURL);
+
+	// Cue sheets are written in a variety of encodings
+	NSString *cueSheet = [NSString stringWithContentsOfURL:cueSheetURL encoding:NSUTF8StringEncoding error:NULL];
+	if(!cueSheet)
+		cueSheet = [NSString stringWithContentsOfURL:cueSheetURL encoding:NSWindowsCP1252StringEncoding error:error];
+	if(!cueSheet)
+		return nil;
+
+	NSURL *baseURL = [NSURL fileURLWithPath:[[cueSheetURL path] stringByDeletingLastPathComponent]];
+	NSMutableArray *files = [NSMutableArray array];
+	NSMutableArray *trackStarts = nil;
+	BOOL trackIsAudio = NO;
+
+	for(NSString *line in [cueSheet componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+		NSScanner *scanner = [NSScanner scannerWithString:line];
+		NSString *command = nil;
+
+		if(![scanner scanUpToCharactersFromSet:[NSCharacterSet whitespaceCharacterSet] intoString:&command])
+			continue;
+
+		command = [command uppercaseString];
+
+		if([command isEqualToString:@"FILE"]) {
+			NSString *fileName = nil;
+			if([scanner scanString:@"\"" intoString:NULL])
+				[scanner scanUpToString:@"\"" intoString:&fileName];
+			else
+				[scanner scanUpToCharactersFromSet:[NSCharacterSet whitespaceCharacterSet] intoString:&fileName];
+
+			if(!fileName)
+				goto corrupt;
+
+			// Cue sheets written on Windows may use backslashes
+			fileName = [[fileName stringByReplacingOccurrencesOfString:@"\\" withString:@"/"] lastPathComponent];
+
+			trackStarts = [NSMutableArray array];
+			[files addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+							  [NSURL URLWithString:[fileName stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding] relativeToURL:baseURL], kFileURLKey,
+							  trackStarts, kFileTrackStartsKey,
+							  nil]];
+		}
+		else if([command isEqualToString:@"TRACK"]) {
+			NSString *trackType = nil;
+			if(![scanner scanInt:NULL] || ![scanner scanUpToCharactersFromSet:[NSCharacterSet whitespaceCharacterSet] intoString:&trackType])
+				goto corrupt;
+
+			// Data tracks aren't part of the audio
+			trackIsAudio = [[trackType uppercaseString] isEqualToString:@"AUDIO"];
+		}
+		else if([command isEqualToString:@"INDEX"]) {
+			int indexNumber = 0, minute = 0, second = 0, frame = 0;
+			if(![scanner scanInt:&indexNumber] || ![scanner scanInt:&minute] || ![scanner scanString:@":" intoString:NULL] || ![scanner scanInt:&second] || ![scanner scanString:@":" intoString:NULL] || ![scanner scanInt:&frame])
+				goto corrupt;
+
+			if(!trackStarts)
+				goto corrupt;
+
+			if(1 == indexNumber && trackIsAudio)
+				[trackStarts addObject:[NSNumber numberWithUnsignedInteger:(((minute * 60) + second) * CDDA_SECTORS_PER_SECOND) + frame]];
+		}
+	}
+
+	return files;
+
+corrupt:
+	if(error)
+		*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:[NSDictionary dictionaryWithObject:[cueSheetURL path] forKey:NSFilePathErrorKey]];
+
+	return nil;
+}
+
+@interface AlbumVerificationOperation ()
+@property (copy) NSError * error;
+@property (copy) NSDictionary * report;
+@end
+
+// ========================================
+// Private methods
+// ========================================
+@interface AlbumVerificationOperation (Private)
+- (BOOL) appendAudioFromURL:(NSURL *)URL toSectorStore:(SectorStore *)sectorStore trackStartFrames:(const NSUInteger *)trackStartFrames trackCount:(NSUInteger)trackCount trackCRCs:(EACCRCContext *)trackCRCs error:(NSError **)error;
+@end
+
+@implementation AlbumVerificationOperation
+
+@synthesize trackURLs = _trackURLs;
+@synthesize cueSheetURL = _cueSheetURL;
+@synthesize maximumOffsetInSectors = _maximumOffsetInSectors;
+@synthesize cachePolicy = _cachePolicy;
+@synthesize error = _error;
+@synthesize report = _report;
+
+- (id) init
+{
+	if((self = [super init])) {
+		self.maximumOffsetInSectors = 3;
+		self.cachePolicy = (eAccurateRipCachePolicy)[[NSUserDefaults standardUserDefaults] integerForKey:@"accurateRipCachePolicy"];
+	}
+	return self;
+}
+
+- (void) main
+{
+	NSAssert(nil != self.trackURLs || nil != self.cueSheetURL, @"self.trackURLs and self.cueSheetURL may not both be nil");
+
+	NSError *error = nil;
+
+	// Determine the files making up the album and where the tracks begin in each
+	NSArray *files = nil;
+	if(self.cueSheetURL) {
+		files = filesForCueSheet(self.cueSheetURL, &error);
+		if(!files) {
+			self.error = error;
+			return;
+		}
+	}
+	else {
+		NSMutableArray *trackFiles = [NSMutableArray array];
+		NSArray *trackStarts = [NSArray arrayWithObject:[NSNumber numberWithUnsignedInteger:0]];
+		for(NSURL *trackURL in self.trackURLs)
+			[trackFiles addObject:[NSDictionary dictionaryWithObjectsAndKeys:trackURL, kFileURLKey, trackStarts, kFileTrackStartsKey, nil]];
+		files = trackFiles;
+	}
+
+	NSUInteger trackCount = 0;
+	for(NSDictionary *file in files)
+		trackCount += [[file objectForKey:kFileTrackStartsKey] count];
+
+	if(!trackCount || 99 < trackCount) {
+		self.error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:nil];
+		return;
+	}
+
+	NSMutableData *trackStartFramesData = [NSMutableData dataWithLength:(trackCount * sizeof(NSUInteger))];
+	NSMutableData *trackCRCsData = [NSMutableData dataWithLength:(trackCount * sizeof(EACCRCContext))];
+	NSUInteger *trackStartFrames = [trackStartFramesData mutableBytes];
+	EACCRCContext *trackCRCs = [trackCRCsData mutableBytes];
+
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex)
+		eacCRCInit(&trackCRCs[trackIndex]);
+
+	// Decode the album into a single image, calculating each track's CRCs along the way
+	SectorStore *sectorStore = [SectorStore sectorStore];
+	NSUInteger tracksStarted = 0;
+
+	for(NSDictionary *file in files) {
+		if(self.isCancelled)
+			goto cleanup;
+
+		NSUInteger fileFirstFrame = sectorStore.sectorCount * AUDIO_FRAMES_PER_CDDA_SECTOR;
+		for(NSNumber *trackStart in [file objectForKey:kFileTrackStartsKey]) {
+			trackStartFrames[tracksStarted] = fileFirstFrame + (trackStart.unsignedIntegerValue * AUDIO_FRAMES_PER_CDDA_SECTOR);
+
+			if(tracksStarted && trackStartFrames[tracksStarted] <= trackStartFrames[tracksStarted - 1]) {
+				self.error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:nil];
+				goto cleanup;
+			}
+
+			++tracksStarted;
+		}
+
+		if(![self appendAudioFromURL:[file objectForKey:kFileURLKey] toSectorStore:sectorStore trackStartFrames:trackStartFrames trackCount:tracksStarted trackCRCs:trackCRCs error:&error]) {
+			if(!self.isCancelled)
+				self.error = error;
+			goto cleanup;
+		}
+	}
+
+	// Determine the extent of each track, in sectors
+	NSUInteger leadOut = sectorStore.sectorCount;
+	NSRange *trackSectors = malloc(trackCount * sizeof(NSRange));
+	NSUInteger *trackOffsets = malloc(trackCount * sizeof(NSUInteger));
+	if(!trackSectors || !trackOffsets) {
+		free(trackSectors);
+		free(trackOffsets);
+		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		goto cleanup;
+	}
+
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+		NSUInteger trackEnd = (trackCount - 1 == trackIndex ? leadOut : trackStartFrames[trackIndex + 1] / AUDIO_FRAMES_PER_CDDA_SECTOR);
+
+		trackOffsets[trackIndex] = trackStartFrames[trackIndex] / AUDIO_FRAMES_PER_CDDA_SECTOR;
+		trackSectors[trackIndex] = NSMakeRange(trackOffsets[trackIndex], trackEnd - trackOffsets[trackIndex]);
+	}
+
+	if(trackOffsets[trackCount - 1] >= leadOut) {
+		free(trackSectors);
+		free(trackOffsets);
+		self.error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:nil];
+		goto cleanup;
+	}
+
+	// Fetch the dBAR data for the album, from the cache if possible
+	uint32_t discID1, discID2, freeDBDiscID;
+	calculateAccurateRipDiscIDs(trackOffsets, trackCount, leadOut, &discID1, &discID2, &freeDBDiscID);
+	free(trackOffsets);
+
+	AccurateRipDatabaseCache *databaseCache = [AccurateRipDatabaseCache sharedCache];
+	NSData *accurateRipResponseData = [databaseCache dataForTrackCount:trackCount
+															   discID1:discID1
+															   discID2:discID2
+														  freeDBDiscID:freeDBDiscID
+														   cachePolicy:self.cachePolicy
+															 sourceURL:NULL
+																 error:&error];
+
+	// The report is still useful without AccurateRip data, so errors aren't fatal
+	if(!accurateRipResponseData && error)
+		self.error = error;
+
+	AccurateRipChecksumIndex *checksumIndex = nil;
+	if(accurateRipResponseData)
+		checksumIndex = [AccurateRipChecksumIndex checksumIndexWithDatabaseResponse:accurateRipResponseData trackCount:trackCount];
+
+	// Calculate the checksums for every track and offset in one pass over the image
+	NSInteger maximumOffsetInFrames = (NSInteger)(self.maximumOffsetInSectors * AUDIO_FRAMES_PER_CDDA_SECTOR);
+	NSInteger offsetForChecksumV2 = 0;
+	NSArray *checksumsV2 = nil;
+	NSArray *checksums = calculateAccurateRipChecksumsForDiscInSectorStore(sectorStore, trackSectors, trackCount, self.maximumOffsetInSectors, &offsetForChecksumV2, 1, &checksumsV2);
+
+	if(!checksums) {
+		free(trackSectors);
+		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+		goto cleanup;
+	}
+
+	// The offset matching the most tracks is most likely the one the album was ripped with
+	// Ties are resolved in favor of the smallest offset
+	NSInteger readOffset = 0;
+	if(checksumIndex) {
+		NSData *matchCountsData = [checksumIndex matchingTrackCountsForChecksums:checksums firstTrackNumber:1];
+		const uint32_t *matchCounts = [matchCountsData bytes];
+
+		uint32_t bestMatchCount = matchCounts[maximumOffsetInFrames];
+		for(NSInteger offset = 1; offset <= maximumOffsetInFrames; ++offset) {
+			if(matchCounts[maximumOffsetInFrames + offset] > bestMatchCount)
+				bestMatchCount = matchCounts[maximumOffsetInFrames + offset], readOffset = offset;
+			if(matchCounts[maximumOffsetInFrames - offset] > bestMatchCount)
+				bestMatchCount = matchCounts[maximumOffsetInFrames - offset], readOffset = -offset;
+		}
+	}
+
+	// Build the report
+	NSMutableArray *trackReports = [NSMutableArray arrayWithCapacity:trackCount];
+	NSUInteger accurateTrackCount = 0;
+
+	for(NSUInteger trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+		const uint32_t *trackChecksums = [[checksums objectAtIndex:trackIndex] bytes];
+		uint32_t checksum = trackChecksums[maximumOffsetInFrames];
+		uint32_t checksumV2 = *(const uint32_t *)[[checksumsV2 objectAtIndex:trackIndex] bytes];
+
+		NSMutableDictionary *trackReport = [NSMutableDictionary dictionary];
+
+		[trackReport setObject:[NSNumber numberWithUnsignedInteger:(trackIndex + 1)] forKey:kTrackNumberKey];
+		[trackReport setObject:[NSNumber numberWithUnsignedInteger:trackSectors[trackIndex].length] forKey:kTrackSectorCountKey];
+		[trackReport setObject:[NSNumber numberWithUnsignedInt:trackCRCs[trackIndex].CRC32] forKey:kTrackCRC32Key];
+		[trackReport setObject:[NSNumber numberWithUnsignedInt:trackCRCs[trackIndex].CRC32WithoutNullSamples] forKey:kTrackCRC32WithoutNullSamplesKey];
+		[trackReport setObject:[NSNumber numberWithUnsignedInt:checksum] forKey:kTrackAccurateRipChecksumKey];
+		[trackReport setObject:[NSNumber numberWithUnsignedInt:checksumV2] forKey:kTrackAccurateRipChecksumV2Key];
+
+		AccurateRipChecksumEntry match;
+		BOOL matchedV2 = NO;
+		NSInteger matchOffset = 0;
+		BOOL trackIsAccurate = NO;
+
+		if([checksumIndex findChecksum:checksumV2 forTrackNumber:(trackIndex + 1) match:&match])
+			trackIsAccurate = YES, matchedV2 = YES;
+		else if([checksumIndex findChecksum:checksum forTrackNumber:(trackIndex + 1) match:&match])
+			trackIsAccurate = YES;
+		else if(readOffset && [checksumIndex findChecksum:trackChecksums[maximumOffsetInFrames + readOffset] forTrackNumber:(trackIndex + 1) match:&match])
+			trackIsAccurate = YES, matchOffset = readOffset;
+
+		if(trackIsAccurate) {
+			[trackReport setObject:[NSNumber numberWithUnsignedInt:match.confidenceLevel] forKey:kTrackAccurateRipConfidenceLevelKey];
+			[trackReport setObject:[NSNumber numberWithInteger:matchOffset] forKey:kTrackAccurateRipOffsetKey];
+			[trackReport setObject:[NSNumber numberWithBool:matchedV2] forKey:kTrackAccurateRipMatchedV2Key];
+			++accurateTrackCount;
+		}
+
+		[trackReports addObject:trackReport];
+	}
+
+	free(trackSectors);
+
+	NSMutableDictionary *report = [NSMutableDictionary dictionary];
+
+	[report setObject:[files valueForKey:kFileURLKey] forKey:kAlbumURLsKey];
+	if(self.cueSheetURL)
+		[report setObject:self.cueSheetURL forKey:kAlbumCueSheetURLKey];
+	[report setObject:[[databaseCache relativePathForTrackCount:trackCount discID1:discID1 discID2:discID2 freeDBDiscID:freeDBDiscID] lastPathComponent] forKey:kAlbumAccurateRipDiscIDKey];
+	[report setObject:[NSNumber numberWithBool:(nil != checksumIndex)] forKey:kAlbumFoundInAccurateRipKey];
+	[report setObject:[NSNumber numberWithUnsignedInteger:checksumIndex.pressingCount] forKey:kAlbumPressingCountKey];
+	[report setObject:[NSNumber numberWithInteger:readOffset] forKey:kAlbumReadOffsetKey];
+	[report setObject:[NSNumber numberWithUnsignedInteger:accurateTrackCount] forKey:kAlbumAccurateTrackCountKey];
+	[report setObject:trackReports forKey:kAlbumTracksKey];
+
+	self.report = report;
+
+cleanup:
+	[sectorStore close];
+}
+
+@end
+
+@implementation AlbumVerificationOperation (Private)
+
+- (BOOL) appendAudioFromURL:(NSURL *)URL toSectorStore:(SectorStore *)sectorStore trackStartFrames:(const NSUInteger *)trackStartFrames trackCount:(NSUInteger)trackCount trackCRCs:(EACCRCContext *)trackCRCs error:(NSError **)error
+{
+	NSParameterAssert(nil != URL);
+	NSParameterAssert(nil != sectorStore);
+	NSParameterAssert(NULL != trackStartFrames);
+	NSParameterAssert(NULL != trackCRCs);
+
+	BOOL result = NO;
+	uint8_t *buffer = NULL;
+	ExtAudioFileRef file = NULL;
+
+	OSStatus status = ExtAudioFileOpenURL((CFURLRef)URL, &file);
+	if(noErr != status)
+		goto error;
+
+	// Audio that has been resampled or downmixed can't match
+	AudioStreamBasicDescription fileFormat;
+	UInt32 dataSize = (UInt32)sizeof(fileFormat);
+	status = ExtAudioFileGetProperty(file, kExtAudioFileProperty_FileDataFormat, &dataSize, &fileFormat);
+	if(noErr != status)
+		goto error;
+
+	if(CDDA_SAMPLE_RATE != fileFormat.mSampleRate || CDDA_CHANNELS_PER_FRAME != fileFormat.mChannelsPerFrame || (fileFormat.mBitsPerChannel && CDDA_BITS_PER_CHANNEL != fileFormat.mBitsPerChannel)) {
+		[[Logger sharedLogger] logMessage:@"%@ doesn't contain CD audio", [URL path]];
+		status = kAudioFileUnsupportedDataFormatError;
+		goto error;
+	}
+
+	// Decode to little endian CDDA
+	AudioStreamBasicDescription cddaFormat = getStreamDescriptionForCDDA();
+	status = ExtAudioFileSetProperty(file, kExtAudioFileProperty_ClientDataFormat, (UInt32)sizeof(cddaFormat), &cddaFormat);
+	if(noErr != status)
+		goto error;
+
+	buffer = malloc(kCDSectorSizeCDDA * SECTORS_PER_READ);
+	if(!buffer) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		goto cleanup;
+	}
+
+	AudioBufferList bufferList;
+	bufferList.mNumberBuffers = 1;
+	bufferList.mBuffers[0].mNumberChannels = CDDA_CHANNELS_PER_FRAME;
+
+	NSUInteger frame = sectorStore.sectorCount * AUDIO_FRAMES_PER_CDDA_SECTOR;
+	NSUInteger trackIndex = 0;
+
+	for(;;) {
+		if(self.isCancelled)
+			goto cleanup;
+
+		bufferList.mBuffers[0].mData = buffer;
+		bufferList.mBuffers[0].mDataByteSize = kCDSectorSizeCDDA * SECTORS_PER_READ;
+
+		UInt32 frameCount = AUDIO_FRAMES_PER_CDDA_SECTOR * SECTORS_PER_READ;
+		status = ExtAudioFileRead(file, &frameCount, &bufferList);
+		if(noErr != status)
+			goto error;
+
+		if(!frameCount)
+			break;
+
+		// Split the audio at track boundaries for the CRCs; audio preceding the first track isn't part of any track
+		NSUInteger lastFrame = frame + frameCount;
+		NSUInteger currentFrame = frame;
+		while(currentFrame < lastFrame) {
+			while(trackIndex + 1 < trackCount && trackStartFrames[trackIndex + 1] <= currentFrame)
+				++trackIndex;
+
+			NSUInteger segmentEnd = lastFrame;
+			if(trackIndex + 1 < trackCount)
+				segmentEnd = MIN(segmentEnd, trackStartFrames[trackIndex + 1]);
+
+			if(currentFrame < trackStartFrames[trackIndex])
+				segmentEnd = MIN(segmentEnd, trackStartFrames[trackIndex]);
+			else
+				eacCRCUpdate(&trackCRCs[trackIndex], buffer + ((currentFrame - frame) * cddaFormat.mBytesPerFrame), (segmentEnd - currentFrame) * cddaFormat.mBytesPerFrame);
+
+			currentFrame = segmentEnd;
+		}
+
+		if(![sectorStore appendAudio:buffer byteCount:(frameCount * cddaFormat.mBytesPerFrame) error:error])
+			goto cleanup;
+
+		frame = lastFrame;
+	}
+
+	// Files not ripped from CD may not contain whole sectors, so pad them with silence
+	if(frame % AUDIO_FRAMES_PER_CDDA_SECTOR) {
+		NSUInteger paddingFrames = AUDIO_FRAMES_PER_CDDA_SECTOR - (frame % AUDIO_FRAMES_PER_CDDA_SECTOR);
+
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"%@ doesn't contain whole sectors", [URL path]];
+
+		memset(buffer, 0, paddingFrames * cddaFormat.mBytesPerFrame);
+		if(![sectorStore appendAudio:buffer byteCount:(paddingFrames * cddaFormat.mBytesPerFrame) error:error])
+			goto cleanup;
+	}
+
+	result = YES;
+	goto cleanup;
+
+error:
+	if(error)
+		*error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:[NSDictionary dictionaryWithObject:[URL path] forKey:NSFilePathErrorKey]];
+
+cleanup:
+	if(file)
+		ExtAudioFileDispose(file);
+	free(buffer);
+
+	return result;
+}
+
+@end
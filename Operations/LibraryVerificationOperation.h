@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#import "AccurateRipDatabaseCache.h"
+
+// ========================================
+// An NSOperation subclass that verifies every album in a directory tree
+// against AccurateRip, writing a plain text report to reportURL
+// A directory containing cue sheets is treated as one album per cue sheet,
+// otherwise the audio files in a directory form an album, in file name order
+// Albums are verified concurrently (one AlbumVerificationOperation per album),
+// and reported in the order they appear in the library
+// ========================================
+@interface LibraryVerificationOperation : NSOperation
+{
+@private
+	NSURL *_libraryURL;
+	NSURL *_reportURL;
+	NSUInteger _maximumOffsetInSectors;
+	NSUInteger _maximumConcurrentAlbumCount;
+	eAccurateRipCachePolicy _cachePolicy;
+
+	NSUInteger _albumCount;
+	NSUInteger _albumsVerified;
+	NSUInteger _accurateAlbumCount;
+
+	NSError *_error;
+}
+
+// ========================================
+// The file extensions of the audio files considered part of an album
+// Only formats Core Audio always decodes are included, so FLAC files are skipped
++ (NSArray *) audioFileExtensions;
+
+// ========================================
+// Properties affecting verification
+@property (copy) NSURL * libraryURL;
+@property (copy) NSURL * reportURL;
+@property (assign) NSUInteger maximumOffsetInSectors;
+@property (assign) NSUInteger maximumConcurrentAlbumCount; // Defaults to the number of active processors
+@property (assign) eAccurateRipCachePolicy cachePolicy;
+
+// ========================================
+// Properties set during verification
+@property (readonly, assign) NSUInteger albumCount;
+@property (readonly, assign) NSUInteger albumsVerified;
+@property (readonly, assign) NSUInteger accurateAlbumCount;
+
+// ========================================
+// Properties set after verification is complete (or cancelled)
+@property (readonly, copy) NSError * error;
+
+@end
@@ -0,0 +1,239 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "LibraryVerificationOperation.h"
+#import "AlbumVerificationOperation.h"
+
+#import "Logger.h"
+
+// ========================================
+// Format the report for an album as plain text
+// ========================================
+static NSString *
+textForAlbumReport(AlbumVerificationOperation *operation)
+{
+	NSCParameterAssert(nil != operation);
+
+	NSMutableString *text = [NSMutableString string];
+	NSDictionary *report = operation.report;
+
+	if(operation.cueSheetURL)
+		[text appendFormat:@"%@\n", [operation.cueSheetURL path]];
+	else
+		[text appendFormat:@"%@\n", [[[operation.trackURLs objectAtIndex:0] path] stringByDeletingLastPathComponent]];
+
+	if(!report) {
+		[text appendFormat:@"  Unable to verify: %@\n\n", (operation.error ? [operation.error localizedDescription] : @"cancelled")];
+		return text;
+	}
+
+	NSArray *tracks = [report objectForKey:kAlbumTracksKey];
+
+	if([[report objectForKey:kAlbumFoundInAccurateRipKey] boolValue])
+		[text appendFormat:@"  %@: %@ pressing(s)\n", [report objectForKey:kAlbumAccurateRipDiscIDKey], [report objectForKey:kAlbumPressingCountKey]];
+	else if(operation.error)
+		[text appendFormat:@"  %@: %@\n", [report objectForKey:kAlbumAccurateRipDiscIDKey], [operation.error localizedDescription]];
+	else
+		[text appendFormat:@"  %@: not present in AccurateRip\n", [report objectForKey:kAlbumAccurateRipDiscIDKey]];
+
+	if([[report objectForKey:kAlbumReadOffsetKey] integerValue])
+		[text appendFormat:@"  Best matching offset: %+ld\n", (long)[[report objectForKey:kAlbumReadOffsetKey] integerValue]];
+
+	[text appendString:@"  Track  CRC32     CRC32 (skip)  AR v1     AR v2     Status\n"];
+
+	for(NSDictionary *track in tracks) {
+		NSString *status = nil;
+		NSNumber *confidenceLevel = [track objectForKey:kTrackAccurateRipConfidenceLevelKey];
+
+		if(!confidenceLevel)
+			status = ([[report objectForKey:kAlbumFoundInAccurateRipKey] boolValue] ? @"Not accurate" : @"Unknown");
+		else if([[track objectForKey:kTrackAccurateRipOffsetKey] integerValue])
+			status = [NSString stringWithFormat:@"Accurate at offset %+ld (confidence %@)", (long)[[track objectForKey:kTrackAccurateRipOffsetKey] integerValue], confidenceLevel];
+		else
+			status = [NSString stringWithFormat:@"Accurate%@ (confidence %@)", ([[track objectForKey:kTrackAccurateRipMatchedV2Key] boolValue] ? @" v2" : @""), confidenceLevel];
+
+		[text appendFormat:@"  %5u  %.8x  %.8x      %.8x  %.8x  %@\n",
+		 [[track objectForKey:kTrackNumberKey] unsignedIntValue],
+		 [[track objectForKey:kTrackCRC32Key] unsignedIntValue],
+		 [[track objectForKey:kTrackCRC32WithoutNullSamplesKey] unsignedIntValue],
+		 [[track objectForKey:kTrackAccurateRipChecksumKey] unsignedIntValue],
+		 [[track objectForKey:kTrackAccurateRipChecksumV2Key] unsignedIntValue],
+		 status];
+	}
+
+	[text appendFormat:@"  %@ of %u tracks accurate\n\n", [report objectForKey:kAlbumAccurateTrackCountKey], tracks.count];
+
+	return text;
+}
+
+// ========================================
+// Sort track files the way the Finder does, so "Track 10" follows "Track 9"
+// ========================================
+static NSInteger
+compareFileNames(id a, id b, void *context)
+{
+#pragma unused(context)
+	return [a compare:b options:(NSCaseInsensitiveSearch | NSNumericSearch)];
+}
+
+@interface LibraryVerificationOperation ()
+@property (assign) NSUInteger albumCount;
+@property (assign) NSUInteger albumsVerified;
+@property (assign) NSUInteger accurateAlbumCount;
+@property (copy) NSError * error;
+@end
+
+// ========================================
+// Private methods
+// ========================================
+@interface LibraryVerificationOperation (Private)
+- (NSArray *) albumVerificationOperations;
+@end
+
+@implementation LibraryVerificationOperation
+
+@synthesize libraryURL = _libraryURL;
+@synthesize reportURL = _reportURL;
+@synthesize maximumOffsetInSectors = _maximumOffsetInSectors;
+@synthesize maximumConcurrentAlbumCount = _maximumConcurrentAlbumCount;
+@synthesize cachePolicy = _cachePolicy;
+@synthesize albumCount = _albumCount;
+@synthesize albumsVerified = _albumsVerified;
+@synthesize accurateAlbumCount = _accurateAlbumCount;
+@synthesize error = _error;
+
++ (NSArray *) audioFileExtensions
+{
+	return [NSArray arrayWithObjects:@"wav", @"wave", @"aif", @"aiff", @"aifc", @"caf", @"m4a", nil];
+}
+
+- (id) init
+{
+	if((self = [super init])) {
+		self.maximumOffsetInSectors = 3;
+		self.maximumConcurrentAlbumCount = [[NSProcessInfo processInfo] activeProcessorCount];
+		self.cachePolicy = (eAccurateRipCachePolicy)[[NSUserDefaults standardUserDefaults] integerForKey:@"accurateRipCachePolicy"];
+	}
+	return self;
+}
+
+- (void) main
+{
+	NSAssert(nil != self.libraryURL, @"self.libraryURL may not be nil");
+	NSAssert(nil != self.reportURL, @"self.reportURL may not be nil");
+
+	NSArray *albumOperations = [self albumVerificationOperations];
+	self.albumCount = albumOperations.count;
+
+	[[Logger sharedLogger] logMessage:@"Verifying %u albums in %@", albumOperations.count, [self.libraryURL path]];
+
+	// The report is written as albums are verified, so nothing is lost if verification is interrupted
+	NSString *reportPath = [self.reportURL path];
+	if(![[NSFileManager defaultManager] createFileAtPath:reportPath contents:nil attributes:nil]) {
+		self.error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:[NSDictionary dictionaryWithObject:reportPath forKey:NSFilePathErrorKey]];
+		return;
+	}
+
+	NSFileHandle *reportFile = [NSFileHandle fileHandleForWritingAtPath:reportPath];
+	[reportFile writeData:[[NSString stringWithFormat:@"AccurateRip verification of %@\n\n", [self.libraryURL path]] dataUsingEncoding:NSUTF8StringEncoding]];
+
+	// Each album is decoded and verified independently, so verification scales with the number of processors
+	NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+	[queue setMaxConcurrentOperationCount:MAX(self.maximumConcurrentAlbumCount, 1U)];
+	[queue addOperations:albumOperations waitUntilFinished:NO];
+
+	for(AlbumVerificationOperation *albumOperation in albumOperations) {
+		if(self.isCancelled) {
+			[queue cancelAllOperations];
+			break;
+		}
+
+		[albumOperation waitUntilFinished];
+
+		NSDictionary *report = albumOperation.report;
+		NSNumber *accurateTrackCount = [report objectForKey:kAlbumAccurateTrackCountKey];
+		if(report && accurateTrackCount.unsignedIntegerValue == [[report objectForKey:kAlbumTracksKey] count])
+			self.accurateAlbumCount = self.accurateAlbumCount + 1;
+
+		[reportFile writeData:[textForAlbumReport(albumOperation) dataUsingEncoding:NSUTF8StringEncoding]];
+
+		self.albumsVerified = self.albumsVerified + 1;
+	}
+
+	[queue waitUntilAllOperationsAreFinished];
+
+	[reportFile writeData:[[NSString stringWithFormat:@"%u of %u albums accurate\n", self.accurateAlbumCount, self.albumCount] dataUsingEncoding:NSUTF8StringEncoding]];
+	[reportFile closeFile];
+
+	[[Logger sharedLogger] logMessage:@"%u of %u albums accurate", self.accurateAlbumCount, self.albumCount];
+}
+
+@end
+
+@implementation LibraryVerificationOperation (Private)
+
+- (NSArray *) albumVerificationOperations
+{
+	NSString *libraryPath = [self.libraryURL path];
+	NSArray *audioFileExtensions = [LibraryVerificationOperation audioFileExtensions];
+
+	// Group the files of interest by directory
+	NSMutableDictionary *directoryContents = [NSMutableDictionary dictionary];
+	NSDirectoryEnumerator *directoryEnumerator = [[NSFileManager defaultManager] enumeratorAtPath:libraryPath];
+
+	NSString *path = nil;
+	while((path = [directoryEnumerator nextObject])) {
+		NSString *pathExtension = [[path pathExtension] lowercaseString];
+		if(![pathExtension isEqualToString:@"cue"] && ![audioFileExtensions containsObject:pathExtension])
+			continue;
+
+		NSString *directory = [path stringByDeletingLastPathComponent];
+		NSMutableArray *files = [directoryContents objectForKey:directory];
+		if(!files) {
+			files = [NSMutableArray array];
+			[directoryContents setObject:files forKey:directory];
+		}
+
+		[files addObject:[libraryPath stringByAppendingPathComponent:path]];
+	}
+
+	NSMutableArray *albumOperations = [NSMutableArray array];
+
+	for(NSString *directory in [[directoryContents allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+		NSArray *files = [[directoryContents objectForKey:directory] sortedArrayUsingFunction:compareFileNames context:NULL];
+
+		NSArray *cueSheets = [files filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"pathExtension ==[c] 'cue'"]];
+
+		// Cue sheets describe the album (including the gaps between tracks) better than the files alone
+		if(cueSheets.count) {
+			for(NSString *cueSheet in cueSheets) {
+				AlbumVerificationOperation *albumOperation = [[AlbumVerificationOperation alloc] init];
+
+				albumOperation.cueSheetURL = [NSURL fileURLWithPath:cueSheet];
+				albumOperation.maximumOffsetInSectors = self.maximumOffsetInSectors;
+				albumOperation.cachePolicy = self.cachePolicy;
+
+				[albumOperations addObject:albumOperation];
+			}
+		}
+		else {
+			NSMutableArray *trackURLs = [NSMutableArray array];
+			for(NSString *file in files)
+				[trackURLs addObject:[NSURL fileURLWithPath:file]];
+
+			AlbumVerificationOperation *albumOperation = [[AlbumVerificationOperation alloc] init];
+
+			albumOperation.trackURLs = trackURLs;
+			albumOperation.maximumOffsetInSectors = self.maximumOffsetInSectors;
+			albumOperation.cachePolicy = self.cachePolicy;
+
+			[albumOperations addObject:albumOperation];
+		}
+	}
+
+	return albumOperations;
+}
+
+@end
@@ -6,78 +6,66 @@
 #import "PregapDetectionOperation.h"
 #import "SectorRange.h"
 #import "Drive.h"
+#import "QSubchannelUtilities.h"
 #import "CompactDisc.h"
 #import "SessionDescriptor.h"
 #import "TrackDescriptor.h"
 #import "ApplicationDelegate.h"
+#import "Logger.h"
 
-// The typical pregap is 2 seconds, or 150 sectors
-#define BUFFER_SIZE_IN_SECTORS 150u
+// The typical pregap is 2 seconds, or 150 sectors, so the backward search starts with steps of this size
+#define INITIAL_SEARCH_STEP_IN_SECTORS		150
 
-#pragma pack(push, 1)                        /* (enable 8-bit struct packing) */
+// The number of sectors on each side of a boundary read to confirm it
+#define CONFIRMATION_SECTORS				8
+
+// The number of nearby sectors tried when a sector's Q is unreadable
+#define MAXIMUM_PROBE_ATTEMPTS				5
+
+// The number of times the search is repeated when the confirmation disagrees with it
+#define MAXIMUM_SEARCH_ATTEMPTS				3
 
 // ========================================
-// Q subchannel data format
+// Where a sector lies relative to the pregap being searched for
 // ========================================
-struct QSubChannelData {
-#ifdef __LITTLE_ENDIAN__
-	UInt8 adr:4;
-	UInt8 control:4;
-#else /* !__LITTLE_ENDIAN__ */
-	UInt8 control:4;
-	UInt8 adr:4;
-#endif /* !__LITTLE_ENDIAN__ */
-	UInt8 tno;
-	UInt8 index;
-	CDMSF msf;
-	UInt8 zero;
-	CDMSF amsf;
-	UInt16 crc;
-	UInt16 pad;
-	UInt8 pad2;
-#ifdef __LITTLE_ENDIAN__
-	UInt8 zero2:7;
-	UInt8 p:1;
-#else /* !__LITTLE_ENDIAN__ */
-	UInt8 p:1;
-	UInt8 zero2:7;
-#endif /* !__LITTLE_ENDIAN__ */
+enum _eSectorPosition {
+	eSectorPositionUnknown		= -1,	// The Q couldn't be read or doesn't describe the position
+	eSectorPositionBeforePregap	= 0,
+	eSectorPositionInPregap		= 1
 };
-
-#pragma pack(pop)                        /* (reset to default struct packing) */
+typedef enum _eSectorPosition eSectorPosition;
 
 // ========================================
-// Utility functions for dealing with BCD values
+// Determine from a sector's Q where it lies relative to the pregap of trackNumber
+// The pregap is encoded as index 0 with the subsequent track number
 // ========================================
-static UInt8
-convertBCDToDecimal(UInt8 bcdValue)
+static eSectorPosition
+positionForQSubchannelFrame(const QSubchannelFrame *frame, NSUInteger trackNumber)
 {
-	UInt8 highNibble = 0x0F & (bcdValue >> 4);
-	UInt8 lowNibble = 0x0F & bcdValue;
+	NSCParameterAssert(NULL != frame);
 	
-	return (10 * highNibble) + lowNibble;
-}
-
-static void
-convertQSubChannelDataFromBCDToDecimal(struct QSubChannelData *qData)
-{
-	NSCParameterAssert(NULL != qData);
-	
-	// Convert BCD to decimal representation
-	qData->tno = convertBCDToDecimal(qData->tno);
-	qData->index = convertBCDToDecimal(qData->index);
-	qData->msf.minute = convertBCDToDecimal(qData->msf.minute);
-	qData->msf.second = convertBCDToDecimal(qData->msf.second);
-	qData->msf.frame = convertBCDToDecimal(qData->msf.frame);
-	qData->amsf.minute = convertBCDToDecimal(qData->amsf.minute);
-	qData->amsf.second = convertBCDToDecimal(qData->amsf.second);
-	qData->amsf.frame = convertBCDToDecimal(qData->amsf.frame);
+	if(!(eQSubchannelFramePositionIsValid & frame->flags))
+		return eSectorPositionUnknown;
+	
+	if(trackNumber == frame->trackNumber && 0 == frame->index)
+		return eSectorPositionInPregap;
+	else if(trackNumber - 1 == frame->trackNumber)
+		return eSectorPositionBeforePregap;
+	else
+		return eSectorPositionUnknown;
 }
 
 @interface PregapDetectionOperation ()
 @property (copy) NSError * error;
 @end
 
+// ========================================
+// Private methods
+// ========================================
+@interface PregapDetectionOperation (Private)
+- (eSectorPosition) probeSector:(NSInteger *)sector trackNumber:(NSUInteger)trackNumber firstSector:(NSInteger)firstSector lastSector:(NSInteger)lastSector drive:(Drive *)drive;
+@end
+
 @implementation PregapDetectionOperation
 
 @synthesize disk = _disk;
@@ -138,101 +126,122 @@ convertQSubChannelDataFromBCDToDecimal(struct QSubChannelData *qData)
 		return;
 	}
 	
-	// Allocate the extraction buffers
-	__strong int8_t *buffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * (kCDSectorSizeCDDA + kCDSectorSizeQSubchannel), 0);
-	__strong int8_t *qBuffer = NSAllocateCollectable(BUFFER_SIZE_IN_SECTORS * kCDSectorSizeQSubchannel, 0);
-	int8_t *alias = NULL;
-	struct QSubChannelData *qData = NULL;
-
-	if(NULL == buffer || NULL == qBuffer) {
-		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
-		goto cleanup;
-	}
-	
-	
 	// Store the sector range delineating the track holding the pregap
 	TrackDescriptor *trackToScan = [track.session trackNumber:(track.number.unsignedIntegerValue - 1)];
 	
-	NSUInteger firstSector = trackToScan.firstSector.unsignedIntegerValue;
-	NSUInteger lastSector = trackToScan.lastSector.unsignedIntegerValue;
-		
+	NSInteger firstSector = trackToScan.firstSector.integerValue;
+	NSInteger lastSector = trackToScan.lastSector.integerValue;
+	NSUInteger trackNumber = track.number.unsignedIntegerValue;
+	
 	// ========================================
-	// ITERATIVELY EXTRACT AND SCAN MODE-1 Q
-
-	// Since the pregap for a track is located at the end of the preceding track, perform a backwards search
-	NSUInteger startSector = lastSector;
-	NSUInteger pregapStart = 0;
+	// BINARY SEARCH USING MODE-1 Q
 	
-	NSUInteger sectorsRemaining = lastSector - firstSector + 1;
-	while(0 < sectorsRemaining) {
-		NSUInteger sectorCount = MIN(BUFFER_SIZE_IN_SECTORS, sectorsRemaining);
-		
-		SectorRange *readRange = [SectorRange sectorRangeWithLastSector:startSector sectorCount:sectorCount];
-		NSUInteger sectorsRead = [drive readAudioAndQSubchannel:buffer sectorRange:readRange];
+	// Since the pregap lies at the end of the preceding track, the sectors in it are a suffix of that track
+	// The search maintains the invariant that sectors <= before aren't in the pregap and sectors >= after are
+	// (the sectors on either side of the track are treated as known)
+	NSInteger before = firstSector - 1;
+	NSInteger after = lastSector + 1;
+	NSUInteger searchAttempt = 0;
+	
+	for(;;) {
+		// Most tracks have no pregap or a short one, so search backwards in growing steps from the end of the track
+		// to bracket the boundary before bisecting
+		NSInteger step = 1;
+		while(before + 1 < after && after - step > before) {
+			NSInteger sector = after - step;
+			eSectorPosition position = [self probeSector:&sector trackNumber:trackNumber firstSector:(before + 1) lastSector:(after - 1) drive:drive];
+			
+			if(self.isCancelled)
+				goto cleanup;
+			else if(eSectorPositionInPregap == position)
+				after = sector;
+			else if(eSectorPositionBeforePregap == position) {
+				before = sector;
+				break;
+			}
+			else
+				break;
+			
+			step = (1 == step ? INITIAL_SEARCH_STEP_IN_SECTORS : 2 * step);
+		}
 		
-		// Verify the requested sectors were read
-		if(0 == sectorsRead) {
-			self.error = drive.error;
-			goto cleanup;
+		while(before + 1 < after) {
+			NSInteger sector = before + ((after - before) / 2);
+			eSectorPosition position = [self probeSector:&sector trackNumber:trackNumber firstSector:(before + 1) lastSector:(after - 1) drive:drive];
+			
+			if(self.isCancelled)
+				goto cleanup;
+			else if(eSectorPositionInPregap == position)
+				after = sector;
+			else if(eSectorPositionBeforePregap == position)
+				before = sector;
+			// If none of the Q near the midpoint is readable there is nothing more to learn from this range
+			else
+				break;
 		}
-		else if(sectorsRead != sectorCount) {
-			self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+		
+		// ========================================
+		// CONFIRM THE BOUNDARY
+		
+		// The boundary is confirmed by reading the sectors around it, which also resolves boundaries the search couldn't
+		// narrow because of unreadable Q
+		// A probe may also have been misled by a Q that passed its CRC by chance, in which case the search is repeated
+		NSInteger confirmationStart = MAX(firstSector, after - CONFIRMATION_SECTORS);
+		NSInteger confirmationEnd = MIN(lastSector, after + CONFIRMATION_SECTORS - 1);
+		
+		uint8_t qBuffer [2 * CONFIRMATION_SECTORS * kCDSectorSizeQSubchannel];
+		NSUInteger sectorCount = (NSUInteger)(confirmationEnd - confirmationStart + 1);
+		
+		NSUInteger sectorsRead = [drive readQSubchannel:qBuffer startSector:(NSUInteger)confirmationStart sectorCount:sectorCount];
+		if(sectorsRead != sectorCount) {
+			self.error = (sectorsRead ? [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil] : drive.error);
 			goto cleanup;
 		}
 		
-		// Copy the q data to its buffer and convert from BCD representation to decimal
+		NSInteger lastSectorBeforePregap = (confirmationStart == firstSector ? firstSector - 1 : NSIntegerMin);
+		NSInteger firstSectorInPregap = (confirmationEnd == lastSector ? lastSector + 1 : NSIntegerMax);
+		
+		QSubchannelFrame frames [2 * CONFIRMATION_SECTORS];
+		decodeQSubchannelFrames(qBuffer, kCDSectorSizeQSubchannel, sectorsRead, frames);
+		
 		for(NSUInteger i = 0; i < sectorsRead; ++i) {
-			alias = buffer + (i * (kCDSectorSizeCDDA + kCDSectorSizeQSubchannel));
-			
-			// Convert from BCD to decimal representation
-			convertQSubChannelDataFromBCDToDecimal((struct QSubChannelData *)(alias + kCDSectorSizeCDDA));
+			NSInteger sector = confirmationStart + (NSInteger)i;
+			eSectorPosition position = positionForQSubchannelFrame(&frames[i], trackNumber);
 			
-			memcpy(qBuffer + (i * kCDSectorSizeQSubchannel), alias + kCDSectorSizeCDDA, kCDSectorSizeQSubchannel);
+			if(eSectorPositionBeforePregap == position)
+				lastSectorBeforePregap = MAX(lastSectorBeforePregap, sector);
+			else if(eSectorPositionInPregap == position)
+				firstSectorInPregap = MIN(firstSectorInPregap, sector);
 		}
 		
-		// Loop through the Mode-1 Q and look for the start of the pregap
-		for(NSUInteger i = 0; i < sectorsRead; ++i) {
-			qData = (struct QSubChannelData *)(qBuffer + (i * kCDSectorSizeQSubchannel));
-			
-			// Ignore everything except Mode-1 Q in the program area (AKA current position Q)
-			if(0x1 != qData->adr)
-				continue;
-			
-			// Sanity check
-			if(0 != qData->zero) {
-#if DEBUG
-				NSLog(@"Mode-1 Q error: 8 bits of zero missing for sector %i", readRange.firstSector + i);
-#endif
-				continue;
-			}
+		BOOL searchWasMisled = (lastSectorBeforePregap >= after || firstSectorInPregap <= before);
+		
+		if(!searchWasMisled) {
+			before = MAX(before, lastSectorBeforePregap);
+			after = MIN(after, firstSectorInPregap);
 			
-			// The pregap is encoded as index 0 with the subsequent track number
-			if(1 + trackToScan.number.unsignedIntegerValue == qData->tno && 0 == qData->index) {
-				pregapStart = readRange.firstSector + i;
+			if(before + 1 == after)
 				break;
-			}
 		}
 		
-		// If no pregap was found, stop looking since this is a backwards search
-		if(0 == pregapStart)
-			break;
-		// If the pregap was found, ensure that the entirety was accounted for
-		else if(pregapStart != readRange.firstSector)
+		if(MAXIMUM_SEARCH_ATTEMPTS == ++searchAttempt) {
+			[[Logger sharedLogger] logMessage:@"Unable to confirm the pregap for track %u from the Q sub-channel", trackNumber];
 			break;
+		}
 		
-		// Housekeeping
-		sectorsRemaining -= sectorsRead;
-		startSector -= sectorsRead;
-
-		// Stop if requested
-		if(self.isCancelled)
-			goto cleanup;
+		if(searchWasMisled) {
+			if(lastSectorBeforePregap >= after) {
+				before = lastSectorBeforePregap;
+				after = lastSector + 1;
+			}
+			else {
+				before = firstSector - 1;
+				after = firstSectorInPregap;
+			}
+		}
 	}
-
-	if(0 != pregapStart)
-		track.pregap = [NSNumber numberWithUnsignedInteger:(lastSector - pregapStart + 1)];
-	else
-		track.pregap = [NSNumber numberWithUnsignedInteger:0];
+	
+	track.pregap = [NSNumber numberWithUnsignedInteger:(NSUInteger)(lastSector + 1 - after)];
 	
 	// Save the changes
 	if(managedObjectContext.hasChanges) {
@@ -251,3 +260,39 @@ cleanup:
 }
 
 @end
+
+@implementation PregapDetectionOperation (Private)
+
+- (eSectorPosition) probeSector:(NSInteger *)sector trackNumber:(NSUInteger)trackNumber firstSector:(NSInteger)firstSector lastSector:(NSInteger)lastSector drive:(Drive *)drive
+{
+	NSParameterAssert(NULL != sector);
+	NSParameterAssert(nil != drive);
+	
+	uint8_t qData [kCDSectorSizeQSubchannel];
+	QSubchannelFrame frame;
+	NSInteger requestedSector = *sector;
+	
+	// If the sector's Q is unusable, try the sectors alternately before and after it
+	for(NSUInteger attempt = 0; attempt < MAXIMUM_PROBE_ATTEMPTS; ++attempt) {
+		NSInteger distance = (NSInteger)((attempt + 1) / 2);
+		NSInteger sectorToRead = (attempt % 2 ? requestedSector - distance : requestedSector + distance);
+		
+		if(sectorToRead < firstSector || sectorToRead > lastSector)
+			continue;
+		
+		if(1 != [drive readQSubchannel:qData sector:(NSUInteger)sectorToRead])
+			continue;
+		
+		decodeQSubchannelFrames(qData, kCDSectorSizeQSubchannel, 1, &frame);
+		
+		eSectorPosition position = positionForQSubchannelFrame(&frame, trackNumber);
+		if(eSectorPositionUnknown != position) {
+			*sector = sectorToRead;
+			return position;
+		}
+	}
+	
+	return eSectorPositionUnknown;
+}
+
+@end
@@ -5,16 +5,19 @@
 
 #import <Cocoa/Cocoa.h>
 
+@class SectorStore;
+
 // ========================================
 // KVC key names for the read offset dictionaries
 // ========================================
 extern NSString * const		kReadOffsetKey; // NSNumber *, in sample frames
 extern NSString * const		kConfidenceLevelKey; // NSNumber *
 extern NSString * const		kAccurateRipTrackIDKey; // NSManagedObjectID * for an AccurateRipTrackDescriptor *
+extern NSString * const		kMatchingTrackCountKey; // NSNumber *, the number of tracks matched when results are combined
 
 // ========================================
 // An NSOperation subclass which uses AccurateRip data to detect extracted audio's read offset
-// URL is assumed to point to a file containing CDDA audio with the six second
+// sectorStore is assumed to contain CDDA audio with the six second
 // point of the track to check occurring at sixSecondPoint
 // Offsets ranging from  -maximumOffsetToCheck to +maximumOffsetToCheck will be
 // checked
@@ -26,7 +29,7 @@ extern NSString * const		kAccurateRipTrackIDKey; // NSManagedObjectID * for an A
 @interface ReadOffsetCalculationOperation : NSOperation
 {
 @private
-	NSURL *_URL;
+	SectorStore *_sectorStore;
 	NSManagedObjectID *_trackID;
 	NSUInteger _sixSecondPointSector;
 	NSUInteger _maximumOffsetToCheck;
@@ -39,7 +42,7 @@ extern NSString * const		kAccurateRipTrackIDKey; // NSManagedObjectID * for an A
 
 // ========================================
 // Properties affecting scanning
-@property (copy) NSURL * URL;
+@property (assign) SectorStore * sectorStore;
 @property (copy) NSManagedObjectID * trackID;
 @property (assign) NSUInteger sixSecondPointSector; // In CDDA sectors
 @property (assign) NSUInteger maximumOffsetToCheck; // In sample frames,  should be a multiple of AUDIO_FRAMES_PER_CDDA_SECTOR
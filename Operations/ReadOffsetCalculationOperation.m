@@ -24,6 +24,7 @@
 NSString * const	kReadOffsetKey							= @"readOffset";
 NSString * const	kConfidenceLevelKey						= @"confidenceLevel";
 NSString * const	kAccurateRipTrackIDKey					= @"accurateRipTrackID";
+NSString * const	kMatchingTrackCountKey					= @"matchingTrackCount";
 
 @interface ReadOffsetCalculationOperation ()
 @property (copy) NSError * error;
@@ -33,7 +34,7 @@ NSString * const	kAccurateRipTrackIDKey					= @"accurateRipTrackID";
 
 @implementation ReadOffsetCalculationOperation
 
-@synthesize URL = _URL;
+@synthesize sectorStore = _sectorStore;
 @synthesize trackID = _trackID;
 @synthesize sixSecondPointSector = _sixSecondPointSector;
 @synthesize maximumOffsetToCheck = _maximumOffsetToCheck;
@@ -43,7 +44,7 @@ NSString * const	kAccurateRipTrackIDKey					= @"accurateRipTrackID";
 
 - (void) main
 {
-	NSParameterAssert(nil != self.URL);
+	NSParameterAssert(nil != self.sectorStore);
 	NSParameterAssert(nil != self.trackID);
 	
 	// Create our own context for accessing the store
@@ -58,11 +59,11 @@ NSString * const	kAccurateRipTrackIDKey					= @"accurateRipTrackID";
 	}
 	
 	// Attempt to calculate the drive's offset using AccurateRip offset checksums
-	// The offset checksum is the checksum for one single frame of audio starting at exactly six
+	// The offset checksum is the checksum for one single sector of audio starting at exactly six
 	// seconds into the track
 	
-	// We will accomplish this by calculating AccurateRip checksums for the specified track using
-	// different read offsets until a match is found
+	// We will accomplish this by calculating AccurateRip offset checksums for the specified track at
+	// every read offset in a single pass, and looking each one up in the pressings' offset checksums
 	TrackDescriptor *trackDescriptor = (TrackDescriptor *)managedObject;	
 	
 	if(!trackDescriptor) {
@@ -70,51 +71,52 @@ NSString * const	kAccurateRipTrackIDKey					= @"accurateRipTrackID";
 		return;
 	}
 
+	// Gather the offset checksums for this track from all the pressings that were found in AccurateRip
+	NSMutableDictionary *accurateRipTracksByOffsetChecksum = [NSMutableDictionary dictionary];
+	for(AccurateRipDiscRecord *accurateRipDisc in trackDescriptor.session.disc.accurateRipDiscs) {
+		AccurateRipTrackRecord *accurateRipTrack = [accurateRipDisc trackNumber:[trackDescriptor.number unsignedIntegerValue]];
+		
+		// If the track wasn't found or doesn't contain an offset checksum, it can't be used
+		if(!accurateRipTrack || !accurateRipTrack.offsetChecksum)
+			continue;
+		
+		NSNumber *offsetChecksum = [NSNumber numberWithUnsignedInt:accurateRipTrack.offsetChecksum.unsignedIntValue];
+		NSMutableArray *accurateRipTracks = [accurateRipTracksByOffsetChecksum objectForKey:offsetChecksum];
+		if(!accurateRipTracks) {
+			accurateRipTracks = [NSMutableArray array];
+			[accurateRipTracksByOffsetChecksum setObject:accurateRipTracks forKey:offsetChecksum];
+		}
+		
+		[accurateRipTracks addObject:accurateRipTrack];
+	}
+	
 	NSMutableArray *possibleReadOffsets = [NSMutableArray array];
 	
-	// Adjust the starting sector in the file
-	NSRange singleSectorRange = NSMakeRange(self.sixSecondPointSector, 1);
+	// Calculate the AccurateRip offset checksums for this track at every offset
+	NSData *offsetChecksumsData = nil;
+	if(accurateRipTracksByOffsetChecksum.count && !self.isCancelled)
+		offsetChecksumsData = calculateAccurateRipOffsetChecksumsForSectorStore(self.sectorStore, self.sixSecondPointSector, self.maximumOffsetToCheck);
 	
-	NSInteger firstOffsetToTry = -1 * self.maximumOffsetToCheck;
-	NSInteger lastOffsetToTry = self.maximumOffsetToCheck;
-	for(NSInteger currentOffset = firstOffsetToTry; currentOffset <= lastOffsetToTry; ++currentOffset) {
-
-		// Allow cancellation
-		if(self.isCancelled)
-			break;
-		
-		// Calculate the AccurateRip checksum for this track with the specified offset
-		uint32_t trackActualOffsetChecksum = calculateAccurateRipChecksumForFileRegionUsingOffset(self.URL, 
-																								  singleSectorRange,
-																								  NO,
-																								  NO,
-																								  currentOffset);
+	// The checksums are arranged in the array from [-maximumOffsetToCheck, +maximumOffsetToCheck]
+	const uint32_t *offsetChecksums = [offsetChecksumsData bytes];
+	NSUInteger offsetChecksumsCount = [offsetChecksumsData length] / sizeof(uint32_t);
+	
+	for(NSUInteger offsetIndex = 0; offsetIndex < offsetChecksumsCount; ++offsetIndex) {
+		NSArray *accurateRipTracks = [accurateRipTracksByOffsetChecksum objectForKey:[NSNumber numberWithUnsignedInt:offsetChecksums[offsetIndex]]];
 		
-		// Check all the pressings that were found in AccurateRip for matching checksums
-		for(AccurateRipDiscRecord *accurateRipDisc in trackDescriptor.session.disc.accurateRipDiscs) {
-			
-			// Determine what AccurateRip checksum we are attempting to match
-			AccurateRipTrackRecord *accurateRipTrack = [accurateRipDisc trackNumber:[trackDescriptor.number unsignedIntegerValue]];
+		for(AccurateRipTrackRecord *accurateRipTrack in accurateRipTracks) {
+			NSDictionary *offsetDictionary = [NSDictionary dictionaryWithObjectsAndKeys:
+											  [NSNumber numberWithInteger:((NSInteger)offsetIndex - (NSInteger)self.maximumOffsetToCheck)], kReadOffsetKey,
+											  accurateRipTrack.confidenceLevel, kConfidenceLevelKey,
+											  [accurateRipTrack objectID], kAccurateRipTrackIDKey,
+											  nil];
 			
-			// If the track wasn't found or doesn't contain an offset checksum, it can't be used
-			if(!accurateRipTrack || !accurateRipTrack.offsetChecksum)
-				continue;
-
-			if([accurateRipTrack.offsetChecksum unsignedIntegerValue] == trackActualOffsetChecksum) {
-				NSDictionary *offsetDictionary = [NSDictionary dictionaryWithObjectsAndKeys:
-												  [NSNumber numberWithInteger:currentOffset], kReadOffsetKey,
-												  accurateRipTrack.confidenceLevel, kConfidenceLevelKey,
-												  [accurateRipTrack objectID], kAccurateRipTrackIDKey,
-												  nil];
-				
-				[possibleReadOffsets addObject:offsetDictionary];
-			}
+			[possibleReadOffsets addObject:offsetDictionary];
 		}
-
-		// Update progress
-		self.fractionComplete = fabsf((float)(firstOffsetToTry - currentOffset)) / (float)(lastOffsetToTry - firstOffsetToTry);
 	}
 	
+	self.fractionComplete = 1;
+	
 	// Sort the possible read offsets by confidence level
 	if(possibleReadOffsets.count) {
 		NSSortDescriptor *confidenceLevelSortDescriptor = [[NSSortDescriptor alloc] initWithKey:kConfidenceLevelKey ascending:NO];
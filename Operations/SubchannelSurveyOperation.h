@@ -0,0 +1,46 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#include <DiskArbitration/DiskArbitration.h>
+
+@class DriveSession;
+
+// ========================================
+// An NSOperation subclass that surveys the Q sub-channel of the first session
+// of a compact disc in a single pass, collecting the MCN, the ISRC, pregap and
+// index points of every track
+// The device is opened once and the tracks are visited in LBA order; only
+// Q is read, a window of sectors per track for the MCN and ISRCs and a
+// bisection over (track, index) for the boundaries
+// All track descriptors are updated and saved together when the survey completes
+// If session is set its drive, which must be open, is used instead, and the session is
+// locked while each track is surveyed
+// ========================================
+@interface SubchannelSurveyOperation : NSOperation
+{
+@private
+	__strong DADiskRef _disk;		// The DADiskRef holding the CD to survey
+	DriveSession *_session;			// The session whose drive is used, if any
+
+	NSDictionary *_indexPoints;		// Track number -> NSArray of the first sector of each index >= 1
+	NSError *_error;				// Holds the first error (if any) occurring during the survey
+}
+
+// ========================================
+// Properties affecting the survey
+@property (assign) DADiskRef disk;
+@property (assign) DriveSession * session;
+
+// ========================================
+// Properties set after the survey is complete (or cancelled)
+@property (readonly, copy) NSDictionary * indexPoints;
+@property (readonly, copy) NSError * error;
+
+// ========================================
+// Initialization
+- (id) initWithDADiskRef:(DADiskRef)disk;
+
+@end
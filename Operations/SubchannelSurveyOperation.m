@@ -0,0 +1,470 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "SubchannelSurveyOperation.h"
+#import "Drive.h"
+#import "DriveSession.h"
+#import "QSubchannelUtilities.h"
+#import "CompactDisc.h"
+#import "SessionDescriptor.h"
+#import "TrackDescriptor.h"
+#import "TrackMetadata.h"
+#import "AlbumMetadata.h"
+#import "DiscIdentityCache.h"
+#import "ApplicationDelegate.h"
+#import "Logger.h"
+
+// The MCN and each ISRC must appear at least once in every 100 consecutive Q frames
+#define IDENTIFIER_WINDOW_SECTORS			100
+
+// Ranges this narrow are read in full, along with this many sectors on each side, to place their boundaries
+#define CONFIRMATION_SECTORS				8
+
+// The number of nearby sectors tried when a sector's Q is unreadable
+#define MAXIMUM_PROBE_ATTEMPTS				5
+
+// The key used for sectors whose Q couldn't be read or doesn't describe the position
+#define UNKNOWN_POSITION					-1
+
+// ========================================
+// Mode-1 Q in the program area gives the position as (track, index), which never decreases
+// with the LBA, so it is folded into a single ordered key
+// ========================================
+static NSInteger
+positionKeyForQSubchannelFrame(const QSubchannelFrame *frame)
+{
+	NSCParameterAssert(NULL != frame);
+
+	if(!(eQSubchannelFramePositionIsValid & frame->flags) || 1 > frame->trackNumber || 99 < frame->trackNumber)
+		return UNKNOWN_POSITION;
+
+	return (100 * frame->trackNumber) + frame->index;
+}
+
+// ========================================
+// Return the identifier seen most often, to outvote any frame that passed its CRC by chance
+// ========================================
+static NSString *
+mostFrequentObject(NSCountedSet *set)
+{
+	NSString *result = nil;
+	NSUInteger resultCount = 0;
+
+	for(NSString *object in set) {
+		NSUInteger count = [set countForObject:object];
+		if(count > resultCount) {
+			result = object;
+			resultCount = count;
+		}
+	}
+
+	return result;
+}
+
+@interface SubchannelSurveyOperation ()
+@property (copy) NSDictionary * indexPoints;
+@property (copy) NSError * error;
+@end
+
+// ========================================
+// Private methods
+// ========================================
+@interface SubchannelSurveyOperation (Private)
+- (NSInteger) probeSector:(NSInteger *)sector firstSector:(NSInteger)firstSector lastSector:(NSInteger)lastSector drive:(Drive *)drive;
+- (BOOL) findBoundariesFromSector:(NSInteger)lowSector key:(NSInteger)lowKey toSector:(NSInteger)highSector key:(NSInteger)highKey drive:(Drive *)drive boundaries:(NSMutableDictionary *)boundaries;
+- (BOOL) resolveBoundariesFromSector:(NSInteger)lowSector key:(NSInteger)lowKey toSector:(NSInteger)highSector key:(NSInteger)highKey drive:(Drive *)drive boundaries:(NSMutableDictionary *)boundaries;
+@end
+
+@implementation SubchannelSurveyOperation
+
+@synthesize disk = _disk;
+@synthesize session = _session;
+@synthesize indexPoints = _indexPoints;
+@synthesize error = _error;
+
+- (id) initWithDADiskRef:(DADiskRef)disk
+{
+	NSParameterAssert(NULL != disk);
+
+	if((self = [super init]))
+		self.disk = disk;
+	return self;
+}
+
+- (void) main
+{
+	NSAssert(NULL != self.disk, @"self.disk may not be NULL");
+
+	// Create our own context for accessing the store
+	NSManagedObjectContext *managedObjectContext = [[NSManagedObjectContext alloc] init];
+	[managedObjectContext setPersistentStoreCoordinator:[(ApplicationDelegate *)[[NSApplication sharedApplication] delegate] persistentStoreCoordinator]];
+
+	// Fetch the compact disc object
+	CompactDisc *disc = [CompactDisc compactDiscWithDADiskRef:self.disk inManagedObjectContext:managedObjectContext];
+
+	NSSortDescriptor *trackNumberSortDescriptor = [[NSSortDescriptor alloc] initWithKey:@"number" ascending:YES];
+	NSArray *tracks = [disc.firstSession.tracks.allObjects sortedArrayUsingDescriptors:[NSArray arrayWithObject:trackNumberSortDescriptor]];
+
+	// ========================================
+	// GENERAL SETUP
+
+	// Open the CD media for reading, or use the session's drive, which is already open
+	// The session is only locked while a track is being surveyed, so others sharing it can use the drive in between
+	Drive *drive = nil;
+	if(self.session) {
+		drive = self.session.drive;
+
+		[self.session lock];
+		BOOL deviceIsOpen = drive.deviceIsOpen;
+		[self.session unlock];
+
+		if(!deviceIsOpen) {
+			self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENXIO userInfo:nil];
+			return;
+		}
+	}
+	else {
+		drive = [[Drive alloc] initWithDADiskRef:self.disk];
+		if(![drive openDevice]) {
+			self.error = drive.error;
+			return;
+		}
+	}
+
+	// Nothing is waiting on the survey's reads, so they yield to any others for the drive
+	// The drive may be shared, so its priority is set each time the survey takes the session
+	eDriveIOPriority previousPriority = drive.ioPriority;
+
+	NSCountedSet *mediaCatalogNumbers = [NSCountedSet set];
+	NSMutableDictionary *isrcs = [NSMutableDictionary dictionary];
+	NSMutableDictionary *boundaries = [NSMutableDictionary dictionary];
+
+	uint8_t qBuffer [IDENTIFIER_WINDOW_SECTORS * kCDSectorSizeQSubchannel];
+
+	// ========================================
+	// SURVEY EACH TRACK IN LBA ORDER
+
+	for(NSUInteger i = 0; i < tracks.count; ++i) {
+		TrackDescriptor *track = [tracks objectAtIndex:i];
+		TrackDescriptor *nextTrack = (i + 1 < tracks.count ? [tracks objectAtIndex:(i + 1)] : nil);
+
+		if(self.isCancelled)
+			goto cleanup;
+
+		if(track.isDataTrack.boolValue)
+			continue;
+
+		[self.session lock];
+		previousPriority = drive.ioPriority;
+		drive.ioPriority = eDriveIOPriorityBackground;
+
+		NSInteger trackNumber = track.number.integerValue;
+		NSInteger firstSector = track.firstSector.integerValue;
+		NSInteger lastSector = track.lastSector.integerValue;
+
+		// The MCN and ISRC are read from a window in the middle of the track, well clear of its boundaries
+		NSUInteger sectorCount = MIN((NSUInteger)IDENTIFIER_WINDOW_SECTORS, track.sectorCount);
+		NSInteger windowStart = firstSector + (NSInteger)((track.sectorCount - sectorCount) / 2);
+
+		NSUInteger sectorsRead = [drive readQSubchannel:qBuffer startSector:(NSUInteger)windowStart sectorCount:sectorCount];
+
+		NSCountedSet *trackISRCs = [NSCountedSet set];
+		for(NSUInteger j = 0; j < sectorsRead; ++j) {
+			const uint8_t *qData = qBuffer + (j * kCDSectorSizeQSubchannel);
+
+			NSString *mcn = mediaCatalogNumberForQSubchannelData(qData);
+			if(mcn)
+				[mediaCatalogNumbers addObject:mcn];
+
+			NSString *isrc = isrcForQSubchannelData(qData);
+			if(isrc)
+				[trackISRCs addObject:isrc];
+		}
+
+		// Some drives don't return Mode-3 Q from READ CD, so fall back to the drive's own reading
+		NSString *isrc = mostFrequentObject(trackISRCs);
+		if(!isrc)
+			isrc = [drive readISRC:(NSUInteger)trackNumber];
+		if(isrc)
+			[isrcs setObject:isrc forKey:track.number];
+
+		// The TOC places index 1 at the track's first sector, and the sector following the track belongs to the next
+		// track's index 1 (or the lead-out), so the keys at these sectors are known
+		// The pregap of the next track and any index points are the positions where the key changes between them
+		NSInteger lowKey = (100 * trackNumber) + 1;
+		NSInteger highSector = lastSector + 1;
+		NSInteger highKey = (100 * (trackNumber + 1)) + 1;
+
+		// The lead-out's Q doesn't follow the same numbering, so the last track is bounded by its own last sector
+		if(!nextTrack || nextTrack.isDataTrack.boolValue) {
+			highSector = lastSector;
+			highKey = [self probeSector:&highSector firstSector:firstSector lastSector:lastSector drive:drive];
+		}
+
+		if(UNKNOWN_POSITION == highKey)
+			[[Logger sharedLogger] logMessage:@"Unable to read the Q sub-channel at the end of track %@", track.number];
+		else if(![self findBoundariesFromSector:firstSector key:lowKey toSector:highSector key:highKey drive:drive boundaries:boundaries])
+			[[Logger sharedLogger] logMessage:@"Unable to locate every index point in track %@ from the Q sub-channel", track.number];
+
+		drive.ioPriority = previousPriority;
+		[self.session unlock];
+	}
+
+	if(self.isCancelled)
+		goto cleanup;
+
+	// ========================================
+	// UPDATE THE TRACKS IN ONE BATCH
+
+	NSString *mcn = mostFrequentObject(mediaCatalogNumbers);
+	if(!mcn) {
+		[self.session lock];
+		previousPriority = drive.ioPriority;
+		drive.ioPriority = eDriveIOPriorityBackground;
+
+		mcn = [drive readMCN];
+
+		drive.ioPriority = previousPriority;
+		[self.session unlock];
+	}
+	disc.metadata.MCN = mcn;
+
+	NSMutableDictionary *indexPoints = [NSMutableDictionary dictionary];
+
+	for(TrackDescriptor *track in tracks) {
+		if(track.isDataTrack.boolValue)
+			continue;
+
+		[self.session lock];
+		previousPriority = drive.ioPriority;
+		drive.ioPriority = eDriveIOPriorityBackground;
+
+		NSInteger trackNumber = track.number.integerValue;
+
+		track.metadata.ISRC = [isrcs objectForKey:track.number];
+
+		// For the first track, the pre-gap is the area between the sector 0 and the track's first sector
+		if(1 == trackNumber) {
+			if(0 != track.firstSector.unsignedIntegerValue)
+				track.pregap = track.firstSector;
+			else
+				track.pregap = [NSNumber numberWithUnsignedInteger:150];
+		}
+		else {
+			NSNumber *pregapStart = [boundaries objectForKey:[NSNumber numberWithInteger:(100 * trackNumber)]];
+			if(pregapStart)
+				track.pregap = [NSNumber numberWithInteger:(track.firstSector.integerValue - pregapStart.integerValue)];
+			else if([boundaries objectForKey:[NSNumber numberWithInteger:(100 * trackNumber) + 1]])
+				track.pregap = [NSNumber numberWithInteger:0];
+		}
+
+		NSMutableArray *trackIndexPoints = [NSMutableArray arrayWithObject:track.firstSector];
+		for(NSInteger index = 2; index < 100; ++index) {
+			NSNumber *indexStart = [boundaries objectForKey:[NSNumber numberWithInteger:(100 * trackNumber) + index]];
+			if(!indexStart)
+				break;
+			[trackIndexPoints addObject:indexStart];
+		}
+
+		if(1 < trackIndexPoints.count)
+			[[Logger sharedLogger] logMessage:@"Track %@ has %u index points: %@", track.number, trackIndexPoints.count, [trackIndexPoints componentsJoinedByString:@", "]];
+
+		[indexPoints setObject:trackIndexPoints forKey:track.number];
+	}
+
+	self.indexPoints = indexPoints;
+
+	// Save the changes
+	if(managedObjectContext.hasChanges) {
+		NSError *error = nil;
+		if(![managedObjectContext save:&error])
+			self.error = error;
+	}
+
+	// Record the results with the disc, so it isn't surveyed again
+	if(!self.error) {
+		NSMutableDictionary *pregaps = [NSMutableDictionary dictionary];
+		for(TrackDescriptor *track in tracks) {
+			if(track.pregap)
+				[pregaps setObject:track.pregap forKey:track.number];
+		}
+
+		NSMutableDictionary *values = [NSMutableDictionary dictionary];
+
+		[values setObject:(mcn ? (id)mcn : (id)[NSNull null]) forKey:kDiscIdentityMCNKey];
+		[values setObject:isrcs forKey:kDiscIdentityISRCsKey];
+		[values setObject:pregaps forKey:kDiscIdentityPregapsKey];
+		[values setObject:[NSNumber numberWithBool:YES] forKey:kDiscIdentitySubchannelSurveyedKey];
+
+		NSError *error = nil;
+		if(![[DiscIdentityCache sharedCache] updateIdentityForDiscTOC:disc.discTOC withValues:values error:&error])
+			[[Logger sharedLogger] logMessage:@"Unable to cache the disc's identity: %@", error];
+	}
+
+	// ========================================
+	// CLEAN UP
+
+cleanup:
+	// Close the device, unless it belongs to the session
+	if(!self.session && ![drive closeDevice])
+		self.error = drive.error;
+}
+
+@end
+
+@implementation SubchannelSurveyOperation (Private)
+
+- (NSInteger) probeSector:(NSInteger *)sector firstSector:(NSInteger)firstSector lastSector:(NSInteger)lastSector drive:(Drive *)drive
+{
+	NSParameterAssert(NULL != sector);
+	NSParameterAssert(nil != drive);
+
+	uint8_t qData [kCDSectorSizeQSubchannel];
+	QSubchannelFrame frame;
+	NSInteger requestedSector = *sector;
+
+	// If the sector's Q is unusable, try the sectors alternately before and after it
+	for(NSUInteger attempt = 0; attempt < MAXIMUM_PROBE_ATTEMPTS; ++attempt) {
+		NSInteger distance = (NSInteger)((attempt + 1) / 2);
+		NSInteger sectorToRead = (attempt % 2 ? requestedSector - distance : requestedSector + distance);
+
+		if(sectorToRead < firstSector || sectorToRead > lastSector)
+			continue;
+
+		if(1 != [drive readQSubchannel:qData sector:(NSUInteger)sectorToRead])
+			continue;
+
+		decodeQSubchannelFrames(qData, kCDSectorSizeQSubchannel, 1, &frame);
+
+		NSInteger key = positionKeyForQSubchannelFrame(&frame);
+		if(UNKNOWN_POSITION != key) {
+			*sector = sectorToRead;
+			return key;
+		}
+	}
+
+	return UNKNOWN_POSITION;
+}
+
+// The first sector of each key in (lowKey, highKey] found between the sectors is recorded in boundaries
+- (BOOL) findBoundariesFromSector:(NSInteger)lowSector key:(NSInteger)lowKey toSector:(NSInteger)highSector key:(NSInteger)highKey drive:(Drive *)drive boundaries:(NSMutableDictionary *)boundaries
+{
+	NSParameterAssert(nil != drive);
+	NSParameterAssert(nil != boundaries);
+
+	// Since the key never decreases, a range with the same key at both ends holds no boundaries
+	if(lowKey >= highKey || self.isCancelled)
+		return YES;
+
+	// Once the range is narrow it is cheaper, and more reliable, to read all of it
+	if(highSector - lowSector <= CONFIRMATION_SECTORS)
+		return [self resolveBoundariesFromSector:lowSector key:lowKey toSector:highSector key:highKey drive:drive boundaries:boundaries];
+
+	NSInteger sector = lowSector + ((highSector - lowSector) / 2);
+	NSInteger key = [self probeSector:&sector firstSector:(lowSector + 1) lastSector:(highSector - 1) drive:drive];
+
+	// If none of the Q near the midpoint is readable there is nothing more to learn from this range
+	// A key outside the range can only come from a Q that passed its CRC by chance
+	if(UNKNOWN_POSITION == key || key < lowKey || key > highKey)
+		return NO;
+
+	BOOL lowerHalfResolved = [self findBoundariesFromSector:lowSector key:lowKey toSector:sector key:key drive:drive boundaries:boundaries];
+	BOOL upperHalfResolved = [self findBoundariesFromSector:sector key:key toSector:highSector key:highKey drive:drive boundaries:boundaries];
+
+	return (lowerHalfResolved && upperHalfResolved);
+}
+
+// The bisection relies on a single Q frame on each side of a boundary, so the frames around a narrowed range are read
+// together and each boundary placed at the position the most frames agree with
+- (BOOL) resolveBoundariesFromSector:(NSInteger)lowSector key:(NSInteger)lowKey toSector:(NSInteger)highSector key:(NSInteger)highKey drive:(Drive *)drive boundaries:(NSMutableDictionary *)boundaries
+{
+	NSParameterAssert(nil != drive);
+	NSParameterAssert(nil != boundaries);
+	NSParameterAssert(highSector - lowSector <= CONFIRMATION_SECTORS);
+
+	NSInteger windowStart = MAX(0, lowSector - CONFIRMATION_SECTORS);
+	NSInteger windowEnd = highSector + CONFIRMATION_SECTORS - 1;
+
+	uint8_t qBuffer [3 * CONFIRMATION_SECTORS * kCDSectorSizeQSubchannel];
+	NSUInteger sectorCount = (NSUInteger)(windowEnd - windowStart + 1);
+
+	// The window may extend into the lead-out, which some drives won't read
+	NSUInteger sectorsRead = [drive readQSubchannel:qBuffer startSector:(NSUInteger)windowStart sectorCount:sectorCount];
+	if(sectorsRead != sectorCount)
+		sectorsRead = [drive readQSubchannel:qBuffer startSector:(NSUInteger)windowStart sectorCount:(NSUInteger)(highSector - windowStart + 1)];
+
+	QSubchannelFrame frames [3 * CONFIRMATION_SECTORS];
+	decodeQSubchannelFrames(qBuffer, kCDSectorSizeQSubchannel, sectorsRead, frames);
+
+	NSInteger keys [3 * CONFIRMATION_SECTORS];
+	for(NSUInteger i = 0; i < sectorsRead; ++i)
+		keys[i] = positionKeyForQSubchannelFrame(&frames[i]);
+
+	// An unreadable Q within the range leaves the boundary ambiguous, so the range itself is re-read to fill the gaps
+	NSUInteger rangeStart = (NSUInteger)(lowSector + 1 - windowStart);
+	NSUInteger rangeCount = (NSUInteger)(highSector - lowSector);
+
+	for(NSUInteger attempt = 0; attempt < MAXIMUM_PROBE_ATTEMPTS && rangeStart + rangeCount <= sectorsRead; ++attempt) {
+		BOOL rangeIsComplete = YES;
+		for(NSUInteger i = rangeStart; i < rangeStart + rangeCount; ++i) {
+			if(UNKNOWN_POSITION == keys[i])
+				rangeIsComplete = NO;
+		}
+
+		if(rangeIsComplete || rangeCount != [drive readQSubchannel:qBuffer startSector:(NSUInteger)(lowSector + 1) sectorCount:rangeCount])
+			break;
+
+		decodeQSubchannelFrames(qBuffer, kCDSectorSizeQSubchannel, rangeCount, frames);
+
+		for(NSUInteger i = 0; i < rangeCount; ++i) {
+			if(UNKNOWN_POSITION == keys[rangeStart + i])
+				keys[rangeStart + i] = positionKeyForQSubchannelFrame(&frames[i]);
+		}
+	}
+
+	// Short index points may lie entirely within the range, so every key seen in it is placed
+	NSMutableIndexSet *keysToPlace = [NSMutableIndexSet indexSetWithIndex:(NSUInteger)highKey];
+	for(NSUInteger i = 0; i < sectorsRead; ++i) {
+		NSInteger sector = windowStart + (NSInteger)i;
+		if(sector > lowSector && sector < highSector && keys[i] > lowKey && keys[i] < highKey)
+			[keysToPlace addIndex:(NSUInteger)keys[i]];
+	}
+
+	NSUInteger key = [keysToPlace firstIndex];
+	while(NSNotFound != key) {
+		// Count the frames that disagree with each candidate boundary within the range, preferring the latest on a tie
+		// since the bisection saw the key at highSector
+		NSInteger boundary = highSector;
+		NSUInteger fewestDisagreements = NSUIntegerMax;
+
+		for(NSInteger candidate = lowSector + 1; candidate <= highSector; ++candidate) {
+			NSUInteger disagreements = 0;
+
+			for(NSUInteger i = 0; i < sectorsRead; ++i) {
+				NSInteger sector = windowStart + (NSInteger)i;
+
+				if(UNKNOWN_POSITION == keys[i])
+					continue;
+				else if(sector < candidate && keys[i] >= (NSInteger)key)
+					++disagreements;
+				else if(sector >= candidate && keys[i] < (NSInteger)key)
+					++disagreements;
+			}
+
+			if(disagreements <= fewestDisagreements) {
+				boundary = candidate;
+				fewestDisagreements = disagreements;
+			}
+		}
+
+		[boundaries setObject:[NSNumber numberWithInteger:boundary] forKey:[NSNumber numberWithInteger:(NSInteger)key]];
+
+		key = [keysToPlace indexGreaterThanIndex:key];
+	}
+
+	return (0 != sectorsRead);
+}
+
+@end
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+#include <IOKit/storage/IOCDTypes.h>
+
+@class SectorStore;
+
+// ========================================
+// Records use Rip's own format (signature "RipPAR01"), which is not compatible with the
+// CUETools database: the disc's audio is viewed as a matrix of 16-bit little endian
+// samples PARITY_RECORD_STRIDE samples (ten sectors) wide, padded with silence, and each
+// column is a Reed-Solomon codeword over GF(2^16) with parityCount parity symbols
+// A record can therefore repair up to parityCount / 2 damaged rows in each column,
+// for example a contiguous burst of (parityCount / 2) * PARITY_RECORD_STRIDE_IN_SECTORS sectors
+// ========================================
+#define PARITY_RECORD_STRIDE_IN_SECTORS			10
+#define PARITY_RECORD_STRIDE					(PARITY_RECORD_STRIDE_IN_SECTORS * (kCDSectorSizeCDDA / sizeof(int16_t)))
+#define PARITY_RECORD_DEFAULT_PARITY_COUNT		8
+
+// ========================================
+// A CRC32 and Reed-Solomon parity for the audio of an entire disc, used to verify
+// a rip and repair it without reading the disc again
+// ========================================
+@interface ParityRecord : NSObject
+{
+@private
+	NSUInteger _sectorCount;
+	NSUInteger _parityCount;
+	uint32_t _CRC32;
+	NSData *_parity;			// parityCount rows of PARITY_RECORD_STRIDE little endian samples
+}
+
+// ========================================
+// Creation
++ (id) parityRecordWithData:(NSData *)data error:(NSError **)error;
++ (id) parityRecordForSectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors parityCount:(NSUInteger)parityCount error:(NSError **)error;
+
+// ========================================
+// Properties
+@property (readonly) NSUInteger sectorCount;
+@property (readonly) NSUInteger parityCount;
+@property (readonly) uint32_t CRC32;
+@property (readonly, copy) NSData * parity;
+
+// The serialized record
+@property (readonly) NSData * dataRepresentation;
+
+// ========================================
+// Verification and repair
+- (BOOL) verifySectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors;
+
+// Returns the repaired audio for each damaged sector, as NSData keyed by the sector's index in sectorStore
+// An empty dictionary is returned if the audio is intact, and nil if it can't be repaired
+- (NSDictionary *) repairedSectorsForSectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors error:(NSError **)error;
+
+@end
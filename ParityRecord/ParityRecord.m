@@ -0,0 +1,374 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "ParityRecord.h"
+#import "SectorStore.h"
+
+#include "ReedSolomonKernels.h"
+#include "DigestUtilities.h"
+
+#include <libkern/OSByteOrder.h>
+
+// ========================================
+// The serialized record is this header, with all fields little endian, followed by the parity
+// ========================================
+#define PARITY_RECORD_SIGNATURE				"RipPAR01"
+#define PARITY_RECORD_SIGNATURE_LENGTH		8
+
+typedef struct {
+	char signature [PARITY_RECORD_SIGNATURE_LENGTH];
+	uint32_t sectorCount;
+	uint32_t stride;
+	uint32_t parityCount;
+	uint32_t CRC32;
+} ParityRecordHeader;
+
+// The number of samples in a sector
+#define SAMPLES_PER_CDDA_SECTOR				(kCDSectorSizeCDDA / sizeof(int16_t))
+
+// A sanity limit on the size of records
+#define MAXIMUM_PARITY_COUNT				256
+
+// ========================================
+// Read one row of the audio matrix into samples, padding with silence and substituting
+// any repaired sectors
+// Returns the number of bytes of audio in the row, or NSNotFound if the audio couldn't be read
+// ========================================
+static NSUInteger
+readParityRecordRow(SectorStore *sectorStore, NSRange sectors, NSUInteger row, NSDictionary *repairedSectors, uint16_t *samples, NSError **error)
+{
+	NSUInteger firstSector = row * PARITY_RECORD_STRIDE_IN_SECTORS;
+	NSUInteger sectorCount = MIN(PARITY_RECORD_STRIDE_IN_SECTORS, sectors.length - firstSector);
+
+	memset(samples, 0, PARITY_RECORD_STRIDE * sizeof(uint16_t));
+
+	NSUInteger sectorsRead = [sectorStore readAudioForSectors:NSMakeRange(sectors.location + firstSector, sectorCount) buffer:samples error:error];
+	if(sectorsRead != sectorCount)
+		return NSNotFound;
+
+	for(NSUInteger i = 0; repairedSectors.count && i < sectorCount; ++i) {
+		NSData *repairedSector = [repairedSectors objectForKey:[NSNumber numberWithUnsignedInteger:(sectors.location + firstSector + i)]];
+		if(repairedSector)
+			memcpy(samples + (i * SAMPLES_PER_CDDA_SECTOR), [repairedSector bytes], kCDSectorSizeCDDA);
+	}
+
+	return (sectorCount * kCDSectorSizeCDDA);
+}
+
+static inline void
+swapParityRecordSamples(uint16_t *samples, NSUInteger count)
+{
+	for(NSUInteger i = 0; i < count; ++i)
+		samples[i] = OSSwapLittleToHostInt16(samples[i]);
+}
+
+// ========================================
+// Private methods
+// ========================================
+@interface ParityRecord ()
+@property (assign) NSUInteger sectorCount;
+@property (assign) NSUInteger parityCount;
+@property (assign) uint32_t CRC32;
+@property (copy) NSData * parity;
+@end
+
+@interface ParityRecord (Private)
+- (uint32_t) CRC32ForSectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors repairedSectors:(NSDictionary *)repairedSectors error:(NSError **)error;
+- (NSError *) unrepairableAudioError;
+@end
+
+@implementation ParityRecord
+
+@synthesize sectorCount = _sectorCount;
+@synthesize parityCount = _parityCount;
+@synthesize CRC32 = _CRC32;
+@synthesize parity = _parity;
+
++ (id) parityRecordWithData:(NSData *)data error:(NSError **)error
+{
+	NSParameterAssert(nil != data);
+
+	ParityRecordHeader header;
+	if(sizeof(header) > [data length])
+		goto corrupt;
+
+	[data getBytes:&header length:sizeof(header)];
+
+	NSUInteger sectorCount = OSSwapLittleToHostInt32(header.sectorCount);
+	NSUInteger stride = OSSwapLittleToHostInt32(header.stride);
+	NSUInteger parityCount = OSSwapLittleToHostInt32(header.parityCount);
+
+	if(memcmp(header.signature, PARITY_RECORD_SIGNATURE, PARITY_RECORD_SIGNATURE_LENGTH) || PARITY_RECORD_STRIDE != stride)
+		goto corrupt;
+
+	if(!sectorCount || !parityCount || MAXIMUM_PARITY_COUNT < parityCount)
+		goto corrupt;
+
+	NSUInteger parityLength = parityCount * PARITY_RECORD_STRIDE * sizeof(uint16_t);
+	if(sizeof(header) + parityLength != [data length])
+		goto corrupt;
+
+	ParityRecord *parityRecord = [[ParityRecord alloc] init];
+
+	parityRecord.sectorCount = sectorCount;
+	parityRecord.parityCount = parityCount;
+	parityRecord.CRC32 = OSSwapLittleToHostInt32(header.CRC32);
+	parityRecord.parity = [data subdataWithRange:NSMakeRange(sizeof(header), parityLength)];
+
+	return parityRecord;
+
+corrupt:
+	if(error)
+		*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:nil];
+
+	return nil;
+}
+
++ (id) parityRecordForSectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors parityCount:(NSUInteger)parityCount error:(NSError **)error
+{
+	NSParameterAssert(nil != sectorStore);
+	NSParameterAssert(0 < sectors.length);
+	NSParameterAssert(0 < parityCount && MAXIMUM_PARITY_COUNT >= parityCount);
+
+	// Each column of the matrix must fit in a single codeword
+	NSUInteger rowCount = (sectors.length + PARITY_RECORD_STRIDE_IN_SECTORS - 1) / PARITY_RECORD_STRIDE_IN_SECTORS;
+	if(GF16_MAXIMUM_CODEWORD_LENGTH < rowCount + parityCount) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+		return nil;
+	}
+
+	uint16_t generator [parityCount];
+	reedSolomonGeneratorPolynomial(generator, parityCount);
+
+	// remainder holds, for every column, the coefficients of the remainder of the data divided by the generator
+	NSMutableData *remainderData = [NSMutableData dataWithLength:(parityCount * PARITY_RECORD_STRIDE * sizeof(uint16_t))];
+	NSMutableData *samplesData = [NSMutableData dataWithLength:(PARITY_RECORD_STRIDE * sizeof(uint16_t))];
+	NSMutableData *feedbackData = [NSMutableData dataWithLength:(PARITY_RECORD_STRIDE * sizeof(uint16_t))];
+	if(!remainderData || !samplesData || !feedbackData) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		return nil;
+	}
+
+	uint16_t *remainder = [remainderData mutableBytes];
+	uint16_t *samples = [samplesData mutableBytes];
+	uint16_t *feedback = [feedbackData mutableBytes];
+
+	uint32_t crc = 0;
+
+	// Encode one row at a time, so each step of the division is applied to all the columns at once
+	for(NSUInteger row = 0; row < rowCount; ++row) {
+		NSUInteger byteCount = readParityRecordRow(sectorStore, sectors, row, nil, samples, error);
+		if(NSNotFound == byteCount)
+			return nil;
+
+		crc = crc32Update(crc, samples, byteCount);
+		swapParityRecordSamples(samples, PARITY_RECORD_STRIDE);
+
+		const uint16_t *highestCoefficients = remainder + ((parityCount - 1) * PARITY_RECORD_STRIDE);
+		for(NSUInteger column = 0; column < PARITY_RECORD_STRIDE; ++column)
+			feedback[column] = samples[column] ^ highestCoefficients[column];
+
+		for(NSUInteger j = parityCount - 1; j > 0; --j)
+			gf16MultiplyAddRegion(remainder + (j * PARITY_RECORD_STRIDE), feedback, remainder + ((j - 1) * PARITY_RECORD_STRIDE), generator[j], PARITY_RECORD_STRIDE);
+		gf16MultiplyAddRegion(remainder, feedback, NULL, generator[0], PARITY_RECORD_STRIDE);
+	}
+
+	// The parity follows the data in each codeword, highest power first
+	NSMutableData *parityData = [NSMutableData dataWithLength:[remainderData length]];
+	uint16_t *parity = [parityData mutableBytes];
+
+	for(NSUInteger k = 0; k < parityCount; ++k) {
+		const uint16_t *coefficients = remainder + ((parityCount - 1 - k) * PARITY_RECORD_STRIDE);
+		for(NSUInteger column = 0; column < PARITY_RECORD_STRIDE; ++column)
+			parity[(k * PARITY_RECORD_STRIDE) + column] = OSSwapHostToLittleInt16(coefficients[column]);
+	}
+
+	ParityRecord *parityRecord = [[ParityRecord alloc] init];
+
+	parityRecord.sectorCount = sectors.length;
+	parityRecord.parityCount = parityCount;
+	parityRecord.CRC32 = crc;
+	parityRecord.parity = parityData;
+
+	return parityRecord;
+}
+
+- (NSData *) dataRepresentation
+{
+	ParityRecordHeader header;
+
+	memcpy(header.signature, PARITY_RECORD_SIGNATURE, PARITY_RECORD_SIGNATURE_LENGTH);
+	header.sectorCount = OSSwapHostToLittleInt32((uint32_t)self.sectorCount);
+	header.stride = OSSwapHostToLittleInt32((uint32_t)PARITY_RECORD_STRIDE);
+	header.parityCount = OSSwapHostToLittleInt32((uint32_t)self.parityCount);
+	header.CRC32 = OSSwapHostToLittleInt32(self.CRC32);
+
+	NSMutableData *data = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+	[data appendData:self.parity];
+
+	return data;
+}
+
+- (BOOL) verifySectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors
+{
+	NSParameterAssert(nil != sectorStore);
+
+	if(sectors.length != self.sectorCount)
+		return NO;
+
+	NSError *error = nil;
+	uint32_t crc = [self CRC32ForSectorStore:sectorStore sectors:sectors repairedSectors:nil error:&error];
+
+	return (!error && crc == self.CRC32);
+}
+
+- (NSDictionary *) repairedSectorsForSectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors error:(NSError **)error
+{
+	NSParameterAssert(nil != sectorStore);
+
+	if(sectors.length != self.sectorCount) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+		return nil;
+	}
+
+	NSUInteger parityCount = self.parityCount;
+	NSUInteger rowCount = (sectors.length + PARITY_RECORD_STRIDE_IN_SECTORS - 1) / PARITY_RECORD_STRIDE_IN_SECTORS;
+	NSUInteger codewordLength = rowCount + parityCount;
+
+	NSMutableData *syndromesData = [NSMutableData dataWithLength:(parityCount * PARITY_RECORD_STRIDE * sizeof(uint16_t))];
+	NSMutableData *samplesData = [NSMutableData dataWithLength:(PARITY_RECORD_STRIDE * sizeof(uint16_t))];
+	if(!syndromesData || !samplesData) {
+		if(error)
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+		return nil;
+	}
+
+	uint16_t *syndromes = [syndromesData mutableBytes];
+	uint16_t *samples = [samplesData mutableBytes];
+
+	uint16_t roots [parityCount];
+	for(NSUInteger i = 0; i < parityCount; ++i)
+		roots[i] = gf16Power(i);
+
+	// Evaluate every column's codeword at the roots of the generator (Horner's rule), row by row
+	uint32_t crc = 0;
+	for(NSUInteger row = 0; row < codewordLength; ++row) {
+		if(row < rowCount) {
+			NSUInteger byteCount = readParityRecordRow(sectorStore, sectors, row, nil, samples, error);
+			if(NSNotFound == byteCount)
+				return nil;
+
+			crc = crc32Update(crc, samples, byteCount);
+		}
+		else
+			memcpy(samples, (const uint16_t *)[self.parity bytes] + ((row - rowCount) * PARITY_RECORD_STRIDE), PARITY_RECORD_STRIDE * sizeof(uint16_t));
+
+		swapParityRecordSamples(samples, PARITY_RECORD_STRIDE);
+
+		for(NSUInteger i = 0; i < parityCount; ++i) {
+			uint16_t *syndrome = syndromes + (i * PARITY_RECORD_STRIDE);
+			gf16MultiplyAddRegion(syndrome, syndrome, samples, roots[i], PARITY_RECORD_STRIDE);
+		}
+	}
+
+	NSMutableDictionary *repairedSectors = [NSMutableDictionary dictionary];
+
+	// Nothing to do
+	if(crc == self.CRC32)
+		return repairedSectors;
+
+	uint16_t columnSyndromes [parityCount];
+	NSUInteger positions [parityCount];
+	uint16_t magnitudes [parityCount];
+
+	for(NSUInteger column = 0; column < PARITY_RECORD_STRIDE; ++column) {
+		for(NSUInteger i = 0; i < parityCount; ++i)
+			columnSyndromes[i] = syndromes[(i * PARITY_RECORD_STRIDE) + column];
+
+		NSInteger errorCount = reedSolomonCorrectErrors(columnSyndromes, parityCount, codewordLength, positions, magnitudes);
+		if(0 > errorCount) {
+			if(error)
+				*error = [self unrepairableAudioError];
+			return nil;
+		}
+
+		for(NSInteger i = 0; i < errorCount; ++i) {
+			// Errors in the parity itself don't affect the audio
+			if(positions[i] >= rowCount)
+				continue;
+
+			NSUInteger sample = (positions[i] * PARITY_RECORD_STRIDE) + column;
+			NSUInteger sector = sample / SAMPLES_PER_CDDA_SECTOR;
+
+			// A correction in the padding means the decoder was misled
+			if(sector >= sectors.length) {
+				if(error)
+					*error = [self unrepairableAudioError];
+				return nil;
+			}
+
+			NSNumber *sectorNumber = [NSNumber numberWithUnsignedInteger:(sectors.location + sector)];
+			NSMutableData *sectorData = [repairedSectors objectForKey:sectorNumber];
+			if(!sectorData) {
+				sectorData = [[sectorStore audioDataForSector:(sectors.location + sector) error:error] mutableCopy];
+				if(!sectorData)
+					return nil;
+
+				[repairedSectors setObject:sectorData forKey:sectorNumber];
+			}
+
+			uint16_t *sectorSamples = [sectorData mutableBytes];
+			sectorSamples[sample % SAMPLES_PER_CDDA_SECTOR] ^= OSSwapHostToLittleInt16(magnitudes[i]);
+		}
+	}
+
+	// Confirm the repair
+	crc = [self CRC32ForSectorStore:sectorStore sectors:sectors repairedSectors:repairedSectors error:error];
+	if(crc != self.CRC32) {
+		if(error)
+			*error = [self unrepairableAudioError];
+		return nil;
+	}
+
+	return repairedSectors;
+}
+
+@end
+
+@implementation ParityRecord (Private)
+
+- (uint32_t) CRC32ForSectorStore:(SectorStore *)sectorStore sectors:(NSRange)sectors repairedSectors:(NSDictionary *)repairedSectors error:(NSError **)error
+{
+	NSMutableData *samplesData = [NSMutableData dataWithLength:(PARITY_RECORD_STRIDE * sizeof(uint16_t))];
+	uint16_t *samples = [samplesData mutableBytes];
+
+	NSUInteger rowCount = (sectors.length + PARITY_RECORD_STRIDE_IN_SECTORS - 1) / PARITY_RECORD_STRIDE_IN_SECTORS;
+
+	uint32_t crc = 0;
+	for(NSUInteger row = 0; row < rowCount; ++row) {
+		NSUInteger byteCount = readParityRecordRow(sectorStore, sectors, row, repairedSectors, samples, error);
+		if(NSNotFound == byteCount)
+			return 0;
+
+		crc = crc32Update(crc, samples, byteCount);
+	}
+
+	return crc;
+}
+
+- (NSError *) unrepairableAudioError
+{
+	NSMutableDictionary *errorDictionary = [NSMutableDictionary dictionary];
+
+	[errorDictionary setObject:NSLocalizedString(@"The audio could not be repaired.", @"") forKey:NSLocalizedDescriptionKey];
+	[errorDictionary setObject:NSLocalizedString(@"The damage exceeds the correction capacity of the parity record, or the record belongs to a different pressing.", @"") forKey:NSLocalizedRecoverySuggestionErrorKey];
+
+	return [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:errorDictionary];
+}
+
+@end
@@ -0,0 +1,47 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+@class CompactDisc, ParityRecord;
+
+// ========================================
+// Access to parity records for discs
+// Records are looked up, in order, in localDatabaseURL (a directory of records, for
+// example a mirror of a parity database), in archiveURL (the records generated for
+// our own rips) and at databaseURL (a parity database server or a local stand-in)
+// Records are named for the disc's track count and AccurateRip and FreeDB disc IDs
+// ========================================
+@interface ParityRecordDatabase : NSObject
+{
+@private
+	NSURL *_localDatabaseURL;
+	NSURL *_archiveURL;
+	NSURL *_databaseURL;
+}
+
+// ========================================
+// The shared database, configured from the user defaults
++ (ParityRecordDatabase *) sharedDatabase;
+
+// ========================================
+// Properties
+@property (copy) NSURL * localDatabaseURL;
+@property (copy) NSURL * archiveURL;
+@property (copy) NSURL * databaseURL;
+
+// ========================================
+// Returns the parity record for the disc, or nil
+// If no record exists nil is returned and error is not set
+- (ParityRecord *) parityRecordForCompactDisc:(CompactDisc *)compactDisc error:(NSError **)error;
+
+// ========================================
+// Store the record for the disc in the archive
+- (BOOL) publishParityRecord:(ParityRecord *)parityRecord forCompactDisc:(CompactDisc *)compactDisc error:(NSError **)error;
+
+// The name of the record for the disc
+- (NSString *) fileNameForCompactDisc:(CompactDisc *)compactDisc;
+
+@end
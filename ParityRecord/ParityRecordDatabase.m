@@ -0,0 +1,143 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "ParityRecordDatabase.h"
+#import "ParityRecord.h"
+
+#import "CompactDisc.h"
+#import "SessionDescriptor.h"
+
+#import "Logger.h"
+
+#define REQUEST_TIMEOUT						30.0
+
+// ========================================
+// Private methods
+// ========================================
+@interface ParityRecordDatabase (Private)
+- (NSData *) dataForFileName:(NSString *)fileName inDirectory:(NSURL *)directoryURL;
+@end
+
+// ========================================
+// Static variables
+// ========================================
+static ParityRecordDatabase *sSharedDatabase		= nil;
+
+@implementation ParityRecordDatabase
+
+@synthesize localDatabaseURL = _localDatabaseURL;
+@synthesize archiveURL = _archiveURL;
+@synthesize databaseURL = _databaseURL;
+
++ (ParityRecordDatabase *) sharedDatabase
+{
+	@synchronized(self) {
+		if(!sSharedDatabase) {
+			sSharedDatabase = [[self alloc] init];
+
+			NSArray *applicationSupportPaths = NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES);
+			NSString *applicationSupportPath = (0 < applicationSupportPaths.count) ? [applicationSupportPaths objectAtIndex:0] : NSTemporaryDirectory();
+			NSString *applicationName = [[NSBundle mainBundle] objectForInfoDictionaryKey:@"CFBundleName"];
+			NSString *archivePath = [[applicationSupportPath stringByAppendingPathComponent:applicationName] stringByAppendingPathComponent:@"Parity Records"];
+
+			sSharedDatabase.archiveURL = [NSURL fileURLWithPath:archivePath];
+
+			NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+
+			NSString *databaseURLString = [userDefaults stringForKey:@"parityRecordDatabaseURL"];
+			if(databaseURLString)
+				sSharedDatabase.databaseURL = [NSURL URLWithString:databaseURLString];
+
+			NSString *localDatabasePath = [userDefaults stringForKey:@"parityRecordLocalDatabasePath"];
+			if(localDatabasePath)
+				sSharedDatabase.localDatabaseURL = [NSURL fileURLWithPath:[localDatabasePath stringByExpandingTildeInPath]];
+		}
+	}
+
+	return sSharedDatabase;
+}
+
+- (NSString *) fileNameForCompactDisc:(CompactDisc *)compactDisc
+{
+	NSParameterAssert(nil != compactDisc);
+
+	return [NSString stringWithFormat:@"parity-%.3d-%.8x-%.8x-%.8x.bin",
+			compactDisc.firstSession.tracks.count,
+			compactDisc.accurateRipID1,
+			compactDisc.accurateRipID2,
+			compactDisc.freeDBDiscID];
+}
+
+- (ParityRecord *) parityRecordForCompactDisc:(CompactDisc *)compactDisc error:(NSError **)error
+{
+	NSParameterAssert(nil != compactDisc);
+
+	NSString *fileName = [self fileNameForCompactDisc:compactDisc];
+
+	NSData *recordData = [self dataForFileName:fileName inDirectory:self.localDatabaseURL];
+	if(!recordData)
+		recordData = [self dataForFileName:fileName inDirectory:self.archiveURL];
+
+	if(!recordData && self.databaseURL) {
+		NSURL *recordURL = [NSURL URLWithString:fileName relativeToURL:self.databaseURL];
+
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Querying %@", recordURL];
+
+		NSURLRequest *request = [NSURLRequest requestWithURL:recordURL
+												 cachePolicy:NSURLRequestReloadIgnoringLocalCacheData
+											 timeoutInterval:REQUEST_TIMEOUT];
+
+		NSHTTPURLResponse *response = nil;
+		recordData = [NSURLConnection sendSynchronousRequest:request returningResponse:&response error:error];
+
+		// If the disc isn't in the database it isn't an error condition
+		if(recordData && [response isKindOfClass:[NSHTTPURLResponse class]] && 404 == [response statusCode])
+			return nil;
+		else if(recordData && [response isKindOfClass:[NSHTTPURLResponse class]] && 200 != [response statusCode]) {
+			if(error)
+				*error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil];
+			return nil;
+		}
+	}
+
+	if(!recordData)
+		return nil;
+
+	return [ParityRecord parityRecordWithData:recordData error:error];
+}
+
+- (BOOL) publishParityRecord:(ParityRecord *)parityRecord forCompactDisc:(CompactDisc *)compactDisc error:(NSError **)error
+{
+	NSParameterAssert(nil != parityRecord);
+	NSParameterAssert(nil != compactDisc);
+
+	NSString *archivePath = [self.archiveURL path];
+	if(![[NSFileManager defaultManager] createDirectoryAtPath:archivePath withIntermediateDirectories:YES attributes:nil error:error])
+		return NO;
+
+	NSString *recordPath = [archivePath stringByAppendingPathComponent:[self fileNameForCompactDisc:compactDisc]];
+
+	return [[parityRecord dataRepresentation] writeToFile:recordPath options:NSAtomicWrite error:error];
+}
+
+@end
+
+@implementation ParityRecordDatabase (Private)
+
+- (NSData *) dataForFileName:(NSString *)fileName inDirectory:(NSURL *)directoryURL
+{
+	NSParameterAssert(nil != fileName);
+
+	if(!directoryURL)
+		return nil;
+
+	NSString *recordPath = [[directoryURL path] stringByAppendingPathComponent:fileName];
+	if(![[NSFileManager defaultManager] fileExistsAtPath:recordPath])
+		return nil;
+
+	return [NSData dataWithContentsOfFile:recordPath options:NSMappedRead error:NULL];
+}
+
+@end
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <Cocoa/Cocoa.h>
+
+@class ParityRecord;
+
+// ========================================
+// An NSOperation subclass that checks a disc image against a parity record,
+// writing a repaired copy of the image if any sectors were in error
+// If no parity record is given, a record is generated for the image instead
+// ========================================
+@interface ParityRecordOperation : NSOperation
+{
+@private
+	NSURL *_imageURL;						// The disc image
+	ParityRecord *_parityRecord;			// The record to verify against, or nil to generate one
+
+	NSURL *_repairedImageURL;				// The repaired image, if repairs were made
+	NSString *_MD5;							// The digests of the repaired image
+	NSString *_SHA1;
+	NSIndexSet *_repairedSectors;			// The sectors in the image that were repaired
+	ParityRecord *_generatedParityRecord;	// The record generated for the image
+	NSError *_error;						// Holds the first error (if any) occurring during processing
+}
+
+// ========================================
+// Properties affecting processing
+@property (copy) NSURL * imageURL;
+@property (assign) ParityRecord * parityRecord;
+
+// ========================================
+// Properties set after processing is complete (or cancelled)
+@property (readonly, copy) NSURL * repairedImageURL;
+@property (readonly, copy) NSString * MD5;
+@property (readonly, copy) NSString * SHA1;
+@property (readonly, copy) NSIndexSet * repairedSectors;
+@property (readonly, assign) ParityRecord * generatedParityRecord;
+@property (readonly, copy) NSError * error;
+
+@end
@@ -0,0 +1,134 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "ParityRecordOperation.h"
+#import "ParityRecord.h"
+#import "SectorStore.h"
+#import "AudioUtilities.h"
+#import "FileUtilities.h"
+#import "Logger.h"
+
+@interface ParityRecordOperation ()
+@property (copy) NSURL * repairedImageURL;
+@property (copy) NSString * MD5;
+@property (copy) NSString * SHA1;
+@property (copy) NSIndexSet * repairedSectors;
+@property (assign) ParityRecord * generatedParityRecord;
+@property (copy) NSError * error;
+@end
+
+// ========================================
+// Private methods
+// ========================================
+@interface ParityRecordOperation (Private)
+- (void) repairImage:(SectorStore *)image;
+- (void) generateParityRecordForImage:(SectorStore *)image;
+@end
+
+@implementation ParityRecordOperation
+
+@synthesize imageURL = _imageURL;
+@synthesize parityRecord = _parityRecord;
+@synthesize repairedImageURL = _repairedImageURL;
+@synthesize MD5 = _MD5;
+@synthesize SHA1 = _SHA1;
+@synthesize repairedSectors = _repairedSectors;
+@synthesize generatedParityRecord = _generatedParityRecord;
+@synthesize error = _error;
+
+- (void) main
+{
+	NSAssert(nil != self.imageURL, @"self.imageURL may not be nil");
+
+	NSError *error = nil;
+	SectorStore *image = [SectorStore sectorStoreWithContentsOfURL:self.imageURL error:&error];
+	if(!image) {
+		self.error = error;
+		return;
+	}
+
+	if(self.parityRecord)
+		[self repairImage:image];
+	else
+		[self generateParityRecordForImage:image];
+
+	[image close];
+}
+
+@end
+
+@implementation ParityRecordOperation (Private)
+
+- (void) repairImage:(SectorStore *)image
+{
+	NSParameterAssert(nil != image);
+
+	// The record covers the audio of the entire disc
+	NSRange imageSectors = NSMakeRange(0, image.sectorCount);
+	if(imageSectors.length != self.parityRecord.sectorCount) {
+		[[Logger sharedLogger] logMessage:@"The parity record doesn't match the image (%lu sectors, expected %lu)", (unsigned long)imageSectors.length, (unsigned long)self.parityRecord.sectorCount];
+		self.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+		return;
+	}
+
+	NSError *error = nil;
+	NSDictionary *repairedSectors = [self.parityRecord repairedSectorsForSectorStore:image sectors:imageSectors error:&error];
+	if(!repairedSectors) {
+		self.error = error;
+		return;
+	}
+
+	NSMutableIndexSet *repairedSectorIndexes = [NSMutableIndexSet indexSet];
+	for(NSNumber *sector in repairedSectors)
+		[repairedSectorIndexes addIndex:[sector unsignedIntegerValue]];
+
+	self.repairedSectors = repairedSectorIndexes;
+
+	if(!repairedSectors.count || self.isCancelled)
+		return;
+
+	// Write the repaired audio to a new image
+	SectorStore *repairedImage = [SectorStore sectorStore];
+	BOOL success = [repairedImage copySectors:imageSectors fromSectorStore:image toSector:0 error:&error];
+
+	for(NSNumber *sector in repairedSectors) {
+		if(!success)
+			break;
+		success = [repairedImage setAudioData:[repairedSectors objectForKey:sector] forSector:[sector unsignedIntegerValue] error:&error];
+	}
+
+	NSURL *repairedImageURL = temporaryURLWithExtension(@"wav");
+	if(success)
+		success = [repairedImage writeSectors:imageSectors toURL:repairedImageURL error:&error];
+
+	[repairedImage close];
+
+	NSArray *digests = (success ? calculateMD5AndSHA1DigestsForURL(repairedImageURL) : nil);
+	if(!digests) {
+		self.error = (error ? error : [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil]);
+		[[NSFileManager defaultManager] removeItemAtPath:[repairedImageURL path] error:NULL];
+		return;
+	}
+
+	self.MD5 = [digests objectAtIndex:0];
+	self.SHA1 = [digests objectAtIndex:1];
+	self.repairedImageURL = repairedImageURL;
+}
+
+- (void) generateParityRecordForImage:(SectorStore *)image
+{
+	NSParameterAssert(nil != image);
+
+	NSError *error = nil;
+	ParityRecord *parityRecord = [ParityRecord parityRecordForSectorStore:image sectors:NSMakeRange(0, image.sectorCount) parityCount:PARITY_RECORD_DEFAULT_PARITY_COUNT error:&error];
+	if(!parityRecord) {
+		self.error = error;
+		return;
+	}
+
+	self.generatedParityRecord = parityRecord;
+}
+
+@end
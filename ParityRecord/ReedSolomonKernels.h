@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#include <Foundation/Foundation.h>
+
+// ========================================
+// Reed-Solomon coding over GF(2^16), using the primitive polynomial
+// x^16 + x^12 + x^3 + x + 1 (0x1100B) and generator roots alpha^0 ... alpha^(n - 1)
+// Symbols are 16-bit values in host byte order
+// Codewords are at most 65535 symbols long
+// ========================================
+#define GF16_FIELD_SIZE					65536
+#define GF16_MAXIMUM_CODEWORD_LENGTH	65535
+
+// ========================================
+// Field arithmetic
+// ========================================
+uint16_t gf16Multiply(uint16_t a, uint16_t b);
+uint16_t gf16Divide(uint16_t a, uint16_t b);
+uint16_t gf16Power(NSUInteger exponent);	// alpha^exponent
+
+// ========================================
+// Multiply a region of symbols by a constant and add (xor) another region:
+// destination[i] = addend[i] ^ (source[i] * constant)
+// addend may be NULL, and destination may be the same as source or addend
+// ========================================
+typedef void (*GF16MultiplyAddRegionFunction)(uint16_t *destination, const uint16_t *source, const uint16_t *addend, uint16_t constant, NSUInteger count);
+
+// ========================================
+// The available implementations
+// ========================================
+enum _eReedSolomonKernel {
+	eReedSolomonKernelScalar		= 0,
+	eReedSolomonKernelSSSE3			= 1,
+	eReedSolomonKernelNEON			= 2
+};
+typedef enum _eReedSolomonKernel eReedSolomonKernel;
+
+// Uses the fastest implementation supported by the processor
+void gf16MultiplyAddRegion(uint16_t *destination, const uint16_t *source, const uint16_t *addend, uint16_t constant, NSUInteger count);
+
+// Returns the specified implementation, or NULL if it isn't supported by the
+// compiler or processor (used for testing)
+GF16MultiplyAddRegionFunction gf16MultiplyAddRegionKernel(eReedSolomonKernel kernel);
+
+// A description of the selected implementation, suitable for logging
+NSString * reedSolomonKernelDescription(void);
+
+// ========================================
+// The coefficients g[0] ... g[parityCount - 1] of the monic generator polynomial
+// g(x) = (x - alpha^0) ... (x - alpha^(parityCount - 1)), lowest degree first
+// ========================================
+void reedSolomonGeneratorPolynomial(uint16_t *generator, NSUInteger parityCount);
+
+// ========================================
+// Locate and size the errors in a codeword from its syndromes
+// syndromes[i] is the codeword evaluated at alpha^i, with the first symbol of the codeword the
+// coefficient of the highest power of x
+// On success returns the number of errors (at most parityCount / 2), storing each error's index
+// in the codeword in positions and the value to xor into the symbol in magnitudes
+// Returns -1 if the errors can't be corrected
+// ========================================
+NSInteger reedSolomonCorrectErrors(const uint16_t *syndromes, NSUInteger parityCount, NSUInteger codewordLength, NSUInteger *positions, uint16_t *magnitudes);
@@ -0,0 +1,461 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#include "ReedSolomonKernels.h"
+#include "CPUFeatures.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// ========================================
+// The x86 kernels rely on per-function target attributes, which require a
+// compiler that understands them; older compilers get the scalar code only
+// ========================================
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#  define ENABLE_X86_REED_SOLOMON_KERNELS 1
+#  include <immintrin.h>
+#endif
+
+#if defined(__arm64__) || defined(__aarch64__)
+#  define ENABLE_NEON_REED_SOLOMON_KERNEL 1
+#  include <arm_neon.h>
+#endif
+
+#define GF16_PRIMITIVE_POLYNOMIAL		0x1100B
+#define GF16_ORDER						65535
+
+static pthread_once_t					sGF16TablesOnce					= PTHREAD_ONCE_INIT;
+// The exponent table is doubled so the sum of two logarithms never needs reducing
+static uint16_t							sGF16Exp [2 * GF16_ORDER];
+static uint16_t							sGF16Log [GF16_FIELD_SIZE];
+
+static pthread_once_t					sReedSolomonKernelOnce			= PTHREAD_ONCE_INIT;
+static GF16MultiplyAddRegionFunction	sGF16MultiplyAddRegion			= NULL;
+static const char						*sReedSolomonKernelName			= NULL;
+
+// ========================================
+// Field tables
+// ========================================
+static void
+buildGF16Tables(void)
+{
+	uint32_t x = 1;
+	for(NSUInteger i = 0; i < GF16_ORDER; ++i) {
+		sGF16Exp[i] = (uint16_t)x;
+		sGF16Exp[i + GF16_ORDER] = (uint16_t)x;
+		sGF16Log[x] = (uint16_t)i;
+
+		x <<= 1;
+		if(x & GF16_FIELD_SIZE)
+			x ^= GF16_PRIMITIVE_POLYNOMIAL;
+	}
+
+	// log(0) is undefined; callers check for zero
+	sGF16Log[0] = 0;
+}
+
+static inline void
+ensureGF16Tables(void)
+{
+	pthread_once(&sGF16TablesOnce, buildGF16Tables);
+}
+
+uint16_t
+gf16Multiply(uint16_t a, uint16_t b)
+{
+	ensureGF16Tables();
+
+	if(!a || !b)
+		return 0;
+
+	return sGF16Exp[sGF16Log[a] + sGF16Log[b]];
+}
+
+uint16_t
+gf16Divide(uint16_t a, uint16_t b)
+{
+	NSCParameterAssert(0 != b);
+
+	ensureGF16Tables();
+
+	if(!a)
+		return 0;
+
+	return sGF16Exp[sGF16Log[a] + GF16_ORDER - sGF16Log[b]];
+}
+
+uint16_t
+gf16Power(NSUInteger exponent)
+{
+	ensureGF16Tables();
+
+	return sGF16Exp[exponent % GF16_ORDER];
+}
+
+// ========================================
+// Scalar reference implementation
+// ========================================
+static void
+gf16MultiplyAddRegionScalar(uint16_t *destination, const uint16_t *source, const uint16_t *addend, uint16_t constant, NSUInteger count)
+{
+	ensureGF16Tables();
+
+	if(!constant) {
+		if(addend)
+			memmove(destination, addend, count * sizeof(uint16_t));
+		else
+			memset(destination, 0, count * sizeof(uint16_t));
+		return;
+	}
+
+	uint32_t logConstant = sGF16Log[constant];
+
+	for(NSUInteger i = 0; i < count; ++i) {
+		uint16_t symbol = source[i];
+		uint16_t product = (symbol ? sGF16Exp[sGF16Log[symbol] + logConstant] : 0);
+		destination[i] = (addend ? addend[i] : 0) ^ product;
+	}
+}
+
+// ========================================
+// Multiplication by a constant is linear over GF(2), so the product of a symbol
+// is the xor of the products of its four nibbles
+// The vector kernels look these up with byte shuffles, 16 entries per table:
+// tables[2 * k] holds the low bytes and tables[2 * k + 1] the high bytes of
+// (n << 4k) * constant for nibble k
+// ========================================
+static void
+buildNibbleTables(uint16_t constant, uint8_t tables [8][16])
+{
+	for(NSUInteger k = 0; k < 4; ++k) {
+		for(NSUInteger n = 0; n < 16; ++n) {
+			uint16_t product = gf16Multiply((uint16_t)(n << (4 * k)), constant);
+			tables[2 * k][n] = (uint8_t)product;
+			tables[(2 * k) + 1][n] = (uint8_t)(product >> 8);
+		}
+	}
+}
+
+#if ENABLE_X86_REED_SOLOMON_KERNELS
+
+// ========================================
+// SSSE3, sixteen symbols at a time
+// The symbols are split into vectors of low and high bytes, each byte is split
+// into nibbles, and the nibbles index the product tables with pshufb
+// ========================================
+__attribute__((target("ssse3")))
+static void
+gf16MultiplyAddRegionSSSE3(uint16_t *destination, const uint16_t *source, const uint16_t *addend, uint16_t constant, NSUInteger count)
+{
+	uint8_t tables [8][16];
+	buildNibbleTables(constant, tables);
+
+	__m128i table [8];
+	for(NSUInteger k = 0; k < 8; ++k)
+		table[k] = _mm_loadu_si128((const __m128i *)tables[k]);
+
+	const __m128i lowByteMask = _mm_set1_epi16(0x00FF);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+	NSUInteger i = 0;
+	for(; i + 16 <= count; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(source + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(source + i + 8));
+
+		__m128i lowBytes = _mm_packus_epi16(_mm_and_si128(a, lowByteMask), _mm_and_si128(b, lowByteMask));
+		__m128i highBytes = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+
+		__m128i n0 = _mm_and_si128(lowBytes, nibbleMask);
+		__m128i n1 = _mm_and_si128(_mm_srli_epi16(lowBytes, 4), nibbleMask);
+		__m128i n2 = _mm_and_si128(highBytes, nibbleMask);
+		__m128i n3 = _mm_and_si128(_mm_srli_epi16(highBytes, 4), nibbleMask);
+
+		__m128i productLow = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(table[0], n0), _mm_shuffle_epi8(table[2], n1)),
+										   _mm_xor_si128(_mm_shuffle_epi8(table[4], n2), _mm_shuffle_epi8(table[6], n3)));
+		__m128i productHigh = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(table[1], n0), _mm_shuffle_epi8(table[3], n1)),
+											_mm_xor_si128(_mm_shuffle_epi8(table[5], n2), _mm_shuffle_epi8(table[7], n3)));
+
+		__m128i productA = _mm_unpacklo_epi8(productLow, productHigh);
+		__m128i productB = _mm_unpackhi_epi8(productLow, productHigh);
+
+		if(addend) {
+			productA = _mm_xor_si128(productA, _mm_loadu_si128((const __m128i *)(addend + i)));
+			productB = _mm_xor_si128(productB, _mm_loadu_si128((const __m128i *)(addend + i + 8)));
+		}
+
+		_mm_storeu_si128((__m128i *)(destination + i), productA);
+		_mm_storeu_si128((__m128i *)(destination + i + 8), productB);
+	}
+
+	if(i < count)
+		gf16MultiplyAddRegionScalar(destination + i, source + i, (addend ? addend + i : NULL), constant, count - i);
+}
+
+#endif /* ENABLE_X86_REED_SOLOMON_KERNELS */
+
+#if ENABLE_NEON_REED_SOLOMON_KERNEL
+
+// ========================================
+// NEON, sixteen symbols at a time
+// vld2q_u8 and vst2q_u8 split and rejoin the low and high bytes
+// ========================================
+static void
+gf16MultiplyAddRegionNEON(uint16_t *destination, const uint16_t *source, const uint16_t *addend, uint16_t constant, NSUInteger count)
+{
+	uint8_t tables [8][16];
+	buildNibbleTables(constant, tables);
+
+	uint8x16_t table [8];
+	for(NSUInteger k = 0; k < 8; ++k)
+		table[k] = vld1q_u8(tables[k]);
+
+	const uint8x16_t nibbleMask = vdupq_n_u8(0x0F);
+
+	NSUInteger i = 0;
+	for(; i + 16 <= count; i += 16) {
+		uint8x16x2_t symbols = vld2q_u8((const uint8_t *)(source + i));
+
+		uint8x16_t n0 = vandq_u8(symbols.val[0], nibbleMask);
+		uint8x16_t n1 = vshrq_n_u8(symbols.val[0], 4);
+		uint8x16_t n2 = vandq_u8(symbols.val[1], nibbleMask);
+		uint8x16_t n3 = vshrq_n_u8(symbols.val[1], 4);
+
+		uint8x16x2_t product;
+		product.val[0] = veorq_u8(veorq_u8(vqtbl1q_u8(table[0], n0), vqtbl1q_u8(table[2], n1)),
+								  veorq_u8(vqtbl1q_u8(table[4], n2), vqtbl1q_u8(table[6], n3)));
+		product.val[1] = veorq_u8(veorq_u8(vqtbl1q_u8(table[1], n0), vqtbl1q_u8(table[3], n1)),
+								  veorq_u8(vqtbl1q_u8(table[5], n2), vqtbl1q_u8(table[7], n3)));
+
+		if(addend) {
+			uint8x16x2_t addends = vld2q_u8((const uint8_t *)(addend + i));
+			product.val[0] = veorq_u8(product.val[0], addends.val[0]);
+			product.val[1] = veorq_u8(product.val[1], addends.val[1]);
+		}
+
+		vst2q_u8((uint8_t *)(destination + i), product);
+	}
+
+	if(i < count)
+		gf16MultiplyAddRegionScalar(destination + i, source + i, (addend ? addend + i : NULL), constant, count - i);
+}
+
+#endif /* ENABLE_NEON_REED_SOLOMON_KERNEL */
+
+// ========================================
+// Runtime selection of the implementation
+// ========================================
+static void
+selectReedSolomonKernel(void)
+{
+	ensureGF16Tables();
+
+	sGF16MultiplyAddRegion = gf16MultiplyAddRegionScalar;
+	sReedSolomonKernelName = "scalar";
+
+#if ENABLE_X86_REED_SOLOMON_KERNELS
+	if(cpuHasFeatures(eCPUFeatureSSSE3)) {
+		sGF16MultiplyAddRegion = gf16MultiplyAddRegionSSSE3;
+		sReedSolomonKernelName = "SSSE3";
+	}
+#endif
+
+#if ENABLE_NEON_REED_SOLOMON_KERNEL
+	if(cpuHasFeatures(eCPUFeatureNEON)) {
+		sGF16MultiplyAddRegion = gf16MultiplyAddRegionNEON;
+		sReedSolomonKernelName = "NEON";
+	}
+#endif
+}
+
+void
+gf16MultiplyAddRegion(uint16_t *destination, const uint16_t *source, const uint16_t *addend, uint16_t constant, NSUInteger count)
+{
+	NSCParameterAssert(NULL != destination);
+	NSCParameterAssert(NULL != source);
+
+	pthread_once(&sReedSolomonKernelOnce, selectReedSolomonKernel);
+
+	sGF16MultiplyAddRegion(destination, source, addend, constant, count);
+}
+
+GF16MultiplyAddRegionFunction
+gf16MultiplyAddRegionKernel(eReedSolomonKernel kernel)
+{
+	ensureGF16Tables();
+
+	switch(kernel) {
+		case eReedSolomonKernelScalar:
+			return gf16MultiplyAddRegionScalar;
+
+#if ENABLE_X86_REED_SOLOMON_KERNELS
+		case eReedSolomonKernelSSSE3:
+			return (cpuHasFeatures(eCPUFeatureSSSE3) ? gf16MultiplyAddRegionSSSE3 : NULL);
+#endif
+
+#if ENABLE_NEON_REED_SOLOMON_KERNEL
+		case eReedSolomonKernelNEON:
+			return (cpuHasFeatures(eCPUFeatureNEON) ? gf16MultiplyAddRegionNEON : NULL);
+#endif
+
+		default:
+			return NULL;
+	}
+}
+
+NSString *
+reedSolomonKernelDescription(void)
+{
+	pthread_once(&sReedSolomonKernelOnce, selectReedSolomonKernel);
+
+	return [NSString stringWithUTF8String:sReedSolomonKernelName];
+}
+
+// ========================================
+// Coding
+// ========================================
+void
+reedSolomonGeneratorPolynomial(uint16_t *generator, NSUInteger parityCount)
+{
+	NSCParameterAssert(NULL != generator);
+	NSCParameterAssert(0 < parityCount);
+
+	// Multiply out the factors, keeping the leading 1 implicit in coefficient[parityCount]
+	uint16_t coefficients [parityCount + 1];
+	memset(coefficients, 0, sizeof(coefficients));
+	coefficients[0] = 1;
+
+	for(NSUInteger i = 0; i < parityCount; ++i) {
+		uint16_t root = gf16Power(i);
+
+		// Multiply by (x + root)
+		for(NSUInteger j = i + 1; j > 0; --j)
+			coefficients[j] = coefficients[j - 1] ^ gf16Multiply(coefficients[j], root);
+		coefficients[0] = gf16Multiply(coefficients[0], root);
+	}
+
+	memcpy(generator, coefficients, parityCount * sizeof(uint16_t));
+}
+
+NSInteger
+reedSolomonCorrectErrors(const uint16_t *syndromes, NSUInteger parityCount, NSUInteger codewordLength, NSUInteger *positions, uint16_t *magnitudes)
+{
+	NSCParameterAssert(NULL != syndromes);
+	NSCParameterAssert(NULL != positions);
+	NSCParameterAssert(NULL != magnitudes);
+	NSCParameterAssert(codewordLength <= GF16_MAXIMUM_CODEWORD_LENGTH);
+
+	ensureGF16Tables();
+
+	NSUInteger i, j;
+
+	BOOL noErrors = YES;
+	for(i = 0; i < parityCount; ++i) {
+		if(syndromes[i]) {
+			noErrors = NO;
+			break;
+		}
+	}
+
+	if(noErrors)
+		return 0;
+
+	// Find the error locator polynomial (Berlekamp-Massey)
+	uint16_t locator [parityCount + 1];
+	uint16_t previousLocator [parityCount + 1];
+	uint16_t temporary [parityCount + 1];
+
+	memset(locator, 0, sizeof(locator));
+	memset(previousLocator, 0, sizeof(previousLocator));
+	locator[0] = 1;
+	previousLocator[0] = 1;
+
+	NSUInteger errorCount = 0;
+	NSUInteger shift = 1;
+	uint16_t previousDiscrepancy = 1;
+
+	for(i = 0; i < parityCount; ++i) {
+		uint16_t discrepancy = syndromes[i];
+		for(j = 1; j <= errorCount; ++j)
+			discrepancy ^= gf16Multiply(locator[j], syndromes[i - j]);
+
+		if(!discrepancy) {
+			++shift;
+			continue;
+		}
+
+		uint16_t scale = gf16Divide(discrepancy, previousDiscrepancy);
+		memcpy(temporary, locator, sizeof(locator));
+
+		for(j = 0; j + shift <= parityCount; ++j)
+			locator[j + shift] ^= gf16Multiply(scale, previousLocator[j]);
+
+		if(2 * errorCount <= i) {
+			errorCount = i + 1 - errorCount;
+			memcpy(previousLocator, temporary, sizeof(temporary));
+			previousDiscrepancy = discrepancy;
+			shift = 1;
+		}
+		else
+			++shift;
+	}
+
+	if(2 * errorCount > parityCount)
+		return -1;
+
+	// The error evaluator polynomial, S(x) * locator(x) mod x^parityCount
+	uint16_t evaluator [parityCount];
+	for(i = 0; i < parityCount; ++i) {
+		evaluator[i] = 0;
+		for(j = 0; j <= i && j <= errorCount; ++j)
+			evaluator[i] ^= gf16Multiply(locator[j], syndromes[i - j]);
+	}
+
+	// Find the roots of the locator (Chien search); a root at alpha^-p is an error in the
+	// coefficient of x^p, which is the symbol at codewordLength - 1 - p
+	NSUInteger rootsFound = 0;
+	for(NSUInteger power = 0; power < codewordLength && rootsFound < errorCount; ++power) {
+		NSUInteger inverseExponent = (GF16_ORDER - power) % GF16_ORDER;
+
+		uint16_t value = locator[0];
+		for(j = 1; j <= errorCount; ++j) {
+			if(locator[j])
+				value ^= sGF16Exp[sGF16Log[locator[j]] + ((j * inverseExponent) % GF16_ORDER)];
+		}
+
+		if(value)
+			continue;
+
+		// Forney: magnitude = X * evaluator(X^-1) / locator'(X^-1), with X = alpha^p
+		uint16_t inverseLocation = gf16Power(inverseExponent);
+
+		uint16_t numerator = 0;
+		uint16_t x = 1;
+		for(j = 0; j < parityCount; ++j) {
+			numerator ^= gf16Multiply(evaluator[j], x);
+			x = gf16Multiply(x, inverseLocation);
+		}
+
+		// The formal derivative keeps only the odd powers
+		uint16_t denominator = 0;
+		x = 1;
+		for(j = 1; j <= errorCount; j += 2) {
+			denominator ^= gf16Multiply(locator[j], x);
+			x = gf16Multiply(x, gf16Multiply(inverseLocation, inverseLocation));
+		}
+
+		if(!denominator)
+			return -1;
+
+		positions[rootsFound] = codewordLength - 1 - power;
+		magnitudes[rootsFound] = gf16Multiply(gf16Power(power), gf16Divide(numerator, denominator));
+		++rootsFound;
+	}
+
+	// Too many errors to locate
+	if(rootsFound != errorCount)
+		return -1;
+
+	return (NSInteger)errorCount;
+}
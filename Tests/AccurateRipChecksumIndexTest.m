@@ -0,0 +1,68 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "AccurateRipChecksumIndexTest.h"
+
+#import "AccurateRipChecksumIndex.h"
+
+// ========================================
+// Append a dBAR pressing record whose tracks have the given checksums
+// The offset checksum of each track is its checksum plus one
+// ========================================
+static void
+appendPressing(NSMutableData *responseData, uint8_t trackCount, const uint32_t *checksums, uint8_t confidenceLevel)
+{
+	uint8_t header [1 + 4 + 4 + 4] = { trackCount };
+	[responseData appendBytes:header length:sizeof(header)];
+
+	for(uint8_t i = 0; i < trackCount; ++i) {
+		uint8_t track [1 + 4 + 4];
+		track[0] = confidenceLevel;
+		OSWriteLittleInt32(track, 1, checksums[i]);
+		OSWriteLittleInt32(track, 1 + 4, checksums[i] + 1);
+		[responseData appendBytes:track length:sizeof(track)];
+	}
+}
+
+@implementation AccurateRipChecksumIndexTest
+
+- (void) testResponseWithMixedTrackCounts
+{
+	const uint32_t firstPressing [] = { 0x11111111, 0x22222222 };
+	const uint32_t otherPressing [] = { 0x33333333, 0x44444444, 0x55555555 };
+	const uint32_t secondPressing [] = { 0x66666666, 0x77777777 };
+
+	// A pressing with a different track count in the middle changes the stride of the records that follow it
+	NSMutableData *responseData = [NSMutableData data];
+	appendPressing(responseData, 2, firstPressing, 3);
+	appendPressing(responseData, 3, otherPressing, 4);
+	appendPressing(responseData, 2, secondPressing, 5);
+
+	// A truncated record is ignored
+	appendPressing(responseData, 2, firstPressing, 6);
+	[responseData setLength:([responseData length] - 1)];
+
+	AccurateRipChecksumIndex *checksumIndex = [AccurateRipChecksumIndex checksumIndexWithDatabaseResponse:responseData trackCount:2];
+	STAssertNotNil(checksumIndex, @"Unable to index the response");
+	STAssertEquals(checksumIndex.pressingCount, (NSUInteger)2, @"Pressing count");
+
+	AccurateRipChecksumEntry match;
+	STAssertTrue([checksumIndex findChecksum:0x11111111 forTrackNumber:1 match:&match], @"Checksum from the first pressing");
+	STAssertEquals(match.pressingIndex, (uint32_t)0, @"Pressing index");
+	STAssertEquals(match.confidenceLevel, (uint32_t)3, @"Confidence level");
+
+	STAssertTrue([checksumIndex findChecksum:0x77777777 forTrackNumber:2 match:&match], @"Checksum following a pressing with a different track count");
+	STAssertEquals(match.pressingIndex, (uint32_t)1, @"Pressing index");
+	STAssertEquals(match.confidenceLevel, (uint32_t)5, @"Confidence level");
+
+	STAssertFalse([checksumIndex findChecksum:0x33333333 forTrackNumber:1 match:NULL], @"Checksum from a pressing with a different track count");
+	STAssertFalse([checksumIndex findChecksum:0x22222222 forTrackNumber:1 match:NULL], @"Checksum for the wrong track");
+
+	// Offset checksums are read from the same records
+	checksumIndex = [[AccurateRipChecksumIndex alloc] initWithDatabaseResponse:responseData trackCount:2 useOffsetChecksums:YES];
+	STAssertTrue([checksumIndex findChecksum:(0x66666666 + 1) forTrackNumber:1 match:NULL], @"Offset checksum following a pressing with a different track count");
+}
+
+@end
@@ -0,0 +1,12 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import <SenTestingKit/SenTestingKit.h>
+
+@interface AccurateRipKernelsTest : SenTestCase
+{
+}
+
+@end
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "AccurateRipKernelsTest.h"
+
+#import "AccurateRipKernels.h"
+#import "CDDAUtilities.h"
+#import "TestUtilities.h"
+
+#include <IOKit/storage/IOCDTypes.h>
+
+@interface AccurateRipKernelsTest (Private)
+- (void) compareKernel:(eAccurateRipKernel)kernel name:(NSString *)name;
+@end
+
+@implementation AccurateRipKernelsTest
+
+- (void) testSSE41Kernel
+{
+	[self compareKernel:eAccurateRipKernelSSE41 name:@"SSE4.1"];
+}
+
+- (void) testAVX2Kernel
+{
+	[self compareKernel:eAccurateRipKernelAVX2 name:@"AVX2"];
+}
+
+- (void) testNEONKernel
+{
+	[self compareKernel:eAccurateRipKernelNEON name:@"NEON"];
+}
+
+- (void) testKnownSums
+{
+	uint32_t block [AUDIO_FRAMES_PER_CDDA_SECTOR];
+	for(NSUInteger i = 0; i < AUDIO_FRAMES_PER_CDDA_SECTOR; ++i)
+		block[i] = OSSwapHostToLittleInt32(0xFFFFFFFF);
+
+	AccurateRipBlockSums sums;
+	accurateRipBlockSums(block, 1, &sums);
+
+	// sum(0xFFFFFFFF * i) for i = 1 ... 588 is 0xFFFFFFFF * 173166
+	uint64_t weightedSum = 0xFFFFFFFFULL * 173166;
+	uint32_t highWords = 0;
+	for(uint64_t i = 1; i <= AUDIO_FRAMES_PER_CDDA_SECTOR; ++i)
+		highWords += (uint32_t)((0xFFFFFFFFULL * i) >> 32);
+
+	STAssertEquals(sums.sumOfSamples, (uint32_t)(0xFFFFFFFFULL * AUDIO_FRAMES_PER_CDDA_SECTOR), @"sumOfSamples");
+	STAssertEquals(sums.sumOfSamplesAndPositions, (uint32_t)weightedSum, @"sumOfSamplesAndPositions");
+	STAssertEquals(sums.sumOfProductHighWords, highWords, @"sumOfProductHighWords");
+}
+
+@end
+
+@implementation AccurateRipKernelsTest (Private)
+
+- (void) compareKernel:(eAccurateRipKernel)kernel name:(NSString *)name
+{
+	AccurateRipBlockSumsFunction reference = accurateRipBlockSumsKernel(eAccurateRipKernelScalar);
+	AccurateRipBlockSumsFunction candidate = accurateRipBlockSumsKernel(kernel);
+
+	RETURN_IF_KERNEL_UNSUPPORTED(candidate);
+
+	// The extra bytes allow unaligned blocks to be tested
+	uint8_t buffer [kCDSectorSizeCDDA + MAXIMUM_ALIGNMENT];
+	uint64_t state = TEST_RANDOM_SEED;
+
+	const uint32_t positions [] = { 0, 1, 2, 588, 589, 588 * 4 + 1, 0x7FFFFFFF, 0xFFFFFFFF - AUDIO_FRAMES_PER_CDDA_SECTOR, 0xFFFFFFFF - 3, 0xFFFFFFFF };
+	const NSUInteger positionCount = sizeof(positions) / sizeof(positions[0]);
+
+	for(NSUInteger alignment = 0; alignment < MAXIMUM_ALIGNMENT; ++alignment) {
+		uint8_t *block = buffer + alignment;
+
+		// A single non-zero frame in every position exercises every lane and the remainder handling
+		for(NSUInteger frame = 0; frame < AUDIO_FRAMES_PER_CDDA_SECTOR; ++frame) {
+			memset(block, 0, kCDSectorSizeCDDA);
+			memset(block + (4 * frame), 0xFF, 4);
+
+			for(NSUInteger i = 0; i < positionCount; ++i) {
+				AccurateRipBlockSums expected, actual;
+				reference(block, positions[i], &expected);
+				candidate(block, positions[i], &actual);
+
+				STAssertTrue(0 == memcmp(&expected, &actual, sizeof(AccurateRipBlockSums)), @"%@ kernel mismatch for frame %lu at position %u (alignment %lu)", name, frame, positions[i], alignment);
+			}
+		}
+
+		// Random audio at random and boundary positions
+		for(NSUInteger iteration = 0; iteration < 1000; ++iteration) {
+			for(NSUInteger i = 0; i < kCDSectorSizeCDDA; i += 4) {
+				uint32_t value = nextRandom(&state);
+				memcpy(block + i, &value, 4);
+			}
+
+			uint32_t position = (iteration < positionCount ? positions[iteration] : nextRandom(&state));
+
+			AccurateRipBlockSums expected, actual;
+			reference(block, position, &expected);
+			candidate(block, position, &actual);
+
+			STAssertTrue(0 == memcmp(&expected, &actual, sizeof(AccurateRipBlockSums)), @"%@ kernel mismatch for random block %lu at position %u (alignment %lu)", name, iteration, position, alignment);
+		}
+	}
+}
+
+@end
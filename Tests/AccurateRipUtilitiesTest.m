@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "AccurateRipUtilitiesTest.h"
+
+#import "AccurateRipUtilities.h"
+#import "CDDAUtilities.h"
+#import "SectorStore.h"
+#import "TestUtilities.h"
+
+#define STORE_SECTOR_COUNT 8
+
+// ========================================
+// The checksums calculated directly from their definition, with frames outside the store as silence
+// ========================================
+static uint32_t
+referenceChecksum(const uint32_t *frames, NSInteger frameCount, NSInteger firstFrame, NSUInteger blockCount, uint32_t *checksumV2)
+{
+	uint32_t checksum = 0;
+	uint32_t v2 = 0;
+
+	for(NSUInteger i = 0; i < blockCount * AUDIO_FRAMES_PER_CDDA_SECTOR; ++i) {
+		NSInteger frame = firstFrame + (NSInteger)i;
+		if(0 > frame || frame >= frameCount)
+			continue;
+
+		uint64_t product = (uint64_t)OSSwapLittleToHostInt32(frames[frame]) * (uint64_t)(i + 1);
+		checksum += (uint32_t)product;
+		v2 += (uint32_t)product + (uint32_t)(product >> 32);
+	}
+
+	*checksumV2 = v2;
+
+	return checksum;
+}
+
+@implementation AccurateRipUtilitiesTest
+
+- (void) testRegionChecksumsAtStoreBoundaries
+{
+	uint32_t frames [STORE_SECTOR_COUNT * AUDIO_FRAMES_PER_CDDA_SECTOR];
+	NSInteger frameCount = STORE_SECTOR_COUNT * AUDIO_FRAMES_PER_CDDA_SECTOR;
+
+	uint64_t state = TEST_RANDOM_SEED;
+	for(NSInteger i = 0; i < frameCount; ++i)
+		frames[i] = nextRandom(&state);
+
+	SectorStore *sectorStore = [SectorStore sectorStore];
+	STAssertTrue([sectorStore appendAudio:frames byteCount:sizeof(frames) error:NULL], @"Unable to fill the sector store");
+
+	// The whole store, each end of it and the middle
+	const NSRange regions [] = { { 0, STORE_SECTOR_COUNT }, { 0, 3 }, { STORE_SECTOR_COUNT - 3, 3 }, { 3, 2 } };
+
+	// Offsets within a sector, of whole sectors, reaching exactly to and beyond each end of the store, and missing it entirely
+	const NSInteger offsets [] = { 
+		0, 1, AUDIO_FRAMES_PER_CDDA_SECTOR - 1, AUDIO_FRAMES_PER_CDDA_SECTOR, AUDIO_FRAMES_PER_CDDA_SECTOR + 1, 3 * AUDIO_FRAMES_PER_CDDA_SECTOR, 
+		frameCount - 1, frameCount, frameCount + 1, frameCount + (4 * AUDIO_FRAMES_PER_CDDA_SECTOR) + 7 
+	};
+
+	for(NSUInteger regionIndex = 0; regionIndex < sizeof(regions) / sizeof(regions[0]); ++regionIndex) {
+		NSRange region = regions[regionIndex];
+
+		for(NSUInteger offsetIndex = 0; offsetIndex < sizeof(offsets) / sizeof(offsets[0]); ++offsetIndex) {
+			for(NSInteger sign = -1; sign <= 1; sign += 2) {
+				NSInteger offset = sign * offsets[offsetIndex];
+
+				uint32_t expectedV2, actualV2;
+				uint32_t expected = referenceChecksum(frames, frameCount, (NSInteger)(region.location * AUDIO_FRAMES_PER_CDDA_SECTOR) + offset, region.length, &expectedV2);
+				uint32_t actual = calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(sectorStore, region, NO, NO, offset, &actualV2);
+
+				STAssertEquals(expected, actual, @"v1 checksum mismatch for sectors %@ at offset %ld", NSStringFromRange(region), (long)offset);
+				STAssertEquals(expectedV2, actualV2, @"v2 checksum mismatch for sectors %@ at offset %ld", NSStringFromRange(region), (long)offset);
+			}
+		}
+	}
+
+	// Without an offset the region checksum must agree with the whole-store checksum
+	uint32_t wholeStoreV2, regionV2;
+	uint32_t wholeStore = calculateAccurateRipChecksumForSectorStore(sectorStore, YES, YES, &wholeStoreV2);
+	uint32_t region = calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(sectorStore, NSMakeRange(0, STORE_SECTOR_COUNT), YES, YES, 0, &regionV2);
+
+	STAssertEquals(wholeStore, region, @"v1 checksum mismatch for the whole store");
+	STAssertEquals(wholeStoreV2, regionV2, @"v2 checksum mismatch for the whole store");
+
+	[sectorStore close];
+}
+
+@end
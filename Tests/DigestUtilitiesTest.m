@@ -0,0 +1,155 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "DigestUtilitiesTest.h"
+
+#import "DigestUtilities.h"
+#import "TestUtilities.h"
+
+// The largest buffer compared
+#define MAXIMUM_LENGTH		(64 * 1024)
+
+@interface DigestUtilitiesTest (Private)
+- (void) compareSHA1Kernel:(eSHA1Kernel)kernel name:(NSString *)name;
+- (void) compareCRC32Kernel:(eCRC32Kernel)kernel name:(NSString *)name;
+@end
+
+@implementation DigestUtilitiesTest
+
+- (void) testSHANIKernel
+{
+	[self compareSHA1Kernel:eSHA1KernelSHANI name:@"SHA-NI"];
+}
+
+- (void) testARMSHA1Kernel
+{
+	[self compareSHA1Kernel:eSHA1KernelARM name:@"ARMv8 SHA1"];
+}
+
+- (void) testPCLMULKernel
+{
+	[self compareCRC32Kernel:eCRC32KernelPCLMUL name:@"PCLMULQDQ"];
+}
+
+- (void) testARMCRC32Kernel
+{
+	[self compareCRC32Kernel:eCRC32KernelARM name:@"ARMv8 CRC32"];
+}
+
+- (void) testKnownDigests
+{
+	// FIPS 180-1 test vector
+	SHA1Context context;
+	uint8_t digest [SHA1_DIGEST_LENGTH];
+	sha1Init(&context);
+	sha1Update(&context, "abc", 3);
+	sha1Final(&context, digest);
+
+	STAssertEqualObjects(hexStringForDigest(digest, SHA1_DIGEST_LENGTH), @"a9993e364706816aba3e25717850c26c9cd0d89d", @"SHA1");
+
+	// The CRC32 check value
+	STAssertEquals(crc32Update(0, "123456789", 9), (uint32_t)0xCBF43926, @"CRC32");
+}
+
+- (void) testSHA1AgainstCommonCrypto
+{
+	uint8_t *buffer = malloc(MAXIMUM_LENGTH + MAXIMUM_ALIGNMENT);
+	STAssertTrue(NULL != buffer, @"Unable to allocate memory");
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	// The selected implementation, fed in odd-sized pieces, must match CommonCrypto for unaligned data of odd lengths
+	for(NSUInteger iteration = 0; iteration < 200; ++iteration) {
+		size_t alignment = nextRandom(&state) % MAXIMUM_ALIGNMENT;
+		size_t length = (iteration < 130 ? iteration : (nextRandom(&state) % MAXIMUM_LENGTH));
+		uint8_t *data = buffer + alignment;
+		fillRandom(data, length, &state);
+
+		uint8_t expected [CC_SHA1_DIGEST_LENGTH];
+		CC_SHA1(data, (CC_LONG)length, expected);
+
+		SHA1Context context;
+		uint8_t actual [SHA1_DIGEST_LENGTH];
+		sha1Init(&context);
+		for(size_t offset = 0; offset < length; ) {
+			size_t pieceLength = MIN(length - offset, 1 + (nextRandom(&state) % 157));
+			sha1Update(&context, data + offset, pieceLength);
+			offset += pieceLength;
+		}
+		sha1Final(&context, actual);
+
+		STAssertTrue(0 == memcmp(expected, actual, SHA1_DIGEST_LENGTH), @"SHA1 mismatch for length %lu (alignment %lu)", length, alignment);
+	}
+
+	free(buffer);
+}
+
+@end
+
+@implementation DigestUtilitiesTest (Private)
+
+- (void) compareSHA1Kernel:(eSHA1Kernel)kernel name:(NSString *)name
+{
+	SHA1BlocksFunction reference = sha1BlocksKernel(eSHA1KernelPortable);
+	SHA1BlocksFunction candidate = sha1BlocksKernel(kernel);
+
+	RETURN_IF_KERNEL_UNSUPPORTED(candidate);
+
+	uint8_t *buffer = malloc(MAXIMUM_LENGTH + MAXIMUM_ALIGNMENT);
+	STAssertTrue(NULL != buffer, @"Unable to allocate memory");
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	for(NSUInteger iteration = 0; iteration < 500; ++iteration) {
+		size_t alignment = iteration % MAXIMUM_ALIGNMENT;
+		size_t blockCount = (iteration < 20 ? iteration : (nextRandom(&state) % (MAXIMUM_LENGTH / 64)));
+		uint8_t *data = buffer + alignment;
+		fillRandom(data, 64 * blockCount, &state);
+
+		// Start from a random state, as if continuing a longer message
+		uint32_t expected [5], actual [5];
+		for(unsigned i = 0; i < 5; ++i)
+			expected[i] = actual[i] = nextRandom(&state);
+
+		reference(expected, data, blockCount);
+		candidate(actual, data, blockCount);
+
+		STAssertTrue(0 == memcmp(expected, actual, sizeof(expected)), @"%@ kernel mismatch for %lu blocks (alignment %lu)", name, blockCount, alignment);
+	}
+
+	free(buffer);
+}
+
+- (void) compareCRC32Kernel:(eCRC32Kernel)kernel name:(NSString *)name
+{
+	CRC32Function reference = crc32Kernel(eCRC32KernelSliceBy16);
+	CRC32Function candidate = crc32Kernel(kernel);
+
+	RETURN_IF_KERNEL_UNSUPPORTED(candidate);
+
+	uint8_t *buffer = malloc(MAXIMUM_LENGTH + MAXIMUM_ALIGNMENT);
+	STAssertTrue(NULL != buffer, @"Unable to allocate memory");
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	// Every length around the folding thresholds, then random (mostly odd) lengths
+	for(NSUInteger iteration = 0; iteration < 1000; ++iteration) {
+		size_t alignment = iteration % MAXIMUM_ALIGNMENT;
+		size_t length = (iteration < 300 ? iteration : (nextRandom(&state) % MAXIMUM_LENGTH));
+		uint8_t *data = buffer + alignment;
+		fillRandom(data, length, &state);
+
+		uint32_t crc = (iteration & 1 ? nextRandom(&state) : ~0u);
+
+		uint32_t expected = reference(crc, data, length);
+		uint32_t actual = candidate(crc, data, length);
+
+		STAssertEquals(expected, actual, @"%@ kernel mismatch for length %lu (alignment %lu)", name, length, alignment);
+	}
+
+	free(buffer);
+}
+
+@end
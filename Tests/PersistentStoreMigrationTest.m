@@ -0,0 +1,180 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "PersistentStoreMigrationTest.h"
+
+#import "PersistentStoreMigration.h"
+
+// ========================================
+// Build a model in which Owner has a to-one and a to-many relationship to Item,
+// which has the subentity SpecialItem
+// The second version adds an attribute to Owner
+// ========================================
+static NSAttributeDescription *
+stringAttribute(NSString *name)
+{
+	NSAttributeDescription *attribute = [[NSAttributeDescription alloc] init];
+	[attribute setName:name];
+	[attribute setAttributeType:NSStringAttributeType];
+	[attribute setOptional:YES];
+	return attribute;
+}
+
+static NSRelationshipDescription *
+relationship(NSString *name, NSEntityDescription *destinationEntity, BOOL toMany)
+{
+	NSRelationshipDescription *relationship = [[NSRelationshipDescription alloc] init];
+	[relationship setName:name];
+	[relationship setDestinationEntity:destinationEntity];
+	[relationship setMinCount:0];
+	[relationship setMaxCount:(toMany ? 0 : 1)];
+	[relationship setOptional:YES];
+	[relationship setDeleteRule:NSNullifyDeleteRule];
+	return relationship;
+}
+
+static NSManagedObjectModel *
+testModel(BOOL secondVersion)
+{
+	NSEntityDescription *owner = [[NSEntityDescription alloc] init];
+	[owner setName:@"Owner"];
+	[owner setManagedObjectClassName:@"NSManagedObject"];
+
+	NSEntityDescription *item = [[NSEntityDescription alloc] init];
+	[item setName:@"Item"];
+	[item setManagedObjectClassName:@"NSManagedObject"];
+
+	NSEntityDescription *specialItem = [[NSEntityDescription alloc] init];
+	[specialItem setName:@"SpecialItem"];
+	[specialItem setManagedObjectClassName:@"NSManagedObject"];
+
+	NSRelationshipDescription *items = relationship(@"items", item, YES);
+	NSRelationshipDescription *itemOwner = relationship(@"owner", owner, NO);
+	[items setInverseRelationship:itemOwner];
+	[itemOwner setInverseRelationship:items];
+
+	NSRelationshipDescription *favorite = relationship(@"favorite", item, NO);
+	NSRelationshipDescription *favoriteOf = relationship(@"favoriteOf", owner, NO);
+	[favorite setInverseRelationship:favoriteOf];
+	[favoriteOf setInverseRelationship:favorite];
+
+	NSMutableArray *ownerProperties = [NSMutableArray arrayWithObjects:stringAttribute(@"name"), items, favorite, nil];
+	if(secondVersion)
+		[ownerProperties addObject:stringAttribute(@"note")];
+
+	[owner setProperties:ownerProperties];
+	[item setProperties:[NSArray arrayWithObjects:stringAttribute(@"name"), itemOwner, favoriteOf, nil]];
+	[specialItem setProperties:[NSArray arrayWithObject:stringAttribute(@"detail")]];
+	[item setSubentities:[NSArray arrayWithObject:specialItem]];
+
+	NSManagedObjectModel *model = [[NSManagedObjectModel alloc] init];
+	[model setEntities:[NSArray arrayWithObjects:owner, item, specialItem, nil]];
+
+	return model;
+}
+
+static NSManagedObjectContext *
+contextForStore(NSURL *storeURL, NSManagedObjectModel *model)
+{
+	NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+	if(![coordinator addPersistentStoreWithType:NSSQLiteStoreType configuration:nil URL:storeURL options:nil error:NULL])
+		return nil;
+
+	NSManagedObjectContext *context = [[NSManagedObjectContext alloc] init];
+	[context setPersistentStoreCoordinator:coordinator];
+	return context;
+}
+
+static NSManagedObject *
+objectNamed(NSManagedObjectContext *context, NSString *entityName, NSString *name)
+{
+	NSFetchRequest *fetchRequest = [[NSFetchRequest alloc] init];
+	[fetchRequest setEntity:[NSEntityDescription entityForName:entityName inManagedObjectContext:context]];
+	[fetchRequest setPredicate:[NSPredicate predicateWithFormat:@"name == %@", name]];
+
+	return [[context executeFetchRequest:fetchRequest error:NULL] lastObject];
+}
+
+static NSUInteger
+countOfEntity(NSManagedObjectContext *context, NSString *entityName)
+{
+	NSFetchRequest *fetchRequest = [[NSFetchRequest alloc] init];
+	[fetchRequest setEntity:[NSEntityDescription entityForName:entityName inManagedObjectContext:context]];
+
+	return [context countForFetchRequest:fetchRequest error:NULL];
+}
+
+@implementation PersistentStoreMigrationTest
+
+- (void) testMigrationPreservesRelationshipsToSubentities
+{
+	NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSProcessInfo processInfo] globallyUniqueString]];
+	STAssertTrue([[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL], @"Unable to create the test directory");
+
+	NSURL *storeURL = [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:@"Test.sqlite"]];
+	NSManagedObjectModel *sourceModel = testModel(NO);
+	NSManagedObjectModel *destinationModel = testModel(YES);
+
+	// Populate a store using the first version of the model
+	NSManagedObjectContext *context = contextForStore(storeURL, sourceModel);
+	STAssertNotNil(context, @"Unable to create the baseline store");
+
+	NSManagedObject *firstOwner = [NSEntityDescription insertNewObjectForEntityForName:@"Owner" inManagedObjectContext:context];
+	NSManagedObject *secondOwner = [NSEntityDescription insertNewObjectForEntityForName:@"Owner" inManagedObjectContext:context];
+	NSManagedObject *plainItem = [NSEntityDescription insertNewObjectForEntityForName:@"Item" inManagedObjectContext:context];
+	NSManagedObject *otherPlainItem = [NSEntityDescription insertNewObjectForEntityForName:@"Item" inManagedObjectContext:context];
+	NSManagedObject *specialItem = [NSEntityDescription insertNewObjectForEntityForName:@"SpecialItem" inManagedObjectContext:context];
+
+	[firstOwner setValue:@"first" forKey:@"name"];
+	[secondOwner setValue:@"second" forKey:@"name"];
+	[plainItem setValue:@"plain" forKey:@"name"];
+	[otherPlainItem setValue:@"other" forKey:@"name"];
+	[specialItem setValue:@"special" forKey:@"name"];
+	[specialItem setValue:@"detail" forKey:@"detail"];
+
+	[firstOwner setValue:[NSSet setWithObjects:plainItem, specialItem, nil] forKey:@"items"];
+	[firstOwner setValue:specialItem forKey:@"favorite"];
+	[secondOwner setValue:[NSSet setWithObject:otherPlainItem] forKey:@"items"];
+	[secondOwner setValue:otherPlainItem forKey:@"favorite"];
+
+	STAssertTrue([context save:NULL], @"Unable to save the baseline store");
+
+	NSPersistentStoreCoordinator *coordinator = [context persistentStoreCoordinator];
+	for(NSPersistentStore *store in [coordinator persistentStores])
+		[coordinator removePersistentStore:store error:NULL];
+	context = nil;
+
+	NSError *error = nil;
+	STAssertTrue(migratePersistentStore(storeURL, NSSQLiteStoreType, destinationModel, [NSArray arrayWithObject:sourceModel], &error), @"Migration failed: %@", error);
+
+	// Each instance is migrated once, and relationships point to instances of the correct entity
+	context = contextForStore(storeURL, destinationModel);
+	STAssertNotNil(context, @"Unable to open the migrated store");
+
+	STAssertEquals(countOfEntity(context, @"Owner"), (NSUInteger)2, @"Owner count");
+	STAssertEquals(countOfEntity(context, @"Item"), (NSUInteger)3, @"Item count (including subentities)");
+	STAssertEquals(countOfEntity(context, @"SpecialItem"), (NSUInteger)1, @"SpecialItem count");
+
+	firstOwner = objectNamed(context, @"Owner", @"first");
+	secondOwner = objectNamed(context, @"Owner", @"second");
+	STAssertNotNil(firstOwner, @"First owner missing");
+	STAssertNotNil(secondOwner, @"Second owner missing");
+
+	NSManagedObject *favorite = [firstOwner valueForKey:@"favorite"];
+	STAssertEqualObjects([[favorite entity] name], @"SpecialItem", @"To-one relationship to a subentity");
+	STAssertEqualObjects([favorite valueForKey:@"name"], @"special", @"To-one relationship to a subentity");
+	STAssertEqualObjects([favorite valueForKey:@"detail"], @"detail", @"Subentity attribute");
+
+	favorite = [secondOwner valueForKey:@"favorite"];
+	STAssertEqualObjects([[favorite entity] name], @"Item", @"To-one relationship");
+	STAssertEqualObjects([favorite valueForKey:@"name"], @"other", @"To-one relationship");
+
+	NSSet *itemNames = [[firstOwner valueForKey:@"items"] valueForKey:@"name"];
+	STAssertEqualObjects(itemNames, ([NSSet setWithObjects:@"plain", @"special", nil]), @"To-many relationship");
+
+	[[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+@end
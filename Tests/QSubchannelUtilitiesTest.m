@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "QSubchannelUtilitiesTest.h"
+
+#import "QSubchannelUtilities.h"
+
+// Track 2, index 1, relative 00:02:10, absolute 03:04:05
+static const uint8_t sPositionFrame [kCDSectorSizeQSubchannel] = { 0x01, 0x02, 0x01, 0x00, 0x02, 0x10, 0x00, 0x03, 0x04, 0x05, 0x5B, 0x25, 0x00, 0x00, 0x00, 0x00 };
+
+@implementation QSubchannelUtilitiesTest
+
+- (void) testCRC
+{
+	STAssertEquals((uint16_t)0xA4DA, calculateQSubchannelCRC(sPositionFrame), @"calculateQSubchannelCRC");
+	STAssertTrue(qSubchannelCRCIsValid(sPositionFrame), @"qSubchannelCRCIsValid");
+
+	uint8_t corruptFrame [kCDSectorSizeQSubchannel];
+	memcpy(corruptFrame, sPositionFrame, sizeof(corruptFrame));
+	corruptFrame[3] ^= 0x01;
+
+	STAssertFalse(qSubchannelCRCIsValid(corruptFrame), @"qSubchannelCRCIsValid");
+}
+
+- (void) testDecodeFrames
+{
+	uint8_t buffer [3 * kCDSectorSizeQSubchannel];
+
+	// A valid frame, a corrupt frame and a frame without a CRC
+	memcpy(buffer, sPositionFrame, kCDSectorSizeQSubchannel);
+	memcpy(buffer + kCDSectorSizeQSubchannel, sPositionFrame, kCDSectorSizeQSubchannel);
+	buffer[kCDSectorSizeQSubchannel + 2] = 0x00;
+	memcpy(buffer + (2 * kCDSectorSizeQSubchannel), sPositionFrame, kCDSectorSizeQSubchannel);
+	buffer[(2 * kCDSectorSizeQSubchannel) + 10] = 0x00;
+	buffer[(2 * kCDSectorSizeQSubchannel) + 11] = 0x00;
+
+	QSubchannelFrame frames [3];
+	NSUInteger validFrameCount = decodeQSubchannelFrames(buffer, kCDSectorSizeQSubchannel, 3, frames);
+
+	STAssertEquals(validFrameCount, (NSUInteger)2, @"decodeQSubchannelFrames");
+
+	STAssertEquals(frames[0].adr, (uint8_t)1, @"adr");
+	STAssertEquals(frames[0].trackNumber, (uint8_t)2, @"trackNumber");
+	STAssertEquals(frames[0].index, (uint8_t)1, @"index");
+	STAssertEquals(frames[0].relativeMSF.second, (uint8_t)2, @"relativeMSF");
+	STAssertEquals(frames[0].relativeMSF.frame, (uint8_t)10, @"relativeMSF");
+	STAssertTrue(0 != (eQSubchannelFrameCRCIsValid & frames[0].flags), @"flags");
+
+	STAssertTrue(0 == (eQSubchannelFramePositionIsValid & frames[1].flags), @"flags");
+	STAssertTrue(0 != (eQSubchannelFrameCRCIsAbsent & frames[2].flags), @"flags");
+
+	NSInteger sector = 0;
+	STAssertTrue(getSectorForQSubchannelFrame(&frames[0], &sector), @"getSectorForQSubchannelFrame");
+	STAssertEquals(sector, (NSInteger)13655, @"getSectorForQSubchannelFrame");
+}
+
+- (void) testISRC
+{
+	// USRC17607839
+	uint8_t frame [kCDSectorSizeQSubchannel] = { 0x03, 0x96, 0x38, 0x93, 0x04, 0x76, 0x07, 0x83, 0x90, 0x00, 0x00, 0x00 };
+
+	uint16_t crc = (uint16_t)~calculateQSubchannelCRC(frame);
+	frame[10] = (uint8_t)(crc >> 8);
+	frame[11] = (uint8_t)crc;
+
+	STAssertEqualObjects(isrcForQSubchannelData(frame), @"USRC17607839", @"isrcForQSubchannelData");
+	STAssertNil(mediaCatalogNumberForQSubchannelData(frame), @"mediaCatalogNumberForQSubchannelData");
+}
+
+@end
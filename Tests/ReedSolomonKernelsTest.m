@@ -0,0 +1,335 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "ReedSolomonKernelsTest.h"
+
+#import "ReedSolomonKernels.h"
+#import "TestUtilities.h"
+
+// The parity used for parity records, correcting up to PARITY_COUNT / 2 symbols per codeword
+#define PARITY_COUNT		8
+#define DATA_LENGTH			1000
+
+// The largest region compared
+#define MAXIMUM_REGION_LENGTH	4096
+
+// ========================================
+// Append the parity for the first dataLength symbols of codeword, as ParityRecord does
+// for each column: the remainder of data(x) * x^parityCount divided by the generator
+// ========================================
+static void
+encodeCodeword(uint16_t *codeword, NSUInteger dataLength, NSUInteger parityCount)
+{
+	uint16_t generator [parityCount];
+	uint16_t remainder [parityCount];
+
+	reedSolomonGeneratorPolynomial(generator, parityCount);
+	memset(remainder, 0, sizeof(remainder));
+
+	for(NSUInteger i = 0; i < dataLength; ++i) {
+		uint16_t feedback = codeword[i] ^ remainder[parityCount - 1];
+		for(NSUInteger j = parityCount - 1; j > 0; --j)
+			remainder[j] = remainder[j - 1] ^ gf16Multiply(feedback, generator[j]);
+		remainder[0] = gf16Multiply(feedback, generator[0]);
+	}
+
+	// Highest power first
+	for(NSUInteger k = 0; k < parityCount; ++k)
+		codeword[dataLength + k] = remainder[parityCount - 1 - k];
+}
+
+// The codeword evaluated at alpha^0 ... alpha^(parityCount - 1) (Horner's rule)
+static void
+calculateSyndromes(const uint16_t *codeword, NSUInteger codewordLength, NSUInteger parityCount, uint16_t *syndromes)
+{
+	for(NSUInteger i = 0; i < parityCount; ++i) {
+		uint16_t root = gf16Power(i);
+		uint16_t syndrome = 0;
+		for(NSUInteger j = 0; j < codewordLength; ++j)
+			syndrome = gf16Multiply(syndrome, root) ^ codeword[j];
+		syndromes[i] = syndrome;
+	}
+}
+
+static BOOL
+syndromesAreZero(const uint16_t *syndromes, NSUInteger parityCount)
+{
+	for(NSUInteger i = 0; i < parityCount; ++i) {
+		if(syndromes[i])
+			return NO;
+	}
+
+	return YES;
+}
+
+// Add errorCount nonzero errors at distinct random positions
+static void
+corruptCodeword(uint16_t *codeword, NSUInteger codewordLength, NSUInteger errorCount, uint64_t *state)
+{
+	NSUInteger positions [errorCount];
+
+	for(NSUInteger i = 0; i < errorCount; ++i) {
+		BOOL duplicate;
+		do {
+			positions[i] = nextRandom(state) % codewordLength;
+			duplicate = NO;
+			for(NSUInteger j = 0; j < i; ++j)
+				duplicate |= (positions[i] == positions[j]);
+		} while(duplicate);
+
+		uint16_t magnitude;
+		do {
+			magnitude = (uint16_t)nextRandom(state);
+		} while(!magnitude);
+
+		codeword[positions[i]] ^= magnitude;
+	}
+}
+
+@interface ReedSolomonKernelsTest (Private)
+- (void) compareMultiplyAddRegionKernel:(eReedSolomonKernel)kernel name:(NSString *)name;
+- (void) repairCodewordWithDataLength:(NSUInteger)dataLength errorCount:(NSUInteger)errorCount trials:(NSUInteger)trials;
+@end
+
+@implementation ReedSolomonKernelsTest
+
+- (void) testFieldArithmetic
+{
+	uint64_t state = TEST_RANDOM_SEED;
+
+	STAssertEquals(gf16Power(0), (uint16_t)1, @"alpha^0");
+	STAssertEquals(gf16Power(GF16_MAXIMUM_CODEWORD_LENGTH), (uint16_t)1, @"alpha has order 65535");
+
+	for(NSUInteger iteration = 0; iteration < 10000; ++iteration) {
+		uint16_t a = (uint16_t)nextRandom(&state);
+		uint16_t b = (uint16_t)nextRandom(&state);
+		if(!b)
+			continue;
+
+		STAssertEquals(gf16Multiply(a, b), gf16Multiply(b, a), @"Multiplication isn't commutative for %.4x, %.4x", a, b);
+		STAssertEquals(gf16Divide(gf16Multiply(a, b), b), a, @"Division doesn't invert multiplication for %.4x, %.4x", a, b);
+		STAssertEquals(gf16Multiply(a, 0), (uint16_t)0, @"Multiplication by zero");
+		STAssertEquals(gf16Multiply(a, 1), a, @"Multiplication by one");
+	}
+}
+
+- (void) testScalarKernel
+{
+	[self compareMultiplyAddRegionKernel:eReedSolomonKernelScalar name:@"Scalar"];
+}
+
+- (void) testSSSE3Kernel
+{
+	[self compareMultiplyAddRegionKernel:eReedSolomonKernelSSSE3 name:@"SSSE3"];
+}
+
+- (void) testNEONKernel
+{
+	[self compareMultiplyAddRegionKernel:eReedSolomonKernelNEON name:@"NEON"];
+}
+
+- (void) testEncodedCodewordsAreValid
+{
+	uint16_t codeword [DATA_LENGTH + PARITY_COUNT];
+	uint16_t syndromes [PARITY_COUNT];
+	NSUInteger positions [PARITY_COUNT];
+	uint16_t magnitudes [PARITY_COUNT];
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	for(NSUInteger iteration = 0; iteration < 20; ++iteration) {
+		for(NSUInteger i = 0; i < DATA_LENGTH; ++i)
+			codeword[i] = (uint16_t)nextRandom(&state);
+
+		encodeCodeword(codeword, DATA_LENGTH, PARITY_COUNT);
+		calculateSyndromes(codeword, DATA_LENGTH + PARITY_COUNT, PARITY_COUNT, syndromes);
+
+		STAssertTrue(syndromesAreZero(syndromes, PARITY_COUNT), @"Encoded codeword has nonzero syndromes");
+		STAssertEquals(reedSolomonCorrectErrors(syndromes, PARITY_COUNT, DATA_LENGTH + PARITY_COUNT, positions, magnitudes), (NSInteger)0, @"Errors found in an intact codeword");
+	}
+}
+
+- (void) testRepairSingleError
+{
+	[self repairCodewordWithDataLength:DATA_LENGTH errorCount:1 trials:200];
+}
+
+- (void) testRepairMultipleErrors
+{
+	for(NSUInteger errorCount = 2; errorCount < PARITY_COUNT / 2; ++errorCount)
+		[self repairCodewordWithDataLength:DATA_LENGTH errorCount:errorCount trials:100];
+}
+
+- (void) testRepairMaximumErrors
+{
+	[self repairCodewordWithDataLength:DATA_LENGTH errorCount:(PARITY_COUNT / 2) trials:200];
+}
+
+- (void) testRepairMaximumErrorsInLongestCodeword
+{
+	[self repairCodewordWithDataLength:(GF16_MAXIMUM_CODEWORD_LENGTH - PARITY_COUNT) errorCount:(PARITY_COUNT / 2) trials:2];
+}
+
+- (void) testRepairFirstAndLastSymbols
+{
+	uint16_t codeword [DATA_LENGTH + PARITY_COUNT];
+	uint16_t original [DATA_LENGTH + PARITY_COUNT];
+	uint16_t syndromes [PARITY_COUNT];
+	NSUInteger positions [PARITY_COUNT];
+	uint16_t magnitudes [PARITY_COUNT];
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	for(NSUInteger i = 0; i < DATA_LENGTH; ++i)
+		codeword[i] = (uint16_t)nextRandom(&state);
+
+	encodeCodeword(codeword, DATA_LENGTH, PARITY_COUNT);
+	memcpy(original, codeword, sizeof(codeword));
+
+	// The ends of the codeword are the highest and lowest powers of x
+	codeword[0] ^= 0xFFFF;
+	codeword[DATA_LENGTH - 1] ^= 0x0001;
+	codeword[DATA_LENGTH] ^= 0x8000;
+	codeword[DATA_LENGTH + PARITY_COUNT - 1] ^= 0x1234;
+
+	calculateSyndromes(codeword, DATA_LENGTH + PARITY_COUNT, PARITY_COUNT, syndromes);
+	NSInteger errorCount = reedSolomonCorrectErrors(syndromes, PARITY_COUNT, DATA_LENGTH + PARITY_COUNT, positions, magnitudes);
+
+	STAssertEquals(errorCount, (NSInteger)4, @"Wrong number of errors located");
+	for(NSInteger i = 0; i < errorCount; ++i)
+		codeword[positions[i]] ^= magnitudes[i];
+
+	STAssertTrue(0 == memcmp(codeword, original, sizeof(codeword)), @"Codeword not repaired");
+}
+
+- (void) testTooManyErrors
+{
+	uint16_t codeword [DATA_LENGTH + PARITY_COUNT];
+	uint16_t original [DATA_LENGTH + PARITY_COUNT];
+	uint16_t syndromes [PARITY_COUNT];
+	NSUInteger positions [PARITY_COUNT];
+	uint16_t magnitudes [PARITY_COUNT];
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	for(NSUInteger iteration = 0; iteration < 200; ++iteration) {
+		for(NSUInteger i = 0; i < DATA_LENGTH; ++i)
+			codeword[i] = (uint16_t)nextRandom(&state);
+
+		encodeCodeword(codeword, DATA_LENGTH, PARITY_COUNT);
+		memcpy(original, codeword, sizeof(codeword));
+
+		corruptCodeword(codeword, DATA_LENGTH + PARITY_COUNT, (PARITY_COUNT / 2) + 1, &state);
+		calculateSyndromes(codeword, DATA_LENGTH + PARITY_COUNT, PARITY_COUNT, syndromes);
+
+		NSInteger errorCount = reedSolomonCorrectErrors(syndromes, PARITY_COUNT, DATA_LENGTH + PARITY_COUNT, positions, magnitudes);
+		if(0 > errorCount)
+			continue;
+
+		// Beyond its capacity the code may decode to a different codeword, but never to the original
+		// and never to something that isn't a codeword
+		STAssertTrue(errorCount <= PARITY_COUNT / 2, @"More errors located than can be corrected");
+		for(NSInteger i = 0; i < errorCount; ++i)
+			codeword[positions[i]] ^= magnitudes[i];
+
+		calculateSyndromes(codeword, DATA_LENGTH + PARITY_COUNT, PARITY_COUNT, syndromes);
+		STAssertTrue(syndromesAreZero(syndromes, PARITY_COUNT), @"Miscorrection produced an invalid codeword");
+		STAssertFalse(0 == memcmp(codeword, original, sizeof(codeword)), @"Uncorrectable errors reported as repaired");
+	}
+}
+
+@end
+
+@implementation ReedSolomonKernelsTest (Private)
+
+- (void) compareMultiplyAddRegionKernel:(eReedSolomonKernel)kernel name:(NSString *)name
+{
+	GF16MultiplyAddRegionFunction candidate = gf16MultiplyAddRegionKernel(kernel);
+
+	RETURN_IF_KERNEL_UNSUPPORTED(candidate);
+
+	const size_t bufferSize = (MAXIMUM_REGION_LENGTH + MAXIMUM_ALIGNMENT) * sizeof(uint16_t);
+	uint16_t *sourceBuffer = malloc(bufferSize);
+	uint16_t *addendBuffer = malloc(bufferSize);
+	uint16_t *destinationBuffer = malloc(bufferSize);
+	uint16_t *expected = malloc(bufferSize);
+	STAssertTrue(NULL != sourceBuffer && NULL != addendBuffer && NULL != destinationBuffer && NULL != expected, @"Unable to allocate memory");
+
+	uint64_t state = TEST_RANDOM_SEED;
+
+	// Every length around the vector widths, then random lengths; constants include 0 and 1
+	for(NSUInteger iteration = 0; iteration < 500; ++iteration) {
+		NSUInteger alignment = iteration % MAXIMUM_ALIGNMENT;
+		NSUInteger count = (iteration < 100 ? iteration : (nextRandom(&state) % MAXIMUM_REGION_LENGTH));
+		uint16_t constant = (iteration < 2 ? (uint16_t)iteration : (uint16_t)nextRandom(&state));
+		BOOL useAddend = (0 != (iteration & 1));
+
+		uint16_t *source = sourceBuffer + alignment;
+		uint16_t *addend = addendBuffer + alignment;
+		uint16_t *destination = destinationBuffer + alignment;
+
+		for(NSUInteger i = 0; i < count; ++i) {
+			source[i] = (uint16_t)nextRandom(&state);
+			addend[i] = (uint16_t)nextRandom(&state);
+			expected[i] = (useAddend ? addend[i] : 0) ^ gf16Multiply(source[i], constant);
+		}
+
+		candidate(destination, source, (useAddend ? addend : NULL), constant, count);
+		STAssertTrue(0 == memcmp(destination, expected, count * sizeof(uint16_t)), @"%@ kernel mismatch for %lu symbols (constant %.4x, alignment %lu)", name, count, constant, alignment);
+
+		// In place, as the syndrome calculation uses it
+		if(useAddend) {
+			candidate(addend, source, addend, constant, count);
+			STAssertTrue(0 == memcmp(addend, expected, count * sizeof(uint16_t)), @"%@ kernel mismatch in place for %lu symbols (constant %.4x)", name, count, constant);
+		}
+	}
+
+	free(sourceBuffer);
+	free(addendBuffer);
+	free(destinationBuffer);
+	free(expected);
+}
+
+- (void) repairCodewordWithDataLength:(NSUInteger)dataLength errorCount:(NSUInteger)errorCount trials:(NSUInteger)trials
+{
+	NSUInteger codewordLength = dataLength + PARITY_COUNT;
+
+	uint16_t *codeword = malloc(codewordLength * sizeof(uint16_t));
+	uint16_t *original = malloc(codewordLength * sizeof(uint16_t));
+	STAssertTrue(NULL != codeword && NULL != original, @"Unable to allocate memory");
+
+	uint16_t syndromes [PARITY_COUNT];
+	NSUInteger positions [PARITY_COUNT];
+	uint16_t magnitudes [PARITY_COUNT];
+
+	uint64_t state = TEST_RANDOM_SEED + errorCount;
+
+	for(NSUInteger trial = 0; trial < trials; ++trial) {
+		for(NSUInteger i = 0; i < dataLength; ++i)
+			codeword[i] = (uint16_t)nextRandom(&state);
+
+		encodeCodeword(codeword, dataLength, PARITY_COUNT);
+		memcpy(original, codeword, codewordLength * sizeof(uint16_t));
+
+		corruptCodeword(codeword, codewordLength, errorCount, &state);
+		calculateSyndromes(codeword, codewordLength, PARITY_COUNT, syndromes);
+
+		NSInteger errorsLocated = reedSolomonCorrectErrors(syndromes, PARITY_COUNT, codewordLength, positions, magnitudes);
+		STAssertEquals(errorsLocated, (NSInteger)errorCount, @"Wrong number of errors located in a codeword of length %lu", codewordLength);
+
+		for(NSInteger i = 0; i < errorsLocated; ++i) {
+			STAssertTrue(positions[i] < codewordLength, @"Error located outside the codeword");
+			if(positions[i] < codewordLength)
+				codeword[positions[i]] ^= magnitudes[i];
+		}
+
+		STAssertTrue(0 == memcmp(codeword, original, codewordLength * sizeof(uint16_t)), @"Codeword of length %lu with %lu errors not repaired", codewordLength, errorCount);
+	}
+
+	free(codeword);
+	free(original);
+}
+
+@end
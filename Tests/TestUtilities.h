@@ -0,0 +1,41 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ========================================
+// Helpers shared by the kernel and utility tests
+// ========================================
+
+// The seed for nextRandom, so failures are reproducible
+#define TEST_RANDOM_SEED			88172645463325252ULL
+
+// Buffers are allocated with this many extra bytes (or elements) so they can be misaligned
+#define MAXIMUM_ALIGNMENT			16
+
+// Kernels not supported by this machine can't be tested
+#define RETURN_IF_KERNEL_UNSUPPORTED(candidate)	do { if(!(candidate)) return; } while(0)
+
+// ========================================
+// Deterministic pseudo-random numbers (xorshift)
+// ========================================
+static inline uint32_t
+nextRandom(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (uint32_t)*state;
+}
+
+static inline void
+fillRandom(uint8_t *buffer, size_t length, uint64_t *state)
+{
+	for(size_t i = 0; i < length; ++i)
+		buffer[i] = (uint8_t)nextRandom(state);
+}
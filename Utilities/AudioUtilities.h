@@ -12,17 +12,9 @@
 // ========================================
 BOOL createCDDAFileAtURL(NSURL *fileURL, NSError **error);
 
-// ========================================
-// Copy sectors from one file to another
-// ========================================
-BOOL copyAllSectorsFromURLToURL(NSURL *inputURL, NSURL *outputURL, NSUInteger outputLocation);
-BOOL copySectorsFromURLToURL(NSURL *inputURL, NSRange sectorsToCopy, NSURL *outputURL, NSUInteger outputLocation);
-
 // ========================================
 // Compare two files for differences
 // ========================================
-NSIndexSet * compareFilesForNonMatchingSectors(NSURL *leftFileURL, NSURL *rightFileURL);
-
 NSIndexSet * compareFileRegionsForNonMatchingSectors(NSURL *leftFileURL, NSUInteger leftFileStartingSectorOffset,
 													 NSURL *rightFileURL, NSUInteger rightFileStartingSectorOffset, 
 													 NSUInteger sectorCount);
@@ -46,6 +38,8 @@ NSString * calculateSHA1DigestForURLRegion(NSURL *fileURL, NSUInteger startingSe
 // Calculate the MD5 and SHA1 digests for the audio portion of the specified file
 // The MD5 checksum (NSString *) will be object 0 in the returned array
 // The SHA1 hash (NSString *) will be object 1 in the returned array
+// The EAC-style CRC32 (NSNumber *) will be object 2 in the returned array
+// The EAC-style CRC32 skipping null samples (NSNumber *) will be object 3 in the returned array
 // ========================================
 NSArray * calculateMD5AndSHA1DigestsForURL(NSURL *fileURL);
 NSArray * calculateMD5AndSHA1DigestsForURLRegion(NSURL *fileURL, NSUInteger startingSector, NSUInteger sectorCount);
@@ -0,0 +1,34 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// ========================================
+// Processor features relevant to the accelerated audio kernels
+// ========================================
+enum _eCPUFeature {
+	eCPUFeatureSSSE3		= 1u << 0,
+	eCPUFeatureSSE41		= 1u << 1,
+	eCPUFeatureAVX2			= 1u << 2,
+	eCPUFeaturePCLMULQDQ	= 1u << 3,
+	eCPUFeatureSHA			= 1u << 4,
+	eCPUFeatureNEON			= 1u << 5,
+	eCPUFeatureARMSHA1		= 1u << 6,
+	eCPUFeatureARMCRC32		= 1u << 7
+};
+typedef enum _eCPUFeature eCPUFeature;
+
+// ========================================
+// Determine the features supported by the processor (and operating system)
+// The result is calculated once and cached
+// ========================================
+uint32_t cpuFeatures(void);
+
+// ========================================
+// Returns true if all the specified features are supported
+// ========================================
+int cpuHasFeatures(uint32_t features);
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#include "CPUFeatures.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+static pthread_once_t	sCPUFeaturesOnce	= PTHREAD_ONCE_INIT;
+static uint32_t			sCPUFeatures		= 0;
+
+// ========================================
+// Returns true if the sysctl exists and is non-zero
+// ========================================
+static int
+sysctlIsSet(const char *name)
+{
+	int value = 0;
+	size_t size = sizeof(value);
+
+	if(-1 == sysctlbyname(name, &value, &size, NULL, 0))
+		return 0;
+
+	return (0 != value);
+}
+
+// ========================================
+// Returns true if the space-separated word is present in the sysctl's string value
+// ========================================
+static int
+sysctlStringContainsWord(const char *name, const char *word)
+{
+	char value [1024];
+	size_t size = sizeof(value);
+
+	if(-1 == sysctlbyname(name, value, &size, NULL, 0) || 0 == size)
+		return 0;
+
+	value[sizeof(value) - 1] = '\0';
+
+	size_t wordLength = strlen(word);
+	const char *match = value;
+	while((match = strstr(match, word))) {
+		int atStart = (match == value || ' ' == match[-1]);
+		int atEnd = ('\0' == match[wordLength] || ' ' == match[wordLength]);
+		if(atStart && atEnd)
+			return 1;
+		match += wordLength;
+	}
+
+	return 0;
+}
+
+static void
+detectCPUFeatures(void)
+{
+	uint32_t features = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	// The hw.optional keys reflect support by the kernel as well as the processor,
+	// which matters for the AVX register state
+	if(sysctlIsSet("hw.optional.supplementalsse3"))
+		features |= eCPUFeatureSSSE3;
+	if(sysctlIsSet("hw.optional.sse4_1"))
+		features |= eCPUFeatureSSE41;
+	if(sysctlIsSet("hw.optional.avx2_0"))
+		features |= eCPUFeatureAVX2;
+	if(sysctlStringContainsWord("machdep.cpu.features", "PCLMULQDQ"))
+		features |= eCPUFeaturePCLMULQDQ;
+	if(sysctlStringContainsWord("machdep.cpu.leaf7_features", "SHA"))
+		features |= eCPUFeatureSHA;
+#elif defined(__arm64__) || defined(__aarch64__)
+	// NEON is part of the base ARMv8 architecture
+	features |= eCPUFeatureNEON;
+	// Features the compiler already assumes for the target are always present
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)
+	features |= eCPUFeatureARMSHA1;
+#else
+	if(sysctlIsSet("hw.optional.arm.FEAT_SHA1"))
+		features |= eCPUFeatureARMSHA1;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+	features |= eCPUFeatureARMCRC32;
+#else
+	if(sysctlIsSet("hw.optional.armv8_crc32"))
+		features |= eCPUFeatureARMCRC32;
+#endif
+#endif
+
+	sCPUFeatures = features;
+}
+
+uint32_t
+cpuFeatures(void)
+{
+	pthread_once(&sCPUFeaturesOnce, detectCPUFeatures);
+	return sCPUFeatures;
+}
+
+int
+cpuHasFeatures(uint32_t features)
+{
+	return (features == (cpuFeatures() & features));
+}
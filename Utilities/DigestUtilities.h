@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#import <Cocoa/Cocoa.h>
+#include <CommonCrypto/CommonDigest.h>
+
+// ========================================
+// Digest implementations are selected once, at runtime, based on the
+// features of the processor (SHA extensions, PCLMULQDQ, ARMv8 SHA1/CRC32)
+// with portable fallbacks for everything else
+// ========================================
+
+#define SHA1_DIGEST_LENGTH		20
+
+// ========================================
+// SHA1
+// ========================================
+typedef struct {
+	uint32_t state [5];
+	uint64_t byteCount;
+	uint8_t buffer [64];
+} SHA1Context;
+
+void sha1Init(SHA1Context *context);
+void sha1Update(SHA1Context *context, const void *data, size_t length);
+void sha1Final(SHA1Context *context, uint8_t digest [SHA1_DIGEST_LENGTH]);
+
+// ========================================
+// CRC32 (IEEE 802.3, as used by zlib and EAC)
+// Pass 0 for crc to begin a new calculation, or the previous result to continue one
+// ========================================
+uint32_t crc32Update(uint32_t crc, const void *data, size_t length);
+
+// ========================================
+// EAC-style CRC32s for CD-DA audio, calculated over all samples and with
+// null (zero-valued) 16-bit samples skipped
+// Audio must be passed in whole 16-bit samples
+// ========================================
+typedef struct {
+	uint32_t CRC32;
+	uint32_t CRC32WithoutNullSamples;
+} EACCRCContext;
+
+void eacCRCInit(EACCRCContext *context);
+void eacCRCUpdate(EACCRCContext *context, const void *data, size_t length);
+
+// ========================================
+// xxHash64, used for fast (non-cryptographic) sector fingerprints
+// ========================================
+uint64_t xxHash64(const void *data, size_t length, uint64_t seed);
+
+// ========================================
+// Combined MD5 and SHA1 calculation for extracted audio
+// ========================================
+typedef struct {
+	CC_MD5_CTX md5;
+	SHA1Context sha1;
+} AudioDigestContext;
+
+void audioDigestInit(AudioDigestContext *context);
+void audioDigestUpdate(AudioDigestContext *context, const void *data, size_t length);
+void audioDigestFinal(AudioDigestContext *context, NSString **MD5, NSString **SHA1);
+
+// ========================================
+// The individual kernels (used for testing)
+// The SHA1 kernels process whole 64-byte blocks, and the CRC32 kernels operate
+// on the pre- and post-inverted register
+// ========================================
+typedef void (*SHA1BlocksFunction)(uint32_t state [5], const uint8_t *data, size_t blockCount);
+typedef uint32_t (*CRC32Function)(uint32_t crc, const uint8_t *data, size_t length);
+
+enum _eSHA1Kernel {
+	eSHA1KernelPortable			= 0,
+	eSHA1KernelSHANI			= 1,
+	eSHA1KernelARM				= 2
+};
+typedef enum _eSHA1Kernel eSHA1Kernel;
+
+enum _eCRC32Kernel {
+	eCRC32KernelSliceBy16		= 0,
+	eCRC32KernelPCLMUL			= 1,
+	eCRC32KernelARM				= 2
+};
+typedef enum _eCRC32Kernel eCRC32Kernel;
+
+// Returns the specified implementation, or NULL if it isn't supported by the compiler or processor
+SHA1BlocksFunction sha1BlocksKernel(eSHA1Kernel kernel);
+CRC32Function crc32Kernel(eCRC32Kernel kernel);
+
+// ========================================
+// Utility functions
+// ========================================
+NSString * hexStringForDigest(const uint8_t *digest, size_t length);
+
+// A description of the selected implementations, suitable for logging
+NSString * digestImplementationDescription(void);
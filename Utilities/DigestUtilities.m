@@ -0,0 +1,786 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#include "DigestUtilities.h"
+#include "CPUFeatures.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// ========================================
+// The x86 kernels rely on per-function target attributes, which require a
+// compiler that understands them; older compilers get the portable code only
+// ========================================
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#  define ENABLE_X86_DIGEST_KERNELS 1
+#  include <immintrin.h>
+#endif
+
+#if (defined(__arm64__) || defined(__aarch64__)) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#  define ENABLE_ARM_SHA1_KERNEL 1
+#  include <arm_neon.h>
+#endif
+
+#if (defined(__arm64__) || defined(__aarch64__)) && defined(__ARM_FEATURE_CRC32)
+#  define ENABLE_ARM_CRC32_KERNEL 1
+#  include <arm_acle.h>
+#endif
+
+static pthread_once_t		sDigestImplementationsOnce	= PTHREAD_ONCE_INIT;
+static SHA1BlocksFunction	sSHA1Blocks					= NULL;
+static CRC32Function		sCRC32						= NULL;
+static const char			*sSHA1ImplementationName	= NULL;
+static const char			*sCRC32ImplementationName	= NULL;
+
+static uint32_t				sCRC32Table [16][256];
+
+// ========================================
+// Helpers
+// ========================================
+static inline uint32_t
+rotateLeft32(uint32_t x, unsigned n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static inline uint64_t
+rotateLeft64(uint64_t x, unsigned n)
+{
+	return (x << n) | (x >> (64 - n));
+}
+
+static inline uint32_t
+readBigEndian32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint32_t
+readLittleEndian32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+readLittleEndian64(const uint8_t *p)
+{
+	return (uint64_t)readLittleEndian32(p) | ((uint64_t)readLittleEndian32(p + 4) << 32);
+}
+
+// ========================================
+// Portable SHA1
+// ========================================
+static void
+sha1BlocksPortable(uint32_t state [5], const uint8_t *data, size_t blockCount)
+{
+	uint32_t w [80];
+
+	while(blockCount--) {
+		for(unsigned i = 0; i < 16; ++i)
+			w[i] = readBigEndian32(data + (4 * i));
+		for(unsigned i = 16; i < 80; ++i)
+			w[i] = rotateLeft32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+		for(unsigned i = 0; i < 80; ++i) {
+			uint32_t f, k;
+			if(20 > i) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if(40 > i) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if(60 > i) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+
+			uint32_t temp = rotateLeft32(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rotateLeft32(b, 30);
+			b = a;
+			a = temp;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+
+		data += 64;
+	}
+}
+
+// ========================================
+// SHA1 using the Intel SHA extensions
+// ========================================
+#if ENABLE_X86_DIGEST_KERNELS
+
+// Performs rounds (4 * i) through (4 * i) + 3, with the message schedule interleaved
+#define SHA_NI_ROUNDS(i)																	\
+	do {																					\
+		if(0 == (i))																		\
+			e[0] = _mm_add_epi32(e[0], msg[0]);												\
+		else																				\
+			e[(i) & 1] = _mm_sha1nexte_epu32(e[(i) & 1], msg[(i) & 3]);						\
+		e[((i) + 1) & 1] = abcd;															\
+		if(3 <= (i) && 18 >= (i))															\
+			msg[((i) + 1) & 3] = _mm_sha1msg2_epu32(msg[((i) + 1) & 3], msg[(i) & 3]);		\
+		abcd = _mm_sha1rnds4_epu32(abcd, e[(i) & 1], (i) / 5);								\
+		if(1 <= (i) && 16 >= (i))															\
+			msg[((i) + 3) & 3] = _mm_sha1msg1_epu32(msg[((i) + 3) & 3], msg[(i) & 3]);		\
+		if(2 <= (i) && 17 >= (i))															\
+			msg[((i) + 2) & 3] = _mm_xor_si128(msg[((i) + 2) & 3], msg[(i) & 3]);			\
+	} while(0)
+
+__attribute__((target("sha,ssse3,sse4.1")))
+static void
+sha1BlocksSHANI(uint32_t state [5], const uint8_t *data, size_t blockCount)
+{
+	const __m128i byteSwapMask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+	__m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+	while(blockCount--) {
+		__m128i abcdSaved = abcd;
+		__m128i e0Saved = e0;
+
+		__m128i msg [4];
+		for(unsigned i = 0; i < 4; ++i)
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + (16 * i))), byteSwapMask);
+
+		__m128i e [2] = { e0, e0 };
+
+		SHA_NI_ROUNDS(0);	SHA_NI_ROUNDS(1);	SHA_NI_ROUNDS(2);	SHA_NI_ROUNDS(3);
+		SHA_NI_ROUNDS(4);	SHA_NI_ROUNDS(5);	SHA_NI_ROUNDS(6);	SHA_NI_ROUNDS(7);
+		SHA_NI_ROUNDS(8);	SHA_NI_ROUNDS(9);	SHA_NI_ROUNDS(10);	SHA_NI_ROUNDS(11);
+		SHA_NI_ROUNDS(12);	SHA_NI_ROUNDS(13);	SHA_NI_ROUNDS(14);	SHA_NI_ROUNDS(15);
+		SHA_NI_ROUNDS(16);	SHA_NI_ROUNDS(17);	SHA_NI_ROUNDS(18);	SHA_NI_ROUNDS(19);
+
+		// e[0] holds the state saved before the final four rounds
+		e0 = _mm_sha1nexte_epu32(e[0], e0Saved);
+		abcd = _mm_add_epi32(abcd, abcdSaved);
+
+		data += 64;
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#undef SHA_NI_ROUNDS
+
+#endif /* ENABLE_X86_DIGEST_KERNELS */
+
+// ========================================
+// SHA1 using the ARMv8 cryptographic extensions
+// ========================================
+#if ENABLE_ARM_SHA1_KERNEL
+
+// Performs rounds (4 * i) through (4 * i) + 3, with the message schedule interleaved
+#define ARM_SHA1_ROUNDS(i, op)																	\
+	do {																						\
+		e[((i) + 1) & 1] = vsha1h_u32(vgetq_lane_u32(abcd, 0));									\
+		abcd = op(abcd, e[(i) & 1], wk[(i) & 1]);												\
+		if(17 >= (i))																			\
+			wk[(i) & 1] = vaddq_u32(msg[((i) + 2) & 3], k[((i) + 2) / 5]);						\
+		if(1 <= (i) && 16 >= (i))																\
+			msg[((i) + 3) & 3] = vsha1su1q_u32(msg[((i) + 3) & 3], msg[((i) + 2) & 3]);			\
+		if(15 >= (i))																			\
+			msg[(i) & 3] = vsha1su0q_u32(msg[(i) & 3], msg[((i) + 1) & 3], msg[((i) + 2) & 3]);	\
+	} while(0)
+
+static void
+sha1BlocksARM(uint32_t state [5], const uint8_t *data, size_t blockCount)
+{
+	const uint32x4_t k [4] = {
+		vdupq_n_u32(0x5A827999), vdupq_n_u32(0x6ED9EBA1), vdupq_n_u32(0x8F1BBCDC), vdupq_n_u32(0xCA62C1D6)
+	};
+
+	uint32x4_t abcd = vld1q_u32(state);
+	uint32_t e0 = state[4];
+
+	while(blockCount--) {
+		uint32x4_t abcdSaved = abcd;
+		uint32_t e0Saved = e0;
+
+		uint32x4_t msg [4];
+		for(unsigned i = 0; i < 4; ++i)
+			msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + (16 * i))));
+
+		uint32x4_t wk [2] = { vaddq_u32(msg[0], k[0]), vaddq_u32(msg[1], k[0]) };
+		uint32_t e [2] = { e0, 0 };
+
+		ARM_SHA1_ROUNDS(0, vsha1cq_u32);	ARM_SHA1_ROUNDS(1, vsha1cq_u32);	ARM_SHA1_ROUNDS(2, vsha1cq_u32);
+		ARM_SHA1_ROUNDS(3, vsha1cq_u32);	ARM_SHA1_ROUNDS(4, vsha1cq_u32);
+		ARM_SHA1_ROUNDS(5, vsha1pq_u32);	ARM_SHA1_ROUNDS(6, vsha1pq_u32);	ARM_SHA1_ROUNDS(7, vsha1pq_u32);
+		ARM_SHA1_ROUNDS(8, vsha1pq_u32);	ARM_SHA1_ROUNDS(9, vsha1pq_u32);
+		ARM_SHA1_ROUNDS(10, vsha1mq_u32);	ARM_SHA1_ROUNDS(11, vsha1mq_u32);	ARM_SHA1_ROUNDS(12, vsha1mq_u32);
+		ARM_SHA1_ROUNDS(13, vsha1mq_u32);	ARM_SHA1_ROUNDS(14, vsha1mq_u32);
+		ARM_SHA1_ROUNDS(15, vsha1pq_u32);	ARM_SHA1_ROUNDS(16, vsha1pq_u32);	ARM_SHA1_ROUNDS(17, vsha1pq_u32);
+		ARM_SHA1_ROUNDS(18, vsha1pq_u32);	ARM_SHA1_ROUNDS(19, vsha1pq_u32);
+
+		e0 = e[0] + e0Saved;
+		abcd = vaddq_u32(abcd, abcdSaved);
+
+		data += 64;
+	}
+
+	vst1q_u32(state, abcd);
+	state[4] = e0;
+}
+
+#undef ARM_SHA1_ROUNDS
+
+#endif /* ENABLE_ARM_SHA1_KERNEL */
+
+// ========================================
+// Portable CRC32 (slice-by-16)
+// ========================================
+static uint32_t
+crc32Portable(uint32_t crc, const uint8_t *data, size_t length)
+{
+	while(16 <= length) {
+		uint32_t a = readLittleEndian32(data) ^ crc;
+		uint32_t b = readLittleEndian32(data + 4);
+		uint32_t c = readLittleEndian32(data + 8);
+		uint32_t d = readLittleEndian32(data + 12);
+
+		crc = sCRC32Table[15][a & 0xff] ^ sCRC32Table[14][(a >> 8) & 0xff] ^ sCRC32Table[13][(a >> 16) & 0xff] ^ sCRC32Table[12][a >> 24] ^
+			sCRC32Table[11][b & 0xff] ^ sCRC32Table[10][(b >> 8) & 0xff] ^ sCRC32Table[9][(b >> 16) & 0xff] ^ sCRC32Table[8][b >> 24] ^
+			sCRC32Table[7][c & 0xff] ^ sCRC32Table[6][(c >> 8) & 0xff] ^ sCRC32Table[5][(c >> 16) & 0xff] ^ sCRC32Table[4][c >> 24] ^
+			sCRC32Table[3][d & 0xff] ^ sCRC32Table[2][(d >> 8) & 0xff] ^ sCRC32Table[1][(d >> 16) & 0xff] ^ sCRC32Table[0][d >> 24];
+
+		data += 16;
+		length -= 16;
+	}
+
+	while(length--)
+		crc = (crc >> 8) ^ sCRC32Table[0][(crc ^ *data++) & 0xff];
+
+	return crc;
+}
+
+// ========================================
+// CRC32 using carry-less multiplication (folding by four 128-bit lanes)
+// ========================================
+#if ENABLE_X86_DIGEST_KERNELS
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t
+crc32PCLMUL(uint32_t crc, const uint8_t *data, size_t length)
+{
+	// Folding requires at least four lanes of input
+	if(64 > length)
+		return crc32Portable(crc, data, length);
+
+	// Folding constants for the reflected polynomial 0xEDB88320
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	size_t foldedLength = length & ~(size_t)15;
+	size_t remainingLength = length - foldedLength;
+
+	__m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + 0x00)), _mm_cvtsi32_si128((int)crc));
+	__m128i x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+
+	data += 64;
+	foldedLength -= 64;
+
+	// Fold 64 bytes at a time
+	while(64 <= foldedLength) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(data + 0x30)));
+
+		data += 64;
+		foldedLength -= 64;
+	}
+
+	// Fold the four lanes into one
+	__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+	// Fold any remaining 16 byte blocks
+	while(16 <= foldedLength) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i *)data)), x5);
+
+		data += 16;
+		foldedLength -= 16;
+	}
+
+	// Fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	crc = (uint32_t)_mm_extract_epi32(x1, 1);
+
+	return crc32Portable(crc, data, remainingLength);
+}
+
+#endif /* ENABLE_X86_DIGEST_KERNELS */
+
+// ========================================
+// CRC32 using the ARMv8 CRC32 instructions
+// ========================================
+#if ENABLE_ARM_CRC32_KERNEL
+
+static uint32_t
+crc32ARM(uint32_t crc, const uint8_t *data, size_t length)
+{
+	while(8 <= length) {
+		crc = __crc32d(crc, readLittleEndian64(data));
+		data += 8;
+		length -= 8;
+	}
+
+	while(length--)
+		crc = __crc32b(crc, *data++);
+
+	return crc;
+}
+
+#endif /* ENABLE_ARM_CRC32_KERNEL */
+
+// ========================================
+// Runtime selection of the implementations
+// ========================================
+static void
+selectDigestImplementations(void)
+{
+	// Generate the slice-by-16 tables, which are also used for short inputs by the other kernels
+	for(uint32_t i = 0; i < 256; ++i) {
+		uint32_t crc = i;
+		for(unsigned j = 0; j < 8; ++j)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		sCRC32Table[0][i] = crc;
+	}
+
+	for(uint32_t i = 0; i < 256; ++i) {
+		for(unsigned slice = 1; slice < 16; ++slice)
+			sCRC32Table[slice][i] = (sCRC32Table[slice - 1][i] >> 8) ^ sCRC32Table[0][sCRC32Table[slice - 1][i] & 0xff];
+	}
+
+	sSHA1Blocks = sha1BlocksPortable;
+	sSHA1ImplementationName = "portable";
+
+	sCRC32 = crc32Portable;
+	sCRC32ImplementationName = "slice-by-16";
+
+#if ENABLE_X86_DIGEST_KERNELS
+	if(cpuHasFeatures(eCPUFeatureSHA | eCPUFeatureSSSE3 | eCPUFeatureSSE41)) {
+		sSHA1Blocks = sha1BlocksSHANI;
+		sSHA1ImplementationName = "SHA-NI";
+	}
+
+	if(cpuHasFeatures(eCPUFeaturePCLMULQDQ | eCPUFeatureSSE41)) {
+		sCRC32 = crc32PCLMUL;
+		sCRC32ImplementationName = "PCLMULQDQ";
+	}
+#endif
+
+#if ENABLE_ARM_SHA1_KERNEL
+	if(cpuHasFeatures(eCPUFeatureARMSHA1)) {
+		sSHA1Blocks = sha1BlocksARM;
+		sSHA1ImplementationName = "ARMv8 SHA1";
+	}
+#endif
+
+#if ENABLE_ARM_CRC32_KERNEL
+	if(cpuHasFeatures(eCPUFeatureARMCRC32)) {
+		sCRC32 = crc32ARM;
+		sCRC32ImplementationName = "ARMv8 CRC32";
+	}
+#endif
+}
+
+// ========================================
+// Access to the individual kernels
+// ========================================
+SHA1BlocksFunction
+sha1BlocksKernel(eSHA1Kernel kernel)
+{
+	pthread_once(&sDigestImplementationsOnce, selectDigestImplementations);
+
+	switch(kernel) {
+		case eSHA1KernelPortable:
+			return sha1BlocksPortable;
+
+#if ENABLE_X86_DIGEST_KERNELS
+		case eSHA1KernelSHANI:
+			return (cpuHasFeatures(eCPUFeatureSHA | eCPUFeatureSSSE3 | eCPUFeatureSSE41) ? sha1BlocksSHANI : NULL);
+#endif
+
+#if ENABLE_ARM_SHA1_KERNEL
+		case eSHA1KernelARM:
+			return (cpuHasFeatures(eCPUFeatureARMSHA1) ? sha1BlocksARM : NULL);
+#endif
+
+		default:
+			return NULL;
+	}
+}
+
+CRC32Function
+crc32Kernel(eCRC32Kernel kernel)
+{
+	// The tables are needed by every kernel for short inputs
+	pthread_once(&sDigestImplementationsOnce, selectDigestImplementations);
+
+	switch(kernel) {
+		case eCRC32KernelSliceBy16:
+			return crc32Portable;
+
+#if ENABLE_X86_DIGEST_KERNELS
+		case eCRC32KernelPCLMUL:
+			return (cpuHasFeatures(eCPUFeaturePCLMULQDQ | eCPUFeatureSSE41) ? crc32PCLMUL : NULL);
+#endif
+
+#if ENABLE_ARM_CRC32_KERNEL
+		case eCRC32KernelARM:
+			return (cpuHasFeatures(eCPUFeatureARMCRC32) ? crc32ARM : NULL);
+#endif
+
+		default:
+			return NULL;
+	}
+}
+
+// ========================================
+// SHA1
+// ========================================
+void
+sha1Init(SHA1Context *context)
+{
+	NSCParameterAssert(NULL != context);
+
+	pthread_once(&sDigestImplementationsOnce, selectDigestImplementations);
+
+	context->state[0] = 0x67452301;
+	context->state[1] = 0xEFCDAB89;
+	context->state[2] = 0x98BADCFE;
+	context->state[3] = 0x10325476;
+	context->state[4] = 0xC3D2E1F0;
+	context->byteCount = 0;
+}
+
+void
+sha1Update(SHA1Context *context, const void *data, size_t length)
+{
+	NSCParameterAssert(NULL != context);
+	NSCParameterAssert(NULL != data || 0 == length);
+
+	const uint8_t *bytes = data;
+	size_t bufferedBytes = (size_t)(context->byteCount & 63);
+
+	context->byteCount += length;
+
+	// Complete a partially buffered block
+	if(bufferedBytes) {
+		size_t bytesToCopy = 64 - bufferedBytes;
+		if(bytesToCopy > length)
+			bytesToCopy = length;
+
+		memcpy(context->buffer + bufferedBytes, bytes, bytesToCopy);
+		bytes += bytesToCopy;
+		length -= bytesToCopy;
+
+		if(64 != bufferedBytes + bytesToCopy)
+			return;
+
+		sSHA1Blocks(context->state, context->buffer, 1);
+	}
+
+	// Process whole blocks directly from the input
+	if(64 <= length) {
+		size_t blockCount = length / 64;
+		sSHA1Blocks(context->state, bytes, blockCount);
+		bytes += 64 * blockCount;
+		length -= 64 * blockCount;
+	}
+
+	if(length)
+		memcpy(context->buffer, bytes, length);
+}
+
+void
+sha1Final(SHA1Context *context, uint8_t digest [SHA1_DIGEST_LENGTH])
+{
+	NSCParameterAssert(NULL != context);
+	NSCParameterAssert(NULL != digest);
+
+	uint64_t bitCount = 8 * context->byteCount;
+
+	uint8_t padding [72] = { 0x80 };
+	size_t paddingLength = (56 > (context->byteCount & 63) ? 56 : 120) - (size_t)(context->byteCount & 63);
+
+	for(unsigned i = 0; i < 8; ++i)
+		padding[paddingLength + i] = (uint8_t)(bitCount >> (56 - (8 * i)));
+
+	sha1Update(context, padding, paddingLength + 8);
+
+	for(unsigned i = 0; i < 5; ++i) {
+		digest[(4 * i) + 0] = (uint8_t)(context->state[i] >> 24);
+		digest[(4 * i) + 1] = (uint8_t)(context->state[i] >> 16);
+		digest[(4 * i) + 2] = (uint8_t)(context->state[i] >> 8);
+		digest[(4 * i) + 3] = (uint8_t)context->state[i];
+	}
+
+	memset(context, 0, sizeof(SHA1Context));
+}
+
+// ========================================
+// CRC32
+// ========================================
+uint32_t
+crc32Update(uint32_t crc, const void *data, size_t length)
+{
+	NSCParameterAssert(NULL != data || 0 == length);
+
+	pthread_once(&sDigestImplementationsOnce, selectDigestImplementations);
+
+	return ~sCRC32(~crc, data, length);
+}
+
+// ========================================
+// EAC-style CRC32s
+// ========================================
+void
+eacCRCInit(EACCRCContext *context)
+{
+	NSCParameterAssert(NULL != context);
+
+	context->CRC32 = 0;
+	context->CRC32WithoutNullSamples = 0;
+}
+
+void
+eacCRCUpdate(EACCRCContext *context, const void *data, size_t length)
+{
+	NSCParameterAssert(NULL != context);
+	NSCParameterAssert(0 == length % 2);
+
+	const uint8_t *bytes = data;
+	const uint8_t *end = bytes + length;
+
+	context->CRC32 = crc32Update(context->CRC32, bytes, length);
+
+	// Skip null samples by passing each run of non-null samples to the CRC as a unit
+	while(bytes < end) {
+		while(bytes < end && 0 == bytes[0] && 0 == bytes[1])
+			bytes += 2;
+
+		const uint8_t *runStart = bytes;
+		while(bytes < end && (0 != bytes[0] || 0 != bytes[1]))
+			bytes += 2;
+
+		if(bytes > runStart)
+			context->CRC32WithoutNullSamples = crc32Update(context->CRC32WithoutNullSamples, runStart, (size_t)(bytes - runStart));
+	}
+}
+
+// ========================================
+// xxHash64
+// ========================================
+#define XXH_PRIME64_1	0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3	0x165667B19E3779F9ULL
+#define XXH_PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5	0x27D4EB2F165667C5ULL
+
+static inline uint64_t
+xxHash64Round(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * XXH_PRIME64_2;
+	accumulator = rotateLeft64(accumulator, 31);
+	return accumulator * XXH_PRIME64_1;
+}
+
+static inline uint64_t
+xxHash64MergeRound(uint64_t accumulator, uint64_t value)
+{
+	accumulator ^= xxHash64Round(0, value);
+	return (accumulator * XXH_PRIME64_1) + XXH_PRIME64_4;
+}
+
+uint64_t
+xxHash64(const void *data, size_t length, uint64_t seed)
+{
+	NSCParameterAssert(NULL != data || 0 == length);
+
+	const uint8_t *bytes = data;
+	const uint8_t *end = bytes + length;
+	uint64_t hash;
+
+	if(32 <= length) {
+		uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t v2 = seed + XXH_PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - XXH_PRIME64_1;
+
+		const uint8_t *limit = end - 32;
+		do {
+			v1 = xxHash64Round(v1, readLittleEndian64(bytes));
+			v2 = xxHash64Round(v2, readLittleEndian64(bytes + 8));
+			v3 = xxHash64Round(v3, readLittleEndian64(bytes + 16));
+			v4 = xxHash64Round(v4, readLittleEndian64(bytes + 24));
+			bytes += 32;
+		} while(bytes <= limit);
+
+		hash = rotateLeft64(v1, 1) + rotateLeft64(v2, 7) + rotateLeft64(v3, 12) + rotateLeft64(v4, 18);
+		hash = xxHash64MergeRound(hash, v1);
+		hash = xxHash64MergeRound(hash, v2);
+		hash = xxHash64MergeRound(hash, v3);
+		hash = xxHash64MergeRound(hash, v4);
+	}
+	else
+		hash = seed + XXH_PRIME64_5;
+
+	hash += (uint64_t)length;
+
+	while(bytes + 8 <= end) {
+		hash ^= xxHash64Round(0, readLittleEndian64(bytes));
+		hash = (rotateLeft64(hash, 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+		bytes += 8;
+	}
+
+	if(bytes + 4 <= end) {
+		hash ^= (uint64_t)readLittleEndian32(bytes) * XXH_PRIME64_1;
+		hash = (rotateLeft64(hash, 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+		bytes += 4;
+	}
+
+	while(bytes < end) {
+		hash ^= (*bytes++) * XXH_PRIME64_5;
+		hash = rotateLeft64(hash, 11) * XXH_PRIME64_1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= XXH_PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= XXH_PRIME64_3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+// ========================================
+// Combined MD5 and SHA1
+// ========================================
+void
+audioDigestInit(AudioDigestContext *context)
+{
+	NSCParameterAssert(NULL != context);
+
+	CC_MD5_Init(&context->md5);
+	sha1Init(&context->sha1);
+}
+
+void
+audioDigestUpdate(AudioDigestContext *context, const void *data, size_t length)
+{
+	NSCParameterAssert(NULL != context);
+
+	// CC_MD5_Update takes a 32-bit length
+	const uint8_t *bytes = data;
+	size_t remaining = length;
+	while(remaining) {
+		CC_LONG chunkLength = (CC_LONG)(remaining > 0x40000000 ? 0x40000000 : remaining);
+		CC_MD5_Update(&context->md5, bytes, chunkLength);
+		bytes += chunkLength;
+		remaining -= chunkLength;
+	}
+
+	sha1Update(&context->sha1, data, length);
+}
+
+void
+audioDigestFinal(AudioDigestContext *context, NSString **MD5, NSString **SHA1)
+{
+	NSCParameterAssert(NULL != context);
+
+	unsigned char md5Digest [CC_MD5_DIGEST_LENGTH];
+	CC_MD5_Final(md5Digest, &context->md5);
+
+	uint8_t sha1Digest [SHA1_DIGEST_LENGTH];
+	sha1Final(&context->sha1, sha1Digest);
+
+	if(MD5)
+		*MD5 = hexStringForDigest(md5Digest, CC_MD5_DIGEST_LENGTH);
+	if(SHA1)
+		*SHA1 = hexStringForDigest(sha1Digest, SHA1_DIGEST_LENGTH);
+}
+
+// ========================================
+// Utility functions
+// ========================================
+NSString *
+hexStringForDigest(const uint8_t *digest, size_t length)
+{
+	NSCParameterAssert(NULL != digest);
+
+	static const char hexDigits [] = "0123456789abcdef";
+
+	char *hex = malloc((2 * length) + 1);
+	if(!hex)
+		return nil;
+
+	for(size_t i = 0; i < length; ++i) {
+		hex[(2 * i) + 0] = hexDigits[digest[i] >> 4];
+		hex[(2 * i) + 1] = hexDigits[digest[i] & 0x0f];
+	}
+	hex[2 * length] = '\0';
+
+	NSString *result = [NSString stringWithUTF8String:hex];
+	free(hex);
+
+	return result;
+}
+
+NSString *
+digestImplementationDescription(void)
+{
+	pthread_once(&sDigestImplementationsOnce, selectDigestImplementations);
+
+	return [NSString stringWithFormat:@"SHA1: %s, CRC32: %s", sSHA1ImplementationName, sCRC32ImplementationName];
+}
@@ -0,0 +1,16 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#import <Cocoa/Cocoa.h>
+
+// ========================================
+// Migrate the store at storeURL to destinationModel, if it was created with one of sourceModels
+// The store is migrated in place, and the original is kept alongside it as a backup
+// Only changes that can be made without a mapping model from Xcode are supported:
+// entities and properties may be added or removed, but not renamed
+// ========================================
+BOOL migratePersistentStore(NSURL *storeURL, NSString *storeType, NSManagedObjectModel *destinationModel, NSArray *sourceModels, NSError **error);
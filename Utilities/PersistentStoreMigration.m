@@ -0,0 +1,226 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "PersistentStoreMigration.h"
+#import "Logger.h"
+
+// ========================================
+// Expressions matching those used by the mapping models Xcode generates
+// ========================================
+static NSExpression *
+valueForKeyExpression(NSExpression *object, NSString *key)
+{
+	return [NSExpression expressionForFunction:object selectorName:@"valueForKey:" arguments:[NSArray arrayWithObject:[NSExpression expressionForConstantValue:key]]];
+}
+
+static NSString *
+entityMappingName(NSString *entityName)
+{
+	return [NSString stringWithFormat:@"%@To%@", entityName, entityName];
+}
+
+// ========================================
+// Fetches for an entity include the instances of its subentities, so each instance is
+// migrated only by the mapping for its own entity
+// Relationships are set per instance, from the mapping for the entity of each object
+// they pointed to in the source, so a to-one relationship to a subentity instance
+// resolves to exactly one destination instance
+// ========================================
+@interface PersistentStoreMigrationPolicy : NSEntityMigrationPolicy
+{
+}
+@end
+
+@implementation PersistentStoreMigrationPolicy
+
+- (BOOL) createDestinationInstancesForSourceInstance:(NSManagedObject *)sInstance entityMapping:(NSEntityMapping *)mapping manager:(NSMigrationManager *)manager error:(NSError **)error
+{
+	if(![[[sInstance entity] name] isEqualToString:[mapping sourceEntityName]])
+		return YES;
+
+	return [super createDestinationInstancesForSourceInstance:sInstance entityMapping:mapping manager:manager error:error];
+}
+
+- (BOOL) createRelationshipsForDestinationInstance:(NSManagedObject *)dInstance entityMapping:(NSEntityMapping *)mapping manager:(NSMigrationManager *)manager error:(NSError **)error
+{
+
+#pragma unused(error)
+
+	NSManagedObject *sInstance = [[manager sourceInstancesForEntityMappingNamed:[mapping name] destinationInstances:[NSArray arrayWithObject:dInstance]] lastObject];
+	if(!sInstance)
+		return YES;
+
+	// Relationships new in this version are left empty
+	NSDictionary *sourceRelationships = [[sInstance entity] relationshipsByName];
+	NSDictionary *destinationRelationships = [[dInstance entity] relationshipsByName];
+
+	for(NSString *relationshipName in destinationRelationships) {
+		if(![sourceRelationships objectForKey:relationshipName])
+			continue;
+
+		NSRelationshipDescription *relationship = [destinationRelationships objectForKey:relationshipName];
+		id sourceValue = [sInstance valueForKey:relationshipName];
+
+		if([relationship isToMany]) {
+			NSMutableSet *destinationObjects = [NSMutableSet set];
+			for(NSManagedObject *sourceObject in sourceValue)
+				[destinationObjects addObjectsFromArray:[manager destinationInstancesForEntityMappingNamed:entityMappingName([[sourceObject entity] name]) sourceInstances:[NSArray arrayWithObject:sourceObject]]];
+			[dInstance setValue:destinationObjects forKey:relationshipName];
+		}
+		else if(sourceValue) {
+			NSArray *destinationObjects = [manager destinationInstancesForEntityMappingNamed:entityMappingName([[sourceValue entity] name]) sourceInstances:[NSArray arrayWithObject:sourceValue]];
+			[dInstance setValue:[destinationObjects lastObject] forKey:relationshipName];
+		}
+	}
+
+	return YES;
+}
+
+@end
+
+// ========================================
+// Map each entity and property in destinationModel to the one with the same name in sourceModel
+// ========================================
+static NSMappingModel *
+mappingModelForModels(NSManagedObjectModel *sourceModel, NSManagedObjectModel *destinationModel)
+{
+	NSCParameterAssert(nil != sourceModel);
+	NSCParameterAssert(nil != destinationModel);
+
+	NSExpression *manager = [NSExpression expressionForVariable:@"manager"];
+	NSExpression *source = [NSExpression expressionForVariable:@"source"];
+	NSDictionary *sourceEntities = [sourceModel entitiesByName];
+	NSMutableArray *entityMappings = [NSMutableArray array];
+
+	for(NSEntityDescription *destinationEntity in [destinationModel entities]) {
+		NSString *entityName = [destinationEntity name];
+		NSEntityDescription *sourceEntity = [sourceEntities objectForKey:entityName];
+
+		NSEntityMapping *entityMapping = [[NSEntityMapping alloc] init];
+		[entityMapping setName:entityMappingName(entityName)];
+		[entityMapping setDestinationEntityName:entityName];
+		[entityMapping setDestinationEntityVersionHash:[destinationEntity versionHash]];
+
+		// Entities new in this version have no instances to migrate
+		if(!sourceEntity) {
+			[entityMapping setMappingType:NSAddEntityMappingType];
+			[entityMappings addObject:entityMapping];
+			continue;
+		}
+
+		[entityMapping setMappingType:NSTransformEntityMappingType];
+		[entityMapping setSourceEntityName:entityName];
+		[entityMapping setSourceEntityVersionHash:[sourceEntity versionHash]];
+
+		// The policy skips subentity instances and sets the relationships
+		[entityMapping setEntityMigrationPolicyClassName:NSStringFromClass([PersistentStoreMigrationPolicy class])];
+
+		// FETCH(FUNCTION($manager, "fetchRequestForSourceEntityNamed:predicateString:", entityName, "TRUEPREDICATE"), $manager.sourceContext, NO)
+		NSArray *fetchArguments = [NSArray arrayWithObjects:[NSExpression expressionForConstantValue:entityName], [NSExpression expressionForConstantValue:@"TRUEPREDICATE"], nil];
+		NSExpression *fetchRequest = [NSExpression expressionForFunction:manager selectorName:@"fetchRequestForSourceEntityNamed:predicateString:" arguments:fetchArguments];
+		NSExpression *sourceContext = [NSExpression expressionForFunction:manager selectorName:@"sourceContext" arguments:[NSArray array]];
+		[entityMapping setSourceExpression:[NSFetchRequestExpression expressionForFetch:fetchRequest context:sourceContext countOnly:NO]];
+
+		// Attributes are copied, and those new in this version are left at their default values
+		NSDictionary *sourceAttributes = [sourceEntity attributesByName];
+		NSMutableArray *attributeMappings = [NSMutableArray array];
+		for(NSString *attributeName in [destinationEntity attributesByName]) {
+			NSPropertyMapping *propertyMapping = [[NSPropertyMapping alloc] init];
+			[propertyMapping setName:attributeName];
+			if([sourceAttributes objectForKey:attributeName])
+				[propertyMapping setValueExpression:valueForKeyExpression(source, attributeName)];
+			[attributeMappings addObject:propertyMapping];
+		}
+		[entityMapping setAttributeMappings:attributeMappings];
+
+		[entityMappings addObject:entityMapping];
+	}
+
+	NSMappingModel *mappingModel = [[NSMappingModel alloc] init];
+	[mappingModel setEntityMappings:entityMappings];
+
+	return mappingModel;
+}
+
+// "Ripped CDs.sqlite" becomes "Ripped CDs (suffix).sqlite"
+static NSString *
+pathWithSuffix(NSString *path, NSString *suffix)
+{
+	NSString *pathWithoutExtension = [NSString stringWithFormat:@"%@ (%@)", [path stringByDeletingPathExtension], suffix];
+	return [pathWithoutExtension stringByAppendingPathExtension:[path pathExtension]];
+}
+
+BOOL
+migratePersistentStore(NSURL *storeURL, NSString *storeType, NSManagedObjectModel *destinationModel, NSArray *sourceModels, NSError **error)
+{
+	NSCParameterAssert(nil != storeURL);
+	NSCParameterAssert(nil != storeType);
+	NSCParameterAssert(nil != destinationModel);
+
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	NSString *storePath = [storeURL path];
+
+	// A store that doesn't exist yet will be created with the current model
+	if(![fileManager fileExistsAtPath:storePath])
+		return YES;
+
+	NSDictionary *metadata = [NSPersistentStoreCoordinator metadataForPersistentStoreOfType:storeType URL:storeURL error:error];
+	if(!metadata)
+		return NO;
+
+	if([destinationModel isConfiguration:nil compatibleWithStoreMetadata:metadata])
+		return YES;
+
+	// Determine the version of the model the store was created with
+	NSManagedObjectModel *sourceModel = nil;
+	for(NSManagedObjectModel *model in sourceModels) {
+		if([model isConfiguration:nil compatibleWithStoreMetadata:metadata]) {
+			sourceModel = model;
+			break;
+		}
+	}
+
+	if(!sourceModel) {
+		if(error)
+			*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSPersistentStoreIncompatibleVersionHashError userInfo:[NSDictionary dictionaryWithObject:storePath forKey:NSFilePathErrorKey]];
+		return NO;
+	}
+
+	[[Logger sharedLogger] logMessage:@"Migrating %@ to the current model", storePath];
+
+	// Migrate to a new store, so the original is untouched if migration fails
+	NSString *migratedStorePath = pathWithSuffix(storePath, @"Migrating");
+	if([fileManager fileExistsAtPath:migratedStorePath] && ![fileManager removeItemAtPath:migratedStorePath error:error])
+		return NO;
+
+	NSMigrationManager *migrationManager = [[NSMigrationManager alloc] initWithSourceModel:sourceModel destinationModel:destinationModel];
+	if(![migrationManager migrateStoreFromURL:storeURL 
+										 type:storeType 
+									  options:nil 
+							 withMappingModel:mappingModelForModels(sourceModel, destinationModel) 
+							 toDestinationURL:[NSURL fileURLWithPath:migratedStorePath] 
+							  destinationType:storeType 
+						   destinationOptions:nil 
+										error:error])
+	{
+		[fileManager removeItemAtPath:migratedStorePath error:NULL];
+		return NO;
+	}
+
+	// Keep the original store as a backup and put the migrated store in its place
+	NSString *backupStorePath = pathWithSuffix(storePath, @"Backup");
+	if([fileManager fileExistsAtPath:backupStorePath] && ![fileManager removeItemAtPath:backupStorePath error:error])
+		return NO;
+
+	if(![fileManager moveItemAtPath:storePath toPath:backupStorePath error:error])
+		return NO;
+
+	if(![fileManager moveItemAtPath:migratedStorePath toPath:storePath error:error]) {
+		[fileManager moveItemAtPath:backupStorePath toPath:storePath error:NULL];
+		return NO;
+	}
+
+	return YES;
+}
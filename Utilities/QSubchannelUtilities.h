@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#pragma once
+
+#import <Cocoa/Cocoa.h>
+#include <IOKit/storage/IOCDTypes.h>
+
+// ========================================
+// Q sub-channel frames as returned by READ CD (kCDSectorSizeQSubchannel bytes each)
+// Byte 0 holds the control and ADR nibbles, bytes 1 - 9 the data and bytes 10 - 11 the
+// CRC-16 of bytes 0 - 9, inverted and big endian
+// ========================================
+#define Q_SUBCHANNEL_CRC_OFFSET			10
+
+// The track number of the lead-out in Mode-1 Q
+#define Q_SUBCHANNEL_LEAD_OUT_TRACK		0xAA
+
+enum _eQSubchannelFrameFlags {
+	eQSubchannelFrameCRCIsValid				= 1u << 0,	// The frame's CRC was present and matched
+	eQSubchannelFrameCRCIsAbsent			= 1u << 1,	// The drive didn't return the CRC (it was zero)
+	eQSubchannelFramePositionIsValid		= 1u << 2	// A Mode-1 frame whose CRC didn't fail and whose BCD fields were well-formed
+};
+typedef enum _eQSubchannelFrameFlags eQSubchannelFrameFlags;
+
+// ========================================
+// A decoded Q frame, with the BCD fields converted to binary
+// The position fields are only meaningful when eQSubchannelFramePositionIsValid is set
+// ========================================
+struct QSubchannelFrame {
+	uint8_t adr;
+	uint8_t control;
+	uint8_t trackNumber;		// Q_SUBCHANNEL_LEAD_OUT_TRACK in the lead-out
+	uint8_t index;
+	CDMSF relativeMSF;			// Relative to the start of the track's index 1 (counts down in the pregap)
+	CDMSF absoluteMSF;
+	uint8_t flags;				// See eQSubchannelFrameFlags
+};
+typedef struct QSubchannelFrame QSubchannelFrame;
+
+// ========================================
+// Calculate the CRC-16 (CCITT) of the first Q_SUBCHANNEL_CRC_OFFSET bytes of a frame, before inversion
+// ========================================
+uint16_t calculateQSubchannelCRC(const uint8_t *qData);
+
+// ========================================
+// Returns YES if the frame's CRC matches, or if the drive didn't return one
+// ========================================
+BOOL qSubchannelCRCIsValid(const uint8_t *qData);
+
+// ========================================
+// Decode frameCount frames spaced stride bytes apart, so Q interleaved with audio or
+// error flags can be decoded in place
+// Returns the number of frames with a valid position
+// ========================================
+NSUInteger decodeQSubchannelFrames(const void *buffer, size_t stride, NSUInteger frameCount, QSubchannelFrame *frames);
+
+// ========================================
+// Get the LBA described by a frame's absolute MSF (negative in the first track's pregap)
+// Returns NO if the frame doesn't hold a valid position
+// ========================================
+BOOL getSectorForQSubchannelFrame(const QSubchannelFrame *frame, NSInteger *sector);
+
+// ========================================
+// Extract the MCN from a Mode-2 frame or the ISRC from a Mode-3 frame
+// These return nil for frames of another mode, with a CRC mismatch or with malformed contents
+// ========================================
+NSString * mediaCatalogNumberForQSubchannelData(const uint8_t *qData);
+NSString * isrcForQSubchannelData(const uint8_t *qData);
@@ -0,0 +1,230 @@
+/*
+ *  Copyright (C) 2009 Stephen F. Booth <me@sbooth.org>
+ *  All Rights Reserved
+ */
+
+#import "QSubchannelUtilities.h"
+#import "CDDAUtilities.h"
+
+// ========================================
+// CRC-16-CCITT (polynomial 0x1021) of each byte value, so the CRC is calculated a byte at a time
+// ========================================
+static const uint16_t sCRC16Table [256] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+	0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+	0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+	0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+	0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+	0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+	0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+	0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+	0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+	0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+	0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+	0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+	0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+	0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+	0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+	0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+	0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+	0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+	0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+	0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+	0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+	0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+// ========================================
+// The binary value of each BCD byte, or 0xFF if either nibble isn't a decimal digit
+// ========================================
+#define INVALID_BCD		0xFF
+
+static const uint8_t sBCDTable [256] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+uint16_t
+calculateQSubchannelCRC(const uint8_t *qData)
+{
+	NSCParameterAssert(NULL != qData);
+
+	uint16_t crc = 0;
+	for(NSUInteger i = 0; i < Q_SUBCHANNEL_CRC_OFFSET; ++i)
+		crc = (uint16_t)((crc << 8) ^ sCRC16Table[(crc >> 8) ^ qData[i]]);
+
+	return crc;
+}
+
+BOOL
+qSubchannelCRCIsValid(const uint8_t *qData)
+{
+	NSCParameterAssert(NULL != qData);
+
+	uint16_t storedCRC = (uint16_t)((qData[Q_SUBCHANNEL_CRC_OFFSET] << 8) | qData[Q_SUBCHANNEL_CRC_OFFSET + 1]);
+
+	return (0 == storedCRC || (uint16_t)~calculateQSubchannelCRC(qData) == storedCRC);
+}
+
+NSUInteger
+decodeQSubchannelFrames(const void *buffer, size_t stride, NSUInteger frameCount, QSubchannelFrame *frames)
+{
+	NSCParameterAssert(NULL != buffer);
+	NSCParameterAssert(kCDSectorSizeQSubchannel <= stride);
+	NSCParameterAssert(NULL != frames);
+
+	const uint8_t *qData = (const uint8_t *)buffer;
+	NSUInteger validFrameCount = 0;
+
+	for(NSUInteger i = 0; i < frameCount; ++i, qData += stride) {
+		QSubchannelFrame *frame = frames + i;
+
+		bzero(frame, sizeof(QSubchannelFrame));
+
+		frame->adr = 0x0F & qData[0];
+		frame->control = 0x0F & (qData[0] >> 4);
+
+		uint16_t storedCRC = (uint16_t)((qData[Q_SUBCHANNEL_CRC_OFFSET] << 8) | qData[Q_SUBCHANNEL_CRC_OFFSET + 1]);
+		if(0 == storedCRC)
+			frame->flags |= eQSubchannelFrameCRCIsAbsent;
+		else if((uint16_t)~calculateQSubchannelCRC(qData) == storedCRC)
+			frame->flags |= eQSubchannelFrameCRCIsValid;
+		else
+			continue;
+
+		// Only Mode-1 Q in the program area (AKA current position Q) describes the position
+		if(0x1 != frame->adr || 0 != qData[6])
+			continue;
+
+		uint8_t trackNumber = (Q_SUBCHANNEL_LEAD_OUT_TRACK == qData[1] ? Q_SUBCHANNEL_LEAD_OUT_TRACK : sBCDTable[qData[1]]);
+		if(INVALID_BCD == trackNumber)
+			continue;
+
+		// The index and MSF fields are bytes 2 - 5 and 7 - 9
+		// Valid values never exceed 99, so OR-ing the converted fields together catches an invalid BCD byte in any of them at once
+		uint8_t fields [7];
+		uint8_t combinedFields = 0;
+		for(NSUInteger j = 0; j < 7; ++j) {
+			fields[j] = sBCDTable[qData[(j < 4 ? 2 + j : 3 + j)]];
+			combinedFields |= fields[j];
+		}
+
+		if(0x80 & combinedFields)
+			continue;
+
+		frame->trackNumber = trackNumber;
+		frame->index = fields[0];
+		frame->relativeMSF.minute = fields[1];
+		frame->relativeMSF.second = fields[2];
+		frame->relativeMSF.frame = fields[3];
+		frame->absoluteMSF.minute = fields[4];
+		frame->absoluteMSF.second = fields[5];
+		frame->absoluteMSF.frame = fields[6];
+
+		if(60 <= frame->relativeMSF.second || CDDA_SECTORS_PER_SECOND <= frame->relativeMSF.frame || 60 <= frame->absoluteMSF.second || CDDA_SECTORS_PER_SECOND <= frame->absoluteMSF.frame)
+			continue;
+
+		frame->flags |= eQSubchannelFramePositionIsValid;
+		++validFrameCount;
+	}
+
+	return validFrameCount;
+}
+
+BOOL
+getSectorForQSubchannelFrame(const QSubchannelFrame *frame, NSInteger *sector)
+{
+	NSCParameterAssert(NULL != frame);
+	NSCParameterAssert(NULL != sector);
+
+	if(!(eQSubchannelFramePositionIsValid & frame->flags))
+		return NO;
+
+	*sector = (NSInteger)(((frame->absoluteMSF.minute * 60) + frame->absoluteMSF.second) * CDDA_SECTORS_PER_SECOND) + frame->absoluteMSF.frame - 150;
+
+	return YES;
+}
+
+NSString *
+mediaCatalogNumberForQSubchannelData(const uint8_t *qData)
+{
+	NSCParameterAssert(NULL != qData);
+
+	if(0x2 != (0x0F & qData[0]) || !qSubchannelCRCIsValid(qData))
+		return nil;
+
+	// The MCN is 13 BCD digits
+	char mcn [14];
+	for(NSUInteger i = 0; i < 13; ++i) {
+		uint8_t digit = 0x0F & (qData[1 + (i / 2)] >> (i % 2 ? 0 : 4));
+		if(9 < digit)
+			return nil;
+		mcn[i] = (char)('0' + digit);
+	}
+	mcn[13] = '\0';
+
+	// Discs without an MCN may still emit Mode-2 Q, but with all digits zero
+	if(0 == strcmp(mcn, "0000000000000"))
+		return nil;
+
+	return [NSString stringWithCString:mcn encoding:NSASCIIStringEncoding];
+}
+
+NSString *
+isrcForQSubchannelData(const uint8_t *qData)
+{
+	NSCParameterAssert(NULL != qData);
+
+	if(0x3 != (0x0F & qData[0]) || !qSubchannelCRCIsValid(qData))
+		return nil;
+
+	// The ISRC is five 6-bit characters (country and owner), two zero bits, then seven BCD digits (year and serial number)
+	uint64_t bits = 0;
+	for(NSUInteger i = 1; i <= 8; ++i)
+		bits = (bits << 8) | qData[i];
+
+	char isrc [13];
+	for(NSUInteger i = 0; i < 5; ++i) {
+		uint8_t c = (uint8_t)(0x3F & (bits >> (58 - (6 * i))));
+		if(9 >= c)
+			isrc[i] = (char)('0' + c);
+		else if(0x11 <= c && 0x2A >= c)
+			isrc[i] = (char)('A' + (c - 0x11));
+		else
+			return nil;
+	}
+
+	for(NSUInteger i = 0; i < 7; ++i) {
+		uint8_t digit = (uint8_t)(0x0F & (bits >> (28 - (4 * i))));
+		if(9 < digit)
+			return nil;
+		isrc[5 + i] = (char)('0' + digit);
+	}
+	isrc[12] = '\0';
+
+	return [NSString stringWithCString:isrc encoding:NSASCIIStringEncoding];
+}
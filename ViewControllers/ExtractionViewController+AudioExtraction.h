@@ -14,5 +14,7 @@
 - (void) extractSectorRange:(SectorRange *)sectorRange useC2:(BOOL)useC2;
 - (void) extractSectorRange:(SectorRange *)sectorRange useC2:(BOOL)useC2 enforceMinimumReadSize:(BOOL)enforceMinimumReadSize;
 
+- (void) extractSectors:(NSIndexSet *)sectorIndexes inSectorRange:(SectorRange *)sectorRange useC2:(BOOL)useC2;
+
 - (void) extractSectors:(NSIndexSet *)sectorIndexes coalesceRanges:(BOOL)coalesceRanges;
 @end
@@ -12,11 +12,32 @@
 #import "SessionDescriptor.h"
 
 #import "ExtractionOperation.h"
-
-#import "FileUtilities.h"
+#import "SectorStore.h"
 
 #include <IOKit/storage/IOCDTypes.h>
 
+// ========================================
+// Pad range on both sides so that at least MINIMUM_DISC_READ_SIZE is read
+// ========================================
+static SectorRange *
+sectorRangeEnforcingMinimumReadSize(SectorRange *sectorRange)
+{
+	NSCParameterAssert(nil != sectorRange);
+	
+	if(MINIMUM_DISC_READ_SIZE <= sectorRange.byteSize)
+		return sectorRange;
+	
+	NSUInteger sizeIncrease = MINIMUM_DISC_READ_SIZE - sectorRange.byteSize;
+	NSUInteger sectorOffset = ((sizeIncrease / 2)  / kCDSectorSizeCDDA) + 1;
+	
+	NSUInteger newFirstSector = sectorRange.firstSector;
+	if(newFirstSector > sectorOffset)
+		newFirstSector -= sectorOffset;
+	NSUInteger newLastSector = sectorRange.lastSector + sectorOffset;
+	
+	return [SectorRange sectorRangeWithFirstSector:newFirstSector lastSector:newLastSector];
+}
+
 @implementation ExtractionViewController (AudioExtraction)
 
 - (void) extractSectorRange:(SectorRange *)sectorRange
@@ -34,27 +55,40 @@
 	NSParameterAssert(nil != sectorRange);
 	
 	// Should a block of at least MINIMUM_DISC_READ_SIZE be read?
-	if(enforceMinimumReadSize && MINIMUM_DISC_READ_SIZE > sectorRange.byteSize) {
-		NSUInteger sizeIncrease = MINIMUM_DISC_READ_SIZE - sectorRange.byteSize;
-		NSUInteger sectorOffset = ((sizeIncrease / 2)  / kCDSectorSizeCDDA) + 1;
-		
-		NSUInteger newFirstSector = sectorRange.firstSector;
-		if(newFirstSector > sectorOffset)
-			newFirstSector -= sectorOffset;
-		NSUInteger newLastSector = sectorRange.lastSector + sectorOffset;
-		
-		sectorRange = [SectorRange sectorRangeWithFirstSector:newFirstSector lastSector:newLastSector];
-	}
+	if(enforceMinimumReadSize)
+		sectorRange = sectorRangeEnforcingMinimumReadSize(sectorRange);
+	
+	[self extractSectors:nil inSectorRange:sectorRange useC2:useC2];
+}
+
+- (void) extractSectors:(NSIndexSet *)sectorIndexes inSectorRange:(SectorRange *)sectorRange useC2:(BOOL)useC2
+{
+	NSParameterAssert(nil != sectorRange);
 	
 	// Audio extraction
 	ExtractionOperation *extractionOperation = [[ExtractionOperation alloc] init];
 	
 	extractionOperation.disk = self.disk;
+	extractionOperation.session = _driveSession;
+	// The track can't be finished until these reads are, so they go ahead of anything else using the drive
+	extractionOperation.ioPriority = eDriveIOPriorityCritical;
 	extractionOperation.sectors = sectorRange;
+	extractionOperation.sectorIndexes = sectorIndexes;
 	extractionOperation.allowedSectors = self.compactDisc.firstSession.sectorRange;
 	extractionOperation.readOffset = self.driveInformation.readOffset;
-	extractionOperation.URL = temporaryURLWithExtension(@"wav");
+	extractionOperation.sectorStore = [SectorStore sectorStore];
 	extractionOperation.useC2 = useC2;
+	extractionOperation.verifyPositions = [[NSUserDefaults standardUserDefaults] boolForKey:@"verifyQSubchannelPositions"];
+	// Drives that don't stream accurately (or may not) need their reads aligned
+	extractionOperation.correctJitter = ![self.driveInformation.hasAccurateStream boolValue];
+	// Sectors that can't be read are retried more slowly (a multiplier of 0 leaves the speed alone)
+	extractionOperation.recoveryRetryCount = [[NSUserDefaults standardUserDefaults] integerForKey:@"recoveryRetryCount"];
+	extractionOperation.recoveryBackoffInterval = [[NSUserDefaults standardUserDefaults] doubleForKey:@"recoveryBackoffInterval"];
+	extractionOperation.recoverySpeed = (uint16_t)MIN(kCDSpeedMax, kCDSpeedMin * MAX(0, [[NSUserDefaults standardUserDefaults] integerForKey:@"recoverySpeedMultiplier"]));
+	// Sectors that disagreed (or had C2 errors) in earlier passes are re-read more slowly
+	extractionOperation.speedController = _speedController;
+	extractionOperation.suspectSectors = _sectorsNeedingVerification;
+	extractionOperation.trackSectors = _currentTrack.sectorRange;
 	
 	// Observe the operation's progress
 	[extractionOperation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kAudioExtractionKVOContext];
@@ -69,52 +103,31 @@
 {
 	NSParameterAssert(nil != sectorIndexes);
 	
-	// Coalesce the index set into ranges to minimize the number of disc accesses
-	if(coalesceRanges) {
-		NSUInteger firstIndex = NSNotFound;
-		NSUInteger latestIndex = NSNotFound;
-		NSUInteger sectorIndex = [sectorIndexes firstIndex];
-		
-		for(;;) {
-			// Last sector
-			if(NSNotFound == sectorIndex) {
-				if(NSNotFound != firstIndex) {
-					if(firstIndex == latestIndex)
-						[self extractSectorRange:[SectorRange sectorRangeWithSector:firstIndex] useC2:[self.driveInformation.useC2 boolValue] enforceMinimumReadSize:YES];
-					else
-						[self extractSectorRange:[SectorRange sectorRangeWithFirstSector:firstIndex lastSector:latestIndex] useC2:[self.driveInformation.useC2 boolValue] enforceMinimumReadSize:YES];
-				}
-				
-				break;
-			}
-			
-			// Consolidate this sector into the current range
-			if(latestIndex == (sectorIndex - 1))
-				latestIndex = sectorIndex;
-			// Store the previous range and start a new one
-			else {
-				if(NSNotFound != firstIndex) {
-					if(firstIndex == latestIndex)
-						[self extractSectorRange:[SectorRange sectorRangeWithSector:firstIndex] useC2:[self.driveInformation.useC2 boolValue] enforceMinimumReadSize:YES];
-					else /*if(firstIndex + 891 < latestIndex)*/
-						[self extractSectorRange:[SectorRange sectorRangeWithFirstSector:firstIndex lastSector:latestIndex] useC2:[self.driveInformation.useC2 boolValue] enforceMinimumReadSize:YES];
-				}
-				
-				firstIndex = sectorIndex;
-				latestIndex = sectorIndex;
-			}
-			
-			sectorIndex = [sectorIndexes indexGreaterThanIndex:sectorIndex];
-		}
-	}
-	else {
-		NSUInteger sectorIndex = [sectorIndexes firstIndex];
-		while(NSNotFound != sectorIndex) {
-			[self extractSectorRange:[SectorRange sectorRangeWithSector:sectorIndex] useC2:[self.driveInformation.useC2 boolValue] enforceMinimumReadSize:YES];
-			sectorIndex = [sectorIndexes indexGreaterThanIndex:sectorIndex];			
+	if(![sectorIndexes count])
+		return;
+	
+	// Each range (or sector) is padded to the minimum read size, and all of them are read
+	// in a single operation into a single store, so a round of scattered re-reads only pays
+	// the cost of setting up an extraction once
+	// When ranges are coalesced, adjacent sectors are padded as one
+	NSMutableIndexSet *sectorsToExtract = [NSMutableIndexSet indexSet];
+	NSUInteger firstIndex = [sectorIndexes firstIndex];
+	
+	while(NSNotFound != firstIndex) {
+		NSUInteger latestIndex = firstIndex;
+		if(coalesceRanges) {
+			while([sectorIndexes containsIndex:(latestIndex + 1)])
+				++latestIndex;
 		}
 		
-	}	
+		SectorRange *sectorRange = sectorRangeEnforcingMinimumReadSize([SectorRange sectorRangeWithFirstSector:firstIndex lastSector:latestIndex]);
+		[sectorsToExtract addIndexesInRange:[sectorRange rangeValue]];
+		
+		firstIndex = [sectorIndexes indexGreaterThanIndex:latestIndex];
+	}
+	
+	SectorRange *sectorRange = [SectorRange sectorRangeWithFirstSector:[sectorsToExtract firstIndex] lastSector:[sectorsToExtract lastIndex]];
+	[self extractSectors:sectorsToExtract inSectorRange:sectorRange useC2:[self.driveInformation.useC2 boolValue]];
 }
 
 @end
@@ -6,13 +6,13 @@
 #import <Cocoa/Cocoa.h>
 #import "ExtractionViewController.h"
 
-@class ExtractionOperation, TrackDescriptor, TrackExtractionRecord, ImageExtractionRecord;
+@class ExtractionOperation, SectorStore, TrackDescriptor, TrackExtractionRecord, ImageExtractionRecord;
 
 // ========================================
 // Methods for creating track and image extraction records
 // ========================================
 @interface ExtractionViewController (ExtractionRecordCreation)
-- (NSURL *) generateOutputFileForURL:(NSURL *)inputURL error:(NSError **)error;
+- (NSURL *) generateOutputFileForSectorStore:(SectorStore *)sectorStore error:(NSError **)error;
 
 - (TrackExtractionRecord *) createTrackExtractionRecordForFileURL:(NSURL *)fileURL;
 - (TrackExtractionRecord *) createTrackExtractionRecordForFileURL:(NSURL *)fileURL accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel;
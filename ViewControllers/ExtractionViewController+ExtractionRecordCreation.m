@@ -9,7 +9,7 @@
 #import "AudioUtilities.h"
 #import "CDDAUtilities.h"
 
-#import "ExtractedAudioFile.h"
+#import "SectorStore.h"
 
 #import "SectorRange.h"
 
@@ -26,51 +26,43 @@
 
 #import "Logger.h"
 
-#include <AudioToolbox/AudioFile.h>
-
 @implementation ExtractionViewController (ExtractionRecordCreation)
 
-- (NSURL *) generateOutputFileForURL:(NSURL *)inputURL error:(NSError **)error
+- (NSURL *) generateOutputFileForSectorStore:(SectorStore *)sectorStore error:(NSError **)error
 {
-	NSParameterAssert(nil != inputURL);
+	NSParameterAssert(nil != sectorStore);
 	
 	[_detailedStatusTextField setStringValue:NSLocalizedString(@"Creating output file", @"")];	
 	
-	NSURL *URL = inputURL;
+	// The encoders require a file, so write the track audio out of the store
+	NSURL *outputURL = temporaryURLWithExtension(@"wav");
 	
-	// Strip off the extra audio before encoding
-	if(MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS) {
-
-		// Create the output file
-		NSURL *outputURL = temporaryURLWithExtension(@"wav");
-		if(!createCDDAFileAtURL(outputURL, error))
-			return nil;
-		
-		// The inputURL may have extra audio prepended for Accurate Rip calculations
-		// If so, it needs to be skipped
-		if(!copySectorsFromURLToURL(inputURL, NSMakeRange(MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS - _sectorsOfSilenceToPrepend, _currentTrack.sectorCount), outputURL, 0)) {
-			if(error)
-				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
-			return nil;
-		}
-		
-		URL = outputURL;
-	}
+	// The store may have extra audio prepended for Accurate Rip calculations
+	// If so, it needs to be skipped
+	if(![sectorStore writeSectors:NSMakeRange(MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS - _sectorsOfSilenceToPrepend, _currentTrack.sectorCount) toURL:outputURL error:error])
+		return nil;
 	
-	return URL;
+	return outputURL;
 }
 
 - (TrackExtractionRecord *) createTrackExtractionRecordForFileURL:(NSURL *)fileURL
 {
 	NSParameterAssert(nil != fileURL);
 	
+	uint32_t accurateRipChecksumV2 = 0;
 	NSUInteger accurateRipChecksum = calculateAccurateRipChecksumForFile(fileURL,											
 																		 [self.compactDisc.firstSession.firstTrack.number isEqualToNumber:_currentTrack.number],
-																		 [self.compactDisc.firstSession.lastTrack.number isEqualToNumber:_currentTrack.number]);
+																		 [self.compactDisc.firstSession.lastTrack.number isEqualToNumber:_currentTrack.number],
+																		 &accurateRipChecksumV2);
 	
-	return [self createTrackExtractionRecordForFileURL:fileURL
-								   accurateRipChecksum:accurateRipChecksum 
-							accurateRipConfidenceLevel:nil];
+	TrackExtractionRecord *extractionRecord = [self createTrackExtractionRecordForFileURL:fileURL
+																	  accurateRipChecksum:accurateRipChecksum 
+															   accurateRipConfidenceLevel:nil];
+	
+	if(extractionRecord && accurateRipChecksumV2)
+		extractionRecord.accurateRipChecksumV2 = [NSNumber numberWithUnsignedInt:accurateRipChecksumV2];
+	
+	return extractionRecord;
 }
 
 - (TrackExtractionRecord *) createTrackExtractionRecordForFileURL:(NSURL *)fileURL
@@ -108,7 +100,7 @@
 {
 	NSParameterAssert(nil != fileURL);
 
-	// Calculate the MD5 and SHA1 digests
+	// Calculate the MD5 and SHA1 digests and the CRCs
 	NSArray *digests = calculateMD5AndSHA1DigestsForURL(fileURL);
 	if(!digests)
 		return nil;
@@ -120,8 +112,10 @@
 	extractionRecord.date = [NSDate date];
 	extractionRecord.drive = self.driveInformation;
 	extractionRecord.inputURL = fileURL;
-	extractionRecord.MD5 = [digests objectAtIndex:0];
-	extractionRecord.SHA1 = [digests objectAtIndex:1];
+	extractionRecord.MD5 = MD5;
+	extractionRecord.SHA1 = SHA1;
+	extractionRecord.CRC32 = [digests objectAtIndex:2];
+	extractionRecord.CRC32WithoutNullSamples = [digests objectAtIndex:3];
 	extractionRecord.track = _currentTrack;
 	
 	if(blockErrorFlags)
@@ -163,39 +157,43 @@
 	[_statusTextField setStringValue:NSLocalizedString(@"Creating image file", @"")];
 	[_detailedStatusTextField setStringValue:@""];
 	
-	NSURL *imageFileURL = temporaryURLWithExtension(@"wav");
-	
-	// Set up the ASBD for CDDA audio
-	AudioStreamBasicDescription cddaASBD = getStreamDescriptionForCDDA();
-	
-	// Create the output file
-	AudioFileID file = NULL;
-	OSStatus status = AudioFileCreateWithURL((CFURLRef)imageFileURL, kAudioFileWAVEType, &cddaASBD, kAudioFileFlags_EraseFile, &file);
-	if(noErr != status)
-		return nil;
-	
-	status = AudioFileClose(file);
-	if(noErr != status)
-		return nil;
-
 	// Sort the extracted tracks
 	NSSortDescriptor *trackNumberSortDescriptor = [[NSSortDescriptor alloc] initWithKey:@"track.number" ascending:YES];
 	NSArray *sortedTrackExtractionRecords = [[_trackExtractionRecords allObjects] sortedArrayUsingDescriptors:[NSArray arrayWithObject:trackNumberSortDescriptor]];
-		
+	
 	// Loop over all the extracted tracks and concatenate them together
+	SectorStore *image = [SectorStore sectorStore];
 	NSUInteger imageSectorNumber = 0;
 	for(TrackExtractionRecord *trackExtractionRecord in sortedTrackExtractionRecords) {
-		if(!copyAllSectorsFromURLToURL(trackExtractionRecord.inputURL, imageFileURL, imageSectorNumber))
+		NSError *error = nil;
+		SectorStore *track = [SectorStore sectorStoreWithContentsOfURL:trackExtractionRecord.inputURL error:&error];
+		BOOL trackCopied = (track && [image copySectors:NSMakeRange(0, track.sectorCount) fromSectorStore:track toSector:imageSectorNumber error:&error]);
+		
+		[track close];
+		
+		if(!trackCopied) {
+			[[Logger sharedLogger] logMessage:@"Unable to add track %@ to the image: %@", trackExtractionRecord.track.number, error];
+			[image close];
 			return nil;
+		}
 		
 		// Housekeeping
 		imageSectorNumber += trackExtractionRecord.track.sectorCount;
 	}
 	
-	// Calculate the audio checksums
-	NSArray *digests = calculateMD5AndSHA1DigestsForURL(imageFileURL);
-	if(!digests)
+	// Calculate the audio checksums from the store rather than reading the image file back
+	NSString *MD5 = image.MD5;
+	NSString *SHA1 = image.SHA1;
+	
+	NSURL *imageFileURL = temporaryURLWithExtension(@"wav");
+	BOOL imageWritten = (MD5 && SHA1 && [image writeSectors:NSMakeRange(0, image.sectorCount) toURL:imageFileURL error:NULL]);
+	
+	[image close];
+	
+	if(!imageWritten) {
+		[[NSFileManager defaultManager] removeItemAtPath:[imageFileURL path] error:NULL];
 		return nil;
+	}
 	
 	// Create the extraction record
 	ImageExtractionRecord *extractionRecord = [NSEntityDescription insertNewObjectForEntityForName:@"ImageExtractionRecord" 
@@ -205,8 +203,8 @@
 	extractionRecord.disc = self.compactDisc;
 	extractionRecord.drive = self.driveInformation;
 	extractionRecord.inputURL = imageFileURL;
-	extractionRecord.MD5 = [digests objectAtIndex:0];
-	extractionRecord.SHA1 = [digests objectAtIndex:1];
+	extractionRecord.MD5 = MD5;
+	extractionRecord.SHA1 = SHA1;
 	
 	[extractionRecord addTracks:_trackExtractionRecords];
 	
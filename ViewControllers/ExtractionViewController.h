@@ -9,15 +9,23 @@
 #include "replaygain_analysis.h"
 
 @class SectorRange, CompactDisc, DriveInformation;
-@class ExtractionOperation;
+@class ExtractionOperation, SectorStore, DriveSession, DriveSpeedController;
 @class TrackDescriptor;
 @class ImageExtractionRecord;
+@class AccurateRipChecksumIndex;
+@class ParityRecord;
 
 // ========================================
 // The number of sectors which will be scanned during offset verification
 // ========================================
 #define MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS 3
 
+// ========================================
+// The number of sectors searched for alternate pressings using AccurateRip offset checksums
+// This doesn't require any additional audio to be read
+// ========================================
+#define MAXIMUM_ALTERNATE_PRESSING_OFFSET_IN_SECTORS 50
+
 // ========================================
 // The minimum size (in bytes) of blocks to re-read from the disc
 // ========================================
@@ -35,10 +43,9 @@ typedef enum _eExtractionMode eExtractionMode;
 // ========================================
 // Context objects for observeValueForKeyPath:ofObject:change:context:
 // ========================================
-extern NSString * const kMCNDetectionKVOContext;
-extern NSString * const kISRCDetectionKVOContext;
-extern NSString * const kPregapDetectionKVOContext;
+extern NSString * const kSubchannelSurveyKVOContext;
 extern NSString * const kAudioExtractionKVOContext;
+extern NSString * const kParityRecordKVOContext;
 
 // ========================================
 // An NSViewController subclass for customizing the extraction
@@ -63,6 +70,8 @@ extern NSString * const kAudioExtractionKVOContext;
 	
 	NSMutableArray *_activeTimers;
 	NSOperationQueue *_operationQueue;
+	DriveSession *_driveSession;
+	DriveSpeedController *_speedController;
 	
 	TrackDescriptor *_currentTrack;
 	NSMutableSet *_trackIDsRemaining;
@@ -71,19 +80,26 @@ extern NSString * const kAudioExtractionKVOContext;
 	NSMutableArray *_partialExtractions;
 	NSMutableIndexSet *_sectorsNeedingVerification;
 
-	NSURL *_synthesizedTrackURL;
+	SectorStore *_synthesizedTrack;
 	NSUInteger _sectorsOfSilenceToPrepend;
 	NSUInteger _sectorsOfSilenceToAppend;
 	SectorRange *_sectorsToExtract;
 	
-	NSMutableArray *_synthesizedTrackURLs;
-	NSMutableDictionary *_synthesizedTrackSHAs;
+	NSMutableArray *_synthesizedTracks;
+	NSMutableArray *_bestGuessTracks;
 
 	NSUInteger _requiredSectorMatches;
 	NSUInteger _requiredTrackMatches;
 	NSUInteger _retryCount;
 	NSUInteger _maxRetries;
 	BOOL _allowExtractionFailure;
+	BOOL _useTestAndCopy;
+	
+	AccurateRipChecksumIndex *_accurateRipChecksumIndex;
+	AccurateRipChecksumIndex *_accurateRipOffsetChecksumIndex;
+	
+	ParityRecord *_parityRecord;
+	NSMutableSet *_trackIDsAwaitingParityRepair;
 	
 	eExtractionMode _extractionMode;
 		
@@ -112,6 +128,7 @@ extern NSString * const kAudioExtractionKVOContext;
 @property (assign) NSUInteger requiredSectorMatches;
 @property (assign) NSUInteger requiredTrackMatches;
 @property (assign) BOOL allowExtractionFailure;
+@property (assign) BOOL useTestAndCopy;
 
 @property (assign) eExtractionMode extractionMode;
 
@@ -17,11 +17,12 @@
 
 #import "SectorRange.h"
 #import "ExtractionOperation.h"
+#import "DriveSession.h"
+#import "DriveSpeedController.h"
 #import "BitArray.h"
 
-#import "MCNDetectionOperation.h"
-#import "ISRCDetectionOperation.h"
-#import "PregapDetectionOperation.h"
+#import "SubchannelSurveyOperation.h"
+#import "DiscIdentityCache.h"
 
 #import "TrackExtractionRecord.h"
 #import "ImageExtractionRecord.h"
@@ -29,6 +30,11 @@
 #import "AccurateRipDiscRecord.h"
 #import "AccurateRipTrackRecord.h"
 #import "AccurateRipUtilities.h"
+#import "AccurateRipChecksumIndex.h"
+
+#import "ParityRecord.h"
+#import "ParityRecordDatabase.h"
+#import "ParityRecordOperation.h"
 
 #import "ReadMCNSheetController.h"
 #import "ReadISRCsSheetController.h"
@@ -37,11 +43,11 @@
 #import "EncoderManager.h"
 #import "CompactDiscWindowController.h"
 
-#import "ExtractedAudioFile.h"
+#import "SectorStore.h"
 
 #import "CDDAUtilities.h"
-#import "FileUtilities.h"
 #import "AudioUtilities.h"
+#import "FileUtilities.h"
 #import "ReplayGainUtilities.h"
 
 #import "NSIndexSet+SetMethods.h"
@@ -54,16 +60,35 @@
 // ========================================
 // Context objects for observeValueForKeyPath:ofObject:change:context:
 // ========================================
-NSString * const kMCNDetectionKVOContext		= @"org.sbooth.Rip.ExtractionViewController.MCNDetectionKVOContext";
-NSString * const kISRCDetectionKVOContext		= @"org.sbooth.Rip.ExtractionViewController.ISRCDetectionKVOContext";
-NSString * const kPregapDetectionKVOContext		= @"org.sbooth.Rip.ExtractionViewController.PregapDetectionKVOContext";
+NSString * const kSubchannelSurveyKVOContext	= @"org.sbooth.Rip.ExtractionViewController.SubchannelSurveyKVOContext";
 NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewController.AudioExtractionKVOContext";
+NSString * const kParityRecordKVOContext		= @"org.sbooth.Rip.ExtractionViewController.ParityRecordKVOContext";
 
 // ========================================
 // For debugging
 // ========================================
 #define ENABLE_ACCURATERIP 1
 
+// ========================================
+// Unreadable sectors are zero-filled and misplaced sectors may hold another sector's audio,
+// so whether or not C2 is in use neither can count towards a match
+// ========================================
+static BOOL
+operationReadSectorUnreliably(ExtractionOperation *operation, NSUInteger sector)
+{
+	NSCParameterAssert(nil != operation);
+
+	return ([operation.unreadableSectors containsIndex:sector] || [operation.misplacedSectors containsIndex:sector]);
+}
+
+static BOOL
+operationHasUnreliableSectors(ExtractionOperation *operation)
+{
+	NSCParameterAssert(nil != operation);
+
+	return (operation.unreadableSectors.count || operation.misplacedSectors.count);
+}
+
 // ========================================
 // Secret goodness
 // ========================================
@@ -95,9 +120,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 - (void) didPresentErrorWithRecovery:(BOOL)didRecover contextInfo:(void *)contextInfo;
 - (void) audioExtractionTimerFired:(NSTimer *)timer;
 
-- (void) detectMCNOperationDidExecute:(MCNDetectionOperation *)operation;
-- (void) detectISRCOperationDidExecute:(ISRCDetectionOperation *)operation;
-- (void) detectPregapOperationDidExecute:(PregapDetectionOperation *)operation;
+- (void) subchannelSurveyOperationDidExecute:(SubchannelSurveyOperation *)operation;
 - (void) extractionOperationDidExecute:(ExtractionOperation *)operation;
 @end
 
@@ -107,7 +130,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 @interface ExtractionViewController (Private)
 - (void) managedObjectContextDidSave:(NSNotification *)notification;
 
-- (void) removeTemporaryFiles;
+- (void) closeSectorStores;
 - (void) resetExtractionState;
 
 - (void) startExtractingNextTrack;
@@ -115,6 +138,11 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 - (void) processExtractionOperation:(ExtractionOperation *)operation;
 - (void) processWholeTrackExtractionOperation:(ExtractionOperation *)operation;
 - (void) processPartialTrackExtractionOperation:(ExtractionOperation *)operation;
+- (void) giveUpOnCurrentTrack;
+
+- (void) finishExtraction;
+
+- (BOOL) testAndCopyCRCsMatchForOperation:(ExtractionOperation *)operation;
 
 - (NSData *) dataForSector:(NSUInteger)sector interpolate:(BOOL)interpolate;
 - (NSData *) dataForSector:(NSUInteger)sector interpolate:(BOOL)interpolate useC2:(BOOL)useC2;
@@ -131,22 +159,28 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 - (NSIndexSet *) mismatchedSectors;
 - (NSIndexSet *) mismatchedSectorsUsingC2:(BOOL)useC2;
 
-- (NSURL *) outputURL;
-- (NSURL *) outputURLUsingC2:(BOOL)useC2;
+- (SectorStore *) outputSectorStore;
+- (SectorStore *) outputSectorStoreUsingC2:(BOOL)useC2;
+
+- (SectorStore *) bestGuessSectorStore;
+- (SectorStore *) bestGuessSectorStoreUsingC2:(BOOL)useC2;
 
-- (NSURL *) bestGuessURL;
-- (NSURL *) bestGuessURLUsingC2:(BOOL)useC2;
+- (BOOL) verifyTrackWithAccurateRip:(SectorStore *)sectorStore;
 
-- (BOOL) verifyTrackWithAccurateRip:(NSURL *)inputURL;
+- (BOOL) allTracksVerifiedWithAccurateRip;
+- (void) startParityRecordOperation;
+- (void) processParityRecordOperation:(ParityRecordOperation *)operation;
+- (BOOL) repairTracksAwaitingParityRepairFromImageURL:(NSURL *)imageURL repairedSectors:(NSIndexSet *)repairedSectors;
+- (void) reextractTracksAwaitingParityRepair;
 
 - (BOOL) saveSector:(NSUInteger)sector sectorData:(NSData *)sectorData;
 - (BOOL) saveSectors:(NSIndexSet *)sectors fromOperation:(ExtractionOperation *)operation;
 
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL;
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL copyVerified:(BOOL)copyVerified;
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors;
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors copyVerified:(BOOL)copyVerified;
 
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel;
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel accurateRipAlternatePressingChecksum:(NSUInteger)accurateRipAlternatePressingChecksum accurateRipAlternatePressingOffset:(NSNumber *)accurateRipAlternatePressingOffset;
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipChecksumV2:(NSUInteger)accurateRipChecksumV2 accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel;
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipChecksumV2:(NSUInteger)accurateRipChecksumV2 accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel accurateRipAlternatePressingChecksum:(NSUInteger)accurateRipAlternatePressingChecksum accurateRipAlternatePressingOffset:(NSNumber *)accurateRipAlternatePressingOffset;
 @end
 
 @implementation ExtractionViewController
@@ -158,6 +192,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 @synthesize requiredSectorMatches = _requiredSectorMatches;
 @synthesize requiredTrackMatches = _requiredTrackMatches;
 @synthesize allowExtractionFailure = _allowExtractionFailure;
+@synthesize useTestAndCopy = _useTestAndCopy;
 @synthesize extractionMode = _extractionMode;
 
 @synthesize imageExtractionRecord = _imageExtractionRecord;
@@ -210,52 +245,16 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 
 - (void) observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context
 {
-	if(kMCNDetectionKVOContext == context) {
-		MCNDetectionOperation *operation = (MCNDetectionOperation *)object;
+	if(kSubchannelSurveyKVOContext == context) {
+		SubchannelSurveyOperation *operation = (SubchannelSurveyOperation *)object;
 		
 		if([keyPath isEqualToString:@"isExecuting"]) {			
 			if([operation isExecuting]) {
 				// KVO is thread-safe, but doesn't guarantee observeValueForKeyPath: will be called from the main thread
 				if([NSThread isMainThread])
-					[self detectMCNOperationDidExecute:operation];
-				else
-					[self performSelectorOnMainThread:@selector(detectMCNOperationDidExecute:) withObject:operation waitUntilDone:NO];
-			}
-		}
-		else if([keyPath isEqualToString:@"isCancelled"] || [keyPath isEqualToString:@"isFinished"]) {
-			[operation removeObserver:self forKeyPath:@"isExecuting"];
-			[operation removeObserver:self forKeyPath:@"isCancelled"];
-			[operation removeObserver:self forKeyPath:@"isFinished"];
-		}
-	}
-	else if(kISRCDetectionKVOContext == context) {
-		ISRCDetectionOperation *operation = (ISRCDetectionOperation *)object;
-		
-		if([keyPath isEqualToString:@"isExecuting"]) {
-			if([operation isExecuting]) {
-				// KVO is thread-safe, but doesn't guarantee observeValueForKeyPath: will be called from the main thread
-				if([NSThread isMainThread])
-					[self detectISRCOperationDidExecute:operation];
-				else
-					[self performSelectorOnMainThread:@selector(detectISRCOperationDidExecute:) withObject:operation waitUntilDone:NO];
-			}
-		}
-		else if([keyPath isEqualToString:@"isCancelled"] || [keyPath isEqualToString:@"isFinished"]) {
-			[operation removeObserver:self forKeyPath:@"isExecuting"];
-			[operation removeObserver:self forKeyPath:@"isCancelled"];
-			[operation removeObserver:self forKeyPath:@"isFinished"];
-		}
-	}
-	else if(kPregapDetectionKVOContext == context) {
-		PregapDetectionOperation *operation = (PregapDetectionOperation *)object;
-		
-		if([keyPath isEqualToString:@"isExecuting"]) {
-			if([operation isExecuting]) {
-				// KVO is thread-safe, but doesn't guarantee observeValueForKeyPath: will be called from the main thread
-				if([NSThread isMainThread])
-					[self detectPregapOperationDidExecute:operation];
+					[self subchannelSurveyOperationDidExecute:operation];
 				else
-					[self performSelectorOnMainThread:@selector(detectPregapOperationDidExecute:) withObject:operation waitUntilDone:NO];
+					[self performSelectorOnMainThread:@selector(subchannelSurveyOperationDidExecute:) withObject:operation waitUntilDone:NO];
 			}
 		}
 		else if([keyPath isEqualToString:@"isCancelled"] || [keyPath isEqualToString:@"isFinished"]) {
@@ -293,7 +292,22 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 			else
 				[self performSelectorOnMainThread:@selector(processExtractionOperation:) withObject:operation waitUntilDone:NO];
 		}
-	}	
+	}
+	else if(kParityRecordKVOContext == context) {
+		ParityRecordOperation *operation = (ParityRecordOperation *)object;
+		
+		if([keyPath isEqualToString:@"isCancelled"] || [keyPath isEqualToString:@"isFinished"]) {
+			[operation removeObserver:self forKeyPath:@"isExecuting"];
+			[operation removeObserver:self forKeyPath:@"isCancelled"];
+			[operation removeObserver:self forKeyPath:@"isFinished"];
+			
+			// KVO is thread-safe, but doesn't guarantee observeValueForKeyPath: will be called from the main thread
+			if([NSThread isMainThread])
+				[self processParityRecordOperation:operation];
+			else
+				[self performSelectorOnMainThread:@selector(processParityRecordOperation:) withObject:operation waitUntilDone:NO];
+		}
+	}
 	else
 		[super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
 }
@@ -316,6 +330,18 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		if(_disk)
 			CFRelease(_disk), _disk = NULL;
 		
+		// The drive session belongs to the previous disk
+		if(_driveSession) {
+			NSError *error = nil;
+			if(![_driveSession close:&error])
+				[[Logger sharedLogger] logMessage:@"Error closing the drive session: %@", error];
+			_driveSession = nil;
+		}
+		
+		// Keep what was learned about the drive's speeds
+		[_speedController saveErrorCurve];
+		_speedController = nil;
+		
 		self.compactDisc = nil;
 		self.driveInformation = nil;
 		
@@ -344,20 +370,66 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	_tracks = [NSSet setWithArray:self.orderedTracks];
 	[self didChangeValueForKey:@"tracks"];
 	
+	// Index the AccurateRip checksums for all pressings of the disc once, rather than walking them for every offset
+	_accurateRipChecksumIndex = [AccurateRipChecksumIndex checksumIndexWithAccurateRipDiscs:self.compactDisc.accurateRipDiscs];
+	_accurateRipOffsetChecksumIndex = [AccurateRipChecksumIndex offsetChecksumIndexWithAccurateRipDiscs:self.compactDisc.accurateRipDiscs];
+	
+	// A parity record for the disc allows damage to be repaired once the image is complete, instead of by re-reading
+	_parityRecord = nil;
+	_trackIDsAwaitingParityRepair = [NSMutableSet set];
+	if(eExtractionModeImage == self.extractionMode) {
+		NSError *error = nil;
+		_parityRecord = [[ParityRecordDatabase sharedDatabase] parityRecordForCompactDisc:self.compactDisc error:&error];
+		if(_parityRecord)
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Found parity record (%lu parity rows, CRC32 %.8x)", (unsigned long)_parityRecord.parityCount, _parityRecord.CRC32];
+		else if(error)
+			[[Logger sharedLogger] logMessage:@"Unable to retrieve parity record: %@", error];
+	}
+	
+	// Keep the drive open for the duration of the extraction, so the many small re-reads don't each open it
+	// If the session can't be opened each operation falls back to opening the drive itself
+	// The session belongs to the disc (setDisk: closes it), so one left open by an earlier extraction is reused
+	if(!_driveSession.isOpen) {
+		NSError *sessionError = nil;
+		_driveSession = [[DriveSession alloc] initWithDADiskRef:self.disk];
+		if(![_driveSession open:&sessionError]) {
+			[[Logger sharedLogger] logMessage:@"Unable to open a drive session: %@", sessionError];
+			_driveSession = nil;
+		}
+	}
+	
+	// The drive's speed follows the errors it returns, if requested
+	_speedController = nil;
+	if([[NSUserDefaults standardUserDefaults] boolForKey:@"adaptiveDriveSpeed"] && self.driveInformation.deviceIdentifier)
+		_speedController = [DriveSpeedController speedControllerForDeviceIdentifier:self.driveInformation.deviceIdentifier];
+	
 	// Init replay gain
 	int result = replaygain_analysis_init(&_rg, CDDA_SAMPLE_RATE);
 	if(INIT_GAIN_ANALYSIS_OK != result)
 		[[Logger sharedLogger] logMessage:NSLocalizedString(@"Unable to initialize replay gain", @"")];
 	
-	// Before starting extraction, ensure the disc's MCN has been read
-	if(!self.compactDisc.metadata.MCN) {
-		MCNDetectionOperation *operation = [[MCNDetectionOperation alloc] init];
+	// Before starting extraction, ensure the disc's MCN and the tracks' ISRCs and pregaps have been read
+	// The whole disc is surveyed in one pass, ahead of the first extraction on the (serial) queue
+	// Discs without an MCN or ISRCs are only surveyed once, since the results are kept with the disc's identity
+	BOOL surveyRequired = (nil == self.compactDisc.metadata.MCN);
+	for(TrackDescriptor *track in self.tracks) {
+		if(!track.metadata.ISRC || !track.pregap)
+			surveyRequired = YES;
+	}
+
+	NSDictionary *identity = [[DiscIdentityCache sharedCache] identityForDiscTOC:self.compactDisc.discTOC];
+	if([[identity objectForKey:kDiscIdentitySubchannelSurveyedKey] boolValue])
+		surveyRequired = NO;
+	
+	if(surveyRequired) {
+		SubchannelSurveyOperation *operation = [[SubchannelSurveyOperation alloc] init];
 		
 		operation.disk = self.disk;
+		operation.session = _driveSession;
 		
-		[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kMCNDetectionKVOContext];
-		[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kMCNDetectionKVOContext];
-		[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kMCNDetectionKVOContext];
+		[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kSubchannelSurveyKVOContext];
+		[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kSubchannelSurveyKVOContext];
+		[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kSubchannelSurveyKVOContext];
 		
 		[self.operationQueue addOperation:operation];
 	}
@@ -382,8 +454,8 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	[_activeTimers makeObjectsPerformSelector:@selector(invalidate)];
 	[_activeTimers removeAllObjects];
 	
-	// Remove temporary files
-	[self removeTemporaryFiles];	
+	// Release the sector stores and their temporary files
+	[self closeSectorStores];
 	
 	self.disk = NULL;
 
@@ -507,7 +579,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	
 #pragma unused(contextInfo)
 	
-	[self removeTemporaryFiles];
+	[self closeSectorStores];
 	
 	// Remove any active timers
 	[_activeTimers makeObjectsPerformSelector:@selector(invalidate)];
@@ -537,7 +609,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	self.c2ErrorCount = [operation.errorFlags count];
 }
 
-- (void) detectMCNOperationDidExecute:(MCNDetectionOperation *)operation
+- (void) subchannelSurveyOperationDidExecute:(SubchannelSurveyOperation *)operation
 {
 	
 #pragma unused(operation)
@@ -552,51 +624,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		discDescription = self.compactDisc.musicBrainzDiscID;
 	
 	[_statusTextField setStringValue:discDescription];
-	[_detailedStatusTextField setStringValue:NSLocalizedString(@"Reading the disc's Media Catalog Number", @"")];
-}
-
-- (void) detectISRCOperationDidExecute:(ISRCDetectionOperation *)operation
-{
-	[_progressIndicator setIndeterminate:YES];
-	[_progressIndicator startAnimation:self];
-	
-	// Fetch the TrackDescriptor object from the context and ensure it is the correct class
-	NSManagedObject *managedObject = [self.managedObjectContext objectWithID:operation.trackID];
-	if(![managedObject isKindOfClass:[TrackDescriptor class]])
-		return;
-	
-	TrackDescriptor *track = (TrackDescriptor *)managedObject;
-	
-	NSString *trackDescription = nil;
-	if(track.metadata.title)
-		trackDescription = track.metadata.title;
-	else
-		trackDescription = [track.number stringValue];
-	
-	[_detailedStatusTextField setStringValue:NSLocalizedString(@"Reading the International Standard Recording Code", @"")];
-	[_statusTextField setStringValue:trackDescription];
-}
-
-- (void) detectPregapOperationDidExecute:(PregapDetectionOperation *)operation
-{
-	[_progressIndicator setIndeterminate:YES];
-	[_progressIndicator startAnimation:self];
-	
-	// Fetch the TrackDescriptor object from the context and ensure it is the correct class
-	NSManagedObject *managedObject = [self.managedObjectContext objectWithID:operation.trackID];
-	if(![managedObject isKindOfClass:[TrackDescriptor class]])
-		return;
-	
-	TrackDescriptor *track = (TrackDescriptor *)managedObject;
-	
-	NSString *trackDescription = nil;
-	if(track.metadata.title)
-		trackDescription = track.metadata.title;
-	else
-		trackDescription = [track.number stringValue];
-	
-	[_detailedStatusTextField setStringValue:NSLocalizedString(@"Detecting the pregap", @"")];
-	[_statusTextField setStringValue:trackDescription];
+	[_detailedStatusTextField setStringValue:NSLocalizedString(@"Reading the disc's sub-channel", @"")];
 }
 
 - (void) extractionOperationDidExecute:(ExtractionOperation *)operation
@@ -615,7 +643,7 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		[_statusTextField setStringValue:[_currentTrack.number stringValue]];
 	
 	// Determine if this operation represents a whole track extraction or a partial track extraction
-	BOOL isWholeTrack = [operation.sectors isEqualToSectorRange:_sectorsToExtract];
+	BOOL isWholeTrack = (!operation.sectorIndexes && [operation.sectors isEqualToSectorRange:_sectorsToExtract]);
 	
 	// Check to see if this track has been extracted before
 	if(!isWholeTrack)
@@ -640,39 +668,37 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		[self.managedObjectContext mergeChangesFromContextDidSaveNotification:notification];
 }
 
-- (void) removeTemporaryFiles
+- (void) closeSectorStores
 {
-	NSError *error = nil;
-	
-	// Remove temporary files
-	NSArray *temporaryURLS = [_partialExtractions valueForKey:@"URL"];
-	for(NSURL *URL in temporaryURLS) {
-		if(![[NSFileManager defaultManager] removeItemAtPath:[URL path] error:&error])
-			[[Logger sharedLogger] logMessage:@"Error removing temporary file: %@", [error localizedDescription]];
-	}
-
-	temporaryURLS = [_wholeExtractions valueForKey:@"URL"];
-	for(NSURL *URL in temporaryURLS) {
-		if(![[NSFileManager defaultManager] removeItemAtPath:[URL path] error:&error])
-			[[Logger sharedLogger] logMessage:@"Error removing temporary file: %@", [error localizedDescription]];
+	// Release the memory and temporary files held by the stores
+	NSMutableArray *sectorStores = [NSMutableArray array];
+	
+	[sectorStores addObjectsFromArray:[_partialExtractions valueForKey:@"sectorStore"]];
+	[sectorStores addObjectsFromArray:[_wholeExtractions valueForKey:@"sectorStore"]];
+	[sectorStores addObjectsFromArray:_synthesizedTracks];
+	[sectorStores addObjectsFromArray:_bestGuessTracks];
+	if(_synthesizedTrack)
+		[sectorStores addObject:_synthesizedTrack];
+	
+	for(SectorStore *sectorStore in sectorStores) {
+		if(![sectorStore close])
+			[[Logger sharedLogger] logMessage:@"Error closing temporary sector store"];
 	}
-
-	for(NSURL *URL in _synthesizedTrackURLs) {
-		if(![[NSFileManager defaultManager] removeItemAtPath:[URL path] error:&error])
-			[[Logger sharedLogger] logMessage:@"Error removing temporary file: %@", [error localizedDescription]];
-	}	
 }
 
 - (void) resetExtractionState
 {
 	_retryCount = 0;
-	_synthesizedTrackURL = nil;
+	_synthesizedTrack = nil;
 	_sectorsToExtract = nil;
 	_wholeExtractions = [NSMutableArray array];
 	_partialExtractions = [NSMutableArray array];
 	_sectorsNeedingVerification = [NSMutableIndexSet indexSet];
-	_synthesizedTrackURLs = [NSMutableArray array];
-	_synthesizedTrackSHAs = [NSMutableDictionary dictionary];
+	_synthesizedTracks = [NSMutableArray array];
+	_bestGuessTracks = [NSMutableArray array];
+	
+	// Each track's first pass starts at full speed
+	[_speedController reset];
 }
 
 - (void) startExtractingNextTrack
@@ -680,14 +706,16 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	// Clean up and reset in preparation for extraction
 	_currentTrack = nil;
 
-	[self removeTemporaryFiles];
+	[self closeSectorStores];
 	[self resetExtractionState];
 
 	// Get the next track to be extracted, if any remain
 	NSArray *tracks = self.orderedTracksRemaining;
 	
-	if(![tracks count])
+	if(![tracks count]) {
+		[_speedController saveErrorCurve];
 		return;
+	}
 	
 	TrackDescriptor *track = [tracks objectAtIndex:0];
 	[_trackIDsRemaining removeObject:[track objectID]];
@@ -722,33 +750,6 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	
 	[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Beginning extraction for track %@", track.number];
 	
-	// Ensure the track's ISRC and pregap have been read
-	if(!track.metadata.ISRC) {
-		ISRCDetectionOperation *operation = [[ISRCDetectionOperation alloc] init];
-		
-		operation.disk = self.disk;
-		operation.trackID = track.objectID;
-		
-		[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kISRCDetectionKVOContext];
-		[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kISRCDetectionKVOContext];
-		[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kISRCDetectionKVOContext];
-		
-		[self.operationQueue addOperation:operation];
-	}	
-	
-	if(!track.pregap) {
-		PregapDetectionOperation *operation = [[PregapDetectionOperation alloc] init];
-		
-		operation.disk = self.disk;
-		operation.trackID = track.objectID;
-		
-		[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kPregapDetectionKVOContext];
-		[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kPregapDetectionKVOContext];
-		[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kPregapDetectionKVOContext];
-		
-		[self.operationQueue addOperation:operation];
-	}	
-	
 	// Get going on the extraction
 	[self extractSectorRange:_sectorsToExtract];
 }
@@ -762,31 +763,37 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 
 	[_detailedStatusTextField setStringValue:NSLocalizedString(@"Analyzing audio", @"")];
 	
-	// Delete the output file if the operation was cancelled or did not succeed
+	// Discard the extracted audio if the operation was cancelled or did not succeed
 	if(operation.error || operation.isCancelled) {
 		if(operation.error)
 			[self presentError:operation.error modalForWindow:[[self view] window] delegate:self didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) contextInfo:NULL];
 		
-		NSError *error = nil;
-		NSFileManager *fileManager = [NSFileManager defaultManager];
-		if([fileManager fileExistsAtPath:operation.URL.path] && ![fileManager removeItemAtPath:operation.URL.path error:&error])
-			[self presentError:error modalForWindow:[[self view] window] delegate:self didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) contextInfo:NULL];
+		[operation.sectorStore close];
 		
 		return;
 	}
 	
 	// Log some information about the operation that just completed
 	if(operation.useC2) {
-		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Extracted sectors %u - %u to %@, %u C2 block errors.  MD5 = %@", operation.sectorsRead.firstSector, operation.sectorsRead.lastSector, [operation.URL.path lastPathComponent], operation.blockErrorFlags.count, operation.MD5];
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Extracted sectors %u - %u (%@), %u C2 block errors.  MD5 = %@", operation.sectorsRead.firstSector, operation.sectorsRead.lastSector, (operation.sectorStore.isMemoryBacked ? @"memory" : [operation.sectorStore.URL.path lastPathComponent]), operation.blockErrorFlags.count, operation.MD5];
 		if([operation.blockErrorFlags count])
 			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"C2 block errors for sectors %@", operation.blockErrorFlags];
 	}
 	else
-		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Extracted sectors %u - %u to %@.  MD5 = %@", operation.sectorsRead.firstSector, operation.sectorsRead.lastSector, [operation.URL.path lastPathComponent], operation.MD5];
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Extracted sectors %u - %u (%@).  MD5 = %@", operation.sectorsRead.firstSector, operation.sectorsRead.lastSector, (operation.sectorStore.isMemoryBacked ? @"memory" : [operation.sectorStore.URL.path lastPathComponent]), operation.MD5];
+	
+	if(operation.positionRetryCount)
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"%u blocks re-read because of positioning errors", operation.positionRetryCount];
+	if(operation.sampleSlips.count)
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Corrected %u sample slips: %@", operation.sampleSlips.count, operation.sampleSlips];
+	if(operation.misplacedSectors.count)
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"The positions of %u sectors could not be confirmed", operation.misplacedSectors.count];
+	if(operation.unreadableSectors.count)
+		[[Logger sharedLogger] logMessage:@"%u sectors could not be read: %@", operation.unreadableSectors.count, operation.unreadableSectors];
 	
 	// Determine if this operation represents a whole track extraction or a partial track extraction
 	// and process it accordingly
-	if([operation.sectors isEqualToSectorRange:_sectorsToExtract])
+	if(!operation.sectorIndexes && [operation.sectors isEqualToSectorRange:_sectorsToExtract])
 		[self processWholeTrackExtractionOperation:operation];
 	else
 		[self processPartialTrackExtractionOperation:operation];
@@ -832,17 +839,22 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 				[_trackExtractionRecords removeAllObjects];
 			}
 			else {
-				ImageExtractionRecord *imageExtractionRecord = [self createImageExtractionRecord];
-				if(!imageExtractionRecord)
+				_imageExtractionRecord = [self createImageExtractionRecord];
+				if(!_imageExtractionRecord)
 					[self presentError:error
 						modalForWindow:[[self view] window]
 							  delegate:self
 					didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:)
 						   contextInfo:NULL];
+				// Verify (and if necessary repair) the image with the parity record, or generate a record
+				// for an image whose tracks were all verified; either reads the whole image so it is
+				// done in the background and the extraction finishes when it completes
+				else if(_parityRecord || [self allTracksVerifiedWithAccurateRip]) {
+					[self startParityRecordOperation];
+					return;
+				}
 				
-				_imageExtractionRecord = imageExtractionRecord;
-				
-				if(![[EncoderManager sharedEncoderManager] encodeImageExtractionRecord:self.imageExtractionRecord error:&error])
+				if(_imageExtractionRecord && ![[EncoderManager sharedEncoderManager] encodeImageExtractionRecord:self.imageExtractionRecord error:&error])
 					[self presentError:error 
 						modalForWindow:[[self view] window]
 							  delegate:self
@@ -853,19 +865,24 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		else
 			[[Logger sharedLogger] logMessage:@"Unknown extraction mode"];
 		
-		[self.operationQueue cancelAllOperations];
-		[self removeTemporaryFiles];
-		
-		// Remove any active timers
-		[_activeTimers makeObjectsPerformSelector:@selector(invalidate)];
-		[_activeTimers removeAllObjects];
-		
-		self.disk = NULL;
-		
-		[[[[self view] window] windowController] extractionFinishedWithReturnCode:NSOKButton];
+		[self finishExtraction];
 	}
 }
 
+- (void) finishExtraction
+{
+	[self.operationQueue cancelAllOperations];
+	[self closeSectorStores];
+	
+	// Remove any active timers
+	[_activeTimers makeObjectsPerformSelector:@selector(invalidate)];
+	[_activeTimers removeAllObjects];
+	
+	self.disk = NULL;
+	
+	[[[[self view] window] windowController] extractionFinishedWithReturnCode:NSOKButton];
+}
+
 - (void) processWholeTrackExtractionOperation:(ExtractionOperation *)operation
 {
 	NSParameterAssert(nil != operation);
@@ -873,11 +890,25 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	// Save this extraction operation
 	[_wholeExtractions addObject:operation];
 		
-	if(ENABLE_ACCURATERIP && [self verifyTrackWithAccurateRip:operation.URL])
+	if(ENABLE_ACCURATERIP && [self verifyTrackWithAccurateRip:operation.sectorStore])
 		[self startExtractingNextTrack];
-	// Re-rip only portions of the track if any C2 block error flags were returned
-	else if(operation.useC2 && operation.blockErrorFlags.count) {
-		NSIndexSet *positionOfErrors = operation.blockErrorFlags;
+	// With a parity record the track is repaired after the image is assembled, so it isn't read again
+	else if(_parityRecord && eExtractionModeImage == self.extractionMode) {
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Deferring verification of track %@ to the parity record", _currentTrack.number];
+		
+		if([self saveTrackFromSectorStore:operation.sectorStore copyVerified:NO]) {
+			[_trackIDsAwaitingParityRepair addObject:_currentTrack.objectID];
+			[self startExtractingNextTrack];
+		}
+	}
+	// Re-rip only portions of the track if any C2 block error flags were returned, or if any sectors
+	// couldn't be read in place
+	else if((operation.useC2 && operation.blockErrorFlags.count) || operationHasUnreliableSectors(operation)) {
+		NSMutableIndexSet *positionOfErrors = [NSMutableIndexSet indexSet];
+		if(operation.useC2)
+			[positionOfErrors addIndexes:operation.blockErrorFlags];
+		[positionOfErrors addIndexes:operation.unreadableSectors];
+		[positionOfErrors addIndexes:operation.misplacedSectors];
 		
 		// Determine which sectors have no C2 errors
 		NSMutableIndexSet *sectorsWithNoErrors = [NSMutableIndexSet indexSetWithIndexesInRange:[_sectorsToExtract rangeValue]];
@@ -892,18 +923,33 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		// And re-extract them
 		[self extractSectors:positionOfErrors coalesceRanges:YES];
 	}
+	// In test and copy mode, two passes with matching CRCs are sufficient for a clean track
+	else if(self.useTestAndCopy && operation.CRC32 && (1 == _wholeExtractions.count || [self testAndCopyCRCsMatchForOperation:operation])) {
+		// The first pass was the copy, so extract the track again as the test
+		if(1 == _wholeExtractions.count) {
+			[_detailedStatusTextField setStringValue:NSLocalizedString(@"Testing copy", @"")];
+			[self extractSectorRange:_sectorsToExtract];
+		}
+		else {
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Test and copy CRCs match (%08x)", [operation.CRC32 unsignedIntValue]];
+
+			BOOL trackSaved = [self saveTrackFromSectorStore:operation.sectorStore];
+			if(trackSaved)
+				[self startExtractingNextTrack];
+		}
+	}
 	// No C2 errors were encountered or C2 is disabled, so use brute-force comparison
 	else {
 		[_detailedStatusTextField setStringValue:NSLocalizedString(@"Verifying copy integrity", @"")];
 
 		// Check to see if enough matching extractions exist for this track to be encoded
-		NSURL *trackURL = [self outputURL];
+		SectorStore *track = [self outputSectorStore];
 		
 		// If so, prepare the track for encoding
-		if(trackURL) {
+		if(track) {
 			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Number of required track matches reached"];
 
-			BOOL trackSaved = [self saveTrackFromURL:trackURL];
+			BOOL trackSaved = [self saveTrackFromSectorStore:track];
 			if(trackSaved)
 				[self startExtractingNextTrack];
 		}
@@ -944,6 +990,18 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	}
 }
 
+- (BOOL) testAndCopyCRCsMatchForOperation:(ExtractionOperation *)operation
+{
+	NSParameterAssert(nil != operation);
+
+	for(ExtractionOperation *wholeExtraction in _wholeExtractions) {
+		if(wholeExtraction != operation && [wholeExtraction.CRC32 isEqualToNumber:operation.CRC32])
+			return YES;
+	}
+
+	return NO;
+}
+
 - (void) processPartialTrackExtractionOperation:(ExtractionOperation *)operation
 {
 	NSParameterAssert(nil != operation);
@@ -958,7 +1016,9 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	[_partialExtractions addObject:operation];
 		
 	// Only check sectors that are contained in this extraction operation
-	NSIndexSet *operationSectors = [NSIndexSet indexSetWithIndexesInRange:[operation.sectors rangeValue]];
+	NSIndexSet *operationSectors = operation.sectorIndexes;
+	if(!operationSectors)
+		operationSectors = [NSIndexSet indexSetWithIndexesInRange:[operation.sectors rangeValue]];
 	NSIndexSet *sectorsToCheck = [_sectorsNeedingVerification intersectedIndexSet:operationSectors];
 	
 	// Check for sectors with existing errors that were resolved by this operation
@@ -998,28 +1058,24 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		
 		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"All sector errors resolved"];
 		
-		// Calculate the SHA1 for the audio
-		NSString *SHA1 = calculateSHA1DigestForURL(_synthesizedTrackURL);
-		
-		// Cache the results in case the track isn't verified
-		[_synthesizedTrackURLs addObject:_synthesizedTrackURL];		
-		[_synthesizedTrackSHAs setObject:SHA1 forKey:_synthesizedTrackURL];
+		// Cache the results in case the track isn't verified (the store caches its SHA1)
+		[_synthesizedTracks addObject:_synthesizedTrack];
 		
 		// Any operations in progress are partial extractions and are no longer needed
 		[self.operationQueue cancelAllOperations];
 				
-		if(ENABLE_ACCURATERIP && [self verifyTrackWithAccurateRip:_synthesizedTrackURL]) {
+		if(ENABLE_ACCURATERIP && [self verifyTrackWithAccurateRip:_synthesizedTrack]) {
 			[self startExtractingNextTrack];
 			return;
 		}
 		
-		NSURL *trackURL = [self outputURL];
+		SectorStore *track = [self outputSectorStore];
 
 		// Check to see if enough matching extractions exist for this track for it to be encoded
-		if(trackURL) {
+		if(track) {
 			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Number of required track matches reached"];
 
-			BOOL trackSaved = [self saveTrackFromURL:trackURL];			
+			BOOL trackSaved = [self saveTrackFromSectorStore:track];			
 			if(trackSaved)
 				[self startExtractingNextTrack];
 		}
@@ -1029,14 +1085,13 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 			// Retry the track if the maximum retry count hasn't been exceeded
 			if(self.retryCount <= self.maxRetries) {
 				
-				if((_synthesizedTrackURLs.count + _wholeExtractions.count) > self.requiredTrackMatches)
+				if((_synthesizedTracks.count + _wholeExtractions.count) > self.requiredTrackMatches)
 					++_retryCount;
 				
-				// Remove temporary files for the partial extractions only
-				NSError *error = nil;
-				for(NSURL *URL in [_partialExtractions valueForKey:@"URL"]) {
-					if(![[NSFileManager defaultManager] removeItemAtPath:[URL path] error:&error])
-						[[Logger sharedLogger] logMessage:@"Error removing temporary file: %@", [error localizedDescription]];
+				// Release the stores for the partial extractions only
+				for(SectorStore *sectorStore in [_partialExtractions valueForKey:@"sectorStore"]) {
+					if(![sectorStore close])
+						[[Logger sharedLogger] logMessage:@"Error closing temporary sector store"];
 				}
 				
 				_partialExtractions = [NSMutableArray array];
@@ -1045,39 +1100,52 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 				// Get (re)started on the track
 				[self extractSectorRange:_sectorsToExtract];
 			}
-			else if(!self.allowExtractionFailure) {
-				[[Logger sharedLogger] logMessage:@"Maximum retry count exceeded for track %@, using best guess", _currentTrack.number];
-			
-				// Since the user doesn't want tracks to fail, just throw the best together we can
-				NSURL *bestGuessURL = [self bestGuessURL];
-				
-				BOOL trackSaved = [self saveTrackFromURL:bestGuessURL copyVerified:NO];
-				if(trackSaved)
-					[self startExtractingNextTrack];				
-			}
-			// Failure
-			else {
-				[[Logger sharedLogger] logMessage:@"Extraction failed for track %@: maximum retry count exceeded", _currentTrack.number];
-				
-				[_failedTrackIDs addObject:[_currentTrack objectID]];
-				[_tracksTable reloadData];
-				
-				// A failure for a single track still allows individual tracks to be extracted
-				if(eExtractionModeIndividualTracks == self.extractionMode)
-					[self startExtractingNextTrack];
-				// If a single tracks fails to extract an image cannot be generated
-				else if(eExtractionModeImage == self.extractionMode) {
-					// Set the conditions for termination
-					_currentTrack = nil;
-					[_trackIDsRemaining removeAllObjects];
-				}
-			}
+			else
+				[self giveUpOnCurrentTrack];
 		}
 	}
+	// Sectors that still can't be read in place after maxRetries passes would otherwise be re-read forever
+	else if(_partialExtractions.count > self.maxRetries && operationHasUnreliableSectors(operation)) {
+		[[Logger sharedLogger] logMessage:@"Sectors %@ of track %@ could not be verified", _sectorsNeedingVerification, _currentTrack.number];
+		
+		[self.operationQueue cancelAllOperations];
+		[self giveUpOnCurrentTrack];
+	}
 	else
 		[self extractSectors:_sectorsNeedingVerification coalesceRanges:YES];
 }
 
+- (void) giveUpOnCurrentTrack
+{
+	if(!self.allowExtractionFailure) {
+		[[Logger sharedLogger] logMessage:@"Maximum retry count exceeded for track %@, using best guess", _currentTrack.number];
+	
+		// Since the user doesn't want tracks to fail, just throw the best together we can
+		SectorStore *bestGuess = [self bestGuessSectorStore];
+		
+		BOOL trackSaved = (bestGuess && [self saveTrackFromSectorStore:bestGuess copyVerified:NO]);
+		if(trackSaved)
+			[self startExtractingNextTrack];				
+	}
+	// Failure
+	else {
+		[[Logger sharedLogger] logMessage:@"Extraction failed for track %@: maximum retry count exceeded", _currentTrack.number];
+		
+		[_failedTrackIDs addObject:[_currentTrack objectID]];
+		[_tracksTable reloadData];
+		
+		// A failure for a single track still allows individual tracks to be extracted
+		if(eExtractionModeIndividualTracks == self.extractionMode)
+			[self startExtractingNextTrack];
+		// If a single tracks fails to extract an image cannot be generated
+		else if(eExtractionModeImage == self.extractionMode) {
+			// Set the conditions for termination
+			_currentTrack = nil;
+			[_trackIDsRemaining removeAllObjects];
+		}
+	}
+}
+
 - (NSData *) dataForSector:(NSUInteger)sector interpolate:(BOOL)interpolate
 {
 	return [self dataForSector:sector interpolate:interpolate useC2:[self.driveInformation.useC2 boolValue]];
@@ -1120,24 +1188,22 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		ExtractionOperation *operation = [allOperations objectAtIndex:operationIndex];
 		
 		// If the operation doesn't contain the sector in question, there is nothing to do
-		if(![operation.sectors containsSector:sector])
+		if(![operation containsSector:sector])
 			continue;
 		
 		// Use C2 if specified
 		if(useC2 && ((operation.useC2 != useC2) || [operation.blockErrorFlags containsIndex:sector]))
 			continue;
 
-		// Open the file for reading
-		NSError *error = nil;
-		ExtractedAudioFile *operationFile = [ExtractedAudioFile openFileForReadingAtURL:operation.URL error:&error];
-		if(!operationFile)
+		if(operationReadSectorUnreliably(operation, sector))
 			continue;
 
 		// Extract the sector's data
-		NSUInteger sectorIndex = [operation.sectors indexForSector:sector];
-		NSData *sectorData = [operationFile audioDataForSector:sectorIndex error:&error];
-		
-		[operationFile closeFile], operationFile = nil;
+		NSError *error = nil;
+		NSUInteger sectorIndex = [operation indexForSector:sector];
+		NSData *sectorData = [operation.sectorStore audioDataForSector:sectorIndex error:&error];
+		if(!sectorData)
+			continue;
 				
 		// Set up match tracking
 		NSUInteger matchCount = 0;		
@@ -1150,23 +1216,19 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 				continue;
 			
 			// Skip this operation if it doesn't contain the sector
-			if(![otherOperation.sectors containsSector:sector])
+			if(![otherOperation containsSector:sector])
 				continue;
 			
 			// Use C2 if specified
 			if(useC2 && ((otherOperation.useC2 != useC2) || [otherOperation.blockErrorFlags containsIndex:sector]))
 				continue;
 			
-			// Open the file for reading
-			ExtractedAudioFile *otherOperationFile = [ExtractedAudioFile openFileForReadingAtURL:otherOperation.URL error:&error];
-			if(!otherOperationFile)
+			if(operationReadSectorUnreliably(otherOperation, sector))
 				continue;
 			
 			// Extract the sector's data
-			NSUInteger otherSectorIndex = [otherOperation.sectors indexForSector:sector];
-			NSData *otherSectorData = [otherOperationFile audioDataForSector:otherSectorIndex error:&error];
-			
-			[otherOperationFile closeFile], otherOperationFile = nil;
+			NSUInteger otherSectorIndex = [otherOperation indexForSector:sector];
+			NSData *otherSectorData = [otherOperation.sectorStore audioDataForSector:otherSectorIndex error:&error];
 
 			// Compare the sectors
 			if([sectorData isEqualToData:otherSectorData])
@@ -1212,25 +1274,24 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		ExtractionOperation *operation = [allOperations objectAtIndex:operationIndex];
 		
 		// If the operation doesn't contain the sector in question, there is nothing to do
-		if(![operation.sectors containsSector:sector])
+		if(![operation containsSector:sector])
 			continue;
 
 		// Use C2 if specified
 		if(useC2 && (operation.useC2 != useC2))
 			continue;
 		
-		// Open the file for reading
-		NSError *error = nil;
-		ExtractedAudioFile *operationFile = [ExtractedAudioFile openFileForReadingAtURL:operation.URL error:&error];
-		if(!operationFile)
+		if(operationReadSectorUnreliably(operation, sector))
 			continue;
 		
 		// Extract the sector's data
-		NSUInteger sectorIndex = [operation.sectors indexForSector:sector];
-		NSData *sectorData = [operationFile audioDataForSector:sectorIndex error:&error];
-		const int8_t *rawSectorBytes = [sectorData bytes];
+		NSError *error = nil;
+		NSUInteger sectorIndex = [operation indexForSector:sector];
+		NSData *sectorData = [operation.sectorStore audioDataForSector:sectorIndex error:&error];
+		if(kCDSectorSizeCDDA != [sectorData length])
+			continue;
 		
-		[operationFile closeFile], operationFile = nil;
+		const int8_t *rawSectorBytes = [sectorData bytes];
 
 		// Determine which bytes in the sector are valid (free of C2 errors)
 		NSData *sectorErrorData = [operation.errorFlags objectForKey:[NSNumber numberWithUnsignedInteger:sectorIndex]];
@@ -1255,24 +1316,23 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 				continue;
 			
 			// Skip this operation if it doesn't contain the sector
-			if(![otherOperation.sectors containsSector:sector])
+			if(![otherOperation containsSector:sector])
 				continue;
 
 			// Use C2 if specified
 			if(useC2 && (otherOperation.useC2 != useC2))
 				continue;
 			
-			// Open the file for reading
-			ExtractedAudioFile *otherOperationFile = [ExtractedAudioFile openFileForReadingAtURL:otherOperation.URL error:&error];
-			if(!otherOperationFile)
+			if(operationReadSectorUnreliably(otherOperation, sector))
 				continue;
-						
+			
 			// Extract the sector's data
-			NSUInteger otherSectorIndex = [otherOperation.sectors indexForSector:sector];
-			NSData *otherSectorData = [otherOperationFile audioDataForSector:otherSectorIndex error:&error];
-			const int8_t *otherRawSectorBytes = [otherSectorData bytes];
+			NSUInteger otherSectorIndex = [otherOperation indexForSector:sector];
+			NSData *otherSectorData = [otherOperation.sectorStore audioDataForSector:otherSectorIndex error:&error];
+			if(kCDSectorSizeCDDA != [otherSectorData length])
+				continue;
 			
-			[otherOperationFile closeFile], otherOperationFile = nil;
+			const int8_t *otherRawSectorBytes = [otherSectorData bytes];
 			
 			// Determine which bytes in the sector are valid (free of C2 errors)
 			NSData *otherSectorErrorData = [otherOperation.errorFlags objectForKey:[NSNumber numberWithUnsignedInteger:otherSectorIndex]];
@@ -1366,7 +1426,9 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 				continue;
 			
 			// Determine which sectors don't match
-			NSIndexSet *nonMatchingSectorIndexes = compareFilesForNonMatchingSectors(operation.URL, otherOperation.URL);
+			NSIndexSet *nonMatchingSectorIndexes = [operation.sectorStore nonMatchingSectorsInSectorStore:otherOperation.sectorStore];
+			if(!nonMatchingSectorIndexes)
+				continue;
 			
 			// Convert from sector indexes to sector numbers				
 			NSMutableIndexSet *nonMatchingSectors = [nonMatchingSectorIndexes mutableCopy];
@@ -1375,9 +1437,11 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		}
 		
 		// Compare to the synthesized tracks
-		for(NSURL *synthesizedTrackURL in _synthesizedTrackURLs) {
+		for(SectorStore *synthesizedTrack in _synthesizedTracks) {
 			
-			NSIndexSet *nonMatchingSectorIndexes = compareFilesForNonMatchingSectors(operation.URL, synthesizedTrackURL);
+			NSIndexSet *nonMatchingSectorIndexes = [operation.sectorStore nonMatchingSectorsInSectorStore:synthesizedTrack];
+			if(!nonMatchingSectorIndexes)
+				continue;
 			
 			// Convert from sector indexes to sector numbers				
 			NSMutableIndexSet *nonMatchingSectors = [nonMatchingSectorIndexes mutableCopy];
@@ -1387,9 +1451,9 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	}
 	
 	// Iterate through each synthesized track
-	for(NSUInteger trackIndex = 0; trackIndex < [_synthesizedTrackURLs count]; ++trackIndex) {
+	for(NSUInteger trackIndex = 0; trackIndex < [_synthesizedTracks count]; ++trackIndex) {
 		
-		NSURL *synthesizedTrackURL = [_synthesizedTrackURLs objectAtIndex:trackIndex];
+		SectorStore *synthesizedTrack = [_synthesizedTracks objectAtIndex:trackIndex];
 		
 		// Compare to the whole extraction operations
 		for(ExtractionOperation *operation in _wholeExtractions) {
@@ -1398,7 +1462,9 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 			if(useC2 && (operation.useC2 != useC2))
 				continue;
 			
-			NSIndexSet *nonMatchingSectorIndexes = compareFilesForNonMatchingSectors(synthesizedTrackURL, operation.URL);
+			NSIndexSet *nonMatchingSectorIndexes = [synthesizedTrack nonMatchingSectorsInSectorStore:operation.sectorStore];
+			if(!nonMatchingSectorIndexes)
+				continue;
 						
 			// Convert from sector indexes to sector numbers				
 			NSMutableIndexSet *nonMatchingSectors = [nonMatchingSectorIndexes mutableCopy];
@@ -1407,13 +1473,15 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		}
 		
 		// Compare to the synthesized tracks
-		for(NSURL *otherSynthesizedTrackURL in _synthesizedTrackURLs) {
+		for(SectorStore *otherSynthesizedTrack in _synthesizedTracks) {
 			
 			// Skip ourselves
-			if(synthesizedTrackURL == otherSynthesizedTrackURL)
+			if(synthesizedTrack == otherSynthesizedTrack)
 				continue;
 			
-			NSIndexSet *nonMatchingSectorIndexes = compareFilesForNonMatchingSectors(synthesizedTrackURL, otherSynthesizedTrackURL);
+			NSIndexSet *nonMatchingSectorIndexes = [synthesizedTrack nonMatchingSectorsInSectorStore:otherSynthesizedTrack];
+			if(!nonMatchingSectorIndexes)
+				continue;
 			
 			// Convert from sector indexes to sector numbers				
 			NSMutableIndexSet *nonMatchingSectors = [nonMatchingSectorIndexes mutableCopy];
@@ -1430,12 +1498,12 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	return [nonMatchingSectors copy];
 }
 
-- (NSURL *) outputURL
+- (SectorStore *) outputSectorStore
 {
-	return [self outputURLUsingC2:[self.driveInformation.useC2 boolValue]];
+	return [self outputSectorStoreUsingC2:[self.driveInformation.useC2 boolValue]];
 }
 
-- (NSURL *) outputURLUsingC2:(BOOL)useC2
+- (SectorStore *) outputSectorStoreUsingC2:(BOOL)useC2
 {
 	// For a track to be successfully extracted, it must match self.requiredMatches
 	// other track extractions as determined by SHA1 comparisons
@@ -1454,6 +1522,9 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		if(useC2 && ((operation.useC2 != useC2) || ([operation.blockErrorFlags count])))
 			continue;
 		
+		if(operationHasUnreliableSectors(operation))
+			continue;
+		
 		// Compare to the whole extraction operations
 		for(ExtractionOperation *otherOperation in _wholeExtractions) {
 			
@@ -1465,31 +1536,32 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 			if(useC2 && ((otherOperation.useC2 != useC2) || ([otherOperation.blockErrorFlags count])))
 				continue;			
 			
+			if(operationHasUnreliableSectors(otherOperation))
+				continue;
+			
 			// If the SHA1 hashes match, we've a match
 			if([operation.SHA1 isEqualToString:otherOperation.SHA1])
 				++matchCount;
 		}
 		
 		// Compare to the synthesized tracks
-		for(NSURL *synthesizedTrackURL in _synthesizedTrackURLs) {
+		for(SectorStore *synthesizedTrack in _synthesizedTracks) {
 
 			// If the two tracks match, record it
-			NSString *synthesizedSHA1 = [_synthesizedTrackSHAs objectForKey:synthesizedTrackURL];
-			
-			if([operation.SHA1 isEqualToString:synthesizedSHA1])
+			if([operation.SHA1 isEqualToString:synthesizedTrack.SHA1])
 				++matchCount;
 		}
 
 		// If the required number of matches were made, the track is ready for encoding
 		if(matchCount >= self.requiredTrackMatches)
-			return operation.URL;
+			return operation.sectorStore;
 	}
 		
 	// If a match wasn't yet made, iterate through each synthesized track
-	for(NSUInteger trackIndex = 0; trackIndex < [_synthesizedTrackURLs count]; ++trackIndex) {
+	for(NSUInteger trackIndex = 0; trackIndex < [_synthesizedTracks count]; ++trackIndex) {
 		
-		NSURL *synthesizedTrackURL = [_synthesizedTrackURLs objectAtIndex:trackIndex];
-		NSString *synthesizedSHA1 = [_synthesizedTrackSHAs objectForKey:synthesizedTrackURL];
+		SectorStore *synthesizedTrack = [_synthesizedTracks objectAtIndex:trackIndex];
+		NSString *synthesizedSHA1 = synthesizedTrack.SHA1;
 		NSUInteger matchCount = 0;
 
 		// Compare to the whole extraction operations
@@ -1499,58 +1571,45 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 			if(useC2 && ((operation.useC2 != useC2) || ([operation.blockErrorFlags count])))
 				continue;			
 			
+			if(operationHasUnreliableSectors(operation))
+				continue;
+			
 			// If the SHA1 hashes match, we've a match
 			if([synthesizedSHA1 isEqualToString:operation.SHA1])
 				++matchCount;
 		}
 		
 		// Compare to the synthesized tracks
-		for(NSURL *otherSynthesizedTrackURL in _synthesizedTrackURLs) {
+		for(SectorStore *otherSynthesizedTrack in _synthesizedTracks) {
 			
 			// Skip ourselves
-			if(synthesizedTrackURL == otherSynthesizedTrackURL)
+			if(synthesizedTrack == otherSynthesizedTrack)
 				continue;
 
-			NSString *otherSynthesizedSHA1 = [_synthesizedTrackSHAs objectForKey:otherSynthesizedTrackURL];
-			
 			// If the two tracks match, record it
-			if([synthesizedSHA1 isEqualToString:otherSynthesizedSHA1])
+			if([synthesizedSHA1 isEqualToString:otherSynthesizedTrack.SHA1])
 				++matchCount;
 		}
 		
 		// If the required number of matches were made, the track is ready for encoding
 		if(matchCount >= self.requiredTrackMatches)
-			return synthesizedTrackURL;
+			return synthesizedTrack;
 	}
 
 	// The required number of matches was not reached
 	return nil;
 }
 
-- (NSURL *) bestGuessURL
+- (SectorStore *) bestGuessSectorStore
 {
-	return [self bestGuessURLUsingC2:[self.driveInformation.useC2 boolValue]];
+	return [self bestGuessSectorStoreUsingC2:[self.driveInformation.useC2 boolValue]];
 }
 
-- (NSURL *) bestGuessURLUsingC2:(BOOL)useC2
+- (SectorStore *) bestGuessSectorStoreUsingC2:(BOOL)useC2
 {
-	// Create the output file
-	NSURL *outputURL = temporaryURLWithExtension(@"wav");
-	
+	// Create the output store
+	SectorStore *bestGuess = [SectorStore sectorStore];
 	NSError *error = nil;
-	if(!createCDDAFileAtURL(outputURL, &error)) {
-		[self presentError:error 
-			modalForWindow:[[self view] window] 
-				  delegate:self 
-		didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) 
-			   contextInfo:NULL];
-		
-		return nil;
-	}
-
-	ExtractedAudioFile *outputFile = [ExtractedAudioFile openFileForReadingAndWritingAtURL:outputURL error:&error];
-	if(!outputFile)
-		return nil;
 	
 	// Iterate through each sector and save the audio
 	// This could probably be improved
@@ -1568,83 +1627,144 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 			sectorData = [self interpolatedDataForSector:sector requiredMatches:0 useC2:NO];
 		
 		// Even if no audio was returned, don't fail
-		if(sectorData)
-			[outputFile setAudioData:sectorData forSector:[_sectorsToExtract indexForSector:sector] error:&error];
+		if(sectorData) {
+			if(![bestGuess setAudioData:sectorData forSector:[_sectorsToExtract indexForSector:sector] error:&error]) {
+				[self presentError:error 
+					modalForWindow:[[self view] window] 
+						  delegate:self 
+				didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) 
+					   contextInfo:NULL];
+				
+				[bestGuess close];
+				return nil;
+			}
+		}
 		else
 			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"No audio returned for sector %i", sector];
 	}
 	
-	[outputFile closeFile];
+	// The store is closed along with the track's other stores
+	[_bestGuessTracks addObject:bestGuess];
 	
-	return outputURL;
+	return bestGuess;
 }
 
-- (BOOL) verifyTrackWithAccurateRip:(NSURL *)inputURL
+- (BOOL) verifyTrackWithAccurateRip:(SectorStore *)sectorStore
 {
-	NSParameterAssert(nil != inputURL);
+	NSParameterAssert(nil != sectorStore);
 	
 	NSRange trackAudioRange = NSMakeRange(MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS - _sectorsOfSilenceToPrepend, _currentTrack.sectorCount);
 	
-	// Calculate the AccurateRip checksums for the track
-	NSData *trackAccurateRipChecksumsData = calculateAccurateRipChecksumsForTrackInFile(inputURL, 
-																						trackAudioRange, 
-																						[self.compactDisc.firstSession.firstTrack.number isEqualToNumber:_currentTrack.number],
-																						[self.compactDisc.firstSession.lastTrack.number isEqualToNumber:_currentTrack.number],
-																						MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS,
-																						YES);
+	// Calculate the AccurateRip checksums for the track (v1 for all offsets, v2 for the primary offset)
+	uint32_t trackPrimaryAccurateRipChecksumV2 = 0;
+	NSData *trackAccurateRipChecksumsData = calculateAccurateRipChecksumsForTrackInSectorStore(sectorStore, 
+																							   trackAudioRange, 
+																							   [self.compactDisc.firstSession.firstTrack.number isEqualToNumber:_currentTrack.number],
+																							   [self.compactDisc.firstSession.lastTrack.number isEqualToNumber:_currentTrack.number],
+																							   MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS,
+																							   YES,
+																							   &trackPrimaryAccurateRipChecksumV2);
 	
 	// Only bother checking for AR matches if this disc is present in AR and checksum calculations were successful
-	if(trackAccurateRipChecksumsData && [self.compactDisc.accurateRipDiscs count]) {
+	if(trackAccurateRipChecksumsData && _accurateRipChecksumIndex.count) {
 		const uint32_t *trackAccurateRipChecksums = [trackAccurateRipChecksumsData bytes];
 		NSUInteger checksumsCount = [trackAccurateRipChecksumsData length] / sizeof(uint32_t);
+		NSUInteger trackNumber = [_currentTrack.number unsignedIntegerValue];
 		
 		// The checksums are arranged in the array from [-maximumOffsetInFrames, +maximumOffsetInFrames], so the item at
 		// maximumOffsetInFrames is the checksum for offset 0, the track's primary checksum
 		NSUInteger maximumOffsetInFrames = (checksumsCount - 1) / 2;
-		NSUInteger trackPrimaryAccurateRipChecksum = trackAccurateRipChecksums[maximumOffsetInFrames];
+		uint32_t trackPrimaryAccurateRipChecksum = trackAccurateRipChecksums[maximumOffsetInFrames];
 		
 		// Regardless of any C2 or other errors, a track is ready for encoding if it matches a track in the AR database	
-		for(AccurateRipDiscRecord *accurateRipDisc in self.compactDisc.accurateRipDiscs) {
-			AccurateRipTrackRecord *accurateRipTrack = [accurateRipDisc trackNumber:[_currentTrack.number unsignedIntegerValue]];
+		// Pressings submitted by newer software may only be present in the database with v2 checksums
+		AccurateRipChecksumEntry match;
+		BOOL matchesV1 = [_accurateRipChecksumIndex findChecksum:trackPrimaryAccurateRipChecksum forTrackNumber:trackNumber match:&match];
+		BOOL matchesV2 = !matchesV1 && [_accurateRipChecksumIndex findChecksum:trackPrimaryAccurateRipChecksumV2 forTrackNumber:trackNumber match:&match];
+		
+		// The track matches, so queue it for encoding
+		if(matchesV1 || matchesV2) {
+			if(matchesV1)
+				[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Primary Accurate Rip checksum (%.8x) matches", trackPrimaryAccurateRipChecksum];
+			else
+				[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Primary Accurate Rip v2 checksum (%.8x) matches", trackPrimaryAccurateRipChecksumV2];
 			
-			if(!accurateRipTrack)
-				continue;
+			BOOL trackSaved = [self saveTrackFromSectorStore:sectorStore
+										 accurateRipChecksum:trackPrimaryAccurateRipChecksum 
+									   accurateRipChecksumV2:trackPrimaryAccurateRipChecksumV2
+								  accurateRipConfidenceLevel:[NSNumber numberWithUnsignedInt:match.confidenceLevel]];
 			
-			// The track matches, so queue it for encoding
-			if([accurateRipTrack.checksum unsignedIntegerValue] == trackPrimaryAccurateRipChecksum) {
-				[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Primary Accurate Rip checksum (%.8x) matches", trackPrimaryAccurateRipChecksum];
+			if(trackSaved)
+				return YES;
+		}
+		
+		// Check the remaining offsets
+		for(NSInteger currentOffset = -maximumOffsetInFrames; currentOffset <= (NSInteger)maximumOffsetInFrames; ++currentOffset) {
+			uint32_t trackOffsetAccurateRipChecksum = trackAccurateRipChecksums[currentOffset + maximumOffsetInFrames];
+			
+			if([_accurateRipChecksumIndex findChecksum:trackOffsetAccurateRipChecksum forTrackNumber:trackNumber match:&match]) {
+				[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Alternate Accurate Rip checksum (%.8x) matches (offset %i)",trackOffsetAccurateRipChecksum, currentOffset];
 				
-				BOOL trackSaved = [self saveTrackFromURL:inputURL
-									 accurateRipChecksum:trackPrimaryAccurateRipChecksum 
-							  accurateRipConfidenceLevel:accurateRipTrack.confidenceLevel];
+				BOOL trackSaved = [self saveTrackFromSectorStore:sectorStore 
+											 accurateRipChecksum:trackPrimaryAccurateRipChecksum 
+										   accurateRipChecksumV2:trackPrimaryAccurateRipChecksumV2
+									  accurateRipConfidenceLevel:[NSNumber numberWithUnsignedInt:match.confidenceLevel]
+							accurateRipAlternatePressingChecksum:trackOffsetAccurateRipChecksum 
+							  accurateRipAlternatePressingOffset:[NSNumber numberWithInteger:currentOffset]];
 				
 				if(trackSaved)
 					return YES;
 			}
 		}
 		
-		// Check the remaining offsets
-		for(NSInteger currentOffset = -maximumOffsetInFrames; currentOffset <= (NSInteger)maximumOffsetInFrames; ++currentOffset) {
-			NSUInteger trackOffsetAccurateRipChecksum = trackAccurateRipChecksums[currentOffset + maximumOffsetInFrames];
+		// Pressings may differ by far more than the cushion, so search a much wider window for alignments
+		// using the offset checksums (the checksum of the sector six seconds into the track), which are cheap
+		// to calculate for every offset and only need audio that has already been read
+		// Each candidate is confirmed with the exact checksum for the entire track at the candidate offset;
+		// audio beyond the cushion is treated as silence, which is usually what separates the tracks
+		if(_accurateRipOffsetChecksumIndex.count && ((6 * CDDA_SECTORS_PER_SECOND) + MAXIMUM_ALTERNATE_PRESSING_OFFSET_IN_SECTORS) < _currentTrack.sectorCount) {
+			NSUInteger maximumAlternateOffsetInFrames = MAXIMUM_ALTERNATE_PRESSING_OFFSET_IN_SECTORS * AUDIO_FRAMES_PER_CDDA_SECTOR;
+			NSData *offsetChecksumsData = calculateAccurateRipOffsetChecksumsForSectorStore(sectorStore, 
+																							 trackAudioRange.location + (6 * CDDA_SECTORS_PER_SECOND), 
+																							 maximumAlternateOffsetInFrames);
 			
-			for(AccurateRipDiscRecord *accurateRipDisc in self.compactDisc.accurateRipDiscs) {
-				AccurateRipTrackRecord *accurateRipTrack = [accurateRipDisc trackNumber:[_currentTrack.number unsignedIntegerValue]];
+			const uint32_t *offsetChecksums = [offsetChecksumsData bytes];
+			NSUInteger offsetChecksumsCount = [offsetChecksumsData length] / sizeof(uint32_t);
+			
+			for(NSUInteger offsetIndex = 0; offsetIndex < offsetChecksumsCount; ++offsetIndex) {
+				NSInteger currentOffset = (NSInteger)offsetIndex - (NSInteger)maximumAlternateOffsetInFrames;
 				
-				if(!accurateRipTrack)
+				// These offsets were checked above
+				if((NSInteger)maximumOffsetInFrames >= ABS(currentOffset))
 					continue;
 				
-				if([accurateRipTrack.checksum unsignedIntegerValue] == trackOffsetAccurateRipChecksum) {
-					[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Alternate Accurate Rip checksum (%.8x) matches (offset %i)",trackOffsetAccurateRipChecksum, currentOffset];
-					
-					BOOL trackSaved = [self saveTrackFromURL:inputURL 
-										 accurateRipChecksum:trackPrimaryAccurateRipChecksum 
-								  accurateRipConfidenceLevel:accurateRipTrack.confidenceLevel
-						accurateRipAlternatePressingChecksum:trackOffsetAccurateRipChecksum 
-						  accurateRipAlternatePressingOffset:[NSNumber numberWithInteger:currentOffset]];
-					
-					if(trackSaved)
-						return YES;
+				AccurateRipChecksumEntry candidate;
+				if(![_accurateRipOffsetChecksumIndex findChecksum:offsetChecksums[offsetIndex] forTrackNumber:trackNumber match:&candidate])
+					continue;
+				
+				uint32_t trackOffsetAccurateRipChecksum = calculateAccurateRipChecksumForSectorStoreRegionUsingOffset(sectorStore, 
+																													  trackAudioRange, 
+																													  [self.compactDisc.firstSession.firstTrack.number isEqualToNumber:_currentTrack.number],
+																													  [self.compactDisc.firstSession.lastTrack.number isEqualToNumber:_currentTrack.number],
+																													  currentOffset, 
+																													  NULL);
+				
+				if(![_accurateRipChecksumIndex findChecksum:trackOffsetAccurateRipChecksum forTrackNumber:trackNumber match:&match]) {
+					[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Accurate Rip offset checksum (%.8x) matches (offset %i), but the track checksum does not", offsetChecksums[offsetIndex], currentOffset];
+					continue;
 				}
+				
+				[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Alternate Accurate Rip checksum (%.8x) matches (offset %i)", trackOffsetAccurateRipChecksum, currentOffset];
+				
+				BOOL trackSaved = [self saveTrackFromSectorStore:sectorStore 
+											 accurateRipChecksum:trackPrimaryAccurateRipChecksum 
+										   accurateRipChecksumV2:trackPrimaryAccurateRipChecksumV2
+									  accurateRipConfidenceLevel:[NSNumber numberWithUnsignedInt:match.confidenceLevel]
+							accurateRipAlternatePressingChecksum:trackOffsetAccurateRipChecksum 
+							  accurateRipAlternatePressingOffset:[NSNumber numberWithInteger:currentOffset]];
+				
+				if(trackSaved)
+					return YES;
 			}
 		}
 	}
@@ -1655,34 +1775,217 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	return NO;
 }
 
-- (BOOL) saveSector:(NSUInteger)sector sectorData:(NSData *)sectorData
+- (BOOL) allTracksVerifiedWithAccurateRip
 {
-	NSParameterAssert(nil != sectorData);
+	for(TrackExtractionRecord *trackExtractionRecord in _trackExtractionRecords) {
+		if(!trackExtractionRecord.accurateRipConfidenceLevel)
+			return NO;
+	}
 	
-	NSError *error = nil;
+	return YES;
+}
+
+- (void) startParityRecordOperation
+{
+	NSAssert(nil != self.imageExtractionRecord, @"self.imageExtractionRecord may not be nil");
 	
-	// Create the output file if it doesn't exist
-	if(!_synthesizedTrackURL) {
-		_synthesizedTrackURL = temporaryURLWithExtension(@"wav");
-		
-		if(!createCDDAFileAtURL(_synthesizedTrackURL, &error)) {
-			[self presentError:error 
-				modalForWindow:[[self view] window] 
-					  delegate:self 
-			didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) 
-				   contextInfo:NULL];
+	if(_parityRecord)
+		[_statusTextField setStringValue:NSLocalizedString(@"Verifying image", @"")];
+	else
+		[_statusTextField setStringValue:NSLocalizedString(@"Generating parity record", @"")];
+	
+	ParityRecordOperation *operation = [[ParityRecordOperation alloc] init];
+	
+	operation.imageURL = self.imageExtractionRecord.inputURL;
+	operation.parityRecord = _parityRecord;
+	
+	[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kParityRecordKVOContext];
+	[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kParityRecordKVOContext];
+	[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kParityRecordKVOContext];
+	
+	[self.operationQueue addOperation:operation];
+}
+
+- (void) processParityRecordOperation:(ParityRecordOperation *)operation
+{
+	NSParameterAssert(nil != operation);
+	
+	// A cancelled operation means the extraction was cancelled
+	if(operation.isCancelled) {
+		[[NSFileManager defaultManager] removeItemAtPath:[operation.repairedImageURL path] error:NULL];
+		return;
+	}
+	
+	if(operation.parityRecord) {
+		// If the image couldn't be repaired, any tracks that weren't verified have to be extracted again the usual way
+		if(operation.error) {
+			[[Logger sharedLogger] logMessage:@"Unable to repair image using the parity record: %@", operation.error];
 			
-			return NO;
+			if(_trackIDsAwaitingParityRepair.count) {
+				[[NSFileManager defaultManager] removeItemAtPath:[self.imageExtractionRecord.inputURL path] error:NULL];
+				[self.managedObjectContext deleteObject:self.imageExtractionRecord];
+				_imageExtractionRecord = nil;
+				
+				[self reextractTracksAwaitingParityRepair];
+				return;
+			}
 		}
+		else if(operation.repairedImageURL) {
+			[[NSFileManager defaultManager] removeItemAtPath:[self.imageExtractionRecord.inputURL path] error:NULL];
+			
+			self.imageExtractionRecord.inputURL = operation.repairedImageURL;
+			self.imageExtractionRecord.MD5 = operation.MD5;
+			self.imageExtractionRecord.SHA1 = operation.SHA1;
+			
+			[[Logger sharedLogger] logMessage:@"Repaired %lu sectors using the parity record: %@", (unsigned long)operation.repairedSectors.count, operation.repairedSectors];
+			
+			// The tracks still hold the damaged audio, so replace it with the repaired audio
+			if(![self repairTracksAwaitingParityRepairFromImageURL:operation.repairedImageURL repairedSectors:operation.repairedSectors]) {
+				[[NSFileManager defaultManager] removeItemAtPath:[self.imageExtractionRecord.inputURL path] error:NULL];
+				[self.managedObjectContext deleteObject:self.imageExtractionRecord];
+				_imageExtractionRecord = nil;
+				
+				[self reextractTracksAwaitingParityRepair];
+				return;
+			}
+		}
+		else
+			[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Image matches the parity record"];
+	}
+	else {
+		NSError *error = operation.error;
+		if(!operation.generatedParityRecord || ![[ParityRecordDatabase sharedDatabase] publishParityRecord:operation.generatedParityRecord forCompactDisc:self.compactDisc error:&error])
+			[[Logger sharedLogger] logMessage:@"Unable to archive parity record: %@", error];
 	}
+	
+	NSError *error = nil;
+	if(![[EncoderManager sharedEncoderManager] encodeImageExtractionRecord:self.imageExtractionRecord error:&error])
+		[self presentError:error 
+			modalForWindow:[[self view] window]
+				  delegate:self
+		didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:)
+			   contextInfo:NULL];
+	
+	[self finishExtraction];
+}
 
-	ExtractedAudioFile *synthesizedTrack = [ExtractedAudioFile openFileForReadingAndWritingAtURL:_synthesizedTrackURL error:&error];
-	if(!synthesizedTrack)
+- (BOOL) repairTracksAwaitingParityRepairFromImageURL:(NSURL *)imageURL repairedSectors:(NSIndexSet *)repairedSectors
+{
+	NSParameterAssert(nil != imageURL);
+	NSParameterAssert(nil != repairedSectors);
+	
+	NSError *error = nil;
+	SectorStore *image = [SectorStore sectorStoreWithContentsOfURL:imageURL error:&error];
+	if(!image) {
+		[[Logger sharedLogger] logMessage:@"Unable to open the repaired image: %@", error];
 		return NO;
+	}
+	
+	BOOL result = YES;
+	
+	// The image is the concatenation of the extracted tracks, in order
+	NSUInteger imageSectorNumber = 0;
+	for(TrackExtractionRecord *trackExtractionRecord in self.imageExtractionRecord.orderedTracks) {
+		TrackDescriptor *track = trackExtractionRecord.track;
+		NSRange trackSectors = NSMakeRange(imageSectorNumber, track.sectorCount);
+		
+		imageSectorNumber += track.sectorCount;
+		
+		// Tracks without any repaired sectors matched the parity record as extracted
+		if(![_trackIDsAwaitingParityRepair containsObject:track.objectID] || ![repairedSectors intersectsIndexesInRange:trackSectors])
+			continue;
+		
+		// Surround the track with the same cushion of audio used during extraction, so the repaired track
+		// can be verified against alternate pressings as well
+		NSUInteger sectorsBefore = MIN(MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS, trackSectors.location);
+		NSUInteger sectorsAfter = MIN(MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS, image.sectorCount - NSMaxRange(trackSectors));
+		NSRange sectorsToCopy = NSMakeRange(trackSectors.location - sectorsBefore, sectorsBefore + trackSectors.length + sectorsAfter);
+		
+		SectorStore *trackWithCushionSectors = [SectorStore sectorStore];
+		if(![trackWithCushionSectors copySectors:sectorsToCopy fromSectorStore:image toSector:0 error:&error]) {
+			[[Logger sharedLogger] logMessage:@"Unable to copy the repaired audio for track %@: %@", track.number, error];
+			[trackWithCushionSectors close];
+			result = NO;
+			break;
+		}
+		
+		_currentTrack = track;
+		_sectorsOfSilenceToPrepend = MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS - sectorsBefore;
+		_sectorsOfSilenceToAppend = MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS - sectorsAfter;
+		
+		// Discard the damaged audio along with its digests and checksums
+		[[NSFileManager defaultManager] removeItemAtPath:[trackExtractionRecord.inputURL path] error:NULL];
+		[self.imageExtractionRecord removeTracksObject:trackExtractionRecord];
+		[_trackExtractionRecords removeObject:trackExtractionRecord];
+		[self.managedObjectContext deleteObject:trackExtractionRecord];
+		
+		// Save the repaired track, which creates a new record for it
+		BOOL trackSaved = ENABLE_ACCURATERIP && [self verifyTrackWithAccurateRip:trackWithCushionSectors];
+		if(!trackSaved)
+			trackSaved = [self saveTrackFromSectorStore:trackWithCushionSectors copyVerified:NO];
+		
+		[trackWithCushionSectors close];
+		
+		if(!trackSaved) {
+			[[Logger sharedLogger] logMessage:@"Unable to save the repaired audio for track %@", track.number];
+			result = NO;
+			break;
+		}
+		
+		[[Logger sharedLogger] logMessageWithLevel:eLogMessageLevelDebug format:@"Replaced the audio for track %@ with the repaired audio", track.number];
+		
+		[_trackIDsAwaitingParityRepair removeObject:track.objectID];
+	}
+	
+	_currentTrack = nil;
+	
+	[image close];
+	
+	// Attach the records created for the repaired tracks
+	[self.imageExtractionRecord addTracks:_trackExtractionRecords];
 	
-	[synthesizedTrack setAudioData:sectorData forSector:[_sectorsToExtract indexForSector:sector] error:&error];
+	return result;
+}
+
+- (void) reextractTracksAwaitingParityRepair
+{
+	[[Logger sharedLogger] logMessage:@"Extracting unverified tracks again"];
 	
-	[synthesizedTrack closeFile];
+	// Discard the unverified audio
+	for(TrackExtractionRecord *trackExtractionRecord in [_trackExtractionRecords allObjects]) {
+		if(![_trackIDsAwaitingParityRepair containsObject:trackExtractionRecord.track.objectID])
+			continue;
+		
+		[[NSFileManager defaultManager] removeItemAtPath:[trackExtractionRecord.inputURL path] error:NULL];
+		[_trackExtractionRecords removeObject:trackExtractionRecord];
+		[self.managedObjectContext deleteObject:trackExtractionRecord];
+	}
+	
+	[_trackIDsRemaining unionSet:_trackIDsAwaitingParityRepair];
+	[_trackIDsAwaitingParityRepair removeAllObjects];
+	_parityRecord = nil;
+	
+	[self startExtractingNextTrack];
+}
+
+- (BOOL) saveSector:(NSUInteger)sector sectorData:(NSData *)sectorData
+{
+	NSParameterAssert(nil != sectorData);
+	
+	// Create the output store if it doesn't exist
+	if(!_synthesizedTrack)
+		_synthesizedTrack = [SectorStore sectorStore];
+
+	NSError *error = nil;
+	if(![_synthesizedTrack setAudioData:sectorData forSector:[_sectorsToExtract indexForSector:sector] error:&error]) {
+		[self presentError:error 
+			modalForWindow:[[self view] window] 
+				  delegate:self 
+		didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) 
+			   contextInfo:NULL];
+		
+		return NO;
+	}
 	
 	return YES;
 }
@@ -1692,21 +1995,9 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	NSParameterAssert(nil != sectors);
 	NSParameterAssert(nil != operation);
 	
-	// Create the output file if it doesn't exist
-	if(!_synthesizedTrackURL) {
-		_synthesizedTrackURL = temporaryURLWithExtension(@"wav");
-		
-		NSError *error = nil;
-		if(!createCDDAFileAtURL(_synthesizedTrackURL, &error)) {
-			[self presentError:error 
-				modalForWindow:[[self view] window] 
-					  delegate:self 
-			didPresentSelector:@selector(didPresentErrorWithRecovery:contextInfo:) 
-				   contextInfo:NULL];
-			
-			return NO;
-		}
-	}
+	// Create the output store if it doesn't exist
+	if(!_synthesizedTrack)
+		_synthesizedTrack = [SectorStore sectorStore];
 	
 	// Convert the absolute sector numbers to indexes within the extracted audio
 	NSUInteger firstSectorInInputFile = operation.sectors.firstSector;
@@ -1722,12 +2013,12 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		if(NSNotFound == sectorIndex) {
 			if(NSNotFound != firstIndex) {
 				if(firstIndex == latestIndex) {
-					if(!copySectorsFromURLToURL(operation.URL, NSMakeRange(firstIndex - firstSectorInInputFile, 1), _synthesizedTrackURL, firstIndex - firstSectorInOutputFile))
+					if(![_synthesizedTrack copySectors:NSMakeRange(firstIndex - firstSectorInInputFile, 1) fromSectorStore:operation.sectorStore toSector:(firstIndex - firstSectorInOutputFile) error:NULL])
 						return NO;
 				}
 				else {
 					NSUInteger sectorCount = latestIndex - firstIndex + 1;
-					if(!copySectorsFromURLToURL(operation.URL, NSMakeRange(firstIndex - firstSectorInInputFile, sectorCount), _synthesizedTrackURL, firstIndex - firstSectorInOutputFile))
+					if(![_synthesizedTrack copySectors:NSMakeRange(firstIndex - firstSectorInInputFile, sectorCount) fromSectorStore:operation.sectorStore toSector:(firstIndex - firstSectorInOutputFile) error:NULL])
 						return NO;
 				}
 			}
@@ -1742,12 +2033,12 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 		else {
 			if(NSNotFound != firstIndex) {
 				if(firstIndex == latestIndex) {
-					if(!copySectorsFromURLToURL(operation.URL, NSMakeRange(firstIndex - firstSectorInInputFile, 1), _synthesizedTrackURL, firstIndex - firstSectorInOutputFile))
+					if(![_synthesizedTrack copySectors:NSMakeRange(firstIndex - firstSectorInInputFile, 1) fromSectorStore:operation.sectorStore toSector:(firstIndex - firstSectorInOutputFile) error:NULL])
 						return NO;
 				}
 				else {
 					NSUInteger sectorCount = latestIndex - firstIndex + 1;
-					if(!copySectorsFromURLToURL(operation.URL, NSMakeRange(firstIndex - firstSectorInInputFile, sectorCount), _synthesizedTrackURL, firstIndex - firstSectorInOutputFile))
+					if(![_synthesizedTrack copySectors:NSMakeRange(firstIndex - firstSectorInInputFile, sectorCount) fromSectorStore:operation.sectorStore toSector:(firstIndex - firstSectorInOutputFile) error:NULL])
 						return NO;
 				}
 			}
@@ -1762,19 +2053,19 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	return YES;
 }
 
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors
 {
-	return [self saveTrackFromURL:trackWithCushionSectorsURL copyVerified:YES];
+	return [self saveTrackFromSectorStore:trackWithCushionSectors copyVerified:YES];
 }
 
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL copyVerified:(BOOL)copyVerified
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors copyVerified:(BOOL)copyVerified
 {
-	NSParameterAssert(nil != trackWithCushionSectorsURL);
+	NSParameterAssert(nil != trackWithCushionSectors);
 	
 	NSError *error = nil;
 	
 	// Create an output file containing only the track audio (strip off the extra sectors used for AR calculations)
-	NSURL *trackURL = [self generateOutputFileForURL:trackWithCushionSectorsURL error:&error];
+	NSURL *trackURL = [self generateOutputFileForSectorStore:trackWithCushionSectors error:&error];
 	if(!trackURL)
 		return NO;
 	
@@ -1790,23 +2081,24 @@ NSString * const kAudioExtractionKVOContext		= @"org.sbooth.Rip.ExtractionViewCo
 	return YES;
 }
 
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipChecksumV2:(NSUInteger)accurateRipChecksumV2 accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel
 {
-	return [self saveTrackFromURL:trackWithCushionSectorsURL 
-			  accurateRipChecksum:accurateRipChecksum 
-	   accurateRipConfidenceLevel:accurateRipConfidenceLevel
-accurateRipAlternatePressingChecksum:0
-accurateRipAlternatePressingOffset:nil];
+	return [self saveTrackFromSectorStore:trackWithCushionSectors 
+					  accurateRipChecksum:accurateRipChecksum 
+					accurateRipChecksumV2:accurateRipChecksumV2
+			   accurateRipConfidenceLevel:accurateRipConfidenceLevel
+	 accurateRipAlternatePressingChecksum:0
+	   accurateRipAlternatePressingOffset:nil];
 }
 
-- (BOOL) saveTrackFromURL:(NSURL *)trackWithCushionSectorsURL accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel accurateRipAlternatePressingChecksum:(NSUInteger)accurateRipAlternatePressingChecksum accurateRipAlternatePressingOffset:(NSNumber *)accurateRipAlternatePressingOffset
+- (BOOL) saveTrackFromSectorStore:(SectorStore *)trackWithCushionSectors accurateRipChecksum:(NSUInteger)accurateRipChecksum accurateRipChecksumV2:(NSUInteger)accurateRipChecksumV2 accurateRipConfidenceLevel:(NSNumber *)accurateRipConfidenceLevel accurateRipAlternatePressingChecksum:(NSUInteger)accurateRipAlternatePressingChecksum accurateRipAlternatePressingOffset:(NSNumber *)accurateRipAlternatePressingOffset
 {
-	NSParameterAssert(nil != trackWithCushionSectorsURL);
+	NSParameterAssert(nil != trackWithCushionSectors);
 		
 	NSError *error = nil;
 	
 	// Create an output file containing only the track audio (strip off the extra sectors used for AR calculations)
-	NSURL *trackURL = [self generateOutputFileForURL:trackWithCushionSectorsURL error:&error];
+	NSURL *trackURL = [self generateOutputFileForSectorStore:trackWithCushionSectors error:&error];
 	if(!trackURL)
 		return NO;
 	
@@ -1819,6 +2111,9 @@ accurateRipAlternatePressingOffset:nil];
 	if(!extractionRecord)
 		return NO;
 	
+	if(accurateRipChecksumV2)
+		extractionRecord.accurateRipChecksumV2 = [NSNumber numberWithUnsignedInteger:accurateRipChecksumV2];
+	
 	[self addTrackExtractionRecord:extractionRecord];
 	
 	return YES;
@@ -75,6 +75,12 @@
 		[result appendFormat:@"    Audio MD5 hash:         %@\n", extractionRecord.MD5];
 		[result appendFormat:@"    Audio SHA1 hash:        %@\n", extractionRecord.SHA1];
 		[result appendFormat:@"    AccurateRip checksum:   %08lx\n", extractionRecord.accurateRipChecksum.unsignedIntegerValue];
+		if(extractionRecord.accurateRipChecksumV2)
+			[result appendFormat:@"    AccurateRip v2:         %08x\n", extractionRecord.accurateRipChecksumV2.unsignedIntValue];
+		if(extractionRecord.CRC32) {
+			[result appendFormat:@"    Copy CRC:               %08x\n", extractionRecord.CRC32.unsignedIntValue];
+			[result appendFormat:@"    Copy CRC (no nulls):    %08x\n", extractionRecord.CRC32WithoutNullSamples.unsignedIntValue];
+		}
 
 		if(extractionRecord.track.metadata.replayGain) {
 			[result appendString:@"\n"];
@@ -190,6 +196,12 @@
 		[result appendFormat:@"    Audio MD5 hash:         %@\n", extractionRecord.MD5];
 		[result appendFormat:@"    Audio SHA1 hash:        %@\n", extractionRecord.SHA1];
 		[result appendFormat:@"    AccurateRip checksum:   %08lx\n", extractionRecord.accurateRipChecksum.unsignedIntegerValue];
+		if(extractionRecord.accurateRipChecksumV2)
+			[result appendFormat:@"    AccurateRip v2:         %08x\n", extractionRecord.accurateRipChecksumV2.unsignedIntValue];
+		if(extractionRecord.CRC32) {
+			[result appendFormat:@"    Copy CRC:               %08x\n", extractionRecord.CRC32.unsignedIntValue];
+			[result appendFormat:@"    Copy CRC (no nulls):    %08x\n", extractionRecord.CRC32WithoutNullSamples.unsignedIntValue];
+		}
 		
 		if(extractionRecord.track.metadata.replayGain) {
 			[result appendString:@"\n"];
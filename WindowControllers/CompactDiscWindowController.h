@@ -70,4 +70,9 @@
 
 - (IBAction) ejectDisc:(id)sender;
 
+// ========================================
+// Restore the chosen metadata and the AccurateRip response for a disc that has been seen before
+// Returns the disc's identity, or nil if it isn't known
+- (NSDictionary *) restoreDiscIdentity;
+
 @end
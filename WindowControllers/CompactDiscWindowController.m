@@ -18,6 +18,8 @@
 #import "ExtractionViewController.h"
 
 #import "AccurateRipQueryOperation.h"
+#import "DriveOffsetDatabase.h"
+#import "DiscIdentityCache.h"
 
 #import "DriveInformation.h"
 
@@ -40,6 +42,7 @@
 #import "MetadataSourceManager.h"
 
 #import "FileUtilities.h"
+#import "Logger.h"
 #import "AccurateRipDiscRecord.h"
 #import "AccurateRipTrackRecord.h"
 
@@ -292,15 +295,10 @@ void ejectCallback(DADiskRef disk, DADissenterRef dissenter, void *context)
 
 		return (0 != countOfSelectedTracks);		
 	}
+	// The ISRCs for all tracks are read in a single pass over the disc
 	else if([menuItem action] == @selector(readISRCs:)) {
-		NSUInteger countOfSelectedTracks = self.compactDisc.firstSession.selectedTracks.count;
-		
-		if(1 == countOfSelectedTracks)
-			[menuItem setTitle:NSLocalizedString(@"Read ISRC", @"")];
-		else
-			[menuItem setTitle:NSLocalizedString(@"Read ISRCs", @"")];
-			
-		return (0 != countOfSelectedTracks);
+		[menuItem setTitle:NSLocalizedString(@"Read ISRCs", @"")];
+		return (nil != self.compactDisc);
 	}
 //	else if([menuItem action] == @selector(determineDriveReadOffset:)) {
 //		if(self.driveInformation.productName)
@@ -599,12 +597,9 @@ void ejectCallback(DADiskRef disk, DADissenterRef dissenter, void *context)
 
 #pragma unused(sender)
 
-	NSString *driveOffsetsPath = [[NSBundle mainBundle] pathForResource:@"DriveOffsets" ofType:@"plist" inDirectory:nil];
-	NSDictionary *driveOffsets = [NSDictionary dictionaryWithContentsOfFile:driveOffsetsPath];
-
-	NSString *vendorAndProduct = [NSString stringWithFormat:@"%@ - %@", self.driveInformation.vendorName, self.driveInformation.productName];
-
-	NSNumber *driveOffset = [driveOffsets objectForKey:vendorAndProduct];
+	NSNumber *driveOffset = [[DriveOffsetDatabase sharedDatabase] readOffsetForVendorName:self.driveInformation.vendorName 
+																			  productName:self.driveInformation.productName 
+																				matchType:NULL];
 	if(driveOffset)
 		NSBeginAlertSheet([NSString stringWithFormat:NSLocalizedString(@"The suggested read offset for \u201c%@ %@\u201d is %@ audio frames.  Would you like to use this read offset?", @""), self.driveInformation.vendorName, self.driveInformation.productName, driveOffset],
 						  NSLocalizedString(@"Yes", @""), 
@@ -712,16 +707,9 @@ void ejectCallback(DADiskRef disk, DADissenterRef dissenter, void *context)
 
 #pragma unused(sender)
 	
-	NSSet *selectedTracks = self.compactDisc.firstSession.selectedTracks;
-	if(0 == selectedTracks.count) {
-		NSBeep();
-		return;
-	}
-	
 	ReadISRCsSheetController *sheetController = [[ReadISRCsSheetController alloc] init];
 	
 	sheetController.disk = self.disk;
-	sheetController.trackIDs = [selectedTracks valueForKey:@"objectID"];
 	
 	[sheetController beginReadISRCsSheetForWindow:self.window
 									modalDelegate:nil 
@@ -943,6 +931,34 @@ void ejectCallback(DADiskRef disk, DADissenterRef dissenter, void *context)
 	DADiskUnmount(self.disk, kDADiskUnmountOptionWhole, unmountCallback, self);
 }
 
+- (NSDictionary *) restoreDiscIdentity
+{
+	NSDictionary *identity = [[DiscIdentityCache sharedCache] identityForDiscTOC:self.compactDisc.discTOC];
+	if(!identity)
+		return nil;
+
+	NSDictionary *metadata = [identity objectForKey:kDiscIdentityMetadataKey];
+	if(metadata)
+		[self updateMetadataWithMusicDatabaseEntry:metadata];
+
+	// The response is looked up through the AccurateRip cache, so an expired response is fetched again
+	if([identity objectForKey:kDiscIdentityAccurateRipResponseKey]) {
+		AccurateRipQueryOperation *operation = [[AccurateRipQueryOperation alloc] init];
+
+		operation.compactDiscID = self.compactDisc.objectID;
+		operation.useDiscIdentity = YES;
+
+		// Observe the operation's progress
+		[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kAccurateRipQueryKVOContext];
+		[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kAccurateRipQueryKVOContext];
+		[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kAccurateRipQueryKVOContext];
+
+		[self.operationQueue addOperation:operation];
+	}
+
+	return identity;
+}
+
 @end
 
 @implementation CompactDiscWindowController (SheetCallbacks)
@@ -1258,6 +1274,13 @@ void ejectCallback(DADiskRef disk, DADissenterRef dissenter, void *context)
 	NSError *error = nil;
 	if([self.managedObjectContext hasChanges] && ![self.managedObjectContext save:&error])
 		[self presentError:error modalForWindow:self.window delegate:nil didPresentSelector:NULL contextInfo:NULL];
+
+	// Remember the choice with the disc
+	if([musicDatabaseEntry isKindOfClass:[NSDictionary class]]) {
+		NSDictionary *values = [NSDictionary dictionaryWithObject:musicDatabaseEntry forKey:kDiscIdentityMetadataKey];
+		if(![[DiscIdentityCache sharedCache] updateIdentityForDiscTOC:self.compactDisc.discTOC withValues:values error:&error])
+			[[Logger sharedLogger] logMessage:@"Unable to cache the disc's identity: %@", error];
+	}
 }
 
 - (void) toggleTableColumnVisible:(id)sender
@@ -1356,6 +1379,7 @@ void ejectCallback(DADiskRef disk, DADissenterRef dissenter, void *context)
 	_extractionViewController.requiredSectorMatches = [[NSUserDefaults standardUserDefaults] integerForKey:@"requiredSectorMatches"];
 	_extractionViewController.requiredTrackMatches = [[NSUserDefaults standardUserDefaults] integerForKey:@"requiredTrackMatches"];
 	_extractionViewController.allowExtractionFailure = [[NSUserDefaults standardUserDefaults] boolForKey:@"allowExtractionFailure"];
+	_extractionViewController.useTestAndCopy = [[NSUserDefaults standardUserDefaults] boolForKey:@"useTestAndCopy"];
 	
 	// Start extracting
 	[_extractionViewController extract:self];
@@ -8,6 +8,7 @@
 
 // ========================================
 // An NSWindowController subclass managing ISRC reading
+// The ISRCs for every track are read in a single survey of the disc's sub-channel
 // ========================================
 @interface ReadISRCsSheetController : NSWindowController
 {
@@ -16,15 +17,12 @@
 
 @private
 	__strong DADiskRef _disk;
-	NSSet *_trackIDs;
 	NSOperationQueue *_operationQueue;
-	NSManagedObjectContext *_managedObjectContext;
 }
 
 // ========================================
-// Properties affecting MCN reading
+// Properties affecting ISRC reading
 @property (assign) DADiskRef disk;
-@property (copy) NSSet * trackIDs;
 
 // ========================================
 // The meat & potatoes
@@ -4,12 +4,7 @@
  */
 
 #import "ReadISRCsSheetController.h"
-#import "ISRCDetectionOperation.h"
-
-#import "TrackDescriptor.h"
-#import "TrackMetadata.h"
-
-#import "ApplicationDelegate.h"
+#import "SubchannelSurveyOperation.h"
 
 // ========================================
 // Context objects for observeValueForKeyPath:ofObject:change:context:
@@ -18,7 +13,6 @@ static NSString * const kOperationQueueKVOContext		= @"org.sbooth.Rip.ReadISRCsS
 
 @interface ReadISRCsSheetController ()
 @property (assign) NSOperationQueue * operationQueue;
-@property (readonly) NSManagedObjectContext * managedObjectContext;
 @end
 
 @interface ReadISRCsSheetController (Callbacks)
@@ -26,17 +20,13 @@ static NSString * const kOperationQueueKVOContext		= @"org.sbooth.Rip.ReadISRCsS
 @end
 
 @interface ReadISRCsSheetController (Private)
-- (void) setStatusTextForTrackID:(NSManagedObjectID *)trackID;
-- (void) operationDidReturn:(ISRCDetectionOperation *)operation;
-- (NSManagedObjectContext *) managedObjectContext;
+- (void) operationDidReturn:(SubchannelSurveyOperation *)operation;
 @end
 
 @implementation ReadISRCsSheetController
 
 @synthesize disk = _disk;
-@synthesize trackIDs = _trackIDs;
 @synthesize operationQueue = _operationQueue;
-@synthesize managedObjectContext = _managedObjectContext;
 
 - (id) init
 {
@@ -50,19 +40,9 @@ static NSString * const kOperationQueueKVOContext		= @"org.sbooth.Rip.ReadISRCsS
 - (void) observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context
 {
 	if(kOperationQueueKVOContext == context) {
-		ISRCDetectionOperation *operation = (ISRCDetectionOperation *)object;
+		SubchannelSurveyOperation *operation = (SubchannelSurveyOperation *)object;
 		
-		if([keyPath isEqualToString:@"isExecuting"]) {
-			if([operation isExecuting]) {
-				// KVO is thread-safe, but doesn't guarantee observeValueForKeyPath: will be called from the main thread
-				if([NSThread isMainThread])
-					[self setStatusTextForTrackID:operation.trackID];
-				else
-					[self performSelectorOnMainThread:@selector(setStatusTextForTrackID:) withObject:operation.trackID waitUntilDone:NO];
-			}
-		}
-		else if([keyPath isEqualToString:@"isCancelled"] || [keyPath isEqualToString:@"isFinished"]) {
-			[operation removeObserver:self forKeyPath:@"isExecuting"];
+		if([keyPath isEqualToString:@"isCancelled"] || [keyPath isEqualToString:@"isFinished"]) {
 			[operation removeObserver:self forKeyPath:@"isCancelled"];
 			[operation removeObserver:self forKeyPath:@"isFinished"];
 
@@ -88,19 +68,16 @@ static NSString * const kOperationQueueKVOContext		= @"org.sbooth.Rip.ReadISRCsS
 									  contextInfo:contextInfo];
 
 	[_progressIndicator startAnimation:self];
+	[_statusTextField setStringValue:NSLocalizedString(@"Reading the disc's sub-channel", @"")];
 
-	for(NSManagedObjectID *objectID in self.trackIDs) {
-		ISRCDetectionOperation *operation = [[ISRCDetectionOperation alloc] init];
-		
-		operation.disk = self.disk;
-		operation.trackID = objectID;
-		
-		[operation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kOperationQueueKVOContext];
-		[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kOperationQueueKVOContext];
-		[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kOperationQueueKVOContext];
+	SubchannelSurveyOperation *operation = [[SubchannelSurveyOperation alloc] init];
+	
+	operation.disk = self.disk;
+	
+	[operation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kOperationQueueKVOContext];
+	[operation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kOperationQueueKVOContext];
 
-		[self.operationQueue addOperation:operation];
-	}	
+	[self.operationQueue addOperation:operation];
 }
 
 - (IBAction) cancel:(id)sender
@@ -131,27 +108,7 @@ static NSString * const kOperationQueueKVOContext		= @"org.sbooth.Rip.ReadISRCsS
 
 @implementation ReadISRCsSheetController (Private)
 
-- (void) setStatusTextForTrackID:(NSManagedObjectID *)trackID
-{
-	NSParameterAssert(nil != trackID);
-
-	// Fetch the TrackDescriptor object from the context and ensure it is the correct class
-	NSManagedObject *managedObject = [self.managedObjectContext objectWithID:trackID];
-	if(![managedObject isKindOfClass:[TrackDescriptor class]])
-		return;
-	
-	TrackDescriptor *track = (TrackDescriptor *)managedObject;				
-	
-	NSString *trackDescription = nil;
-	if(track.metadata.title)
-		trackDescription = track.metadata.title;
-	else
-		trackDescription = [track.number stringValue];
-	
-	[_statusTextField setStringValue:trackDescription];
-}
-
-- (void) operationDidReturn:(ISRCDetectionOperation *)operation
+- (void) operationDidReturn:(SubchannelSurveyOperation *)operation
 {
 	NSParameterAssert(nil != operation);
 	
@@ -165,15 +122,4 @@ static NSString * const kOperationQueueKVOContext		= @"org.sbooth.Rip.ReadISRCsS
 	}
 }
 
-- (NSManagedObjectContext *) managedObjectContext
-{
-	// Create our own context for accessing the store
-	if(!_managedObjectContext) {
-		_managedObjectContext = [[NSManagedObjectContext alloc] init];
-		[_managedObjectContext setPersistentStoreCoordinator:[(ApplicationDelegate *)[[NSApplication sharedApplication] delegate] persistentStoreCoordinator]];
-	}
-
-	return _managedObjectContext;
-}
-
 @end
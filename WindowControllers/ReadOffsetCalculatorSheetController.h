@@ -26,6 +26,10 @@
 	NSManagedObjectContext *_managedObjectContext;
 	NSOperationQueue *_operationQueue;
 	BOOL _possibleOffsetsShown;
+	
+	NSMutableDictionary *_readOffsetConfidenceLevels;
+	NSMutableDictionary *_readOffsetMatchingTracks;
+	NSUInteger _tracksRemaining;
 }
 
 // ========================================
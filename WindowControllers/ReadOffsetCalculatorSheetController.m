@@ -20,17 +20,28 @@
 #import "AccurateRipQueryOperation.h"
 #import "ExtractionOperation.h"
 #import "ReadOffsetCalculationOperation.h"
+#import "SectorStore.h"
 
 #import "ApplicationDelegate.h"
+#import "Logger.h"
 
 #import "CDDAUtilities.h"
-#import "FileUtilities.h"
 
 // ========================================
 // The number of sectors which will be scanned during offset detection
 // ========================================
 #define MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS 8
 
+// ========================================
+// Multi-track consensus
+// Up to MAXIMUM_TRACKS_TO_CHECK tracks are sampled, and sampling stops early once
+// one offset has been matched in at least MINIMUM_TRACKS_FOR_CONSENSUS tracks and
+// its combined confidence is at least CONSENSUS_CONFIDENCE_RATIO times that of any other offset
+// ========================================
+#define MAXIMUM_TRACKS_TO_CHECK 5
+#define MINIMUM_TRACKS_FOR_CONSENSUS 2
+#define CONSENSUS_CONFIDENCE_RATIO 4
+
 // ========================================
 // Context objects for observeValueForKeyPath:ofObject:change:context:
 // ========================================
@@ -44,6 +55,9 @@ static NSString * const kCalculateOffsetsKVOContext		= @"org.sbooth.Rip.ReadOffs
 @property (assign) NSManagedObjectContext * managedObjectContext;
 @property (assign) NSOperationQueue * operationQueue;
 @property (assign) BOOL possibleOffsetsShown;
+@property (assign) NSMutableDictionary * readOffsetConfidenceLevels;
+@property (assign) NSMutableDictionary * readOffsetMatchingTracks;
+@property (assign) NSUInteger tracksRemaining;
 @end
 
 @interface ReadOffsetCalculatorSheetController (Callbacks)
@@ -54,6 +68,8 @@ static NSString * const kCalculateOffsetsKVOContext		= @"org.sbooth.Rip.ReadOffs
 - (void) managedObjectContextDidSave:(NSNotification *)notification;
 - (void) accurateRipQueryOperationDidFinish:(AccurateRipQueryOperation *)operation;
 - (void) readOffsetCalculationOperationDidFinish:(ReadOffsetCalculationOperation *)operation;
+- (BOOL) consensusReached;
+- (void) presentPossibleReadOffsets;
 @end
 
 @implementation ReadOffsetCalculatorSheetController
@@ -67,6 +83,10 @@ static NSString * const kCalculateOffsetsKVOContext		= @"org.sbooth.Rip.ReadOffs
 
 @synthesize possibleOffsetsShown = _possibleOffsetsShown;
 
+@synthesize readOffsetConfidenceLevels = _readOffsetConfidenceLevels;
+@synthesize readOffsetMatchingTracks = _readOffsetMatchingTracks;
+@synthesize tracksRemaining = _tracksRemaining;
+
 - (id) init
 {
 	if((self = [super initWithWindowNibName:@"ReadOffsetCalculatorSheet"])) {
@@ -412,18 +432,24 @@ static NSString * const kCalculateOffsetsKVOContext		= @"org.sbooth.Rip.ReadOffs
 	NSPredicate *potentialTracksPredicate = [NSPredicate predicateWithFormat:@"number IN %@", trackNumbers];
 	NSSet *potentialTracks = [self.compactDisc.firstSession.tracks filteredSetUsingPredicate:potentialTracksPredicate];
 
-	// Extract a portion of the first track meeting our criteria that is at least six seconds long
-	TrackDescriptor *trackToExtract = nil;
-	for(TrackDescriptor *potentialTrack in potentialTracks) {
+	// Sample the six second points of up to MAXIMUM_TRACKS_TO_CHECK tracks, in disc order, so the
+	// drive reads them in a single forward sweep
+	NSSortDescriptor *trackNumberSortDescriptor = [[NSSortDescriptor alloc] initWithKey:@"number" ascending:YES];
+	NSArray *sortedPotentialTracks = [[potentialTracks allObjects] sortedArrayUsingDescriptors:[NSArray arrayWithObject:trackNumberSortDescriptor]];
+	
+	NSMutableArray *tracksToExtract = [NSMutableArray array];
+	for(TrackDescriptor *potentialTrack in sortedPotentialTracks) {
 		// The track must be at least six seconds long (plus the buffer); if it isn't, skip it
 		if(((6 * CDDA_SECTORS_PER_SECOND) + MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS) > potentialTrack.sectorCount)
 			continue;
 		
-		trackToExtract = potentialTrack;
-		break;
+		[tracksToExtract addObject:potentialTrack];
+		
+		if(MAXIMUM_TRACKS_TO_CHECK == tracksToExtract.count)
+			break;
 	}
 	
-	if(!trackToExtract) {
+	if(!tracksToExtract.count) {
 		NSMutableDictionary *errorDictionary = [NSMutableDictionary dictionary];
 		
 		[errorDictionary setObject:NSLocalizedString(@"This disc cannot be used to calculate the read offset.", @"") forKey:NSLocalizedDescriptionKey];
@@ -436,52 +462,145 @@ static NSString * const kCalculateOffsetsKVOContext		= @"org.sbooth.Rip.ReadOffs
 		return;
 	}
 	
-	SectorRange *trackSectorRange = [trackToExtract sectorRange];
+	self.readOffsetConfidenceLevels = [NSMutableDictionary dictionary];
+	self.readOffsetMatchingTracks = [NSMutableDictionary dictionary];
+	self.tracksRemaining = tracksToExtract.count;
 	
-	// AccurateRip offset checksums start at six seconds into the file
-	NSUInteger sixSecondPointSector = trackSectorRange.firstSector + (6 * CDDA_SECTORS_PER_SECOND);
+	// Each extraction depends on the previous one, forming one ordered read plan, while the offsets for
+	// a track are calculated concurrently with the extraction of the tracks that follow it
+	ExtractionOperation *previousExtractionOperation = nil;
+	for(TrackDescriptor *trackToExtract in tracksToExtract) {
+		SectorRange *trackSectorRange = [trackToExtract sectorRange];
+		
+		// AccurateRip offset checksums start at six seconds into the file
+		NSUInteger sixSecondPointSector = trackSectorRange.firstSector + (6 * CDDA_SECTORS_PER_SECOND);
+		
+		SectorRange *sectorsToExtract = [SectorRange sectorRangeWithFirstSector:(sixSecondPointSector - MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS)
+																	sectorCount:((2 * MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS) + 1)];
+		
+		ExtractionOperation *extractionOperation = [[ExtractionOperation alloc] init];
+		
+		extractionOperation.disk = self.disk;
+		extractionOperation.sectors = sectorsToExtract;
+		extractionOperation.allowedSectors = self.compactDisc.firstSession.sectorRange;
+		extractionOperation.sectorStore = [SectorStore sectorStore];
+		extractionOperation.useC2 = NO;
+		
+		// Offset calculation
+		ReadOffsetCalculationOperation *offsetCalculationOperation = [[ReadOffsetCalculationOperation alloc] init];
+		
+		offsetCalculationOperation.sectorStore = extractionOperation.sectorStore;
+		offsetCalculationOperation.trackID = trackToExtract.objectID;
+		offsetCalculationOperation.sixSecondPointSector = MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS;
+		offsetCalculationOperation.maximumOffsetToCheck = (MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS * AUDIO_FRAMES_PER_CDDA_SECTOR);
+		
+		// Set up operation dependencies
+		if(previousExtractionOperation)
+			[extractionOperation addDependency:previousExtractionOperation];
+		[offsetCalculationOperation addDependency:extractionOperation];
+		
+		[extractionOperation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kExtractAudioKVOContext];
+		[extractionOperation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kExtractAudioKVOContext];
+		[extractionOperation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kExtractAudioKVOContext];
+		
+		[offsetCalculationOperation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kCalculateOffsetsKVOContext];
+		[offsetCalculationOperation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kCalculateOffsetsKVOContext];
+		[offsetCalculationOperation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kCalculateOffsetsKVOContext];
+		
+		// Go!
+		[self.operationQueue addOperation:extractionOperation];
+		[self.operationQueue addOperation:offsetCalculationOperation];
+		
+		previousExtractionOperation = extractionOperation;
+	}
+}
+
+- (void) readOffsetCalculationOperationDidFinish:(ReadOffsetCalculationOperation *)operation
+{
+	NSParameterAssert(nil != operation);
+	
+	// The extracted audio isn't needed once the offsets have been calculated
+	[operation.sectorStore close];
 	
-	SectorRange *sectorsToExtract = [SectorRange sectorRangeWithFirstSector:(sixSecondPointSector - MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS)
-																sectorCount:((2 * MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS) + 1)];
+	// Operations cancelled once a consensus was reached have nothing to contribute
+	if([operation isCancelled] || !self.tracksRemaining)
+		return;
 	
-	ExtractionOperation *extractionOperation = [[ExtractionOperation alloc] init];
+	// A track whose audio couldn't be read completely is skipped, and the remaining tracks decide
+	BOOL trackFailed = (nil != operation.error);
+	for(NSOperation *dependency in [operation dependencies]) {
+		if(![dependency isKindOfClass:[ExtractionOperation class]])
+			continue;
+		
+		ExtractionOperation *extractionOperation = (ExtractionOperation *)dependency;
+		if([extractionOperation isCancelled] || extractionOperation.error || extractionOperation.unreadableSectors.count)
+			trackFailed = YES;
+	}
 	
-	extractionOperation.disk = self.disk;
-	extractionOperation.sectors = sectorsToExtract;
-	extractionOperation.allowedSectors = self.compactDisc.firstSession.sectorRange;
-	extractionOperation.URL = temporaryURLWithExtension(@"wav");
-	extractionOperation.useC2 = NO;
+	if(trackFailed)
+		[[Logger sharedLogger] logMessage:@"Skipping track %@ for read offset calculation: the audio couldn't be read", [[self.managedObjectContext objectWithID:operation.trackID] valueForKey:@"number"]];
+	else {
+		// Combine the confidence levels for each offset across tracks and pressings
+		for(NSDictionary *possibleReadOffset in operation.possibleReadOffsets) {
+			NSNumber *readOffset = [possibleReadOffset objectForKey:kReadOffsetKey];
+		
+			NSUInteger confidenceLevel = [[self.readOffsetConfidenceLevels objectForKey:readOffset] unsignedIntegerValue];
+			confidenceLevel += [[possibleReadOffset objectForKey:kConfidenceLevelKey] unsignedIntegerValue];
+			[self.readOffsetConfidenceLevels setObject:[NSNumber numberWithUnsignedInteger:confidenceLevel] forKey:readOffset];
+		
+			NSMutableSet *matchingTracks = [self.readOffsetMatchingTracks objectForKey:readOffset];
+			if(!matchingTracks) {
+				matchingTracks = [NSMutableSet set];
+				[self.readOffsetMatchingTracks setObject:matchingTracks forKey:readOffset];
+			}
+		
+			[matchingTracks addObject:operation.trackID];
+		}
+	}
+			
+	--self.tracksRemaining;
 	
-	// Offset calculation
-	ReadOffsetCalculationOperation *offsetCalculationOperation = [[ReadOffsetCalculationOperation alloc] init];
+	// Stop sampling tracks once one offset dominates
+	if(self.tracksRemaining && [self consensusReached]) {
+		self.tracksRemaining = 0;
+		[self.operationQueue cancelAllOperations];
+	}
 	
-	offsetCalculationOperation.URL = extractionOperation.URL;
-	offsetCalculationOperation.trackID = trackToExtract.objectID;
-	offsetCalculationOperation.sixSecondPointSector = MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS;
-	offsetCalculationOperation.maximumOffsetToCheck = (MAXIMUM_OFFSET_TO_CHECK_IN_SECTORS * AUDIO_FRAMES_PER_CDDA_SECTOR);
+	if(!self.tracksRemaining)
+		[self presentPossibleReadOffsets];
+}
+
+- (BOOL) consensusReached
+{
+	NSNumber *bestReadOffset = nil;
+	NSUInteger bestConfidenceLevel = 0;
+	NSUInteger runnerUpConfidenceLevel = 0;
 	
-	// Set up operation dependencies
-	[offsetCalculationOperation addDependency:extractionOperation];
+	for(NSNumber *readOffset in self.readOffsetConfidenceLevels) {
+		NSUInteger confidenceLevel = [[self.readOffsetConfidenceLevels objectForKey:readOffset] unsignedIntegerValue];
+		
+		if(!bestReadOffset || confidenceLevel > bestConfidenceLevel) {
+			runnerUpConfidenceLevel = bestConfidenceLevel;
+			bestConfidenceLevel = confidenceLevel;
+			bestReadOffset = readOffset;
+		}
+		else if(confidenceLevel > runnerUpConfidenceLevel)
+			runnerUpConfidenceLevel = confidenceLevel;
+	}
 	
-	[extractionOperation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kExtractAudioKVOContext];
-	[extractionOperation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kExtractAudioKVOContext];
-	[extractionOperation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kExtractAudioKVOContext];
+	if(!bestReadOffset)
+		return NO;
 	
-	[offsetCalculationOperation addObserver:self forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:kCalculateOffsetsKVOContext];
-	[offsetCalculationOperation addObserver:self forKeyPath:@"isCancelled" options:NSKeyValueObservingOptionNew context:kCalculateOffsetsKVOContext];
-	[offsetCalculationOperation addObserver:self forKeyPath:@"isFinished" options:NSKeyValueObservingOptionNew context:kCalculateOffsetsKVOContext];
+	if(MINIMUM_TRACKS_FOR_CONSENSUS > [[self.readOffsetMatchingTracks objectForKey:bestReadOffset] count])
+		return NO;
 	
-	// Go!
-	[self.operationQueue addOperation:extractionOperation];
-	[self.operationQueue addOperation:offsetCalculationOperation];	
+	return (bestConfidenceLevel >= (CONSENSUS_CONFIDENCE_RATIO * runnerUpConfidenceLevel));
 }
 
-- (void) readOffsetCalculationOperationDidFinish:(ReadOffsetCalculationOperation *)operation
+- (void) presentPossibleReadOffsets
 {
-	NSParameterAssert(nil != operation);
-	
 	// If the operation didn't succeed, it isn't worthwhile to continue
-	if(![operation.possibleReadOffsets count]) {
+	if(![self.readOffsetConfidenceLevels count]) {
 		NSMutableDictionary *errorDictionary = [NSMutableDictionary dictionary];
 		
 		[errorDictionary setObject:NSLocalizedString(@"Unable to determine any potential read offsets.", @"") forKey:NSLocalizedDescriptionKey];
@@ -494,7 +613,18 @@ static NSString * const kCalculateOffsetsKVOContext		= @"org.sbooth.Rip.ReadOffs
 		return;
 	}
 	
-	[_possibleOffsetsArrayController addObjects:operation.possibleReadOffsets];
+	NSMutableArray *possibleReadOffsets = [NSMutableArray array];
+	for(NSNumber *readOffset in self.readOffsetConfidenceLevels) {
+		NSDictionary *offsetDictionary = [NSDictionary dictionaryWithObjectsAndKeys:
+										  readOffset, kReadOffsetKey,
+										  [self.readOffsetConfidenceLevels objectForKey:readOffset], kConfidenceLevelKey,
+										  [NSNumber numberWithUnsignedInteger:[[self.readOffsetMatchingTracks objectForKey:readOffset] count]], kMatchingTrackCountKey,
+										  nil];
+		
+		[possibleReadOffsets addObject:offsetDictionary];
+	}
+	
+	[_possibleOffsetsArrayController addObjects:possibleReadOffsets];
 	
 	[_statusTextField setStringValue:[NSString stringWithFormat:NSLocalizedString(@"Detected %i possible read offsets", @""), [[_possibleOffsetsArrayController arrangedObjects] count]]];
 	[_progressIndicator stopAnimation:self];